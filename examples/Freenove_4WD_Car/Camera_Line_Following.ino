@@ -6,16 +6,182 @@
 
 #ifdef  USE_OV2640
 
+//****************************************
+// Constants
+//****************************************
+
+#define CLF_SPEED           1500    // Forward speed
+#define CLF_SPEED_TURN      1500    // Speed difference for full steering
+
+#define CLF_GAIN_OFFSET     1.0         // Steering per unit of line offset
+#define CLF_GAIN_ANGLE      (1. / 45.)  // Steering per degree of line angle
+#define CLF_GAIN_LATERAL    (1. / 50.)  // Steering per millimeter of line distance
+
+// Frames older than this reduce the steering gain by half
+#define CLF_LATENCY_REFERENCE_USEC  (100 * 1000)
+
+// Brake when no line result arrives within this time
+#define CLF_RESULT_TIMEOUT_MSEC     250
+
+// Rows to sample in the bottom half of the QQVGA (160x120) image
+const uint16_t clfRows[] = {60, 70, 80, 90, 100, 110};
+
+// Camera geometry for the floor distances, adjust for the servo mounting
+#define CLF_CAMERA_HEIGHT_MM    95      // Lens height above the floor
+#define CLF_CAMERA_FOV_DEGREES  60      // Horizontal field of view
+#define CLF_LENS_K1             0.      // Barrel distortion, 0 = none
+#define CLF_PAN_FORWARD         SERVO_PAN_START // Pan servo degrees when looking forward
+#define CLF_TILT_LEVEL          90      // Tilt servo degrees when looking level
+
+//****************************************
+// Locals
+//****************************************
+
+R4A_OV2640_LINE clfLine =
+{
+    clfRows,                                // _rows
+    sizeof(clfRows) / sizeof(clfRows[0]),   // _rowCount
+    96,                                     // _threshold
+    true,                                   // _lineIsDark
+    3,                                      // _minimumPixels
+};
+
+R4A_OV2640_REMAP clfRemap =
+{
+    CLF_CAMERA_HEIGHT_MM,   // _cameraHeightMm
+    CLF_CAMERA_FOV_DEGREES, // _fovDegrees
+    CLF_LENS_K1,            // _lensK1
+    CLF_PAN_FORWARD,        // _panForwardDegrees
+    1,                      // _panDirection
+    CLF_TILT_LEVEL,         // _tiltLevelDegrees
+    1,                      // _tiltDirection
+};
+
+// Line location passed from the camera processing to the challenge
+typedef struct _CLF_RESULT
+{
+    uint32_t frameAgeUsec;  // Age of the frame when processed
+    uint8_t rowsFound;      // Number of rows containing the line
+    float offset;           // Line position, -1 (left) to 1 (right)
+    float angleDegrees;     // Line heading, positive leans to the right
+    bool floorValid;        // True when the line was mapped onto the floor
+    float lateralMm;        // Line distance to the right of the robot
+    float floorAngleDegrees;// Line heading on the floor, positive leans right
+} CLF_RESULT;
+
+CLF_RESULT clfResult;           // Most recent result used by the challenge
+CLF_RESULT clfMailboxMessage;   // Message buffer for the mailbox
+R4A_ESP32_MAILBOX clfMailbox =
+{
+    &clfMailboxMessage,     // _message
+    sizeof(CLF_RESULT),     // _length
+};
+uint32_t clfResultMsec;         // Time when the last result was read
+uint32_t clfSequence;           // Last result read from the mailbox
+
+//*********************************************************************
+// Locate the line in the camera image
+// Inputs:
+//   object: Address of a R4A_OV2640 data structure
+//   frameBuffer: Buffer containing the raw image data
+//   postResult: Set true to pass the line location to the challenge
+//   display: Address of Print object for output
+// Outputs:
+//   Returns true if the line was found and false otherwise
+bool clfLocateLine(R4A_OV2640 * object,
+                   camera_fb_t * frameBuffer,
+                   bool postResult,
+                   Print * display)
+{
+    CLF_RESULT result;
+    bool status;
+
+    // Locate the line
+    clfLine._threshold = clfThreshold;
+    clfLine._lineIsDark = clfLineIsDark;
+    status = r4aOv2640LineFind(&clfLine, frameBuffer, display);
+
+    // Pass the line location to the challenge
+    result.frameAgeUsec = object->_frameAgeUsec;
+    result.rowsFound = clfLine._rowsFound;
+    result.offset = clfLine._offset;
+    result.angleDegrees = clfLine._angleDegrees;
+
+    // Convert the line position into floor distances, the tables are
+    // only rebuilt when the frame size or camera position changes
+    result.floorValid = r4aOv2640RemapUpdate(&clfRemap,
+                                             frameBuffer->width,
+                                             frameBuffer->height,
+                                             clfPanStartDegrees,
+                                             clfTiltStartDegrees,
+                                             display)
+                     && r4aOv2640RemapLine(&clfRemap,
+                                           &clfLine,
+                                           &result.lateralMm,
+                                           &result.floorAngleDegrees);
+    if (postResult)
+        r4aEsp32MailboxPost(&clfMailbox, &result);
+    return status;
+}
+
+//*********************************************************************
+// Locate the line in the camera image
+// Inputs:
+//   object: Address of a R4A_OV2640 data structure
+//   frameBuffer: Buffer containing the raw image data
+//   display: Address of Print object for output
+// Outputs:
+//   Returns true if the line was found and false otherwise
+bool clfProcessFrameBuffer(R4A_OV2640 * object,
+                           camera_fb_t * frameBuffer,
+                           Print * display)
+{
+    return clfLocateLine(object, frameBuffer, true, display);
+}
+
 //*********************************************************************
 // Do camera line following
 void clfChallenge(R4A_ROBOT_CHALLENGE * object)
 {
-    static uint32_t lastDisplayMsec;
-    if ((millis() - lastDisplayMsec) >= (15 * 1000))
+    float gain;
+    float steering;
+
+    // Wait for the next frame, brake if the camera stops delivering
+    // results
+    if (!r4aEsp32MailboxRead(&clfMailbox, &clfResult, &clfSequence))
+    {
+        if ((millis() - clfResultMsec) >= CLF_RESULT_TIMEOUT_MSEC)
+            r4aPca9685MotorBrakeAll();
+        return;
+    }
+    clfResultMsec = millis();
+
+    // Stop if the line is not visible
+    if (!clfResult.rowsFound)
     {
-        lastDisplayMsec = millis();
-        Serial.printf("Add your code to CLF::challenge()\r\n");
+        r4aPca9685MotorBrakeAll();
+        return;
     }
+
+    // Reduce the steering gain as the frame age increases to avoid
+    // over correcting based upon an old image
+    gain = (float)CLF_LATENCY_REFERENCE_USEC
+         / (float)(CLF_LATENCY_REFERENCE_USEC + clfResult.frameAgeUsec);
+
+    // Steer towards the line, use the floor distances when the line
+    // was mapped onto the floor
+    if (clfResult.floorValid)
+        steering = gain * ((clfResult.lateralMm * CLF_GAIN_LATERAL)
+                           + (clfResult.floorAngleDegrees * CLF_GAIN_ANGLE));
+    else
+        steering = gain * ((clfResult.offset * CLF_GAIN_OFFSET)
+                           + (clfResult.angleDegrees * CLF_GAIN_ANGLE));
+    if (steering > 1.)
+        steering = 1.;
+    else if (steering < -1.)
+        steering = -1.;
+    robotMotorSetSpeeds(CLF_SPEED + (int16_t)(steering * CLF_SPEED_TURN),
+                        CLF_SPEED - (int16_t)(steering * CLF_SPEED_TURN));
 }
 
 //*********************************************************************
@@ -35,6 +201,8 @@ void clfStart(R4A_ROBOT_CHALLENGE * object)
     servoTilt.positionSet(clfTiltStartDegrees);
 
     // Set the initial state
+    clfSequence = clfMailbox._sequence >> 1;
+    clfResultMsec = millis();
     challengeStart();
 }
 
@@ -39,6 +39,7 @@
 #include <R4A_Freenove_4WD_Car.h>   // Freenove 4WD Car configuration
 
 #define DOWNLOAD_AREA       "/nvm/"
+#define STATIC_AREA         "/www/"
 
 #include "Parameters.h"
 
@@ -62,6 +63,11 @@ bool ov2640ProcessFrameBuffer(R4A_OV2640 * object,
                               Print * display);
 bool ov2640ProcessWebServerFrameBuffer(R4A_OV2640 * object,
                                        camera_fb_t * frameBuffer);
+
+// Forward data declarations, used by the menus
+extern R4A_OV2640_BLOBS ov2640Blobs;
+extern R4A_OV2640_ODOMETRY ov2640Odometry;
+extern R4A_OV2640_WEB_SOCKET ov2640WebSocket;
 #endif  // USE_OV2640
 
 //****************************************
@@ -114,6 +120,13 @@ R4A_I2C_BUS * r4aI2cBus; // I2C bus for menu system
         OV2640_I2C_ADDRESS,     // _i2cAddress
         &r4aOV2640Pins,         // _pins
     };
+    R4A_OV2640_GATE ov2640Gate =
+    {
+        8,                      // _rowStep
+        4,                      // _wordStep
+        0,                      // _threshold, set from ov2640GateThreshold
+        10,                     // _maximumSkip
+    };
 #endif  // USE_OV2640
 #ifdef  USE_ZED_F9P
     R4A_ZED_F9P zedf9p(&i2cBus, ZEDF9P_I2C_ADDRESS);
@@ -317,6 +330,66 @@ const int r4aWifiSsidPasswordEntries = sizeof(r4aWifiSsidPassword)
 
 R4A_WIFI wifi(nullptr, nullptr);
 
+//****************************************
+// Metrics
+//****************************************
+
+// Metrics returned by /metrics
+R4A_METRICS metrics =
+{
+#ifdef  USE_OV2640
+    &ov2640,                    // _ov2640
+#else   // USE_OV2640
+    nullptr,                    // _ov2640
+#endif  // USE_OV2640
+};
+
+//****************************************
+// Telemetry
+//****************************************
+
+// Forward routine declarations
+void webServerTelemetrySnapshot(R4A_TELEMETRY * telemetry);
+
+// Telemetry snapshot returned by /telemetry
+char telemetryBuffer[1024];
+R4A_TELEMETRY telemetry =
+{
+    telemetryBuffer,            // _buffer
+    sizeof(telemetryBuffer),    // _bufferSize
+    webServerTelemetrySnapshot, // _snapshot
+    &wifi,                      // _wifi
+#ifdef  USE_OV2640
+    &ov2640,                    // _ov2640
+#endif  // USE_OV2640
+};
+
+// Telemetry snapshot sent to the /telemetry/stream subscribers, the
+// stream uses its own buffer since it is built by the loop while the
+// /telemetry snapshot is built by the web server task
+char telemetryStreamBuffer[1024];
+R4A_TELEMETRY telemetryStreamSnapshot =
+{
+    telemetryStreamBuffer,          // _buffer
+    sizeof(telemetryStreamBuffer),  // _bufferSize
+    webServerTelemetrySnapshot,     // _snapshot
+    &wifi,                          // _wifi
+#ifdef  USE_OV2640
+    &ov2640,                        // _ov2640
+#endif  // USE_OV2640
+};
+
+// Server-Sent Events telemetry stream, the event adds the SSE framing
+// to the snapshot
+char telemetryStreamMessage[sizeof(telemetryStreamBuffer) + 16];
+R4A_TELEMETRY_STREAM telemetryStream =
+{
+    &telemetryStreamSnapshot,       // _telemetry
+    telemetryStreamMessage,         // _message
+    sizeof(telemetryStreamMessage), // _messageSize
+    &webServer,                     // _webServer
+};
+
 //*********************************************************************
 // Entry point for the application
 void setup()
@@ -545,11 +618,16 @@ void loop()
         if (DEBUG_LOOP_CORE_1)
             callingRoutine("r4aWebServerUpdate");
         r4aWebServerUpdate(&webServer, wifiConnected && webServerEnable);
+
+        // Publish the telemetry to the stream subscribers
+        if (DEBUG_LOOP_CORE_1)
+            callingRoutine("r4aTelemetryStreamUpdate");
+        r4aTelemetryStreamUpdate(&telemetryStream, currentMsec, telemetryStreamMsec);
     }
 
     // Process the next image
 #ifdef  USE_OV2640
-    if (ov2640Present && ov2640Enable)
+    if (ov2640Present && ov2640Enable && (!ov2640._taskHandle))
     {
         if (DEBUG_LOOP_CORE_1)
             callingRoutine("r4aOv2640Update");
@@ -619,7 +697,23 @@ void setupCore0(void *parameter)
         if(DEBUG_BOOT)
             callingRoutine("r4aOv2640Setup");
         Serial.printf("Initializing the OV2640 camera\r\n");
-        r4aOv2640Setup(&ov2640, PIXFORMAT_RGB565);
+
+        // Skip the frames that have not changed, zero processes all frames
+        ov2640Gate._threshold = ov2640GateThreshold;
+        if (ov2640GateThreshold)
+            ov2640._gate = &ov2640Gate;
+        if (r4aOv2640Setup(&ov2640, PIXFORMAT_RGB565, &Serial, ov2640LowLatency)
+            && ov2640Task)
+        {
+            // Process the camera frames in a separate task
+            if(DEBUG_BOOT)
+                callingRoutine("r4aOv2640TaskStart");
+            r4aOv2640TaskStart(&ov2640,
+                               ov2640TaskCore,
+                               ov2640TaskPriority,
+                               &ov2640Enable,
+                               &Serial);
+        }
     }
 #endif  // USE_OV2640
 
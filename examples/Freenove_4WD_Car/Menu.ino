@@ -295,6 +295,16 @@ enum MENU_TABLE_INDEX
 const R4A_MENU_ENTRY debugMenuTable[] =
 {
     // Command  menuRoutine                 menuParam       HelpRoutine align   HelpText
+#ifdef  USE_OV2640
+    {"cb", r4aOv2640ConvertMenuBenchmark,   0,              nullptr,    0,      "Camera pixel conversion benchmark"},
+    {"cjb", r4aOv2640JpegMenuDecodeBenchmark, 0,        nullptr,    0,      "Camera JPEG decode benchmark"},
+    {"clb", r4aOv2640LineMenuBenchmark, 0,          nullptr,    0,      "Camera line detection check and benchmark"},
+    {"crd",     ov2640MenuRecordDisplay, 0,         nullptr,    0,      "Display the camera recording status"},
+    {"crl",     ov2640MenuRecordLoad,   0,          nullptr,    0,      "Load the camera recording from LittleFS"},
+    {"crp",     ov2640MenuRecordReplay, 0,          nullptr,    0,      "Replay the camera recording"},
+    {"crs",     ov2640MenuRecordStart,  0,          nullptr,    0,      "Start the camera recording"},
+    {"crw",     ov2640MenuRecordSave,   0,          nullptr,    0,      "Stop and write the camera recording to LittleFS"},
+#endif  // USE_OV2640
     {"h",       r4aEsp32MenuDisplayHeap,    0,              nullptr,    0,      "Display the heap"},
     {"i",       nullptr,                    MTI_I2C,        nullptr,    0,      "I2C menu"},
     {"l",       nullptr,                    MTI_LED,        nullptr,    0,      "LED menu"},
@@ -366,19 +376,31 @@ const R4A_MENU_ENTRY mainMenuTable[] =
     {"blt",     menuBltStart,       0,              nullptr,    0,      "Basic light tracking"},
 #ifdef  USE_OV2640
     {"c", r4aMenuBoolToggle, (intptr_t)&ov2640Enable, r4aMenuBoolHelp, 0, "Toggle OV2640 camera"},
+    {"cbl", r4aOv2640BlobMenuDisplay, (intptr_t)&ov2640Blobs, nullptr, 0, "Display the camera blobs"},
     {"clf",     menuClfStart,       0,              nullptr,    0,      "Camera line following"},
+    {"cg", r4aOv2640GateMenuDisplay, (intptr_t)&ov2640, nullptr, 0, "Display camera frame gating"},
+    {"cll", r4aOv2640LineMenuDisplay, (intptr_t)&clfLine, nullptr, 0, "Display the camera line"},
+    {"clr", r4aOv2640RemapMenuDisplay, (intptr_t)&clfRemap, nullptr, 0, "Display the camera floor remap"},
+    {"co", r4aOv2640OdometryMenuDisplay, (intptr_t)&ov2640Odometry, nullptr, 0, "Display the camera odometry"},
+    {"cpr", r4aOv2640MenuStageStatsReset, (intptr_t)&ov2640, nullptr, 0, "Reset camera pipeline timing"},
+    {"cps", r4aOv2640MenuDisplayStageStats, (intptr_t)&ov2640, nullptr, 0, "Display camera pipeline timing"},
+    {"cs", r4aOv2640MenuDisplayFrameStats, (intptr_t)&ov2640, nullptr, 0, "Display camera frame statistics"},
+    {"cws", r4aOv2640WebSocketMenuDisplay, (intptr_t)&ov2640WebSocket, nullptr, 0, "Display the camera WebSocket"},
 #endif  // USE_OV2640
     {"d",       nullptr,            MTI_DEBUG,      nullptr,    0,      "Enter the debug menu"},
 #ifdef  USE_ZED_F9P
     {"g",       nullptr,            MTI_GNSS,       nullptr,    0,      "Enter the GNSS menu"},
 #endif  // USE_ZED_F9P
     {"i",  r4aMenuBoolToggle, (intptr_t)&ignoreBatteryCheck, r4aMenuBoolHelp, 0, "Ignore the battery check"},
+    {"m", r4aMetricsMenuDisplay, (intptr_t)&metrics, nullptr, 0, "Display the metrics"},
 #ifdef  USE_NTRIP
     {"NTRIP",   nullptr,            MTI_NTRIP,      nullptr,    0,      "Enter the NTRIP menu"},
 #endif  // USE_NTRIP
     {"nvm",     nullptr,            MTI_NVM,        nullptr,    0,      "Enter the NVM menu"},
     {"r",  r4aEsp32MenuSystemReset, 0,              nullptr,    0,      "System reset"},
     {"s",       robotMenuStop,      0,              nullptr,    0,      "Stop the robot"},
+    {"t", r4aTelemetryMenuDisplay, (intptr_t)&telemetry, nullptr, 0, "Display the telemetry statistics"},
+    {"ts", r4aTelemetryStreamMenuDisplay, (intptr_t)&telemetryStream, nullptr, 0, "Display the telemetry stream status"},
     {"w", r4aMenuBoolToggle, (intptr_t)&webServerEnable, r4aMenuBoolHelp, 0, "Toggle web server"},
     {"wd",     wifiMenuDebug, (intptr_t)&wifiDebug, r4aMenuBoolHelp, 0, "Toggle WiFi debugging"},
     {"wp",      nullptr,            MTI_WAY_POINT,  nullptr,    0,      "Enter the waypoint menu"},
@@ -10,6 +10,10 @@
 // Constants
 //****************************************
 
+#define OV2640_RECORD_BYTES     (1024 * 1024)   // PSRAM used for recording
+#define OV2640_RECORD_FILE      "/camera.rec"   // LittleFS recording file
+#define OV2640_RECORD_QUALITY   0               // JPEG quality, 0 = raw frames
+
 // URI handler structure for GET /jpeg
 const httpd_uri_t ov2640JpegPage =
 {
@@ -22,6 +26,75 @@ const httpd_uri_t ov2640JpegPage =
     .supported_subprotocol = nullptr,
 };
 
+// URI handler structure for GET /camera/stats
+const httpd_uri_t ov2640StatsPage =
+{
+    .uri      = "/camera/stats",
+    .method   = HTTP_GET,
+    .handler  = r4aOv2640StageStatsHandler,
+    .user_ctx = &ov2640,
+    .is_websocket = true,
+    .handle_ws_control_frames = false,
+    .supported_subprotocol = nullptr,
+};
+
+// URI handler structure for the vision results WebSocket
+const httpd_uri_t ov2640WebSocketPage =
+{
+    .uri      = "/camera/ws",
+    .method   = HTTP_GET,
+    .handler  = r4aOv2640WebSocketHandler,
+    .user_ctx = &ov2640WebSocket,
+    .is_websocket = true,
+    .handle_ws_control_frames = false,
+    .supported_subprotocol = nullptr,
+};
+
+//****************************************
+// Locals
+//****************************************
+
+// Bright blobs (lights), the threshold is set from ov2640BlobThreshold
+R4A_OV2640_BLOBS ov2640Blobs =
+{
+    0,                      // _threshold
+    false,                  // _isDark
+    0,                      // _hueBins, select by luminance
+    0,                      // _hueFirst
+    0,                      // _hueLast
+    0,                      // _minimumChroma
+    4,                      // _minimumArea
+};
+
+// Visual odometry over the bottom half of the QQVGA (160x120) image,
+// the results are posted to the mailbox for the control loops
+R4A_OV2640_ODOMETRY_RESULT ov2640OdometryMessage;
+R4A_ESP32_MAILBOX ov2640OdometryMailbox =
+{
+    &ov2640OdometryMessage,             // _message
+    sizeof(R4A_OV2640_ODOMETRY_RESULT), // _length
+};
+R4A_OV2640_ODOMETRY ov2640Odometry =
+{
+    0,                      // _roiX
+    60,                     // _roiY
+    0,                      // _roiWidth
+    0,                      // _roiHeight
+    1,                      // _levels, 1/2 scale
+    6,                      // _searchRadius
+    200,                    // _minimumTexture
+    &ov2640OdometryMailbox, // _mailbox
+};
+R4A_OV2640_RECORDER ov2640Recorder;
+
+// Push the line, blobs and a 40x30 thumbnail to the browsers
+R4A_OV2640_WEB_SOCKET ov2640WebSocket =
+{
+    40,                     // _thumbnailWidth
+    30,                     // _thumbnailHeight
+    &webServer,             // _webServer
+};
+
 //*********************************************************************
 // Process the frame buffer
 // Inputs:
@@ -34,7 +107,61 @@ bool ov2640ProcessFrameBuffer(R4A_OV2640 * object,
                               camera_fb_t * frameBuffer,
                               Print * display)
 {
-    return true;
+    bool status;
+
+    // Save the frame for offline tuning
+    if (ov2640Recorder._recording)
+        r4aOv2640RecorderAdd(&ov2640Recorder, frameBuffer);
+
+    // Locate the lights, zero disables the blob detection
+    if (ov2640BlobThreshold)
+    {
+        ov2640Blobs._threshold = ov2640BlobThreshold;
+        r4aOv2640BlobFind(&ov2640Blobs, frameBuffer, display);
+    }
+
+    // Estimate the motion since the previous frame
+    if (ov2640OdometryEnable)
+        r4aOv2640OdometryUpdate(&ov2640Odometry, frameBuffer, display);
+
+    // Locate the line for camera line following
+    status = clfProcessFrameBuffer(object, frameBuffer, display);
+
+    // Push the results to the browsers
+    r4aOv2640WebSocketPublish(&ov2640WebSocket,
+                              frameBuffer,
+                              &clfLine,
+                              ov2640BlobThreshold ? &ov2640Blobs : nullptr,
+                              display);
+    return status;
+}
+
+//*********************************************************************
+// Process a recorded frame, the results are only displayed by the menus,
+// the challenge and the browsers are not updated
+// Inputs:
+//   object: Address of a R4A_OV2640 data structure
+//   frameBuffer: Buffer containing the raw image data
+//   display: Address of Print object for output
+// Outputs:
+//   Returns true if the processing was successful and false upon error
+bool ov2640ReplayFrameBuffer(R4A_OV2640 * object,
+                             camera_fb_t * frameBuffer,
+                             Print * display)
+{
+    // Locate the lights, zero disables the blob detection
+    if (ov2640BlobThreshold)
+    {
+        ov2640Blobs._threshold = ov2640BlobThreshold;
+        r4aOv2640BlobFind(&ov2640Blobs, frameBuffer, display);
+    }
+
+    // Estimate the motion since the previous frame
+    if (ov2640OdometryEnable)
+        r4aOv2640OdometryUpdate(&ov2640Odometry, frameBuffer, display);
+
+    // Locate the line without passing it to the challenge
+    return clfLocateLine(object, frameBuffer, false, display);
 }
 
 //*********************************************************************
@@ -50,4 +177,84 @@ bool ov2640ProcessWebServerFrameBuffer(R4A_OV2640 * object,
     return true;
 }
 
+//*********************************************************************
+// Display the recording status
+void ov2640MenuRecordDisplay(const struct _R4A_MENU_ENTRY * menuEntry,
+                             const char * command,
+                             Print * display)
+{
+    r4aOv2640RecorderDisplay(&ov2640Recorder, display);
+}
+
+//*********************************************************************
+// Load the recording from LittleFS
+void ov2640MenuRecordLoad(const struct _R4A_MENU_ENTRY * menuEntry,
+                          const char * command,
+                          Print * display)
+{
+    if (r4aOv2640RecorderLoad(&ov2640Recorder, OV2640_RECORD_FILE, display))
+        display->printf("Loaded %d bytes from %s\r\n",
+                        ov2640Recorder._length, OV2640_RECORD_FILE);
+}
+
+//*********************************************************************
+// Replay the recorded frames through the frame processing routine
+void ov2640MenuRecordReplay(const struct _R4A_MENU_ENTRY * menuEntry,
+                            const char * command,
+                            Print * display)
+{
+    uint32_t frames;
+    R4A_ESP32_MAILBOX * mailbox;
+    int64_t usec;
+
+    // The camera task shares the vision data structures
+    if (ov2640Enable)
+    {
+        display->println("ERROR: Disable the camera (c) before replaying the recording!");
+        return;
+    }
+
+    // Replay the frames without posting the odometry to the control loop
+    r4aOv2640RecorderStop(&ov2640Recorder);
+    mailbox = ov2640Odometry._mailbox;
+    ov2640Odometry._mailbox = nullptr;
+    usec = esp_timer_get_time();
+    frames = r4aOv2640Replay(ov2640Recorder._buffer,
+                             ov2640Recorder._length,
+                             &ov2640,
+                             ov2640ReplayFrameBuffer,
+                             display);
+    usec = esp_timer_get_time() - usec;
+    ov2640Odometry._mailbox = mailbox;
+
+    // Display the results
+    display->printf("Replayed %lu frames in %lld uSec", frames, usec);
+    if (frames)
+        display->printf(", %lld uSec/frame", usec / frames);
+    display->println();
+}
+
+//*********************************************************************
+// Save the recording to LittleFS
+void ov2640MenuRecordSave(const struct _R4A_MENU_ENTRY * menuEntry,
+                          const char * command,
+                          Print * display)
+{
+    if (r4aOv2640RecorderSave(&ov2640Recorder, OV2640_RECORD_FILE, display))
+        display->printf("Saved %lu frames to %s\r\n",
+                        ov2640Recorder._frames, OV2640_RECORD_FILE);
+}
+
+//*********************************************************************
+// Start recording the frames
+void ov2640MenuRecordStart(const struct _R4A_MENU_ENTRY * menuEntry,
+                           const char * command,
+                           Print * display)
+{
+    r4aOv2640RecorderBegin(&ov2640Recorder,
+                           OV2640_RECORD_BYTES,
+                           OV2640_RECORD_QUALITY,
+                           display);
+}
+
 #endif  // USE_OV2640
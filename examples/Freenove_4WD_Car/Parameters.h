@@ -11,7 +11,9 @@
 // Camera Line Following (CLF)
 //****************************************
 
+bool clfLineIsDark;
 uint8_t clfPanStartDegrees;
+uint8_t clfThreshold;
 uint8_t clfTiltStartDegrees;
 
 //****************************************
@@ -30,7 +32,14 @@ const char * parameterFilePath;
 // OV2640 camera
 //****************************************
 
+uint8_t ov2640BlobThreshold;
 bool ov2640Enable;
+uint8_t ov2640GateThreshold;
+bool ov2640LowLatency;
+bool ov2640OdometryEnable;
+bool ov2640Task;
+uint8_t ov2640TaskCore;
+uint8_t ov2640TaskPriority;
 
 //****************************************
 // PCA9685
@@ -57,6 +66,7 @@ const char * wpLogFileName;
 
 bool webServerDebug;
 bool webServerEnable;
+uint32_t telemetryStreamMsec;
 
 //****************************************
 // WiFi Access Points
@@ -81,8 +91,10 @@ const char * wifiPassword4;
 const R4A_ESP32_NVM_PARAMETER nvmParameters[] =
 {
     // Camera Line Following (CLF)
-    {true,  R4A_ESP32_NVM_PT_UINT8,  0,          180,           &clfPanStartDegrees,            "clfPanDeg",    10},
-    {true,  R4A_ESP32_NVM_PT_UINT8,  0,          180,           &servoTiltStartDegrees,         "clfTiltDeg",   90},
+    {true,  R4A_ESP32_NVM_PT_BOOL,   0,          1,             &clfLineIsDark,                 "clfDarkLine",  true},
+    {true,  R4A_ESP32_NVM_PT_UINT8,  0,          180,           &clfPanStartDegrees,            "clfPanDeg",    SERVO_PAN_START},
+    {true,  R4A_ESP32_NVM_PT_UINT8,  0,          255,           &clfThreshold,                  "clfThreshold", 96},
+    {true,  R4A_ESP32_NVM_PT_UINT8,  0,          180,           &clfTiltStartDegrees,           "clfTiltDeg",   90},
 
 #ifdef  USE_ZED_F9P
     // GPS (GNSS)
@@ -138,6 +150,15 @@ const R4A_ESP32_NVM_PARAMETER nvmParameters[] =
     // OV2640 camera
 // Required    Type                  Minimum     Maximum        Address                     Name            Default Value
     {true,  R4A_ESP32_NVM_PT_BOOL,   0,          1,             &ov2640Enable,              "Camera",       false},
+    {true,  R4A_ESP32_NVM_PT_UINT8,  0,          255,           &ov2640BlobThreshold,       "CamBlob",      0},
+    {true,  R4A_ESP32_NVM_PT_UINT8,  0,          255,           &ov2640GateThreshold,       "CamGate",      0},
+    {true,  R4A_ESP32_NVM_PT_BOOL,   0,          1,             &ov2640LowLatency,          "CamLowLat",    true},
+    {true,  R4A_ESP32_NVM_PT_BOOL,   0,          1,             &ov2640OdometryEnable,      "CamOdometry",  false},
+    {true,  R4A_ESP32_NVM_PT_BOOL,   0,          1,             &ov2640Task,                "CamTask",      false},
+    {true,  R4A_ESP32_NVM_PT_UINT8,  0,          1,             &ov2640TaskCore,            "CamTaskCore",  1},
+    {true,  R4A_ESP32_NVM_PT_UINT8,  1,          24,            &ov2640TaskPriority,        "CamTaskPri",   2},
+    {true,  R4A_ESP32_NVM_PT_UINT32, 0,          0xffffffff,    &r4aOv2640JpegLatencyMsec,  "JpegMsec",     200},
+    {true,  R4A_ESP32_NVM_PT_UINT32, 0,          0xffffffff,    &r4aOv2640JpegTargetBytes,  "JpegBytes",    0},
 #endif  // USE_OV2640
 
     // PCA9685
@@ -165,6 +186,9 @@ const R4A_ESP32_NVM_PARAMETER nvmParameters[] =
     {true,  R4A_ESP32_NVM_PT_BOOL,   0,          1,             &webServerDebug,            "WebDebug",     false},
     {true,  R4A_ESP32_NVM_PT_BOOL,   0,          1,             &webServerEnable,           "WebServer",    false},
     {true,  R4A_ESP32_NVM_PT_P_CHAR, 0,          0,             &r4aWebServerNvmArea,       "WebNvmArea",   R4A_ESP32_NVM_STRING(DOWNLOAD_AREA)},
+    {true,  R4A_ESP32_NVM_PT_P_CHAR, 0,          0,             &r4aWebServerStaticArea,    "WebStatic",    R4A_ESP32_NVM_STRING(STATIC_AREA)},
+    {true,  R4A_ESP32_NVM_PT_UINT32, 0,          0xffffffff,    &r4aWebServerUploadMaximum, "WebUploadMax", (256 * 1024)},
+    {true,  R4A_ESP32_NVM_PT_UINT32, 0,          (60 * 1000),   &telemetryStreamMsec,       "TelStreamMs",  200},
 
     // WiFi: Public Access Points (APs)
 // Required    Type                  Minimum     Maximum        Address                     Name            Default Value
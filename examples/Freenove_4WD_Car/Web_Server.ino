@@ -14,6 +14,23 @@ void webServerConfigUpdate(R4A_WEB_SERVER * object,
 {
     // Enable matching multiple web pages
     config->uri_match_fn = httpd_uri_match_wildcard;
+
+    // Allow more than the default 8 web pages
+    config->max_uri_handlers = 16;
+
+    // Leave sockets for the telemetry stream subscribers
+    config->max_open_sockets = 12;
+
+    // Run the file transfers and camera images on two workers using
+    // core 0, leaving core 1 for the robot loop
+    object->_asyncWorkers = 2;
+    object->_asyncCore = 0;
+    object->_asyncPriority = 0;
+
+    // Preallocate a response buffer for the server task, each of the
+    // workers and an error response
+    object->_bufferCount = 4;
+    object->_bufferSize = 8192;
 }
 
 //*********************************************************************
@@ -44,6 +61,92 @@ bool webServerRegisterErrorHandlers(R4A_WEB_SERVER * object)
 }
 
 //*********************************************************************
+// Add the application values to the telemetry snapshot
+// Inputs:
+//   telemetry: Address of a R4A_TELEMETRY data structure
+void webServerTelemetrySnapshot(R4A_TELEMETRY * telemetry)
+{
+#ifdef  USE_OV2640
+    CLF_RESULT clfTelemetry;
+    uint32_t clfTelemetrySequence;
+#endif  // USE_OV2640
+
+    // Add the robot sensors
+    r4aTelemetryFloat(telemetry, "batteryVolts", READ_BATTERY_VOLTAGE(nullptr), 2);
+    r4aTelemetryUint(telemetry, "lineSensors", lineSensors);
+
+#ifdef  USE_OV2640
+    // Add the most recent camera line position.  The snapshot and stream
+    // handlers run concurrently, so each read starts with its own
+    // sequence number to get the newest message.  The line is omitted
+    // when no message was posted or the camera task was updating it.
+    memset(&clfTelemetry, 0, sizeof(clfTelemetry));
+    clfTelemetrySequence = 0;
+    if (r4aEsp32MailboxRead(&clfMailbox, &clfTelemetry, &clfTelemetrySequence))
+    {
+        r4aTelemetryObjectBegin(telemetry, "cameraLine");
+        r4aTelemetryUint(telemetry, "rowsFound", clfTelemetry.rowsFound);
+        r4aTelemetryFloat(telemetry, "offset", clfTelemetry.offset, 3);
+        r4aTelemetryFloat(telemetry, "angleDegrees", clfTelemetry.angleDegrees, 1);
+        if (clfTelemetry.floorValid)
+        {
+            r4aTelemetryFloat(telemetry, "lateralMm", clfTelemetry.lateralMm, 1);
+            r4aTelemetryFloat(telemetry, "floorAngleDegrees", clfTelemetry.floorAngleDegrees, 1);
+        }
+        r4aTelemetryUint(telemetry, "frameAgeUsec", clfTelemetry.frameAgeUsec);
+        r4aTelemetryObjectEnd(telemetry);
+    }
+#endif  // USE_OV2640
+
+#ifdef  USE_ZED_F9P
+    // Add the GNSS position
+    r4aTelemetryObjectBegin(telemetry, "gnss");
+    r4aTelemetryFloat(telemetry, "latitude", zedf9p._latitude, 9);
+    r4aTelemetryFloat(telemetry, "longitude", zedf9p._longitude, 9);
+    r4aTelemetryFloat(telemetry, "altitude", zedf9p._altitude, 3);
+    r4aTelemetryFloat(telemetry, "horizontalAccuracy", zedf9p._horizontalAccuracy, 3);
+    r4aTelemetryUint(telemetry, "satellitesInView", zedf9p._satellitesInView);
+    r4aTelemetryObjectEnd(telemetry);
+#endif  // USE_ZED_F9P
+}
+
+//*********************************************************************
+
+// URI handler for the telemetry snapshot
+const httpd_uri_t webServerTelemetryUri =
+{
+    .uri       = "/telemetry",
+    .method    = HTTP_GET,
+    .handler   = r4aTelemetryHandler,
+    .user_ctx  = (void *)&telemetry,
+    .is_websocket = false,
+    .handle_ws_control_frames = false,
+    .supported_subprotocol = nullptr,
+};
+
+// URI handler for the metrics
+const httpd_uri_t webServerMetricsUri =
+{
+    .uri       = "/metrics",
+    .method    = HTTP_GET,
+    .handler   = r4aMetricsHandler,
+    .user_ctx  = (void *)&metrics,
+    .is_websocket = false,
+    .handle_ws_control_frames = false,
+    .supported_subprotocol = nullptr,
+};
+
+// URI handler for the telemetry stream
+const httpd_uri_t webServerTelemetryStreamUri =
+{
+    .uri       = "/telemetry/stream",
+    .method    = HTTP_GET,
+    .handler   = r4aTelemetryStreamHandler,
+    .user_ctx  = (void *)&telemetryStream,
+    .is_websocket = false,
+    .handle_ws_control_frames = false,
+    .supported_subprotocol = nullptr,
+};
 
 // URI handler for getting uploaded files
 const httpd_uri_t webServerFileDownloadUri =
@@ -57,6 +160,41 @@ const httpd_uri_t webServerFileDownloadUri =
     .supported_subprotocol = nullptr,
 };
 
+// URI handlers for uploading files
+const httpd_uri_t webServerFilePostUri =
+{
+    .uri       = DOWNLOAD_AREA "*",  // Match all URIs of type /path/to/file
+    .method    = HTTP_POST,
+    .handler   = r4aWebServerFileUpload,
+    .user_ctx  = (void *)&webServer,
+    .is_websocket = false,
+    .handle_ws_control_frames = false,
+    .supported_subprotocol = nullptr,
+};
+
+const httpd_uri_t webServerFilePutUri =
+{
+    .uri       = DOWNLOAD_AREA "*",  // Match all URIs of type /path/to/file
+    .method    = HTTP_PUT,
+    .handler   = r4aWebServerFileUpload,
+    .user_ctx  = (void *)&webServer,
+    .is_websocket = false,
+    .handle_ws_control_frames = false,
+    .supported_subprotocol = nullptr,
+};
+
+// URI handler for the static web content
+const httpd_uri_t webServerStaticFileUri =
+{
+    .uri       = STATIC_AREA "*",    // Match all URIs of type /www/path/to/file
+    .method    = HTTP_GET,
+    .handler   = r4aWebServerStaticFile,
+    .user_ctx  = (void *)&webServer,
+    .is_websocket = false,
+    .handle_ws_control_frames = false,
+    .supported_subprotocol = nullptr,
+};
+
 //*********************************************************************
 // Register the URI handlers
 // Inputs:
@@ -80,6 +218,59 @@ bool webServerRegisterUriHandlers(R4A_WEB_SERVER * object)
             break;
         }
 
+        // Add the file uploads
+        error = httpd_register_uri_handler(object->_webServer,
+                                           &webServerFilePostUri);
+        if (error == ESP_OK)
+            error = httpd_register_uri_handler(object->_webServer,
+                                               &webServerFilePutUri);
+        if (error != ESP_OK)
+        {
+            if (r4aWebServerDebug)
+                r4aWebServerDebug->printf("ERROR: Failed to register file upload handlers, error: %d!\r\n", error);
+            break;
+        }
+
+        // Add the metrics
+        error = httpd_register_uri_handler(object->_webServer,
+                                           &webServerMetricsUri);
+        if (error != ESP_OK)
+        {
+            if (r4aWebServerDebug)
+                r4aWebServerDebug->printf("ERROR: Failed to register metrics handler, error: %d!\r\n", error);
+            break;
+        }
+
+        // Add the telemetry snapshot
+        error = httpd_register_uri_handler(object->_webServer,
+                                           &webServerTelemetryUri);
+        if (error != ESP_OK)
+        {
+            if (r4aWebServerDebug)
+                r4aWebServerDebug->printf("ERROR: Failed to register telemetry handler, error: %d!\r\n", error);
+            break;
+        }
+
+        // Add the telemetry stream
+        error = httpd_register_uri_handler(object->_webServer,
+                                           &webServerTelemetryStreamUri);
+        if (error != ESP_OK)
+        {
+            if (r4aWebServerDebug)
+                r4aWebServerDebug->printf("ERROR: Failed to register telemetry stream handler, error: %d!\r\n", error);
+            break;
+        }
+
+        // Add the static web content
+        error = httpd_register_uri_handler(object->_webServer,
+                                           &webServerStaticFileUri);
+        if (error != ESP_OK)
+        {
+            if (r4aWebServerDebug)
+                r4aWebServerDebug->printf("ERROR: Failed to register static content handler, error: %d!\r\n", error);
+            break;
+        }
+
 #ifdef  USE_OV2640
         // Add the jpeg camera image page
         error = httpd_register_uri_handler(object->_webServer, &ov2640JpegPage);
@@ -89,6 +280,24 @@ bool webServerRegisterUriHandlers(R4A_WEB_SERVER * object)
                 r4aWebServerDebug->printf("ERROR: Failed to register JPEG handler, error: %d!\r\n", error);
             break;
         }
+
+        // Add the camera pipeline timing page
+        error = httpd_register_uri_handler(object->_webServer, &ov2640StatsPage);
+        if (error != ESP_OK)
+        {
+            if (r4aWebServerDebug)
+                r4aWebServerDebug->printf("ERROR: Failed to register camera stats handler, error: %d!\r\n", error);
+            break;
+        }
+
+        // Add the vision results WebSocket
+        error = httpd_register_uri_handler(object->_webServer, &ov2640WebSocketPage);
+        if (error != ESP_OK)
+        {
+            if (r4aWebServerDebug)
+                r4aWebServerDebug->printf("ERROR: Failed to register camera WebSocket handler, error: %d!\r\n", error);
+            break;
+        }
 #endif  // USE_OV2640
 
         // Successfully registered the handlers
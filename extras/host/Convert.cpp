@@ -0,0 +1,267 @@
+/**********************************************************************
+  Convert.cpp
+
+  Robots-For-All (R4A)
+  Check and benchmark the OV2640 pixel format conversion kernels on the
+  host computer
+
+  Usage:
+      convert [seed]
+
+  Random RGB565 and YUV422 images are converted with the table driven
+  kernels and with the one pixel at a time references below.  The
+  RGB565 luminance must be within one of the floating point value, the
+  hue bins and the YUV422 luminance must match exactly.  Odd pixel
+  counts check the trailing pixel loops.  The time per megapixel is then
+  displayed for the references and the kernels, followed by
+  r4aOv2640ConvertBenchmark.  The program exits with a non-zero status
+  when a check fails.  The seed selects the random pixels.
+**********************************************************************/
+
+#include "R4A_ESP32.h"
+
+//****************************************
+// Constants
+//****************************************
+
+#define CONVERT_HUE_BINS        12          // Matches the benchmark
+#define CONVERT_MINIMUM_CHROMA  2           // Matches the benchmark
+#define CONVERT_PASSES          10          // Benchmark passes
+#define CONVERT_PIXELS          (320 * 240) // QVGA
+
+//****************************************
+// Locals
+//****************************************
+
+// Pixel counts for the checks, not all multiples of four pixels
+const size_t convertPixelCounts[] = {1, 2, 3, 4, 5, 7, 8, 13, 160, 161, CONVERT_PIXELS};
+
+// Hue bin counts for the checks
+const uint8_t convertBins[] = {1, 3, 6, 12, 16, 24, 255};
+
+//*********************************************************************
+// Reference RGB565 to luminance conversion
+void convertReferenceY8(const uint8_t * src, uint8_t * dst, size_t pixelCount)
+{
+    float blue;
+    float green;
+    float red;
+
+    while (pixelCount--)
+    {
+        // High byte: RRRRRGGG, low byte: GGGBBBBB
+        red = (src[0] >> 3) * (255. / 31.);
+        green = (((src[0] & 7) << 3) | (src[1] >> 5)) * (255. / 63.);
+        blue = (src[1] & 0x1f) * (255. / 31.);
+        *dst++ = (uint8_t)((0.299 * red) + (0.587 * green) + (0.114 * blue) + 0.5);
+        src += 2;
+    }
+}
+
+//*********************************************************************
+// Reference RGB565 to hue bin conversion
+void convertReferenceHue(const uint8_t * src,
+                         uint8_t * dst,
+                         size_t pixelCount,
+                         uint8_t bins,
+                         uint8_t minimumChroma)
+{
+    int blue;
+    int chroma;
+    int green;
+    int maximum;
+    int minimum;
+    int numerator;
+    int red;
+
+    while (pixelCount--)
+    {
+        // Use 5-bit components, drop the low bit of green
+        red = src[0] >> 3;
+        green = (((src[0] & 7) << 3) | (src[1] >> 5)) >> 1;
+        blue = src[1] & 0x1f;
+        src += 2;
+
+        // Gray pixels do not have a hue
+        maximum = std::max(red, std::max(green, blue));
+        minimum = std::min(red, std::min(green, blue));
+        chroma = maximum - minimum;
+        if ((chroma == 0) || (chroma < minimumChroma))
+        {
+            *dst++ = R4A_OV2640_HUE_NONE;
+            continue;
+        }
+
+        // Hue in the range of 0 to 6 * chroma, then divide into bins
+        if (maximum == red)
+            numerator = (green - blue + (6 * chroma)) % (6 * chroma);
+        else if (maximum == green)
+            numerator = (2 * chroma) + blue - red;
+        else
+            numerator = (4 * chroma) + red - green;
+        *dst++ = (numerator * bins) / (6 * chroma);
+    }
+}
+
+//*********************************************************************
+// Reference YUV422 to luminance conversion
+void convertReferenceYuv(const uint8_t * src, uint8_t * dst, size_t pixelCount)
+{
+    size_t index;
+
+    for (index = 0; index < pixelCount; index++)
+        dst[index] = src[index * 2];
+}
+
+//*********************************************************************
+// Compare the kernel output with the reference output
+bool convertCompare(const char * name,
+                    size_t pixelCount,
+                    const uint8_t * expected,
+                    const uint8_t * actual,
+                    int tolerance)
+{
+    size_t index;
+
+    for (index = 0; index < pixelCount; index++)
+        if (abs((int)actual[index] - (int)expected[index]) > tolerance)
+        {
+            Serial.printf("FAIL: %s, %d pixels, pixel %d: %d, expecting %d\r\n",
+                          name, (int)pixelCount, (int)index,
+                          actual[index], expected[index]);
+            return false;
+        }
+    return true;
+}
+
+//*********************************************************************
+// Display the time per megapixel
+void convertTime(const char * name,
+                 int64_t referenceUsec,
+                 int64_t kernelUsec)
+{
+    const int64_t pixels = (int64_t)CONVERT_PIXELS * CONVERT_PASSES;
+
+    Serial.printf("    %11lld  %11lld  %s\r\n",
+                  (referenceUsec * 1000 * 1000) / pixels,
+                  (kernelUsec * 1000 * 1000) / pixels,
+                  name);
+}
+
+//*********************************************************************
+// Check and benchmark the pixel conversion kernels
+int main(int argc, char ** argv)
+{
+    uint8_t * actual;
+    int bin;
+    int checks;
+    uint8_t * expected;
+    int failures;
+    size_t index;
+    int64_t kernelUsec;
+    int pass;
+    size_t pixelCount;
+    int64_t referenceUsec;
+    uint8_t * src;
+    int64_t startUsec;
+    int test;
+
+    // Allocate the buffers, the kernels require 32-bit alignment
+    src = (uint8_t *)malloc(CONVERT_PIXELS * 2);
+    actual = (uint8_t *)malloc(CONVERT_PIXELS);
+    expected = (uint8_t *)malloc(CONVERT_PIXELS);
+    if ((!src) || (!actual) || (!expected))
+    {
+        Serial.println("ERROR: Failed to allocate the buffers!");
+        return 1;
+    }
+
+    // Fill the source image, start with every RGB565 value
+    srand((argc > 1) ? atoi(argv[1]) : 1);
+    for (index = 0; index < 65536; index++)
+    {
+        src[index * 2] = index >> 8;
+        src[(index * 2) + 1] = index & 0xff;
+    }
+    for (index = 65536 * 2; index < (CONVERT_PIXELS * 2); index++)
+        src[index] = rand();
+
+    // Compare the kernels with the references
+    checks = 0;
+    failures = 0;
+    for (test = 0; test < (int)(sizeof(convertPixelCounts) / sizeof(convertPixelCounts[0])); test++)
+    {
+        pixelCount = convertPixelCounts[test];
+
+        // RGB565 to Y8, the tables round the high and low byte
+        // contributions separately
+        convertReferenceY8(src, expected, pixelCount);
+        memset(actual, 0, pixelCount);
+        r4aOv2640Rgb565ToY8(src, actual, pixelCount);
+        failures += convertCompare("RGB565 --> Y8", pixelCount, expected, actual, 1) ? 0 : 1;
+        checks += 1;
+
+        // RGB565 to hue bins
+        for (bin = 0; bin < (int)sizeof(convertBins); bin++)
+        {
+            convertReferenceHue(src, expected, pixelCount, convertBins[bin], CONVERT_MINIMUM_CHROMA);
+            memset(actual, 0, pixelCount);
+            r4aOv2640Rgb565ToHue(src, actual, pixelCount, convertBins[bin], CONVERT_MINIMUM_CHROMA);
+            failures += convertCompare("RGB565 --> Hue bins", pixelCount, expected, actual, 0) ? 0 : 1;
+            checks += 1;
+        }
+
+        // YUV422 to Y8
+        convertReferenceYuv(src, expected, pixelCount);
+        memset(actual, 0, pixelCount);
+        r4aOv2640Yuv422ToY8(src, actual, pixelCount);
+        failures += convertCompare("YUV422 --> Y8", pixelCount, expected, actual, 0) ? 0 : 1;
+        checks += 1;
+    }
+    Serial.printf("%d of %d checks passed\r\n", checks - failures, checks);
+
+    // Time the references and the kernels
+    Serial.printf("QVGA frames, %d passes\r\n", CONVERT_PASSES);
+    Serial.println("    Reference        Table");
+    Serial.println("    uSec/Mpixel  uSec/Mpixel  Conversion");
+    Serial.println("    -----------  -----------  ----------");
+
+    startUsec = esp_timer_get_time();
+    for (pass = 0; pass < CONVERT_PASSES; pass++)
+        convertReferenceY8(src, expected, CONVERT_PIXELS);
+    referenceUsec = esp_timer_get_time() - startUsec;
+    startUsec = esp_timer_get_time();
+    for (pass = 0; pass < CONVERT_PASSES; pass++)
+        r4aOv2640Rgb565ToY8(src, actual, CONVERT_PIXELS);
+    kernelUsec = esp_timer_get_time() - startUsec;
+    convertTime("RGB565 --> Y8", referenceUsec, kernelUsec);
+
+    startUsec = esp_timer_get_time();
+    for (pass = 0; pass < CONVERT_PASSES; pass++)
+        convertReferenceHue(src, expected, CONVERT_PIXELS, CONVERT_HUE_BINS, CONVERT_MINIMUM_CHROMA);
+    referenceUsec = esp_timer_get_time() - startUsec;
+    startUsec = esp_timer_get_time();
+    for (pass = 0; pass < CONVERT_PASSES; pass++)
+        r4aOv2640Rgb565ToHue(src, actual, CONVERT_PIXELS, CONVERT_HUE_BINS, CONVERT_MINIMUM_CHROMA);
+    kernelUsec = esp_timer_get_time() - startUsec;
+    convertTime("RGB565 --> Hue bins", referenceUsec, kernelUsec);
+
+    startUsec = esp_timer_get_time();
+    for (pass = 0; pass < CONVERT_PASSES; pass++)
+        convertReferenceYuv(src, expected, CONVERT_PIXELS);
+    referenceUsec = esp_timer_get_time() - startUsec;
+    startUsec = esp_timer_get_time();
+    for (pass = 0; pass < CONVERT_PASSES; pass++)
+        r4aOv2640Yuv422ToY8(src, actual, CONVERT_PIXELS);
+    kernelUsec = esp_timer_get_time() - startUsec;
+    convertTime("YUV422 --> Y8", referenceUsec, kernelUsec);
+
+    // Display the library benchmark
+    Serial.println();
+    r4aOv2640ConvertBenchmark(&Serial);
+
+    free(expected);
+    free(actual);
+    free(src);
+    return failures ? 1 : 0;
+}
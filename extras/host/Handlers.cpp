@@ -0,0 +1,1469 @@
+/**********************************************************************
+  Handlers.cpp
+
+  Robots-For-All (R4A)
+  Test and benchmark the web server handlers on the host computer
+
+  Usage:
+      handlers [requests]
+      handlers -s [port]
+
+  Without options the program checks r4aWebServerRangeParse and
+  r4aWebServerMimeType, then starts the web server on a local port with
+  the Freenove_4WD_Car example's async workers and buffer pool.  The
+  LittleFS files are placed in a temporary directory and the camera
+  returns a stub JPEG frame.  Requests are sent to the telemetry,
+  metrics, file download, file upload, static file, JPEG and error
+  handlers.  Each GET handler is then timed with the requested number
+  (default 1000) of keep-alive requests.  The program exits with a
+  non-zero status when a check fails.
+
+  The -s option starts the web server on the port (default 8080) with
+  the same pages and files and waits for Ctrl-C, allowing curl, ab,
+  wrk or other HTTP tools to send requests to the pages.
+**********************************************************************/
+
+#include <arpa/inet.h>
+#include <dirent.h>
+#include <ftw.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/stat.h>
+
+#include "R4A_ESP32.h"
+
+//****************************************
+// Constants
+//****************************************
+
+#define HANDLERS_ASYNC_WAIT_MSEC    2000    // Time for the server to pass a request to a worker
+#define HANDLERS_BUFFER_COUNT       4       // Matches the example
+#define HANDLERS_BUFFER_SIZE        8192    // Matches the example
+#define HANDLERS_DOWNLOAD_BYTES     20000   // Size of the download file, several buffers
+#define HANDLERS_NVM_AREA           "/nvm/" // Matches the example's DOWNLOAD_AREA
+#define HANDLERS_PORT               8080    // Default port for the -s option
+#define HANDLERS_REQUESTS           1000    // Default requests for each benchmark
+#define HANDLERS_STATIC_AREA        "/www/" // Matches the example's STATIC_AREA
+#define HANDLERS_UPLOAD_BYTES       10000   // Size of each concurrent upload
+#define HANDLERS_UPLOAD_MAXIMUM     (64 * 1024) // Largest upload
+#define HANDLERS_UPLOAD_TEMP        ".~"    // Matches R4A_WEB_SERVER_UPLOAD_TEMP
+#define HANDLERS_WORKERS            2       // Matches the example
+
+//****************************************
+// Types
+//****************************************
+
+typedef struct _HANDLERS_RANGE_TEST
+{
+    const char * _value;        // Range header value
+    size_t _fileSize;           // Number of bytes in the file
+    int _count;                 // Expected return value
+    R4A_WEB_SERVER_RANGE _range[2]; // Expected ranges
+} HANDLERS_RANGE_TEST;
+
+typedef struct _HANDLERS_MIME_TEST
+{
+    const char * _path;         // File path
+    const char * _type;         // Expected MIME type, nullptr when not known
+} HANDLERS_MIME_TEST;
+
+typedef struct _HANDLERS_FILE
+{
+    const char * _path;         // Path in the temporary directory
+    const char * _data;         // File contents
+    size_t _length;             // Number of bytes in the file
+} HANDLERS_FILE;
+
+typedef struct _HANDLERS_CONNECTION
+{
+    int _fd;                    // Socket connected to the web server
+    char * _data;               // Received data
+    size_t _length;             // Number of bytes in the data buffer
+    size_t _size;               // Size of the data buffer in bytes
+} HANDLERS_CONNECTION;
+
+typedef struct _HANDLERS_RESPONSE
+{
+    int _status;                // HTTP status code
+    char _header[1024];         // Response header, may be truncated
+    char * _body;               // Zero terminated response body
+    size_t _bodyLength;         // Number of bytes in the body
+    bool _chunked;              // Body used the chunked transfer encoding
+} HANDLERS_RESPONSE;
+
+//****************************************
+// Locals
+//****************************************
+
+const HANDLERS_RANGE_TEST handlersRangeTests[] =
+{
+    {"bytes=0-99",          1000,  1, {{  0, 100}}},
+    {"bytes=-100",          1000,  1, {{900, 100}}},
+    {"bytes=900-",          1000,  1, {{900, 100}}},
+    {"bytes=500-2000",      1000,  1, {{500, 500}}},
+    {"BYTES=0-0, -1",       1000,  2, {{  0,   1}, {999, 1}}},
+    {"bytes= 10-19 ,30-39", 1000,  2, {{ 10,  10}, { 30, 10}}},
+    {"bytes=-100",            50,  1, {{  0,  50}}},
+    {"bytes=1000-",         1000,  0},
+    {"bytes=-0",            1000,  0},
+    {"bytes=0-",               0,  0},
+    {"bytes=5-4",           1000, -1},
+    {"bytes=0-99;",         1000, -1},
+    {"bytes=",              1000, -1},
+    {"items=0-99",          1000, -1},
+    {"bytes=0-0,1-1,2-2,3-3,4-4,5-5,6-6,7-7,8-8", 1000, -1},
+};
+
+const HANDLERS_MIME_TEST handlersMimeTests[] =
+{
+    {"/index.html",         "text/html"},
+    {"/INDEX.HTM",          "text/html"},
+    {"/web/app.min.js",     "application/javascript"},
+    {"/logs/archive.tar.gz", "application/gzip"},
+    {"/fonts/icons.woff2",  "font/woff2"},
+    {"/camera.rec",         "application/octet-stream"},
+    {"/README",             nullptr},
+    {"/web.d/README",       nullptr},
+    {"/file.unknown",       nullptr},
+    {"/file.",              nullptr},
+};
+
+// Static web content, the compressed script differs from the script
+// to show which file was sent
+const char handlersIndexHtml[] = "<html><body>R4A host</body></html>\n";
+const char handlersAppJs[] = "console.log(\"R4A host\");\n";
+const char handlersAppJsGz[] = "\x1f\x8b\x08\x00 stands in for the compressed script";
+const HANDLERS_FILE handlersFiles[] =
+{
+    {"www/index.html", handlersIndexHtml, sizeof(handlersIndexHtml) - 1},
+    {"www/app.js", handlersAppJs, sizeof(handlersAppJs) - 1},
+    {"www/app.js.gz", handlersAppJsGz, sizeof(handlersAppJsGz) - 1},
+};
+
+// Download file contents, written to camera.rec
+uint8_t handlersDownloadData[HANDLERS_DOWNLOAD_BYTES];
+
+// Temporary directory containing the LittleFS files
+char handlersDirectory[] = "/tmp/r4a_handlers.XXXXXX";
+
+// Stub JPEG image returned by the camera
+const uint8_t handlersJpeg[] =
+{
+    0xff, 0xd8, 0xff, 0xe0, 0x00, 0x10, 'J', 'F', 'I', 'F', 0x00, 0x01,
+    0x01, 0x00, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0xff, 0xd9,
+};
+
+camera_fb_t handlersFrameBuffer =
+{
+    (uint8_t *)handlersJpeg,    // buf
+    sizeof(handlersJpeg),       // len
+    160,                        // width
+    120,                        // height
+    PIXFORMAT_JPEG,             // format
+    {12, 345678},               // timestamp
+};
+
+// The camera registers are written when the JPEG quality changes
+size_t handlersI2cRead(R4A_I2C_BUS * object,
+                       uint8_t deviceI2cAddress,
+                       const uint8_t * cmdBuffer,
+                       size_t cmdByteCount,
+                       uint8_t * readBuffer,
+                       size_t readByteCount,
+                       Print * display,
+                       bool releaseI2cBus);
+bool handlersI2cWrite(R4A_I2C_BUS * object,
+                      uint8_t deviceI2cAddress,
+                      const uint8_t * cmdBuffer,
+                      size_t cmdByteCount,
+                      const uint8_t * dataBuffer,
+                      size_t dataByteCount,
+                      Print * display,
+                      bool releaseI2cBus);
+
+R4A_I2C_BUS handlersI2cBus =
+{
+    0,                      // _lock
+    handlersI2cRead,        // _read
+    handlersI2cWrite,       // _writeWithLock
+};
+
+// Camera for the JPEG handler
+bool handlersProcessWebServerFrameBuffer(R4A_OV2640 * object,
+                                         camera_fb_t * frameBuffer);
+
+R4A_OV2640 handlersCamera =
+{
+    nullptr,                                // _processFrameBuffer
+    handlersProcessWebServerFrameBuffer,    // _processWebServerFrameBuffer
+    20 * 1000 * 1000,                       // _clockHz
+    &handlersI2cBus,                        // _i2cBus
+    0x30,                                   // _i2cAddress
+    nullptr,                                // _pins
+};
+uint32_t handlersFramesProcessed;
+
+R4A_METRICS handlersMetrics;
+
+// Application values added to each snapshot
+void handlersTelemetrySnapshot(R4A_TELEMETRY * telemetry);
+
+char handlersTelemetryBuffer[1024];
+R4A_TELEMETRY handlersTelemetry =
+{
+    handlersTelemetryBuffer,            // _buffer
+    sizeof(handlersTelemetryBuffer),    // _bufferSize
+    handlersTelemetrySnapshot,          // _snapshot
+    nullptr,                            // _wifi
+    nullptr,                            // _ov2640
+};
+
+// Snapshot buffer too small for the telemetry
+char handlersSmallBuffer[16];
+R4A_TELEMETRY handlersSmall =
+{
+    handlersSmallBuffer,                // _buffer
+    sizeof(handlersSmallBuffer),        // _bufferSize
+    nullptr,                            // _snapshot
+    nullptr,                            // _wifi
+    nullptr,                            // _ov2640
+};
+
+// Web server callbacks
+void handlersConfigUpdate(R4A_WEB_SERVER * object, httpd_config_t * config);
+bool handlersRegisterErrorHandlers(R4A_WEB_SERVER * object);
+bool handlersRegisterUriHandlers(R4A_WEB_SERVER * object);
+
+R4A_WEB_SERVER handlersWebServer =
+{
+    handlersConfigUpdate,           // _configUpdate
+    handlersRegisterErrorHandlers,  // _registerErrorHandlers
+    handlersRegisterUriHandlers,    // _registerUriHandlers
+    HANDLERS_PORT,                  // _port
+    nullptr,                        // _webServer
+};
+
+int handlersChecks;
+int handlersFailures;
+
+//****************************************
+// Web server
+//****************************************
+
+//*********************************************************************
+// Add the application values to the telemetry snapshot
+void handlersTelemetrySnapshot(R4A_TELEMETRY * telemetry)
+{
+    r4aTelemetryString(telemetry, "host", "R4A \"host\"");
+    r4aTelemetryFloat(telemetry, "batteryVolts", 7.42, 2);
+}
+
+//*********************************************************************
+// The camera register values are not needed
+size_t handlersI2cRead(R4A_I2C_BUS * object,
+                       uint8_t deviceI2cAddress,
+                       const uint8_t * cmdBuffer,
+                       size_t cmdByteCount,
+                       uint8_t * readBuffer,
+                       size_t readByteCount,
+                       Print * display,
+                       bool releaseI2cBus)
+{
+    return 0;
+}
+
+//*********************************************************************
+// Accept the camera register writes
+bool handlersI2cWrite(R4A_I2C_BUS * object,
+                      uint8_t deviceI2cAddress,
+                      const uint8_t * cmdBuffer,
+                      size_t cmdByteCount,
+                      const uint8_t * dataBuffer,
+                      size_t dataByteCount,
+                      Print * display,
+                      bool releaseI2cBus)
+{
+    return true;
+}
+
+//*********************************************************************
+// Count the frames captured by the JPEG handler
+bool handlersProcessWebServerFrameBuffer(R4A_OV2640 * object,
+                                         camera_fb_t * frameBuffer)
+{
+    __atomic_add_fetch(&handlersFramesProcessed, 1, __ATOMIC_RELAXED);
+    return true;
+}
+
+//*********************************************************************
+// Update the configuration, matching the Freenove_4WD_Car example
+void handlersConfigUpdate(R4A_WEB_SERVER * object, httpd_config_t * config)
+{
+    config->uri_match_fn = httpd_uri_match_wildcard;
+    config->max_uri_handlers = 16;
+    config->max_open_sockets = 12;
+
+    // Run the file transfers and camera images on the workers
+    object->_asyncWorkers = HANDLERS_WORKERS;
+    object->_asyncCore = 0;
+    object->_asyncPriority = 0;
+
+    // Preallocate a response buffer for the server task, each of the
+    // workers and an error response
+    object->_bufferCount = HANDLERS_BUFFER_COUNT;
+    object->_bufferSize = HANDLERS_BUFFER_SIZE;
+}
+
+//*********************************************************************
+// Register the error handlers
+bool handlersRegisterErrorHandlers(R4A_WEB_SERVER * object)
+{
+    int index;
+
+    for (index = 0; index < r4aHttpErrorCount; index++)
+        if (httpd_register_err_handler(object->_webServer,
+                                       r4aHttpError[index],
+                                       r4aWebServerError) != ESP_OK)
+            return false;
+    return true;
+}
+
+//*********************************************************************
+// Register the URI handlers
+bool handlersRegisterUriHandlers(R4A_WEB_SERVER * object)
+{
+    int index;
+    const httpd_uri_t uriHandlers[] =
+    {
+        {"/jpeg", HTTP_GET, r4aOV2640JpegHandler, &handlersCamera},
+        {"/metrics", HTTP_GET, r4aMetricsHandler, &handlersMetrics},
+        {HANDLERS_NVM_AREA "*", HTTP_GET, r4aWebServerFileDownload, object},
+        {HANDLERS_NVM_AREA "*", HTTP_PUT, r4aWebServerFileUpload, object},
+        {"/small", HTTP_GET, r4aTelemetryHandler, &handlersSmall},
+        {"/telemetry", HTTP_GET, r4aTelemetryHandler, &handlersTelemetry},
+        {HANDLERS_STATIC_AREA "*", HTTP_GET, r4aWebServerStaticFile, object},
+    };
+
+    for (index = 0; index < (int)(sizeof(uriHandlers) / sizeof(uriHandlers[0])); index++)
+        if (httpd_register_uri_handler(object->_webServer, &uriHandlers[index]) != ESP_OK)
+        {
+            Serial.printf("ERROR: Failed to register %s!\r\n", uriHandlers[index].uri);
+            return false;
+        }
+    return true;
+}
+
+//****************************************
+// Client
+//****************************************
+
+//*********************************************************************
+// Connect to the web server
+bool handlersConnect(HANDLERS_CONNECTION * connection, uint16_t port)
+{
+    struct sockaddr_in address;
+    int one;
+
+    memset(connection, 0, sizeof(*connection));
+    connection->_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (connection->_fd < 0)
+        return false;
+    one = 1;
+    setsockopt(connection->_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    if (connect(connection->_fd, (struct sockaddr *)&address, sizeof(address)))
+    {
+        close(connection->_fd);
+        connection->_fd = -1;
+        return false;
+    }
+    return true;
+}
+
+//*********************************************************************
+// Close the connection
+void handlersDisconnect(HANDLERS_CONNECTION * connection)
+{
+    if (connection->_fd >= 0)
+        close(connection->_fd);
+    connection->_fd = -1;
+    free(connection->_data);
+    connection->_data = nullptr;
+    connection->_length = 0;
+    connection->_size = 0;
+}
+
+//*********************************************************************
+// Receive until the buffer contains the requested number of bytes
+bool handlersFill(HANDLERS_CONNECTION * connection, size_t length)
+{
+    char * data;
+    ssize_t received;
+    size_t size;
+
+    while (connection->_length < length)
+    {
+        // Grow the buffer
+        if ((connection->_size - connection->_length) < 1024)
+        {
+            size = connection->_size ? connection->_size * 2 : 8192;
+            data = (char *)realloc(connection->_data, size + 1);
+            if (!data)
+                return false;
+            connection->_data = data;
+            connection->_size = size;
+        }
+
+        // Receive more data
+        received = recv(connection->_fd,
+                        &connection->_data[connection->_length],
+                        connection->_size - connection->_length,
+                        0);
+        if (received <= 0)
+            return false;
+        connection->_length += received;
+        connection->_data[connection->_length] = 0;
+    }
+    return true;
+}
+
+//*********************************************************************
+// Locate the end of a line in the received data
+size_t handlersLine(HANDLERS_CONNECTION * connection, size_t offset)
+{
+    char * end;
+
+    while (1)
+    {
+        if (connection->_length > offset)
+        {
+            end = strstr(&connection->_data[offset], "\r\n");
+            if (end)
+                return end - connection->_data;
+        }
+        if (!handlersFill(connection, connection->_length + 1))
+            return 0;
+    }
+}
+
+//*********************************************************************
+// Locate a response header value
+const char * handlersHeader(HANDLERS_RESPONSE * response, const char * field)
+{
+    const char * line;
+    size_t length;
+
+    length = strlen(field);
+    for (line = strstr(response->_header, "\r\n"); line; line = strstr(line, "\r\n"))
+    {
+        line += 2;
+        if ((strncasecmp(line, field, length) == 0) && (line[length] == ':'))
+            return &line[length + 2];
+    }
+    return nullptr;
+}
+
+//*********************************************************************
+// Locate a response header value and compare it with a string
+bool handlersHeaderMatch(HANDLERS_RESPONSE * response,
+                         const char * field,
+                         const char * value)
+{
+    size_t length;
+    const char * line;
+
+    line = handlersHeader(response, field);
+    length = strlen(value);
+    return line && (strncmp(line, value, length) == 0)
+        && (line[length] == '\r') && (line[length + 1] == '\n');
+}
+
+//*********************************************************************
+// Send data to the web server
+bool handlersSendData(HANDLERS_CONNECTION * connection,
+                      const void * data,
+                      size_t length)
+{
+    const char * buffer;
+    ssize_t bytesSent;
+
+    buffer = (const char *)data;
+    while (length)
+    {
+        bytesSent = send(connection->_fd, buffer, length, MSG_NOSIGNAL);
+        if (bytesSent <= 0)
+            return false;
+        buffer += bytesSent;
+        length -= bytesSent;
+    }
+    return true;
+}
+
+//*********************************************************************
+// Send a request header, the headers string contains complete lines
+bool handlersSend(HANDLERS_CONNECTION * connection,
+                  const char * method,
+                  const char * uri,
+                  const char * headers,
+                  size_t contentLength)
+{
+    char contentLengthLine[48];
+    size_t length;
+    char request[1024];
+
+    contentLengthLine[0] = 0;
+    if (contentLength)
+        snprintf(contentLengthLine, sizeof(contentLengthLine),
+                 "Content-Length: %lu\r\n", (unsigned long)contentLength);
+    length = snprintf(request, sizeof(request),
+                      "%s %s HTTP/1.1\r\nHost: localhost\r\nUser-Agent: r4a-handlers\r\n%s%s\r\n",
+                      method, uri, headers, contentLengthLine);
+    if (length >= sizeof(request))
+        return false;
+    return handlersSendData(connection, request, length);
+}
+
+//*********************************************************************
+// Receive the response
+bool handlersReceive(HANDLERS_CONNECTION * connection,
+                     HANDLERS_RESPONSE * response)
+{
+    size_t bodyLength;
+    size_t end;
+    size_t headerLength;
+    size_t length;
+    size_t offset;
+    const char * value;
+
+    free(response->_body);
+    memset(response, 0, sizeof(*response));
+
+    // Receive the response header
+    headerLength = 0;
+    offset = 0;
+    while (!headerLength)
+    {
+        end = handlersLine(connection, offset);
+        if (!end)
+            return false;
+        if (end == offset)
+            headerLength = end + 2;
+        offset = end + 2;
+    }
+    length = headerLength;
+    if (length >= sizeof(response->_header))
+        length = sizeof(response->_header) - 1;
+    memcpy(response->_header, connection->_data, length);
+    response->_header[length] = 0;
+    if (sscanf(response->_header, "HTTP/1.1 %d", &response->_status) != 1)
+        return false;
+
+    // Receive the body
+    value = handlersHeader(response, "Transfer-Encoding");
+    response->_chunked = value && (strncmp(value, "chunked", 7) == 0);
+    response->_body = (char *)malloc(1);
+    if (!response->_body)
+        return false;
+    offset = headerLength;
+    if (response->_chunked)
+    {
+        while (1)
+        {
+            // Get the chunk length
+            end = handlersLine(connection, offset);
+            if (!end)
+                return false;
+            length = strtoul(&connection->_data[offset], nullptr, 16);
+            offset = end + 2;
+            if (!handlersFill(connection, offset + length + 2))
+                return false;
+
+            // Add the chunk to the body
+            if (length)
+            {
+                response->_body = (char *)realloc(response->_body,
+                                                  response->_bodyLength + length + 1);
+                if (!response->_body)
+                    return false;
+                memcpy(&response->_body[response->_bodyLength],
+                       &connection->_data[offset],
+                       length);
+                response->_bodyLength += length;
+            }
+            offset += length + 2;
+            if (!length)
+                break;
+        }
+    }
+    else
+    {
+        value = handlersHeader(response, "Content-Length");
+        bodyLength = value ? strtoul(value, nullptr, 10) : 0;
+        if (!handlersFill(connection, offset + bodyLength))
+            return false;
+        response->_body = (char *)realloc(response->_body, bodyLength + 1);
+        if (!response->_body)
+            return false;
+        memcpy(response->_body, &connection->_data[offset], bodyLength);
+        response->_bodyLength = bodyLength;
+        offset += bodyLength;
+    }
+    response->_body[response->_bodyLength] = 0;
+
+    // Keep the data following the response
+    connection->_length -= offset;
+    memmove(connection->_data, &connection->_data[offset], connection->_length);
+    connection->_data[connection->_length] = 0;
+    return true;
+}
+
+//*********************************************************************
+// Send a request and receive the response
+bool handlersRequest(HANDLERS_CONNECTION * connection,
+                     const char * method,
+                     const char * uri,
+                     const char * headers,
+                     const void * body,
+                     size_t length,
+                     HANDLERS_RESPONSE * response)
+{
+    return handlersSend(connection, method, uri, headers, length)
+        && handlersSendData(connection, body, length)
+        && handlersReceive(connection, response);
+}
+
+//*********************************************************************
+// Send a GET request and receive the response
+bool handlersGet(HANDLERS_CONNECTION * connection,
+                 const char * uri,
+                 HANDLERS_RESPONSE * response)
+{
+    return handlersRequest(connection, "GET", uri, "", nullptr, 0, response);
+}
+
+//****************************************
+// Files
+//****************************************
+
+//*********************************************************************
+// Write a file in the temporary directory
+bool handlersFileWrite(const char * path, const void * data, size_t length)
+{
+    FILE * file;
+    bool written;
+
+    file = fopen(path, "wb");
+    if (!file)
+        return false;
+    written = (fwrite(data, 1, length, file) == length);
+    return (fclose(file) == 0) && written;
+}
+
+//*********************************************************************
+// Create the LittleFS files in a temporary directory
+bool handlersFilesCreate()
+{
+    size_t index;
+
+    // The host LittleFS uses the current directory
+    if ((!mkdtemp(handlersDirectory)) || chdir(handlersDirectory))
+    {
+        Serial.printf("ERROR: Failed to create %s!\r\n", handlersDirectory);
+        return false;
+    }
+
+    // Create the download file
+    for (index = 0; index < sizeof(handlersDownloadData); index++)
+        handlersDownloadData[index] = rand();
+    if (!handlersFileWrite("camera.rec", handlersDownloadData, sizeof(handlersDownloadData)))
+    {
+        Serial.println("ERROR: Failed to write camera.rec!");
+        return false;
+    }
+
+    // Create the static web content
+    if (mkdir("www", 0755))
+    {
+        Serial.println("ERROR: Failed to create the www directory!");
+        return false;
+    }
+    for (index = 0; index < (sizeof(handlersFiles) / sizeof(handlersFiles[0])); index++)
+        if (!handlersFileWrite(handlersFiles[index]._path,
+                               handlersFiles[index]._data,
+                               handlersFiles[index]._length))
+        {
+            Serial.printf("ERROR: Failed to write %s!\r\n", handlersFiles[index]._path);
+            return false;
+        }
+
+    // Select the areas used by the handlers
+    r4aWebServerNvmArea = HANDLERS_NVM_AREA;
+    r4aWebServerStaticArea = HANDLERS_STATIC_AREA;
+    r4aWebServerUploadMaximum = HANDLERS_UPLOAD_MAXIMUM;
+    return true;
+}
+
+//*********************************************************************
+// Remove a file or directory
+int handlersFileRemove(const char * path,
+                       const struct stat * status,
+                       int type,
+                       struct FTW * ftw)
+{
+    return remove(path);
+}
+
+//*********************************************************************
+// Remove the temporary directory
+void handlersFilesRemove()
+{
+    if (chdir("/")
+        || nftw(handlersDirectory, handlersFileRemove, 16, FTW_DEPTH | FTW_PHYS))
+        Serial.printf("ERROR: Failed to remove %s!\r\n", handlersDirectory);
+}
+
+//****************************************
+// Checks
+//****************************************
+
+//*********************************************************************
+// Account for a check
+void handlersCheck(bool passed, const char * format, ...)
+{
+    va_list args;
+    char line[256];
+
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    handlersChecks += 1;
+    if (!passed)
+        handlersFailures += 1;
+    Serial.printf("    %s  %s\r\n", passed ? "PASS" : "FAIL", line);
+}
+
+//*********************************************************************
+// Check the range parser
+void handlersRangeCheck()
+{
+    int count;
+    int index;
+    bool passed;
+    R4A_WEB_SERVER_RANGE ranges[R4A_WEB_SERVER_RANGES_MAX];
+    const HANDLERS_RANGE_TEST * test;
+    int tests;
+
+    Serial.println("r4aWebServerRangeParse");
+    tests = sizeof(handlersRangeTests) / sizeof(handlersRangeTests[0]);
+    for (index = 0; index < tests; index++)
+    {
+        test = &handlersRangeTests[index];
+        memset(ranges, 0, sizeof(ranges));
+        count = r4aWebServerRangeParse(test->_value,
+                                       test->_fileSize,
+                                       ranges,
+                                       R4A_WEB_SERVER_RANGES_MAX);
+        passed = (count == test->_count);
+        if (passed && (count > 0))
+            passed = (memcmp(ranges, test->_range, count * sizeof(ranges[0])) == 0);
+        handlersCheck(passed, "\"%s\", %lu bytes: %d ranges, %lu-%lu",
+                      test->_value,
+                      (unsigned long)test->_fileSize,
+                      count,
+                      (unsigned long)ranges[0]._offset,
+                      (unsigned long)ranges[0]._length);
+    }
+}
+
+//*********************************************************************
+// Check the MIME type lookup
+void handlersMimeCheck()
+{
+    char path[32];
+    int index;
+    const HANDLERS_MIME_TEST * test;
+    int tests;
+    const char * type;
+
+    Serial.println("r4aWebServerMimeType");
+    tests = sizeof(handlersMimeTests) / sizeof(handlersMimeTests[0]);
+    for (index = 0; index < tests; index++)
+    {
+        test = &handlersMimeTests[index];
+        type = r4aWebServerMimeType(test->_path);
+        handlersCheck((type == test->_type)
+                      || (type && test->_type && (strcmp(type, test->_type) == 0)),
+                      "%s: %s", test->_path, type ? type : "Unknown");
+    }
+
+    // Every extension in the table must be found
+    for (index = 0; index < r4aHttpMimeTypeCount; index++)
+    {
+        snprintf(path, sizeof(path), "/file.%s", r4aHttpMimeType[index]._extension);
+        type = r4aWebServerMimeType(path);
+        if (type != r4aHttpMimeType[index]._type)
+            break;
+    }
+    handlersCheck(index >= r4aHttpMimeTypeCount, "%d of %d table extensions found",
+                  index, r4aHttpMimeTypeCount);
+}
+
+//*********************************************************************
+// Check the responses from the handlers
+void handlersServerCheck(uint16_t port)
+{
+    HANDLERS_CONNECTION connection;
+    bool passed;
+    HANDLERS_RESPONSE response;
+    uint32_t scrapes;
+    const char * value;
+
+    memset(&response, 0, sizeof(response));
+    Serial.println("Web server");
+    if (!handlersConnect(&connection, port))
+    {
+        handlersCheck(false, "Connect to port %d", port);
+        return;
+    }
+
+    // The telemetry snapshot is a JSON object
+    passed = handlersGet(&connection, "/telemetry", &response);
+    value = handlersHeader(&response, "Content-Type");
+    handlersCheck(passed && (response._status == 200)
+                  && value && (strncmp(value, "application/json\r\n", 18) == 0)
+                  && (!response._chunked)
+                  && (response._body[0] == '{')
+                  && (response._body[response._bodyLength - 1] == '}')
+                  && strstr(response._body, "\"uptimeMsec\":")
+                  && strstr(response._body, "\"host\":\"R4A \\\"host\\\"\"")
+                  && strstr(response._body, "\"batteryVolts\":7.42,")
+                  && strstr(response._body, "\"snapshotUsec\":"),
+                  "GET /telemetry: %d, %lu bytes",
+                  response._status, (unsigned long)response._bodyLength);
+    value = handlersHeader(&response, "Cache-Control");
+    handlersCheck(value && (strncmp(value, "no-store\r\n", 10) == 0),
+                  "GET /telemetry: Cache-Control no-store");
+
+    // The metrics are sent in chunks on the same connection
+    scrapes = handlersMetrics._scrapes;
+    passed = handlersGet(&connection, "/metrics", &response);
+    value = handlersHeader(&response, "Content-Type");
+    handlersCheck(passed && (response._status == 200)
+                  && value && (strncmp(value, "text/plain; version=0.0.4\r\n", 27) == 0)
+                  && response._chunked
+                  && strstr(response._body, "# TYPE r4a_web_errors_total counter\n")
+                  && strstr(response._body, "r4a_web_download_seconds_bucket{le=\"+Inf\"}")
+                  && (response._body[response._bodyLength - 1] == '\n')
+                  && (handlersMetrics._scrapes == (scrapes + 1)),
+                  "GET /metrics: %d, %lu bytes",
+                  response._status, (unsigned long)response._bodyLength);
+
+    // A snapshot that does not fit in the buffer
+    passed = handlersGet(&connection, "/small", &response);
+    handlersCheck(passed && (response._status == 500)
+                  && (strcmp(response._body, "Telemetry buffer too small") == 0),
+                  "GET /small: %d, %s", response._status,
+                  response._body ? response._body : "");
+    handlersDisconnect(&connection);
+
+    // The error handler reports the missing page
+    if (handlersConnect(&connection, port))
+    {
+        passed = handlersGet(&connection, "/missing", &response);
+        handlersCheck(passed && (response._status == 404)
+                      && strstr(response._body, "HTTPD_404_NOT_FOUND"),
+                      "GET /missing: %d", response._status);
+        handlersDisconnect(&connection);
+    }
+    else
+        handlersCheck(false, "Connect to port %d", port);
+    free(response._body);
+}
+
+//*********************************************************************
+// Get the value of a counter
+uint32_t handlersMetricValue(R4A_METRIC * metric)
+{
+    return __atomic_load_n(&metric->_value, __ATOMIC_RELAXED);
+}
+
+//*********************************************************************
+// Compare a file with the expected contents
+bool handlersFileMatch(const char * path, const void * data, size_t length)
+{
+    uint8_t * buffer;
+    FILE * file;
+    bool match;
+
+    match = false;
+    buffer = (uint8_t *)malloc(length + 1);
+    file = fopen(path, "rb");
+    if (buffer && file)
+        match = (fread(buffer, 1, length + 1, file) == length)
+             && (memcmp(buffer, data, length) == 0);
+    if (file)
+        fclose(file);
+    free(buffer);
+    return match;
+}
+
+//*********************************************************************
+// Check the file downloads and byte ranges
+void handlersDownloadCheck(uint16_t port)
+{
+    const char * boundary;
+    char contentRange[64];
+    HANDLERS_CONNECTION connection;
+    char * expected;
+    size_t expectedLength;
+    bool passed;
+    HANDLERS_RESPONSE response;
+
+    memset(&response, 0, sizeof(response));
+    Serial.println("r4aWebServerFileDownload");
+    if (!handlersConnect(&connection, port))
+    {
+        handlersCheck(false, "Connect to port %d", port);
+        return;
+    }
+
+    // The entire file is sent in chunks
+    passed = handlersGet(&connection, HANDLERS_NVM_AREA "camera.rec", &response);
+    handlersCheck(passed && (response._status == 200)
+                  && handlersHeaderMatch(&response, "Content-Type", "application/octet-stream")
+                  && handlersHeaderMatch(&response, "Accept-Ranges", "bytes")
+                  && response._chunked
+                  && (response._bodyLength == sizeof(handlersDownloadData))
+                  && (memcmp(response._body, handlersDownloadData, sizeof(handlersDownloadData)) == 0),
+                  "GET %scamera.rec: %d, %lu bytes", HANDLERS_NVM_AREA,
+                  response._status, (unsigned long)response._bodyLength);
+
+    // A single range
+    passed = handlersRequest(&connection, "GET", HANDLERS_NVM_AREA "camera.rec",
+                             "Range: bytes=100-199\r\n", nullptr, 0, &response);
+    snprintf(contentRange, sizeof(contentRange), "bytes 100-199/%d", HANDLERS_DOWNLOAD_BYTES);
+    handlersCheck(passed && (response._status == 206)
+                  && handlersHeaderMatch(&response, "Content-Range", contentRange)
+                  && (response._bodyLength == 100)
+                  && (memcmp(response._body, &handlersDownloadData[100], 100) == 0),
+                  "Range: bytes=100-199: %d, %lu bytes",
+                  response._status, (unsigned long)response._bodyLength);
+
+    // Multiple ranges, the second range spans several response buffers
+    passed = handlersRequest(&connection, "GET", HANDLERS_NVM_AREA "camera.rec",
+                             "Range: bytes=0-9, 1000-18999, -5\r\n", nullptr, 0, &response);
+    boundary = handlersHeader(&response, "Content-Type");
+    if (boundary && (strncmp(boundary, "multipart/byteranges; boundary=", 31) == 0))
+        boundary = &boundary[31];
+    else
+        boundary = nullptr;
+    expected = (char *)malloc(sizeof(handlersDownloadData) + 1024);
+    expectedLength = 0;
+    if (boundary && expected)
+    {
+        const size_t boundaryLength = strchr(boundary, '\r') - boundary;
+        const size_t ranges[][2] =
+        {
+            {0, 10},
+            {1000, 18000},
+            {HANDLERS_DOWNLOAD_BYTES - 5, 5},
+        };
+
+        for (int index = 0; index < 3; index++)
+        {
+            expectedLength += sprintf(&expected[expectedLength],
+                                      "\r\n--%.*s\r\n"
+                                      "Content-Type: application/octet-stream\r\n"
+                                      "Content-Range: bytes %lu-%lu/%d\r\n\r\n",
+                                      (int)boundaryLength, boundary,
+                                      (unsigned long)ranges[index][0],
+                                      (unsigned long)(ranges[index][0] + ranges[index][1] - 1),
+                                      HANDLERS_DOWNLOAD_BYTES);
+            memcpy(&expected[expectedLength],
+                   &handlersDownloadData[ranges[index][0]],
+                   ranges[index][1]);
+            expectedLength += ranges[index][1];
+        }
+        expectedLength += sprintf(&expected[expectedLength], "\r\n--%.*s--\r\n",
+                                  (int)boundaryLength, boundary);
+    }
+    handlersCheck(passed && (response._status == 206) && boundary
+                  && (response._bodyLength == expectedLength)
+                  && (memcmp(response._body, expected, expectedLength) == 0),
+                  "Range: bytes=0-9, 1000-18999, -5: %d, %lu bytes",
+                  response._status, (unsigned long)response._bodyLength);
+    free(expected);
+
+    // None of the ranges are within the file
+    passed = handlersRequest(&connection, "GET", HANDLERS_NVM_AREA "camera.rec",
+                             "Range: bytes=30000-\r\n", nullptr, 0, &response);
+    snprintf(contentRange, sizeof(contentRange), "bytes */%d", HANDLERS_DOWNLOAD_BYTES);
+    handlersCheck(passed && (response._status == 416)
+                  && handlersHeaderMatch(&response, "Content-Range", contentRange)
+                  && (response._bodyLength == 0),
+                  "Range: bytes=30000-: %d", response._status);
+
+    // A missing file
+    passed = handlersGet(&connection, HANDLERS_NVM_AREA "missing.rec", &response);
+    handlersCheck(passed && (response._status == 404)
+                  && (strcmp(response._body, "File does not exist") == 0),
+                  "GET %smissing.rec: %d", HANDLERS_NVM_AREA, response._status);
+    handlersDisconnect(&connection);
+    free(response._body);
+}
+
+//*********************************************************************
+// Check the static web content
+void handlersStaticCheck(uint16_t port)
+{
+    HANDLERS_CONNECTION connection;
+    uint32_t errors;
+    char etag[64];
+    char ifNoneMatch[96];
+    size_t length;
+    bool passed;
+    HANDLERS_RESPONSE response;
+    const char * value;
+
+    memset(&response, 0, sizeof(response));
+    Serial.println("r4aWebServerStaticFile");
+    if (!handlersConnect(&connection, port))
+    {
+        handlersCheck(false, "Connect to port %d", port);
+        return;
+    }
+
+    // The page is sent with the cache validators
+    passed = handlersGet(&connection, HANDLERS_STATIC_AREA "index.html", &response);
+    value = handlersHeader(&response, "ETag");
+    length = value ? strchr(value, '\r') - value : 0;
+    if (length >= sizeof(etag))
+        length = 0;
+    memcpy(etag, value ? value : "", length);
+    etag[length] = 0;
+    handlersCheck(passed && (response._status == 200)
+                  && handlersHeaderMatch(&response, "Content-Type", "text/html")
+                  && (etag[0] == '"') && (etag[length - 1] == '"')
+                  && handlersHeader(&response, "Cache-Control")
+                  && handlersHeader(&response, "Last-Modified")
+                  && handlersHeaderMatch(&response, "Vary", "Accept-Encoding")
+                  && (strcmp(response._body, handlersIndexHtml) == 0),
+                  "GET %sindex.html: %d, ETag %s", HANDLERS_STATIC_AREA,
+                  response._status, etag);
+
+    // The browser's copy is current
+    snprintf(ifNoneMatch, sizeof(ifNoneMatch), "If-None-Match: %s\r\n", etag);
+    passed = handlersRequest(&connection, "GET", HANDLERS_STATIC_AREA "index.html",
+                             ifNoneMatch, nullptr, 0, &response);
+    handlersCheck(passed && (response._status == 304)
+                  && handlersHeaderMatch(&response, "ETag", etag)
+                  && (response._bodyLength == 0),
+                  "If-None-Match: %s: %d", etag, response._status);
+
+    // The directory sends the index page
+    passed = handlersGet(&connection, HANDLERS_STATIC_AREA, &response);
+    handlersCheck(passed && (response._status == 200)
+                  && (strcmp(response._body, handlersIndexHtml) == 0),
+                  "GET %s: %d, %lu bytes", HANDLERS_STATIC_AREA,
+                  response._status, (unsigned long)response._bodyLength);
+
+    // The compressed script is sent to a browser that accepts gzip
+    passed = handlersRequest(&connection, "GET", HANDLERS_STATIC_AREA "app.js",
+                             "Accept-Encoding: gzip, deflate\r\n", nullptr, 0, &response);
+    value = handlersHeader(&response, "ETag");
+    handlersCheck(passed && (response._status == 200)
+                  && handlersHeaderMatch(&response, "Content-Type", "application/javascript")
+                  && handlersHeaderMatch(&response, "Content-Encoding", "gzip")
+                  && value && strstr(value, "-gz\"\r\n")
+                  && (response._bodyLength == (sizeof(handlersAppJsGz) - 1))
+                  && (memcmp(response._body, handlersAppJsGz, response._bodyLength) == 0),
+                  "GET %sapp.js, gzip: %d, %lu bytes", HANDLERS_STATIC_AREA,
+                  response._status, (unsigned long)response._bodyLength);
+
+    // The script is sent to other browsers
+    passed = handlersGet(&connection, HANDLERS_STATIC_AREA "app.js", &response);
+    handlersCheck(passed && (response._status == 200)
+                  && (!handlersHeader(&response, "Content-Encoding"))
+                  && (strcmp(response._body, handlersAppJs) == 0),
+                  "GET %sapp.js: %d, %lu bytes", HANDLERS_STATIC_AREA,
+                  response._status, (unsigned long)response._bodyLength);
+
+    // The static content is read only, r4aWebServerError reports the method
+    errors = handlersMetricValue(&r4aMetricWebErrors);
+    passed = handlersRequest(&connection, "PUT", HANDLERS_STATIC_AREA "index.html",
+                             "", nullptr, 0, &response);
+    handlersCheck(passed && (response._status == 405)
+                  && strstr(response._body, ": " HANDLERS_STATIC_AREA "index.html<br>")
+                  && strstr(response._body, "HTTPD_405_METHOD_NOT_ALLOWED")
+                  && (handlersMetricValue(&r4aMetricWebErrors) == (errors + 1)),
+                  "PUT %sindex.html: %d", HANDLERS_STATIC_AREA, response._status);
+    handlersDisconnect(&connection);
+    free(response._body);
+}
+
+//*********************************************************************
+// Upload a file on a new connection
+bool handlersUpload(uint16_t port,
+                    const char * uri,
+                    const void * data,
+                    size_t length,
+                    HANDLERS_RESPONSE * response)
+{
+    HANDLERS_CONNECTION connection;
+    bool passed;
+
+    if (!handlersConnect(&connection, port))
+        return false;
+    passed = handlersRequest(&connection, "PUT", uri, "", data, length, response);
+    handlersDisconnect(&connection);
+    return passed;
+}
+
+//*********************************************************************
+// Check the file uploads
+void handlersUploadCheck(uint16_t port)
+{
+    HANDLERS_CONNECTION connection;
+    bool passed;
+    HANDLERS_RESPONSE response;
+    const char text[] = "Uploaded from the host\n";
+
+    memset(&response, 0, sizeof(response));
+    Serial.println("r4aWebServerFileUpload");
+
+    // Upload a file and download it again
+    passed = handlersUpload(port, HANDLERS_NVM_AREA "upload.txt",
+                            text, sizeof(text) - 1, &response);
+    handlersCheck(passed && (response._status == 200)
+                  && (strcmp(response._body, "Uploaded 23 bytes to /upload.txt\n") == 0)
+                  && handlersFileMatch("upload.txt", text, sizeof(text) - 1),
+                  "PUT %supload.txt: %d, %lu bytes", HANDLERS_NVM_AREA,
+                  response._status, (unsigned long)(sizeof(text) - 1));
+    if (handlersConnect(&connection, port))
+    {
+        passed = handlersGet(&connection, HANDLERS_NVM_AREA "upload.txt", &response);
+        handlersCheck(passed && (response._status == 200)
+                      && handlersHeaderMatch(&response, "Content-Type", "text/plain")
+                      && (strcmp(response._body, text) == 0),
+                      "GET %supload.txt: %d, %lu bytes", HANDLERS_NVM_AREA,
+                      response._status, (unsigned long)response._bodyLength);
+        handlersDisconnect(&connection);
+    }
+    else
+        handlersCheck(false, "Connect to port %d", port);
+
+    // The temporary file names are reserved
+    passed = handlersUpload(port, HANDLERS_NVM_AREA "bad.txt" HANDLERS_UPLOAD_TEMP "1",
+                            text, sizeof(text) - 1, &response);
+    handlersCheck(passed && (response._status == 400)
+                  && (strcmp(response._body, "Invalid file path") == 0),
+                  "PUT %sbad.txt%s1: %d", HANDLERS_NVM_AREA, HANDLERS_UPLOAD_TEMP,
+                  response._status);
+
+    // The upload is rejected before the body is sent
+    passed = handlersConnect(&connection, port)
+          && handlersSend(&connection, "PUT", HANDLERS_NVM_AREA "large.txt", "",
+                          HANDLERS_UPLOAD_MAXIMUM + 1)
+          && handlersReceive(&connection, &response);
+    handlersCheck(passed && (response._status == 413)
+                  && (strcmp(response._body, "File too large") == 0)
+                  && (access("large.txt", F_OK) != 0),
+                  "PUT %slarge.txt, %d bytes: %d", HANDLERS_NVM_AREA,
+                  HANDLERS_UPLOAD_MAXIMUM + 1, response._status);
+    handlersDisconnect(&connection);
+    free(response._body);
+}
+
+//*********************************************************************
+// Check the async workers with two uploads of the same file at once
+void handlersAsyncCheck(uint16_t port)
+{
+    uint32_t busy;
+    HANDLERS_CONNECTION connection[3];
+    char data[2][HANDLERS_UPLOAD_BYTES];
+    DIR * directory;
+    struct dirent * entry;
+    int index;
+    bool passed;
+    uint32_t requests;
+    HANDLERS_RESPONSE response[3];
+    int64_t startUsec;
+    int tempFiles;
+
+    memset(response, 0, sizeof(response));
+    Serial.println("r4aWebServerAsync");
+    memset(data[0], 'A', sizeof(data[0]));
+    memset(data[1], 'B', sizeof(data[1]));
+
+    // Start both uploads, each worker waits for the rest of its body
+    busy = handlersMetricValue(&r4aMetricWebAsyncBusy);
+    requests = handlersMetricValue(&r4aMetricWebAsyncRequests);
+    passed = true;
+    for (index = 0; index < 3; index++)
+        passed &= handlersConnect(&connection[index], port);
+    for (index = 0; passed && (index < 2); index++)
+        passed = handlersSend(&connection[index], "PUT", HANDLERS_NVM_AREA "same.txt", "",
+                              sizeof(data[index]))
+              && handlersSendData(&connection[index], data[index], sizeof(data[index]) / 2);
+    startUsec = esp_timer_get_time();
+    while (passed && (handlersMetricValue(&r4aMetricWebAsyncRequests) < (requests + 2))
+           && ((esp_timer_get_time() - startUsec) < (HANDLERS_ASYNC_WAIT_MSEC * 1000)))
+        delay(1);
+    handlersCheck(passed && (handlersMetricValue(&r4aMetricWebAsyncRequests) == (requests + 2)),
+                  "%d uploads passed to the workers",
+                  handlersMetricValue(&r4aMetricWebAsyncRequests) - requests);
+
+    // The server rejects the next request while the workers are busy
+    passed = handlersGet(&connection[2], HANDLERS_NVM_AREA "camera.rec", &response[2]);
+    handlersCheck(passed && (response[2]._status == 503)
+                  && handlersHeaderMatch(&response[2], "Retry-After", "1")
+                  && (strcmp(response[2]._body, "Web server busy") == 0)
+                  && (handlersMetricValue(&r4aMetricWebAsyncBusy) == (busy + 1)),
+                  "GET %scamera.rec while busy: %d", HANDLERS_NVM_AREA, response[2]._status);
+
+    // Finish the uploads, the file contains one of the uploads
+    for (index = 0; index < 2; index++)
+    {
+        passed = handlersSendData(&connection[index],
+                                  &data[index][sizeof(data[index]) / 2],
+                                  sizeof(data[index]) / 2)
+              && handlersReceive(&connection[index], &response[index]);
+        handlersCheck(passed && (response[index]._status == 200),
+                      "PUT %ssame.txt, '%c': %d", HANDLERS_NVM_AREA, data[index][0],
+                      response[index]._status);
+    }
+    handlersCheck(handlersFileMatch("same.txt", data[0], sizeof(data[0]))
+                  || handlersFileMatch("same.txt", data[1], sizeof(data[1])),
+                  "same.txt contains one upload");
+
+    // The temporary files are gone
+    tempFiles = 0;
+    directory = opendir(".");
+    while (directory && (entry = readdir(directory)))
+        if (strstr(entry->d_name, HANDLERS_UPLOAD_TEMP))
+            tempFiles += 1;
+    if (directory)
+        closedir(directory);
+    handlersCheck(directory && (tempFiles == 0), "%d temporary files remain", tempFiles);
+
+    for (index = 0; index < 3; index++)
+    {
+        handlersDisconnect(&connection[index]);
+        free(response[index]._body);
+    }
+}
+
+//*********************************************************************
+// Check the camera images
+void handlersJpegCheck(uint16_t port)
+{
+    HANDLERS_CONNECTION connection;
+    uint32_t frames;
+    bool passed;
+    HANDLERS_RESPONSE response;
+
+    memset(&response, 0, sizeof(response));
+    Serial.println("r4aOV2640JpegHandler");
+    if (!handlersConnect(&connection, port))
+    {
+        handlersCheck(false, "Connect to port %d", port);
+        return;
+    }
+
+    // The camera does not return a frame
+    hostCameraFrameBuffer = nullptr;
+    passed = handlersGet(&connection, "/jpeg", &response);
+    handlersCheck(passed && (response._status == 500), "GET /jpeg without a frame: %d",
+                  response._status);
+    handlersDisconnect(&connection);
+
+    // The sensor encoded frame is sent without copying
+    hostCameraFrameBuffer = &handlersFrameBuffer;
+    frames = __atomic_load_n(&handlersFramesProcessed, __ATOMIC_RELAXED);
+    passed = handlersConnect(&connection, port)
+          && handlersGet(&connection, "/jpeg", &response);
+    handlersCheck(passed && (response._status == 200)
+                  && handlersHeaderMatch(&response, "Content-Type", "image/jpeg")
+                  && handlersHeaderMatch(&response, "Content-Disposition", "inline; filename=capture.jpg")
+                  && handlersHeaderMatch(&response, "X-Timestamp", "12.345678")
+                  && handlersHeader(&response, "X-Quality")
+                  && handlersHeader(&response, "X-Bitrate")
+                  && (response._bodyLength == sizeof(handlersJpeg))
+                  && (memcmp(response._body, handlersJpeg, sizeof(handlersJpeg)) == 0)
+                  && (__atomic_load_n(&handlersFramesProcessed, __ATOMIC_RELAXED) == (frames + 1)),
+                  "GET /jpeg: %d, %lu bytes", response._status,
+                  (unsigned long)response._bodyLength);
+    handlersDisconnect(&connection);
+    free(response._body);
+}
+
+//*********************************************************************
+// Check that the workers returned the response buffers
+void handlersBufferCheck(uint32_t misses)
+{
+    uint32_t bufferFree;
+    int64_t startUsec;
+
+    // The worker returns the buffer after sending the response
+    Serial.println("r4aWebServerBufferGet");
+    startUsec = esp_timer_get_time();
+    do
+    {
+        bufferFree = __atomic_load_n(&handlersWebServer._bufferFree, __ATOMIC_ACQUIRE);
+        if (bufferFree == ((1u << HANDLERS_BUFFER_COUNT) - 1))
+            break;
+        delay(1);
+    } while ((esp_timer_get_time() - startUsec) < (HANDLERS_ASYNC_WAIT_MSEC * 1000));
+    handlersCheck(bufferFree == ((1u << HANDLERS_BUFFER_COUNT) - 1),
+                  "%d of %d buffers free", __builtin_popcount(bufferFree),
+                  HANDLERS_BUFFER_COUNT);
+    handlersCheck(handlersMetricValue(&r4aMetricWebBufferMisses) == misses,
+                  "%d buffers allocated from the heap",
+                  handlersMetricValue(&r4aMetricWebBufferMisses) - misses);
+}
+
+//****************************************
+// Benchmark
+//****************************************
+
+//*********************************************************************
+// Time the requests to a handler on a keep-alive connection
+void handlersBenchmark(uint16_t port, const char * uri, int requests)
+{
+    HANDLERS_CONNECTION connection;
+    int index;
+    HANDLERS_RESPONSE response;
+    int64_t startUsec;
+    int64_t usec;
+
+    memset(&response, 0, sizeof(response));
+    if (!handlersConnect(&connection, port))
+    {
+        handlersCheck(false, "Connect to port %d", port);
+        return;
+    }
+    startUsec = esp_timer_get_time();
+    for (index = 0; index < requests; index++)
+        if ((!handlersGet(&connection, uri, &response)) || (response._status != 200))
+            break;
+    usec = esp_timer_get_time() - startUsec;
+    handlersCheck(index == requests, "%-16s %6d requests, %8.1f uSec per request, %8.0f requests per second",
+                  uri, index,
+                  index ? (double)usec / index : 0.,
+                  usec ? index * 1000000. / usec : 0.);
+    handlersDisconnect(&connection);
+    free(response._body);
+}
+
+//*********************************************************************
+// Locate an unused local port
+uint16_t handlersPort()
+{
+    struct sockaddr_in address;
+    socklen_t length;
+    int fd;
+    uint16_t port;
+
+    port = 0;
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+        return 0;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    length = sizeof(address);
+    if ((bind(fd, (struct sockaddr *)&address, sizeof(address)) == 0)
+        && (getsockname(fd, (struct sockaddr *)&address, &length) == 0))
+        port = ntohs(address.sin_port);
+    close(fd);
+    return port;
+}
+
+//*********************************************************************
+// Test and benchmark the web server handlers
+int main(int argc, char ** argv)
+{
+    uint32_t misses;
+    int requests;
+    int signal;
+    sigset_t signals;
+    int status;
+
+    // Place the LittleFS files in a temporary directory and give the
+    // camera a frame
+    if (!handlersFilesCreate())
+        return 1;
+    hostCameraFrameBuffer = &handlersFrameBuffer;
+
+    // Serve the pages to the HTTP tools
+    if ((argc > 1) && (strcmp(argv[1], "-s") == 0))
+    {
+        // Let this thread receive Ctrl-C, the server threads inherit the
+        // signal mask
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGINT);
+        sigaddset(&signals, SIGTERM);
+        pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+        if (argc > 2)
+            handlersWebServer._port = atoi(argv[2]);
+        status = 1;
+        if (r4aWebServerStart(&handlersWebServer))
+        {
+            Serial.printf("Files: %s\r\n", handlersDirectory);
+            Serial.printf("Pages: /telemetry, /metrics, /small, /jpeg, %scamera.rec,\r\n",
+                          HANDLERS_NVM_AREA);
+            Serial.printf("       %sindex.html, %sapp.js, PUT %s<file>\r\n",
+                          HANDLERS_STATIC_AREA, HANDLERS_STATIC_AREA, HANDLERS_NVM_AREA);
+            sigwait(&signals, &signal);
+            r4aWebServerStop(&handlersWebServer);
+            status = 0;
+        }
+        handlersFilesRemove();
+        return status;
+    }
+    requests = (argc > 1) ? atoi(argv[1]) : HANDLERS_REQUESTS;
+
+    // Check the routines that do not need the web server
+    handlersRangeCheck();
+    handlersMimeCheck();
+
+    // Check the handlers through the web server
+    handlersWebServer._port = handlersPort();
+    misses = handlersMetricValue(&r4aMetricWebBufferMisses);
+    if (r4aWebServerStart(&handlersWebServer))
+    {
+        handlersServerCheck(handlersWebServer._port);
+        handlersDownloadCheck(handlersWebServer._port);
+        handlersStaticCheck(handlersWebServer._port);
+        handlersUploadCheck(handlersWebServer._port);
+        handlersAsyncCheck(handlersWebServer._port);
+        handlersJpegCheck(handlersWebServer._port);
+        handlersBufferCheck(misses);
+
+        // Time the handlers
+        Serial.println("Benchmark");
+        handlersBenchmark(handlersWebServer._port, "/telemetry", requests);
+        handlersBenchmark(handlersWebServer._port, "/metrics", requests);
+        handlersBenchmark(handlersWebServer._port, HANDLERS_NVM_AREA "camera.rec", requests);
+        handlersBenchmark(handlersWebServer._port, HANDLERS_STATIC_AREA "index.html", requests);
+        handlersBenchmark(handlersWebServer._port, "/jpeg", requests);
+        Serial.printf("    Telemetry snapshot: %lu uSec, maximum %lu uSec\r\n",
+                      (unsigned long)handlersTelemetry._buildUsec,
+                      (unsigned long)handlersTelemetry._maximumUsec);
+        Serial.printf("    Metrics scrape: %lu uSec\r\n",
+                      (unsigned long)handlersMetrics._scrapeUsec);
+        r4aWebServerStop(&handlersWebServer);
+    }
+    else
+        handlersCheck(false, "Start the web server");
+    handlersFilesRemove();
+
+    // Display the summary
+    Serial.printf("%d of %d checks passed\r\n", handlersChecks - handlersFailures, handlersChecks);
+    return handlersFailures ? 1 : 0;
+}
@@ -0,0 +1,534 @@
+/**********************************************************************
+  Host.cpp
+
+  Robots-For-All (R4A)
+  Host computer implementation of the Arduino, ESP-IDF and FreeRTOS
+  routines used by the library
+
+  The tasks are POSIX threads, the queues and semaphores use a mutex
+  and condition variable, PSRAM is the host heap and the LittleFS files
+  are in the current directory.  There is no camera, the frames come
+  from recordings or are generated by the host programs, which may set
+  hostCameraFrameBuffer to the frame returned by esp_camera_fb_get.
+**********************************************************************/
+
+#include <pthread.h>
+
+#include "R4A_ESP32.h"
+
+//****************************************
+// Locals
+//****************************************
+
+EspClass ESP;
+camera_fb_t * hostCameraFrameBuffer;
+fs::FS LittleFS;
+HardwareSerial Serial;
+WiFiClass WiFi;
+
+static pthread_mutex_t hostCriticalSection = PTHREAD_MUTEX_INITIALIZER;
+static struct timespec hostStartTime;
+static bool hostStartTimeSet;
+
+// Queue and semaphore
+typedef struct _HOST_QUEUE
+{
+    pthread_mutex_t _mutex;     // Protects the queue
+    pthread_cond_t _changed;    // Signaled when an item is added or removed
+    uint8_t * _buffer;          // Item storage
+    UBaseType_t _itemSize;      // Bytes per item, zero for a semaphore
+    UBaseType_t _length;        // Maximum number of items
+    UBaseType_t _count;         // Number of items in the queue
+    UBaseType_t _head;          // Index of the oldest item
+} HOST_QUEUE;
+
+//*********************************************************************
+// Get the time since the program started in microseconds
+int64_t esp_timer_get_time()
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (!hostStartTimeSet)
+    {
+        hostStartTime = now;
+        hostStartTimeSet = true;
+    }
+    return (((int64_t)(now.tv_sec - hostStartTime.tv_sec)) * 1000 * 1000)
+           + ((now.tv_nsec - hostStartTime.tv_nsec) / 1000);
+}
+
+//*********************************************************************
+// Get a random number
+uint32_t esp_random()
+{
+    return (((uint32_t)random()) << 16) ^ (uint32_t)random();
+}
+
+//*********************************************************************
+// Allocate memory
+void * heap_caps_malloc(size_t size, uint32_t caps)
+{
+    return malloc(size);
+}
+
+//*********************************************************************
+// Resize an allocation
+void * heap_caps_realloc(void * ptr, size_t size, uint32_t caps)
+{
+    return realloc(ptr, size);
+}
+
+//*********************************************************************
+// Free an allocation
+void heap_caps_free(void * ptr)
+{
+    free(ptr);
+}
+
+//*********************************************************************
+// The host heap size is not known
+size_t heap_caps_get_free_size(uint32_t caps)
+{
+    return 0;
+}
+
+//*********************************************************************
+// The host heap size is not known
+size_t heap_caps_get_largest_free_block(uint32_t caps)
+{
+    return 0;
+}
+
+//*********************************************************************
+// The host heap size is not known
+size_t heap_caps_get_minimum_free_size(uint32_t caps)
+{
+    return 0;
+}
+
+//*********************************************************************
+// The host heap size is not known
+uint32_t EspClass::getFreeHeap()
+{
+    return 0;
+}
+
+//*********************************************************************
+// The host heap size is not known
+uint32_t EspClass::getFreePsram()
+{
+    return 0;
+}
+
+//*********************************************************************
+// Wait for the specified number of milliseconds
+void delay(uint32_t msec)
+{
+    usleep(msec * 1000);
+}
+
+//*********************************************************************
+// Get the time since the program started in milliseconds
+uint32_t millis()
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+//*********************************************************************
+// Get the time since the program started in microseconds
+uint32_t micros()
+{
+    return (uint32_t)esp_timer_get_time();
+}
+
+//*********************************************************************
+// Display a buffer in hexadecimal and ASCII
+void r4aDumpBuffer(intptr_t offset, const uint8_t * buffer, int length, Print * display)
+{
+    int bytes;
+    int index;
+
+    while (length > 0)
+    {
+        bytes = 16 - (offset & 0xf);
+        if (bytes > length)
+            bytes = length;
+        display->printf("0x%08lx: ", (unsigned long)offset);
+        for (index = 0; index < (offset & 0xf); index++)
+            display->print("   ");
+        for (index = 0; index < bytes; index++)
+            display->printf("%02x ", buffer[index]);
+        for (index = bytes + (offset & 0xf); index < 16; index++)
+            display->print("   ");
+        display->print(" ");
+        for (index = 0; index < (offset & 0xf); index++)
+            display->print(" ");
+        for (index = 0; index < bytes; index++)
+            display->print((char)(((buffer[index] < ' ') || (buffer[index] > '~'))
+                                  ? '.' : buffer[index]));
+        display->println();
+        buffer += bytes;
+        length -= bytes;
+        offset += bytes;
+    }
+}
+
+//****************************************
+// FreeRTOS
+//****************************************
+
+//*********************************************************************
+// Enter a critical section
+void vPortEnterCritical(portMUX_TYPE * mux)
+{
+    pthread_mutex_lock(&hostCriticalSection);
+}
+
+//*********************************************************************
+// Exit a critical section
+void vPortExitCritical(portMUX_TYPE * mux)
+{
+    pthread_mutex_unlock(&hostCriticalSection);
+}
+
+//*********************************************************************
+// All of the threads appear to run on core 0
+BaseType_t xPortGetCoreID()
+{
+    return 0;
+}
+
+//*********************************************************************
+// The host heap size is not known
+size_t xPortGetFreeHeapSize()
+{
+    return 0;
+}
+
+//*********************************************************************
+// The host heap size is not known
+size_t xPortGetMinimumEverFreeHeapSize()
+{
+    return 0;
+}
+
+//*********************************************************************
+// Run the task routine in a thread
+static void * hostTask(void * parameter)
+{
+    void ** arguments;
+    TaskFunction_t function;
+
+    arguments = (void **)parameter;
+    function = (TaskFunction_t)arguments[0];
+    parameter = arguments[1];
+    free(arguments);
+    function(parameter);
+    return nullptr;
+}
+
+//*********************************************************************
+// Start a task
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function,
+                                   const char * name,
+                                   uint32_t stackBytes,
+                                   void * parameter,
+                                   UBaseType_t priority,
+                                   TaskHandle_t * handle,
+                                   BaseType_t core)
+{
+    void ** arguments;
+    pthread_t thread;
+
+    arguments = (void **)malloc(2 * sizeof(void *));
+    if (!arguments)
+        return pdFAIL;
+    arguments[0] = (void *)function;
+    arguments[1] = parameter;
+    if (pthread_create(&thread, nullptr, hostTask, arguments))
+    {
+        free(arguments);
+        return pdFAIL;
+    }
+    pthread_detach(thread);
+    if (handle)
+        *handle = (TaskHandle_t)thread;
+    return pdPASS;
+}
+
+//*********************************************************************
+// All of the threads appear to run on core 0
+BaseType_t xTaskGetCoreID(TaskHandle_t task)
+{
+    return 0;
+}
+
+//*********************************************************************
+// Get the handle of the running task
+TaskHandle_t xTaskGetCurrentTaskHandle()
+{
+    return (TaskHandle_t)pthread_self();
+}
+
+//*********************************************************************
+// The threads do not have FreeRTOS priorities
+UBaseType_t uxTaskPriorityGet(TaskHandle_t task)
+{
+    return 0;
+}
+
+//*********************************************************************
+// Wait for the specified number of ticks
+void vTaskDelay(TickType_t ticks)
+{
+    delay(ticks * portTICK_PERIOD_MS);
+}
+
+//*********************************************************************
+// Exit the running task
+void vTaskDelete(TaskHandle_t task)
+{
+    if ((!task) || (task == xTaskGetCurrentTaskHandle()))
+        pthread_exit(nullptr);
+}
+
+//*********************************************************************
+// Create a queue, an item size of zero creates a semaphore
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize)
+{
+    HOST_QUEUE * queue;
+
+    queue = (HOST_QUEUE *)calloc(1, sizeof(HOST_QUEUE) + (length * itemSize));
+    if (!queue)
+        return nullptr;
+    pthread_mutex_init(&queue->_mutex, nullptr);
+    pthread_cond_init(&queue->_changed, nullptr);
+    queue->_buffer = (uint8_t *)&queue[1];
+    queue->_itemSize = itemSize;
+    queue->_length = length;
+    return (QueueHandle_t)queue;
+}
+
+//*********************************************************************
+// Wait for the queue to change, returns false upon timeout
+static bool hostQueueWait(HOST_QUEUE * queue, TickType_t ticks)
+{
+    struct timespec timeout;
+
+    if (ticks == portMAX_DELAY)
+        return pthread_cond_wait(&queue->_changed, &queue->_mutex) == 0;
+    clock_gettime(CLOCK_REALTIME, &timeout);
+    timeout.tv_sec += ticks / 1000;
+    timeout.tv_nsec += (ticks % 1000) * 1000 * 1000;
+    if (timeout.tv_nsec >= (1000 * 1000 * 1000))
+    {
+        timeout.tv_sec += 1;
+        timeout.tv_nsec -= 1000 * 1000 * 1000;
+    }
+    return pthread_cond_timedwait(&queue->_changed, &queue->_mutex, &timeout) == 0;
+}
+
+//*********************************************************************
+// Remove the oldest item from the queue
+BaseType_t xQueueReceive(QueueHandle_t handle, void * item, TickType_t ticks)
+{
+    HOST_QUEUE * queue;
+
+    queue = (HOST_QUEUE *)handle;
+    pthread_mutex_lock(&queue->_mutex);
+    while (!queue->_count)
+        if ((!ticks) || (!hostQueueWait(queue, ticks)))
+        {
+            pthread_mutex_unlock(&queue->_mutex);
+            return pdFALSE;
+        }
+    if (queue->_itemSize)
+        memcpy(item, &queue->_buffer[queue->_head * queue->_itemSize], queue->_itemSize);
+    queue->_head = (queue->_head + 1) % queue->_length;
+    queue->_count -= 1;
+    pthread_cond_broadcast(&queue->_changed);
+    pthread_mutex_unlock(&queue->_mutex);
+    return pdTRUE;
+}
+
+//*********************************************************************
+// Add an item to the end of the queue
+BaseType_t xQueueSend(QueueHandle_t handle, const void * item, TickType_t ticks)
+{
+    UBaseType_t index;
+    HOST_QUEUE * queue;
+
+    queue = (HOST_QUEUE *)handle;
+    pthread_mutex_lock(&queue->_mutex);
+    while (queue->_count >= queue->_length)
+        if ((!ticks) || (!hostQueueWait(queue, ticks)))
+        {
+            pthread_mutex_unlock(&queue->_mutex);
+            return pdFALSE;
+        }
+    index = (queue->_head + queue->_count) % queue->_length;
+    if (queue->_itemSize)
+        memcpy(&queue->_buffer[index * queue->_itemSize], item, queue->_itemSize);
+    queue->_count += 1;
+    pthread_cond_broadcast(&queue->_changed);
+    pthread_mutex_unlock(&queue->_mutex);
+    return pdTRUE;
+}
+
+//*********************************************************************
+// Free the queue
+void vQueueDelete(QueueHandle_t handle)
+{
+    HOST_QUEUE * queue;
+
+    queue = (HOST_QUEUE *)handle;
+    pthread_cond_destroy(&queue->_changed);
+    pthread_mutex_destroy(&queue->_mutex);
+    free(queue);
+}
+
+//*********************************************************************
+// Create a counting semaphore
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t maximum, UBaseType_t initial)
+{
+    HOST_QUEUE * queue;
+
+    queue = (HOST_QUEUE *)xQueueCreate(maximum, 0);
+    if (queue)
+        queue->_count = initial;
+    return (SemaphoreHandle_t)queue;
+}
+
+//*********************************************************************
+// Create a mutex
+SemaphoreHandle_t xSemaphoreCreateMutex()
+{
+    return xSemaphoreCreateCounting(1, 1);
+}
+
+//*********************************************************************
+// Release the semaphore
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+    return xQueueSend((QueueHandle_t)semaphore, nullptr, 0);
+}
+
+//*********************************************************************
+// Take the semaphore
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks)
+{
+    return xQueueReceive((QueueHandle_t)semaphore, nullptr, ticks);
+}
+
+//*********************************************************************
+// Free the semaphore
+void vSemaphoreDelete(SemaphoreHandle_t semaphore)
+{
+    vQueueDelete((QueueHandle_t)semaphore);
+}
+
+//****************************************
+// Camera
+//****************************************
+
+//*********************************************************************
+// There is no camera on the host
+esp_err_t esp_camera_init(const camera_config_t * config)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+//*********************************************************************
+// Return the frame supplied by the host program
+camera_fb_t * esp_camera_fb_get()
+{
+    return hostCameraFrameBuffer;
+}
+
+//*********************************************************************
+// There is no camera on the host
+void esp_camera_fb_return(camera_fb_t * frameBuffer)
+{
+}
+
+//*********************************************************************
+// There is no camera on the host
+sensor_t * esp_camera_sensor_get()
+{
+    return nullptr;
+}
+
+//*********************************************************************
+// The JPEG encoder is part of the camera driver, record raw frames
+bool frame2jpg(camera_fb_t * frameBuffer, uint8_t quality, uint8_t ** out, size_t * outLength)
+{
+    return false;
+}
+
+//*********************************************************************
+// The JPEG encoder is part of the camera driver, record raw frames
+bool frame2jpg_cb(camera_fb_t * frameBuffer, uint8_t quality, jpg_out_cb callback, void * arg)
+{
+    return false;
+}
+
+//*********************************************************************
+// The JPEG decoder is part of the camera driver
+bool jpg2rgb565(const uint8_t * src, size_t srcLength, uint8_t * out, jpg_scale_t scale)
+{
+    return false;
+}
+
+//****************************************
+// WiFi
+//****************************************
+
+//*********************************************************************
+// The host program listens on all interfaces
+String IPAddress::toString() const
+{
+    return String("0.0.0.0");
+}
+
+//*********************************************************************
+// The host program listens on all interfaces
+IPAddress WiFiClass::localIP()
+{
+    return IPAddress();
+}
+
+//*********************************************************************
+// There is no WiFi radio on the host
+int8_t WiFiClass::RSSI()
+{
+    return 0;
+}
+
+//*********************************************************************
+// There is no WiFi radio on the host
+uint8_t R4A_WIFI::channelGet()
+{
+    return 0;
+}
+
+//*********************************************************************
+// There is no WiFi radio on the host
+const char * R4A_WIFI::ssidGet()
+{
+    return "";
+}
+
+//*********************************************************************
+// There is no WiFi radio on the host
+bool R4A_WIFI::stationConnected()
+{
+    return false;
+}
+
+//*********************************************************************
+// There is no WiFi radio on the host
+bool R4A_WIFI::stationHasIp()
+{
+    return false;
+}
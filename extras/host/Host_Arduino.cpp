@@ -0,0 +1,278 @@
+/**********************************************************************
+  Host_Arduino.cpp
+
+  Robots-For-All (R4A)
+  Host computer implementation of the Arduino String, Print and Serial
+  classes, Serial uses the standard input and output
+**********************************************************************/
+
+#include "R4A_ESP32.h"
+
+//****************************************
+// String
+//****************************************
+
+//*********************************************************************
+// Copy a zero terminated string
+String::String(const char * string)
+{
+    _buffer = strdup(string ? string : "");
+}
+
+//*********************************************************************
+// Copy a string
+String::String(const String & string)
+{
+    _buffer = strdup(string._buffer);
+}
+
+//*********************************************************************
+// Free the string
+String::~String()
+{
+    free(_buffer);
+}
+
+//*********************************************************************
+// Replace the string
+String & String::operator=(const String & string)
+{
+    char * buffer;
+
+    buffer = strdup(string._buffer);
+    free(_buffer);
+    _buffer = buffer;
+    return *this;
+}
+
+//*********************************************************************
+// Get the zero terminated string
+const char * String::c_str() const
+{
+    return _buffer;
+}
+
+//*********************************************************************
+// Get the string length
+size_t String::length() const
+{
+    return strlen(_buffer);
+}
+
+//****************************************
+// Print
+//****************************************
+
+//*********************************************************************
+// Output a buffer
+size_t Print::write(const uint8_t * buffer, size_t length)
+{
+    size_t index;
+
+    for (index = 0; index < length; index++)
+        if (!write(buffer[index]))
+            break;
+    return index;
+}
+
+//*********************************************************************
+// Output a zero terminated string
+size_t Print::write(const char * string)
+{
+    return write((const uint8_t *)string, strlen(string));
+}
+
+//*********************************************************************
+// Output a zero terminated string
+size_t Print::print(const char * string)
+{
+    return write(string);
+}
+
+//*********************************************************************
+// Output a character
+size_t Print::print(char value)
+{
+    return write((uint8_t)value);
+}
+
+//*********************************************************************
+// Output a number
+size_t Print::print(int value, int base)
+{
+    return print((long)value, base);
+}
+
+//*********************************************************************
+// Output a number
+size_t Print::print(unsigned int value, int base)
+{
+    return print((unsigned long)value, base);
+}
+
+//*********************************************************************
+// Output a number
+size_t Print::print(long value, int base)
+{
+    return (base == HEX) ? printf("%lx", value) : printf("%ld", value);
+}
+
+//*********************************************************************
+// Output a number
+size_t Print::print(unsigned long value, int base)
+{
+    return (base == HEX) ? printf("%lx", value) : printf("%lu", value);
+}
+
+//*********************************************************************
+// Output a number
+size_t Print::print(double value, int digits)
+{
+    return printf("%.*f", digits, value);
+}
+
+//*********************************************************************
+// Output a string
+size_t Print::print(const String & string)
+{
+    return write(string.c_str());
+}
+
+//*********************************************************************
+// Output a formatted string
+size_t Print::printf(const char * format, ...)
+{
+    va_list args;
+    char buffer[256];
+    char * data;
+    int length;
+
+    // Format the string
+    va_start(args, format);
+    length = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    if (length < 0)
+        return 0;
+    if (length < (int)sizeof(buffer))
+        return write((const uint8_t *)buffer, length);
+
+    // The string does not fit in the buffer
+    data = (char *)malloc(length + 1);
+    if (!data)
+        return 0;
+    va_start(args, format);
+    vsnprintf(data, length + 1, format, args);
+    va_end(args);
+    length = write((const uint8_t *)data, length);
+    free(data);
+    return length;
+}
+
+//*********************************************************************
+// Output the end of line
+size_t Print::println()
+{
+    return write("\r\n");
+}
+
+//*********************************************************************
+// Output a zero terminated string and the end of line
+size_t Print::println(const char * string)
+{
+    return print(string) + println();
+}
+
+//*********************************************************************
+// Output a character and the end of line
+size_t Print::println(char value)
+{
+    return print(value) + println();
+}
+
+//*********************************************************************
+// Output a number and the end of line
+size_t Print::println(int value, int base)
+{
+    return print(value, base) + println();
+}
+
+//*********************************************************************
+// Output a number and the end of line
+size_t Print::println(unsigned int value, int base)
+{
+    return print(value, base) + println();
+}
+
+//*********************************************************************
+// Output a number and the end of line
+size_t Print::println(long value, int base)
+{
+    return print(value, base) + println();
+}
+
+//*********************************************************************
+// Output a number and the end of line
+size_t Print::println(unsigned long value, int base)
+{
+    return print(value, base) + println();
+}
+
+//*********************************************************************
+// Output a number and the end of line
+size_t Print::println(double value, int digits)
+{
+    return print(value, digits) + println();
+}
+
+//*********************************************************************
+// Output a string and the end of line
+size_t Print::println(const String & string)
+{
+    return print(string) + println();
+}
+
+//****************************************
+// HardwareSerial
+//****************************************
+
+//*********************************************************************
+// Input is not buffered
+int HardwareSerial::available()
+{
+    return 0;
+}
+
+//*********************************************************************
+// Input is not buffered
+int HardwareSerial::peek()
+{
+    return -1;
+}
+
+//*********************************************************************
+// Read a character from the standard input
+int HardwareSerial::read()
+{
+    return getchar();
+}
+
+//*********************************************************************
+// Output a character, the carriage returns are dropped
+size_t HardwareSerial::write(uint8_t data)
+{
+    if (data != '\r')
+        putchar(data);
+    return 1;
+}
+
+//*********************************************************************
+// Output a buffer, the carriage returns are dropped
+size_t HardwareSerial::write(const uint8_t * buffer, size_t length)
+{
+    size_t index;
+
+    for (index = 0; index < length; index++)
+        if (buffer[index] != '\r')
+            putchar(buffer[index]);
+    return length;
+}
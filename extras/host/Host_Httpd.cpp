@@ -0,0 +1,1245 @@
+/**********************************************************************
+  Host_Httpd.cpp
+
+  Robots-For-All (R4A)
+  Host computer implementation of the ESP-IDF HTTP server, allowing the
+  web server handlers to be tested and benchmarked with curl, ab, wrk
+  or any other HTTP client
+
+  The server listens on a local TCP socket.  Each connection is a
+  session served by its own thread.  The handlers, error handlers and
+  queued work run while holding the server mutex, so like the ESP-IDF
+  server task only one of them runs at a time.  The asynchronous
+  request copies run without the mutex, the session waits for the copy
+  to complete before reading the next request.
+
+  Responses use HTTP/1.1 with keep-alive.  httpd_resp_send sends a
+  Content-Length, httpd_resp_send_chunk uses the chunked transfer
+  encoding.  WebSocket upgrades are not supported.
+**********************************************************************/
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/uio.h>
+
+#include "R4A_ESP32.h"
+
+//****************************************
+// Constants
+//****************************************
+
+#define HOST_HTTPD_HEADER_SIZE      4096    // Largest request or response header
+#define HOST_HTTPD_RESP_HEADERS     32      // Most response headers
+
+//****************************************
+// Types
+//****************************************
+
+typedef struct _HOST_HTTPD
+{
+    httpd_config_t _config;     // Server configuration
+    httpd_uri_t * _uri;         // Registered URI handlers
+    int _uriCount;              // Number of registered URI handlers
+    httpd_err_handler_func_t _errorHandler[HTTPD_ERR_CODE_MAX];
+    int _listenFd;              // Socket accepting the connections
+    pthread_t _thread;          // Thread accepting the connections
+    pthread_mutex_t _mutex;     // Held while a handler runs, the server task
+    pthread_mutex_t _lock;      // Protects the session list and counts
+    pthread_cond_t _changed;    // Signaled when a session, work or copy ends
+    struct _HOST_HTTPD_SESSION * _sessionList;  // Open sessions
+    int _sessions;              // Number of open sessions
+    int _work;                  // Number of queued work routines
+    bool _stopping;             // True once httpd_stop is called
+} HOST_HTTPD;
+
+typedef struct _HOST_HTTPD_SESSION
+{
+    struct _HOST_HTTPD_SESSION * _next; // Next session in the list
+    HOST_HTTPD * _server;       // Server owning the session
+    int _fd;                    // Client socket
+    void * _context;            // Session context set by the handlers
+    httpd_free_ctx_fn_t _freeContext;   // Releases the session context
+    int _async;                 // Asynchronous copies not yet complete
+    bool _asyncBegin;           // The request was copied for an asynchronous handler
+    bool _close;                // Close the session after the request
+    size_t _length;             // Number of bytes in the buffer
+    char _buffer[HOST_HTTPD_HEADER_SIZE];   // Received data
+} HOST_HTTPD_SESSION;
+
+typedef struct _HOST_HTTPD_REQUEST
+{
+    httpd_req_t _request;       // Request passed to the handlers, must be first
+    HOST_HTTPD_SESSION * _session;  // Session receiving the request
+    const char * _headers;      // Header lines, each ends with a zero and a line feed
+    int _headerLines;           // Number of header lines
+    const char * _query;        // Query string, nullptr when not present
+    char * _body;               // Body data in the session buffer
+    size_t _bodyLength;         // Number of body bytes in the session buffer
+    size_t _bodyRemaining;      // Body bytes not yet received by the handler
+    const char * _status;       // Response status
+    const char * _type;         // Response content type
+    const char * _field[HOST_HTTPD_RESP_HEADERS];   // Response header names
+    const char * _value[HOST_HTTPD_RESP_HEADERS];   // Response header values
+    int _fieldCount;            // Number of response headers
+    bool _headerSent;           // Response header was sent
+} HOST_HTTPD_REQUEST;
+
+typedef struct _HOST_HTTPD_WORK
+{
+    HOST_HTTPD * _server;       // Server running the work
+    httpd_work_fn_t _routine;   // Routine to call
+    void * _arg;                // Argument for the routine
+} HOST_HTTPD_WORK;
+
+//****************************************
+// Locals
+//****************************************
+
+static const char * const hostHttpdErrorStatus[HTTPD_ERR_CODE_MAX] =
+{
+    "500 Internal Server Error",            // HTTPD_500_INTERNAL_SERVER_ERROR
+    "501 Method Not Implemented",           // HTTPD_501_METHOD_NOT_IMPLEMENTED
+    "505 Version Not Supported",            // HTTPD_505_VERSION_NOT_SUPPORTED
+    "400 Bad Request",                      // HTTPD_400_BAD_REQUEST
+    "401 Unauthorized",                     // HTTPD_401_UNAUTHORIZED
+    "403 Forbidden",                        // HTTPD_403_FORBIDDEN
+    "404 Not Found",                        // HTTPD_404_NOT_FOUND
+    "405 Method Not Allowed",               // HTTPD_405_METHOD_NOT_ALLOWED
+    "408 Request Timeout",                  // HTTPD_408_REQ_TIMEOUT
+    "411 Length Required",                  // HTTPD_411_LENGTH_REQUIRED
+    "414 URI Too Long",                     // HTTPD_414_URI_TOO_LONG
+    "431 Request Header Fields Too Large",  // HTTPD_431_REQ_HDR_FIELDS_TOO_LARGE
+};
+
+static const char * const hostHttpdMethod[] =
+{
+    "DELETE",                   // HTTP_DELETE
+    "GET",                      // HTTP_GET
+    "HEAD",                     // HTTP_HEAD
+    "POST",                     // HTTP_POST
+    "PUT",                      // HTTP_PUT
+};
+static const int hostHttpdMethodCount = sizeof(hostHttpdMethod)
+                                      / sizeof(hostHttpdMethod[0]);
+
+//****************************************
+// Socket
+//****************************************
+
+//*********************************************************************
+// Wait for data on the socket, returns HTTPD_SOCK_ERR_TIMEOUT upon timeout
+static int hostHttpdRecv(int fd, char * buffer, size_t length, int timeoutMsec)
+{
+    struct pollfd poller;
+    int status;
+
+    poller.fd = fd;
+    poller.events = POLLIN;
+    do
+        status = poll(&poller, 1, timeoutMsec);
+    while ((status < 0) && (errno == EINTR));
+    if (status == 0)
+        return HTTPD_SOCK_ERR_TIMEOUT;
+    if (status < 0)
+        return HTTPD_SOCK_ERR_FAIL;
+    do
+        status = recv(fd, buffer, length, 0);
+    while ((status < 0) && (errno == EINTR));
+    return (status < 0) ? HTTPD_SOCK_ERR_FAIL : status;
+}
+
+//*********************************************************************
+// Send the buffers, returns false upon failure
+static bool hostHttpdSend(int fd, struct iovec * iov, int count)
+{
+    struct msghdr message;
+    ssize_t sent;
+
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = iov;
+    message.msg_iovlen = count;
+    while (message.msg_iovlen)
+    {
+        // Send as much as possible
+        sent = sendmsg(fd, &message, MSG_NOSIGNAL);
+        if (sent < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+
+        // Skip the data that was sent
+        while (message.msg_iovlen && ((size_t)sent >= message.msg_iov->iov_len))
+        {
+            sent -= message.msg_iov->iov_len;
+            message.msg_iov++;
+            message.msg_iovlen--;
+        }
+        if (message.msg_iovlen)
+        {
+            message.msg_iov->iov_base = (char *)message.msg_iov->iov_base + sent;
+            message.msg_iov->iov_len -= sent;
+        }
+    }
+    return true;
+}
+
+//****************************************
+// Request
+//****************************************
+
+//*********************************************************************
+// Locate a request header value
+static const char * hostHttpdHeader(HOST_HTTPD_REQUEST * request,
+                                    const char * field,
+                                    size_t * length)
+{
+    const char * line;
+    int index;
+    size_t fieldLength;
+    const char * value;
+
+    fieldLength = strlen(field);
+    line = request->_headers;
+    for (index = 0; index < request->_headerLines; index++)
+    {
+        if ((strncasecmp(line, field, fieldLength) == 0) && (line[fieldLength] == ':'))
+        {
+            // Remove the white space around the value
+            value = &line[fieldLength + 1];
+            while ((*value == ' ') || (*value == '\t'))
+                value++;
+            *length = strlen(value);
+            while (*length && ((value[*length - 1] == ' ') || (value[*length - 1] == '\t')))
+                *length -= 1;
+            return value;
+        }
+        line += strlen(line) + 2;
+    }
+    return nullptr;
+}
+
+//*********************************************************************
+// Copy a value into the caller's buffer, the value may be truncated
+static esp_err_t hostHttpdCopy(const char * value, size_t length, char * buffer, size_t bufferSize)
+{
+    if (!bufferSize)
+        return ESP_ERR_HTTPD_RESULT_TRUNC;
+    if (length >= bufferSize)
+    {
+        memcpy(buffer, value, bufferSize - 1);
+        buffer[bufferSize - 1] = 0;
+        return ESP_ERR_HTTPD_RESULT_TRUNC;
+    }
+    memcpy(buffer, value, length);
+    buffer[length] = 0;
+    return ESP_OK;
+}
+
+//*********************************************************************
+// Copy the request for an asynchronous handler
+esp_err_t httpd_req_async_handler_begin(httpd_req_t * request, httpd_req_t ** copy)
+{
+    HOST_HTTPD_REQUEST * asyncRequest;
+    HOST_HTTPD * server;
+    HOST_HTTPD_SESSION * session;
+
+    asyncRequest = (HOST_HTTPD_REQUEST *)malloc(sizeof(HOST_HTTPD_REQUEST));
+    if (!asyncRequest)
+        return ESP_ERR_NO_MEM;
+    memcpy((void *)asyncRequest, request, sizeof(HOST_HTTPD_REQUEST));
+
+    // The session waits for the copy before reading the next request
+    session = asyncRequest->_session;
+    server = session->_server;
+    pthread_mutex_lock(&server->_lock);
+    session->_async += 1;
+    session->_asyncBegin = true;
+    pthread_mutex_unlock(&server->_lock);
+    *copy = &asyncRequest->_request;
+    return ESP_OK;
+}
+
+//*********************************************************************
+// Release the asynchronous request
+esp_err_t httpd_req_async_handler_complete(httpd_req_t * request)
+{
+    HOST_HTTPD_REQUEST * asyncRequest;
+    HOST_HTTPD * server;
+    HOST_HTTPD_SESSION * session;
+
+    asyncRequest = (HOST_HTTPD_REQUEST *)request;
+    session = asyncRequest->_session;
+    server = session->_server;
+
+    // Close the session when the body was not received, the next
+    // request would start in the middle of the body
+    pthread_mutex_lock(&server->_lock);
+    if (asyncRequest->_bodyRemaining)
+        session->_close = true;
+    session->_async -= 1;
+    pthread_cond_broadcast(&server->_changed);
+    pthread_mutex_unlock(&server->_lock);
+    free(asyncRequest);
+    return ESP_OK;
+}
+
+//*********************************************************************
+// Get the length of a request header
+size_t httpd_req_get_hdr_value_len(httpd_req_t * request, const char * field)
+{
+    size_t length;
+
+    if (!hostHttpdHeader((HOST_HTTPD_REQUEST *)request, field, &length))
+        return 0;
+    return length;
+}
+
+//*********************************************************************
+// Get the value of a request header
+esp_err_t httpd_req_get_hdr_value_str(httpd_req_t * request,
+                                      const char * field,
+                                      char * buffer,
+                                      size_t bufferSize)
+{
+    size_t length;
+    const char * value;
+
+    value = hostHttpdHeader((HOST_HTTPD_REQUEST *)request, field, &length);
+    if (!value)
+        return ESP_ERR_NOT_FOUND;
+    return hostHttpdCopy(value, length, buffer, bufferSize);
+}
+
+//*********************************************************************
+// Get the length of the query string
+size_t httpd_req_get_url_query_len(httpd_req_t * request)
+{
+    const char * query;
+
+    query = ((HOST_HTTPD_REQUEST *)request)->_query;
+    return query ? strlen(query) : 0;
+}
+
+//*********************************************************************
+// Get the query string
+esp_err_t httpd_req_get_url_query_str(httpd_req_t * request, char * buffer, size_t bufferSize)
+{
+    const char * query;
+
+    query = ((HOST_HTTPD_REQUEST *)request)->_query;
+    if (!query)
+        return ESP_ERR_NOT_FOUND;
+    return hostHttpdCopy(query, strlen(query), buffer, bufferSize);
+}
+
+//*********************************************************************
+// Get a value from the query string
+esp_err_t httpd_query_key_value(const char * query, const char * key, char * value, size_t valueSize)
+{
+    const char * end;
+    size_t keyLength;
+
+    keyLength = strlen(key);
+    while (*query)
+    {
+        // Locate the end of the key=value pair
+        end = strchr(query, '&');
+        if (!end)
+            end = query + strlen(query);
+
+        // Return the value when the key matches
+        if ((strncmp(query, key, keyLength) == 0) && (query[keyLength] == '='))
+        {
+            query += keyLength + 1;
+            return hostHttpdCopy(query, end - query, value, valueSize);
+        }
+
+        // Move to the next pair
+        query = *end ? end + 1 : end;
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+//*********************************************************************
+// Receive the request body
+int httpd_req_recv(httpd_req_t * request, char * buffer, size_t bufferSize)
+{
+    HOST_HTTPD_REQUEST * hostRequest;
+    int length;
+    HOST_HTTPD * server;
+
+    hostRequest = (HOST_HTTPD_REQUEST *)request;
+    server = hostRequest->_session->_server;
+    if (bufferSize > hostRequest->_bodyRemaining)
+        bufferSize = hostRequest->_bodyRemaining;
+    if (!bufferSize)
+        return 0;
+
+    // Return the body data received with the header
+    if (hostRequest->_bodyLength)
+    {
+        length = (bufferSize < hostRequest->_bodyLength) ? bufferSize : hostRequest->_bodyLength;
+        memcpy(buffer, hostRequest->_body, length);
+        hostRequest->_body += length;
+        hostRequest->_bodyLength -= length;
+    }
+
+    // Receive the rest of the body from the socket
+    else
+    {
+        length = hostHttpdRecv(hostRequest->_session->_fd,
+                               buffer,
+                               bufferSize,
+                               server->_config.recv_wait_timeout * 1000);
+        if (length == 0)
+            return HTTPD_SOCK_ERR_FAIL;
+        if (length < 0)
+            return length;
+    }
+    hostRequest->_bodyRemaining -= length;
+    return length;
+}
+
+//*********************************************************************
+// Get the request's socket
+int httpd_req_to_sockfd(httpd_req_t * request)
+{
+    return ((HOST_HTTPD_REQUEST *)request)->_session->_fd;
+}
+
+//****************************************
+// Response
+//****************************************
+
+//*********************************************************************
+// Send the response header and the first data
+static esp_err_t hostHttpdRespond(HOST_HTTPD_REQUEST * request,
+                                  const char * data,
+                                  size_t length,
+                                  bool chunked)
+{
+    char chunkHeader[32];
+    int count;
+    char header[HOST_HTTPD_HEADER_SIZE];
+    int headerLength;
+    int index;
+    struct iovec iov[4];
+    int used;
+
+    // Build the response header
+    headerLength = snprintf(header, sizeof(header),
+                            "HTTP/1.1 %s\r\nContent-Type: %s\r\n",
+                            request->_status ? request->_status : "200 OK",
+                            request->_type ? request->_type : "text/html");
+    if (chunked)
+        used = snprintf(&header[headerLength], sizeof(header) - headerLength,
+                        "Transfer-Encoding: chunked\r\n");
+    else
+        used = snprintf(&header[headerLength], sizeof(header) - headerLength,
+                        "Content-Length: %lu\r\n", (unsigned long)length);
+    headerLength += used;
+    for (index = 0; index < request->_fieldCount; index++)
+    {
+        if (headerLength >= (int)sizeof(header))
+            break;
+        used = snprintf(&header[headerLength], sizeof(header) - headerLength,
+                        "%s: %s\r\n", request->_field[index], request->_value[index]);
+        headerLength += used;
+    }
+    if (headerLength >= (int)(sizeof(header) - 2))
+        return ESP_ERR_HTTPD_RESP_HDR;
+    header[headerLength++] = '\r';
+    header[headerLength++] = '\n';
+    request->_headerSent = true;
+
+    // Send the header with the data
+    count = 0;
+    iov[count].iov_base = header;
+    iov[count++].iov_len = headerLength;
+    if (chunked && length)
+    {
+        iov[count].iov_base = chunkHeader;
+        iov[count++].iov_len = snprintf(chunkHeader, sizeof(chunkHeader),
+                                        "%lx\r\n", (unsigned long)length);
+    }
+    if (length)
+    {
+        iov[count].iov_base = (void *)data;
+        iov[count++].iov_len = length;
+    }
+    if (chunked)
+    {
+        iov[count].iov_base = (void *)(length ? "\r\n" : "0\r\n\r\n");
+        iov[count++].iov_len = length ? 2 : 5;
+    }
+    if (!hostHttpdSend(request->_session->_fd, iov, count))
+    {
+        request->_session->_close = true;
+        return ESP_ERR_HTTPD_RESP_SEND;
+    }
+    return ESP_OK;
+}
+
+//*********************************************************************
+// Send the response
+esp_err_t httpd_resp_send(httpd_req_t * request, const char * buffer, ssize_t length)
+{
+    if (length == HTTPD_RESP_USE_STRLEN)
+        length = buffer ? strlen(buffer) : 0;
+    return hostHttpdRespond((HOST_HTTPD_REQUEST *)request, buffer, length, false);
+}
+
+//*********************************************************************
+// Send part of the response, a length of zero sends the final chunk
+esp_err_t httpd_resp_send_chunk(httpd_req_t * request, const char * buffer, ssize_t length)
+{
+    char chunkHeader[32];
+    int count;
+    HOST_HTTPD_REQUEST * hostRequest;
+    struct iovec iov[3];
+
+    hostRequest = (HOST_HTTPD_REQUEST *)request;
+    if (length == HTTPD_RESP_USE_STRLEN)
+        length = buffer ? strlen(buffer) : 0;
+
+    // Send the response header with the first chunk
+    if (!hostRequest->_headerSent)
+        return hostHttpdRespond(hostRequest, buffer, length, true);
+
+    // Send the chunk
+    count = 0;
+    if (length)
+    {
+        iov[count].iov_base = chunkHeader;
+        iov[count++].iov_len = snprintf(chunkHeader, sizeof(chunkHeader),
+                                        "%lx\r\n", (unsigned long)length);
+        iov[count].iov_base = (void *)buffer;
+        iov[count++].iov_len = length;
+    }
+    iov[count].iov_base = (void *)(length ? "\r\n" : "0\r\n\r\n");
+    iov[count++].iov_len = length ? 2 : 5;
+    if (!hostHttpdSend(hostRequest->_session->_fd, iov, count))
+    {
+        hostRequest->_session->_close = true;
+        return ESP_ERR_HTTPD_RESP_SEND;
+    }
+    return ESP_OK;
+}
+
+//*********************************************************************
+// Send an error response
+esp_err_t httpd_resp_send_err(httpd_req_t * request, httpd_err_code_t error, const char * message)
+{
+    HOST_HTTPD_REQUEST * hostRequest;
+
+    if ((error < 0) || (error >= HTTPD_ERR_CODE_MAX))
+        return ESP_ERR_INVALID_ARG;
+    hostRequest = (HOST_HTTPD_REQUEST *)request;
+    hostRequest->_status = hostHttpdErrorStatus[error];
+    hostRequest->_type = "text/html";
+    return httpd_resp_sendstr(request, message ? message : hostHttpdErrorStatus[error]);
+}
+
+//*********************************************************************
+// Add a response header, the strings must remain valid until the
+// response is sent
+esp_err_t httpd_resp_set_hdr(httpd_req_t * request, const char * field, const char * value)
+{
+    HOST_HTTPD_REQUEST * hostRequest;
+    int maximum;
+
+    hostRequest = (HOST_HTTPD_REQUEST *)request;
+    maximum = hostRequest->_session->_server->_config.max_resp_headers;
+    if (maximum > HOST_HTTPD_RESP_HEADERS)
+        maximum = HOST_HTTPD_RESP_HEADERS;
+    if (hostRequest->_fieldCount >= maximum)
+        return ESP_ERR_HTTPD_RESP_HDR;
+    hostRequest->_field[hostRequest->_fieldCount] = field;
+    hostRequest->_value[hostRequest->_fieldCount++] = value;
+    return ESP_OK;
+}
+
+//*********************************************************************
+// Set the response status, the string must remain valid until the
+// response is sent
+esp_err_t httpd_resp_set_status(httpd_req_t * request, const char * status)
+{
+    ((HOST_HTTPD_REQUEST *)request)->_status = status;
+    return ESP_OK;
+}
+
+//*********************************************************************
+// Set the response content type, the string must remain valid until
+// the response is sent
+esp_err_t httpd_resp_set_type(httpd_req_t * request, const char * type)
+{
+    ((HOST_HTTPD_REQUEST *)request)->_type = type;
+    return ESP_OK;
+}
+
+//*********************************************************************
+// Send data on the request's socket
+int httpd_send(httpd_req_t * request, const char * buffer, size_t length)
+{
+    HOST_HTTPD_REQUEST * hostRequest;
+    struct iovec iov;
+
+    hostRequest = (HOST_HTTPD_REQUEST *)request;
+    hostRequest->_headerSent = true;
+    iov.iov_base = (void *)buffer;
+    iov.iov_len = length;
+    if (!hostHttpdSend(hostRequest->_session->_fd, &iov, 1))
+        return HTTPD_SOCK_ERR_FAIL;
+    return length;
+}
+
+//****************************************
+// Session
+//****************************************
+
+//*********************************************************************
+// Report an error to the error handler or send the default response
+static esp_err_t hostHttpdError(HOST_HTTPD_REQUEST * request, httpd_err_code_t error)
+{
+    HOST_HTTPD * server;
+
+    server = request->_session->_server;
+    if (server->_errorHandler[error])
+        return server->_errorHandler[error](&request->_request, error);
+    httpd_resp_send_err(&request->_request, error, nullptr);
+    return ((error == HTTPD_404_NOT_FOUND) || (error == HTTPD_405_METHOD_NOT_ALLOWED))
+           ? ESP_OK : ESP_FAIL;
+}
+
+//*********************************************************************
+// Parse the request header and call the handler
+static esp_err_t hostHttpdRequest(HOST_HTTPD_SESSION * session,
+                                  HOST_HTTPD_REQUEST * request,
+                                  char * header,
+                                  size_t headerLength)
+{
+    size_t bodyLength;
+    char * end;
+    httpd_uri_match_func_t match;
+    int method;
+    bool methodFound;
+    int index;
+    char * line;
+    char * next;
+    size_t pathLength;
+    HOST_HTTPD * server;
+    httpd_uri_t * uri;
+    size_t valueLength;
+    const char * value;
+    char * version;
+
+    server = session->_server;
+    request->_request.handle = server;
+    request->_request.sess_ctx = session->_context;
+    request->_request.free_ctx = session->_freeContext;
+
+    // Split the header into lines, replacing each carriage return with a zero
+    header[headerLength - 2] = 0;
+    next = header;
+    line = nullptr;
+    while ((end = strstr(next, "\r\n")))
+    {
+        *end = 0;
+        if (!line)
+            line = next;
+        else
+            request->_headerLines += 1;
+        next = end + 2;
+    }
+    request->_headers = line + strlen(line) + 2;
+
+    // Parse the request line: method, URI and version
+    end = strchr(line, ' ');
+    version = end ? strrchr(end + 1, ' ') : nullptr;
+    if ((!end) || (!version) || (version == end))
+        return hostHttpdError(request, HTTPD_400_BAD_REQUEST);
+    *end++ = 0;
+    *version++ = 0;
+    if (strncmp(version, "HTTP/1.", 7) != 0)
+        return hostHttpdError(request, HTTPD_505_VERSION_NOT_SUPPORTED);
+    for (method = 0; method < hostHttpdMethodCount; method++)
+        if (strcmp(line, hostHttpdMethod[method]) == 0)
+            break;
+    if (method >= hostHttpdMethodCount)
+        return hostHttpdError(request, HTTPD_501_METHOD_NOT_IMPLEMENTED);
+    request->_request.method = method;
+    if (strlen(end) > HTTPD_MAX_URI_LEN)
+        return hostHttpdError(request, HTTPD_414_URI_TOO_LONG);
+    strcpy((char *)request->_request.uri, end);
+    request->_query = strchr(request->_request.uri, '?');
+    pathLength = request->_query ? (size_t)(request->_query - request->_request.uri)
+                                 : strlen(request->_request.uri);
+    if (request->_query)
+        request->_query += 1;
+
+    // HTTP/1.0 closes the connection after each request
+    if (strcmp(version, "HTTP/1.0") == 0)
+        session->_close = true;
+    value = hostHttpdHeader(request, "Connection", &valueLength);
+    if (value && (strncasecmp(value, "close", valueLength) == 0))
+        session->_close = true;
+
+    // Get the body length
+    value = hostHttpdHeader(request, "Content-Length", &valueLength);
+    if (value)
+    {
+        request->_request.content_len = strtoul(value, &end, 10);
+        if (end == value)
+            return hostHttpdError(request, HTTPD_400_BAD_REQUEST);
+    }
+    else if (hostHttpdHeader(request, "Transfer-Encoding", &valueLength))
+        return hostHttpdError(request, HTTPD_411_LENGTH_REQUIRED);
+    request->_bodyRemaining = request->_request.content_len;
+
+    // Locate the start of the body in the session buffer
+    bodyLength = session->_length - headerLength;
+    request->_body = &header[headerLength];
+    request->_bodyLength = (bodyLength < request->_request.content_len)
+                         ? bodyLength : request->_request.content_len;
+
+    // Locate the URI handler
+    match = server->_config.uri_match_fn;
+    methodFound = false;
+    uri = nullptr;
+    for (index = 0; index < server->_uriCount; index++)
+    {
+        if (match ? match(server->_uri[index].uri, request->_request.uri, pathLength)
+                  : ((strlen(server->_uri[index].uri) == pathLength)
+                     && (strncmp(server->_uri[index].uri, request->_request.uri, pathLength) == 0)))
+        {
+            methodFound = true;
+            if (server->_uri[index].method == method)
+            {
+                uri = &server->_uri[index];
+                break;
+            }
+        }
+    }
+    if (!uri)
+        return hostHttpdError(request, methodFound ? HTTPD_405_METHOD_NOT_ALLOWED
+                                                   : HTTPD_404_NOT_FOUND);
+
+    // Call the handler
+    request->_request.user_ctx = uri->user_ctx;
+    return uri->handler(&request->_request);
+}
+
+//*********************************************************************
+// Release the session context
+static void hostHttpdSessionFree(HOST_HTTPD_SESSION * session)
+{
+    if (session->_freeContext)
+        session->_freeContext(session->_context);
+    else if (session->_context)
+        free(session->_context);
+    session->_context = nullptr;
+    session->_freeContext = nullptr;
+}
+
+//*********************************************************************
+// Serve the requests from a connection
+static void * hostHttpdSession(void * parameter)
+{
+    char discard[256];
+    char * end;
+    size_t headerLength;
+    int length;
+    HOST_HTTPD_REQUEST * request;
+    HOST_HTTPD * server;
+    HOST_HTTPD_SESSION * session;
+    HOST_HTTPD_SESSION ** previous;
+    esp_err_t status;
+
+    session = (HOST_HTTPD_SESSION *)parameter;
+    server = session->_server;
+
+    // The request contains the constant URI, allocate it
+    request = (HOST_HTTPD_REQUEST *)malloc(sizeof(HOST_HTTPD_REQUEST));
+    if (!request)
+        session->_close = true;
+    while (!session->_close)
+    {
+        // Receive the request header
+        session->_buffer[session->_length] = 0;
+        while (!(end = strstr(session->_buffer, "\r\n\r\n")))
+        {
+            if (session->_length >= (sizeof(session->_buffer) - 1))
+                break;
+            length = hostHttpdRecv(session->_fd,
+                                   &session->_buffer[session->_length],
+                                   sizeof(session->_buffer) - 1 - session->_length,
+                                   -1);
+            if (length <= 0)
+                break;
+            session->_length += length;
+            session->_buffer[session->_length] = 0;
+        }
+        if (!end)
+        {
+            // Report the header that does not fit in the buffer
+            if (session->_length >= (sizeof(session->_buffer) - 1))
+            {
+                memset((void *)request, 0, sizeof(*request));
+                request->_request.handle = server;
+                request->_session = session;
+                request->_headers = "";
+                pthread_mutex_lock(&server->_mutex);
+                hostHttpdError(request, HTTPD_431_REQ_HDR_FIELDS_TOO_LARGE);
+                pthread_mutex_unlock(&server->_mutex);
+            }
+            break;
+        }
+        headerLength = end + 4 - session->_buffer;
+
+        // Process the request in the server task
+        memset((void *)request, 0, sizeof(*request));
+        request->_session = session;
+        session->_asyncBegin = false;
+        pthread_mutex_lock(&server->_mutex);
+        status = hostHttpdRequest(session, request, session->_buffer, headerLength);
+        if (status != ESP_OK)
+            session->_close = true;
+        session->_context = request->_request.sess_ctx;
+        session->_freeContext = request->_request.free_ctx;
+        pthread_mutex_unlock(&server->_mutex);
+
+        // Wait for the asynchronous copies of the request
+        pthread_mutex_lock(&server->_lock);
+        while (session->_async)
+            pthread_cond_wait(&server->_changed, &server->_lock);
+        pthread_mutex_unlock(&server->_lock);
+        if (session->_close)
+            break;
+
+        // Discard the body that the handler did not receive, the
+        // asynchronous copy closes the session instead
+        while ((!session->_asyncBegin) && request->_bodyRemaining)
+        {
+            length = httpd_req_recv(&request->_request, discard, sizeof(discard));
+            if (length <= 0)
+            {
+                session->_close = true;
+                break;
+            }
+        }
+
+        // Keep the start of the next request
+        if (request->_request.content_len < (session->_length - headerLength))
+            headerLength += request->_request.content_len;
+        else
+            headerLength = session->_length;
+        session->_length -= headerLength;
+        memmove(session->_buffer, &session->_buffer[headerLength], session->_length);
+    }
+    free(request);
+
+    // Close the session in the server task
+    pthread_mutex_lock(&server->_mutex);
+    hostHttpdSessionFree(session);
+    pthread_mutex_unlock(&server->_mutex);
+    close(session->_fd);
+
+    // Remove the session from the list
+    pthread_mutex_lock(&server->_lock);
+    previous = &server->_sessionList;
+    while (*previous != session)
+        previous = &(*previous)->_next;
+    *previous = session->_next;
+    server->_sessions -= 1;
+    pthread_cond_broadcast(&server->_changed);
+    pthread_mutex_unlock(&server->_lock);
+    free(session);
+    return nullptr;
+}
+
+//****************************************
+// Server
+//****************************************
+
+//*********************************************************************
+// Accept the connections
+static void * hostHttpdAccept(void * parameter)
+{
+    int fd;
+    int one;
+    HOST_HTTPD * server;
+    HOST_HTTPD_SESSION * session;
+    pthread_t thread;
+
+    server = (HOST_HTTPD *)parameter;
+    while (1)
+    {
+        // Wait for a session to close when all of the sockets are in use
+        pthread_mutex_lock(&server->_lock);
+        while ((!server->_stopping) && (server->_sessions >= server->_config.max_open_sockets))
+            pthread_cond_wait(&server->_changed, &server->_lock);
+        pthread_mutex_unlock(&server->_lock);
+
+        // Wait for a connection
+        fd = accept(server->_listenFd, nullptr, nullptr);
+        if (fd < 0)
+        {
+            if ((errno == EINTR) || (errno == ECONNABORTED))
+                continue;
+            break;
+        }
+        one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        // Start the session
+        session = (HOST_HTTPD_SESSION *)calloc(1, sizeof(HOST_HTTPD_SESSION));
+        if (!session)
+        {
+            close(fd);
+            continue;
+        }
+        session->_server = server;
+        session->_fd = fd;
+        pthread_mutex_lock(&server->_lock);
+        if (server->_stopping)
+        {
+            pthread_mutex_unlock(&server->_lock);
+            close(fd);
+            free(session);
+            break;
+        }
+        session->_next = server->_sessionList;
+        server->_sessionList = session;
+        server->_sessions += 1;
+        pthread_mutex_unlock(&server->_lock);
+        if (pthread_create(&thread, nullptr, hostHttpdSession, session))
+        {
+            session->_close = true;
+            shutdown(fd, SHUT_RDWR);
+            hostHttpdSession(session);
+            continue;
+        }
+        pthread_detach(thread);
+    }
+    return nullptr;
+}
+
+//*********************************************************************
+// Start the server
+esp_err_t httpd_start(httpd_handle_t * handle, const httpd_config_t * config)
+{
+    struct sockaddr_in address;
+    int one;
+    HOST_HTTPD * server;
+
+    *handle = nullptr;
+    server = (HOST_HTTPD *)calloc(1, sizeof(HOST_HTTPD));
+    if (!server)
+        return ESP_ERR_HTTPD_ALLOC_MEM;
+    server->_config = *config;
+    server->_uri = (httpd_uri_t *)calloc(config->max_uri_handlers, sizeof(httpd_uri_t));
+    server->_listenFd = -1;
+    do
+    {
+        if (!server->_uri)
+            break;
+
+        // The lwIP sockets do not raise SIGPIPE
+        signal(SIGPIPE, SIG_IGN);
+
+        // Listen for connections on all interfaces
+        server->_listenFd = socket(AF_INET, SOCK_STREAM, 0);
+        if (server->_listenFd < 0)
+            break;
+        one = 1;
+        setsockopt(server->_listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_ANY);
+        address.sin_port = htons(config->server_port);
+        if (bind(server->_listenFd, (struct sockaddr *)&address, sizeof(address))
+            || listen(server->_listenFd, config->backlog_conn))
+            break;
+
+        // Start accepting the connections
+        pthread_mutex_init(&server->_mutex, nullptr);
+        pthread_mutex_init(&server->_lock, nullptr);
+        pthread_cond_init(&server->_changed, nullptr);
+        if (pthread_create(&server->_thread, nullptr, hostHttpdAccept, server))
+        {
+            pthread_cond_destroy(&server->_changed);
+            pthread_mutex_destroy(&server->_lock);
+            pthread_mutex_destroy(&server->_mutex);
+            break;
+        }
+        *handle = server;
+        return ESP_OK;
+    } while (0);
+
+    // Release the resources
+    if (server->_listenFd >= 0)
+        close(server->_listenFd);
+    free(server->_uri);
+    free(server);
+    return ESP_ERR_HTTPD_TASK;
+}
+
+//*********************************************************************
+// Stop the server
+esp_err_t httpd_stop(httpd_handle_t handle)
+{
+    int index;
+    HOST_HTTPD * server;
+    HOST_HTTPD_SESSION * session;
+
+    server = (HOST_HTTPD *)handle;
+    if (!server)
+        return ESP_ERR_INVALID_ARG;
+
+    // Stop accepting the connections
+    pthread_mutex_lock(&server->_lock);
+    server->_stopping = true;
+    pthread_cond_broadcast(&server->_changed);
+    pthread_mutex_unlock(&server->_lock);
+    shutdown(server->_listenFd, SHUT_RDWR);
+    pthread_join(server->_thread, nullptr);
+    close(server->_listenFd);
+
+    // Close the sessions and wait for the queued work
+    pthread_mutex_lock(&server->_lock);
+    for (session = server->_sessionList; session; session = session->_next)
+        shutdown(session->_fd, SHUT_RDWR);
+    while (server->_sessions || server->_work)
+        pthread_cond_wait(&server->_changed, &server->_lock);
+    pthread_mutex_unlock(&server->_lock);
+
+    // Release the resources
+    if (server->_config.global_user_ctx_free_fn)
+        server->_config.global_user_ctx_free_fn(server->_config.global_user_ctx);
+    else
+        free(server->_config.global_user_ctx);
+    for (index = 0; index < server->_uriCount; index++)
+        free((void *)server->_uri[index].uri);
+    pthread_cond_destroy(&server->_changed);
+    pthread_mutex_destroy(&server->_lock);
+    pthread_mutex_destroy(&server->_mutex);
+    free(server->_uri);
+    free(server);
+    return ESP_OK;
+}
+
+//*********************************************************************
+// Register a URI handler
+esp_err_t httpd_register_uri_handler(httpd_handle_t handle, const httpd_uri_t * uri)
+{
+    int index;
+    HOST_HTTPD * server;
+    char * uriCopy;
+
+    server = (HOST_HTTPD *)handle;
+    if ((!server) || (!uri) || (!uri->uri) || (!uri->handler))
+        return ESP_ERR_INVALID_ARG;
+
+    // Verify that the handler is not already registered
+    pthread_mutex_lock(&server->_mutex);
+    for (index = 0; index < server->_uriCount; index++)
+        if ((server->_uri[index].method == uri->method)
+            && (strcmp(server->_uri[index].uri, uri->uri) == 0))
+        {
+            pthread_mutex_unlock(&server->_mutex);
+            return ESP_ERR_HTTPD_HANDLER_EXISTS;
+        }
+    if (server->_uriCount >= server->_config.max_uri_handlers)
+    {
+        pthread_mutex_unlock(&server->_mutex);
+        return ESP_ERR_HTTPD_HANDLERS_FULL;
+    }
+
+    // Add the handler
+    uriCopy = strdup(uri->uri);
+    if (!uriCopy)
+    {
+        pthread_mutex_unlock(&server->_mutex);
+        return ESP_ERR_HTTPD_ALLOC_MEM;
+    }
+    server->_uri[server->_uriCount] = *uri;
+    server->_uri[server->_uriCount++].uri = uriCopy;
+    pthread_mutex_unlock(&server->_mutex);
+    return ESP_OK;
+}
+
+//*********************************************************************
+// Register an error handler
+esp_err_t httpd_register_err_handler(httpd_handle_t handle,
+                                     httpd_err_code_t error,
+                                     httpd_err_handler_func_t handler)
+{
+    HOST_HTTPD * server;
+
+    server = (HOST_HTTPD *)handle;
+    if ((!server) || (error < 0) || (error >= HTTPD_ERR_CODE_MAX))
+        return ESP_ERR_INVALID_ARG;
+    server->_errorHandler[error] = handler;
+    return ESP_OK;
+}
+
+//*********************************************************************
+// Compare the URI with a template ending in an optional '*'
+bool httpd_uri_match_wildcard(const char * template_uri, const char * uri, size_t uri_len)
+{
+    size_t length;
+
+    length = strlen(template_uri);
+    if (length && (template_uri[length - 1] == '*'))
+        return (uri_len >= (length - 1)) && (strncmp(template_uri, uri, length - 1) == 0);
+    return (uri_len == length) && (strncmp(template_uri, uri, length) == 0);
+}
+
+//*********************************************************************
+// Get the server's user context
+void * httpd_get_global_user_ctx(httpd_handle_t handle)
+{
+    return handle ? ((HOST_HTTPD *)handle)->_config.global_user_ctx : nullptr;
+}
+
+//*********************************************************************
+// Run the queued work in the server task
+static void * hostHttpdWork(void * parameter)
+{
+    HOST_HTTPD * server;
+    HOST_HTTPD_WORK * work;
+
+    work = (HOST_HTTPD_WORK *)parameter;
+    server = work->_server;
+    pthread_mutex_lock(&server->_mutex);
+    work->_routine(work->_arg);
+    pthread_mutex_unlock(&server->_mutex);
+    free(work);
+
+    // Allow the server to stop
+    pthread_mutex_lock(&server->_lock);
+    server->_work -= 1;
+    pthread_cond_broadcast(&server->_changed);
+    pthread_mutex_unlock(&server->_lock);
+    return nullptr;
+}
+
+//*********************************************************************
+// Run a routine in the server task
+esp_err_t httpd_queue_work(httpd_handle_t handle, httpd_work_fn_t routine, void * arg)
+{
+    HOST_HTTPD * server;
+    pthread_t thread;
+    HOST_HTTPD_WORK * work;
+
+    server = (HOST_HTTPD *)handle;
+    if ((!server) || (!routine))
+        return ESP_ERR_INVALID_ARG;
+    work = (HOST_HTTPD_WORK *)malloc(sizeof(HOST_HTTPD_WORK));
+    if (!work)
+        return ESP_ERR_NO_MEM;
+    work->_server = server;
+    work->_routine = routine;
+    work->_arg = arg;
+
+    // Account for the work before starting the thread
+    pthread_mutex_lock(&server->_lock);
+    if (server->_stopping)
+    {
+        pthread_mutex_unlock(&server->_lock);
+        free(work);
+        return ESP_FAIL;
+    }
+    server->_work += 1;
+    pthread_mutex_unlock(&server->_lock);
+    if (pthread_create(&thread, nullptr, hostHttpdWork, work))
+    {
+        pthread_mutex_lock(&server->_lock);
+        server->_work -= 1;
+        pthread_cond_broadcast(&server->_changed);
+        pthread_mutex_unlock(&server->_lock);
+        free(work);
+        return ESP_FAIL;
+    }
+    pthread_detach(thread);
+    return ESP_OK;
+}
+
+//*********************************************************************
+// Locate the session using the socket, call while holding the lock
+static HOST_HTTPD_SESSION * hostHttpdSessionFind(HOST_HTTPD * server, int sockfd)
+{
+    HOST_HTTPD_SESSION * session;
+
+    for (session = server->_sessionList; session; session = session->_next)
+        if (session->_fd == sockfd)
+            break;
+    return session;
+}
+
+//*********************************************************************
+// Close a session
+esp_err_t httpd_sess_trigger_close(httpd_handle_t handle, int sockfd)
+{
+    HOST_HTTPD * server;
+    HOST_HTTPD_SESSION * session;
+
+    server = (HOST_HTTPD *)handle;
+    if (!server)
+        return ESP_ERR_INVALID_ARG;
+
+    // The session thread sees the end of the input and closes the session
+    pthread_mutex_lock(&server->_lock);
+    session = hostHttpdSessionFind(server, sockfd);
+    if (session)
+        shutdown(sockfd, SHUT_RDWR);
+    pthread_mutex_unlock(&server->_lock);
+    return session ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+//*********************************************************************
+// Get the socket type, WebSocket upgrades are not supported
+httpd_ws_client_info_t httpd_ws_get_fd_info(httpd_handle_t handle, int sockfd)
+{
+    HOST_HTTPD * server;
+    HOST_HTTPD_SESSION * session;
+
+    server = (HOST_HTTPD *)handle;
+    if (!server)
+        return HTTPD_WS_CLIENT_INVALID;
+    pthread_mutex_lock(&server->_lock);
+    session = hostHttpdSessionFind(server, sockfd);
+    pthread_mutex_unlock(&server->_lock);
+    return session ? HTTPD_WS_CLIENT_HTTP : HTTPD_WS_CLIENT_INVALID;
+}
+
+//*********************************************************************
+// WebSocket upgrades are not supported
+esp_err_t httpd_ws_recv_frame(httpd_req_t * request, httpd_ws_frame_t * frame, size_t maximumLength)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+//*********************************************************************
+// WebSocket upgrades are not supported
+esp_err_t httpd_ws_send_frame_async(httpd_handle_t handle, int sockfd, httpd_ws_frame_t * frame)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+//*********************************************************************
+// WebSocket upgrades are not supported
+esp_err_t httpd_ws_send_data_async(httpd_handle_t handle,
+                                   int sockfd,
+                                   httpd_ws_frame_t * frame,
+                                   transfer_complete_cb callback,
+                                   void * arg)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
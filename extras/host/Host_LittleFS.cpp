@@ -0,0 +1,225 @@
+/**********************************************************************
+  Host_LittleFS.cpp
+
+  Robots-For-All (R4A)
+  Host computer implementation of the LittleFS file system, the path
+  "/camera.rec" is the file camera.rec in the current directory
+**********************************************************************/
+
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+
+#include "R4A_ESP32.h"
+
+//*********************************************************************
+// Convert the LittleFS path into a host path
+static String hostPath(const char * path)
+{
+    while (*path == '/')
+        path++;
+    return String(*path ? path : ".");
+}
+
+//****************************************
+// File
+//****************************************
+
+//*********************************************************************
+// Describe an open file
+fs::File::File(FILE * file, const char * name)
+    : _file(file, [](FILE * file) {if (file) fclose(file);}),
+      _name(name)
+{
+}
+
+//*********************************************************************
+// Determine if the file is open
+fs::File::operator bool() const
+{
+    return _file != nullptr;
+}
+
+//*********************************************************************
+// Get the number of bytes remaining in the file
+int fs::File::available()
+{
+    return _file ? (int)(size() - position()) : 0;
+}
+
+//*********************************************************************
+// Close this copy of the file
+void fs::File::close()
+{
+    _file.reset();
+}
+
+//*********************************************************************
+// Get the time of the last write
+time_t fs::File::getLastWrite()
+{
+    struct stat status;
+
+    if (stat(_name.c_str(), &status))
+        return 0;
+    return status.st_mtime;
+}
+
+//*********************************************************************
+// Directories are not supported
+bool fs::File::isDirectory() const
+{
+    return false;
+}
+
+//*********************************************************************
+// Get the file name
+const char * fs::File::name() const
+{
+    return _name.c_str();
+}
+
+//*********************************************************************
+// Directories are not supported
+fs::File fs::File::openNextFile()
+{
+    return File();
+}
+
+//*********************************************************************
+// Get the next byte without removing it
+int fs::File::peek()
+{
+    int data;
+
+    if (!_file)
+        return -1;
+    data = fgetc(_file.get());
+    if (data != EOF)
+        ungetc(data, _file.get());
+    return (data == EOF) ? -1 : data;
+}
+
+//*********************************************************************
+// Get the file offset
+size_t fs::File::position() const
+{
+    return _file ? (size_t)ftell(_file.get()) : 0;
+}
+
+//*********************************************************************
+// Read a byte
+int fs::File::read()
+{
+    int data;
+
+    if (!_file)
+        return -1;
+    data = fgetc(_file.get());
+    return (data == EOF) ? -1 : data;
+}
+
+//*********************************************************************
+// Read data from the file
+size_t fs::File::read(uint8_t * buffer, size_t length)
+{
+    return _file ? fread(buffer, 1, length, _file.get()) : 0;
+}
+
+//*********************************************************************
+// Set the file offset
+bool fs::File::seek(uint32_t position, SeekMode mode)
+{
+    return _file && (fseek(_file.get(), position, (int)mode) == 0);
+}
+
+//*********************************************************************
+// Get the file size
+size_t fs::File::size() const
+{
+    struct stat status;
+
+    if ((!_file) || fstat(fileno(_file.get()), &status))
+        return 0;
+    return status.st_size;
+}
+
+//*********************************************************************
+// Write a byte
+size_t fs::File::write(uint8_t data)
+{
+    return write(&data, 1);
+}
+
+//*********************************************************************
+// Write data to the file
+size_t fs::File::write(const uint8_t * buffer, size_t length)
+{
+    return _file ? fwrite(buffer, 1, length, _file.get()) : 0;
+}
+
+//****************************************
+// FS
+//****************************************
+
+//*********************************************************************
+// The current directory is always available
+bool fs::FS::begin(bool formatOnFail)
+{
+    return true;
+}
+
+//*********************************************************************
+// Determine if the file exists
+bool fs::FS::exists(const char * path)
+{
+    return access(hostPath(path).c_str(), F_OK) == 0;
+}
+
+//*********************************************************************
+// Open a file
+fs::File fs::FS::open(const char * path, const char * mode, bool create)
+{
+    FILE * file;
+    String name;
+
+    name = hostPath(path);
+    file = fopen(name.c_str(), (mode[0] == 'r') ? "rb" : ((mode[0] == 'a') ? "ab" : "wb"));
+    return File(file, name.c_str());
+}
+
+//*********************************************************************
+// Remove a file
+bool fs::FS::remove(const char * path)
+{
+    return unlink(hostPath(path).c_str()) == 0;
+}
+
+//*********************************************************************
+// Rename a file
+bool fs::FS::rename(const char * pathFrom, const char * pathTo)
+{
+    return ::rename(hostPath(pathFrom).c_str(), hostPath(pathTo).c_str()) == 0;
+}
+
+//*********************************************************************
+// Get the size of the file system holding the current directory
+size_t fs::FS::totalBytes()
+{
+    struct statvfs fileSystem;
+
+    if (statvfs(".", &fileSystem))
+        return 0;
+    return fileSystem.f_blocks * fileSystem.f_frsize;
+}
+
+//*********************************************************************
+// Get the bytes not available in the file system holding the current
+// directory
+size_t fs::FS::usedBytes()
+{
+    struct statvfs fileSystem;
+
+    if (statvfs(".", &fileSystem))
+        return 0;
+    return (fileSystem.f_blocks - fileSystem.f_bavail) * fileSystem.f_frsize;
+}
@@ -0,0 +1,27 @@
+/**********************************************************************
+  Line.cpp
+
+  Robots-For-All (R4A)
+  Check and benchmark the SWAR line detection kernels on the host
+  computer
+
+  Usage:
+      line [seed]
+
+  r4aOv2640LineBenchmark compares the SWAR grayscale and RGB565 row
+  kernels with the one pixel at a time reference on random rows,
+  locates lines drawn into synthetic QQVGA frames and displays the time
+  per frame for the kernels and the reference.  The program exits with
+  a non-zero status when a check fails.  The seed selects the random
+  rows.
+**********************************************************************/
+
+#include "R4A_ESP32.h"
+
+//*********************************************************************
+// Check and benchmark the line detection kernels
+int main(int argc, char ** argv)
+{
+    srandom((argc > 1) ? atoi(argv[1]) : 1);
+    return r4aOv2640LineBenchmark(&Serial) ? 0 : 1;
+}
@@ -0,0 +1,223 @@
+/**********************************************************************
+  Odometry.cpp
+
+  Robots-For-All (R4A)
+  Validate the block matching visual odometry on the host computer
+
+  Usage:
+      odometry [seed]
+
+  Each test renders a textured floor into a QQVGA (160x120) grayscale
+  frame, moves the floor by a known translation and rotation about the
+  center of the region of interest and renders the second frame.  The
+  frames are passed to r4aOv2640OdometryUpdate with the
+  Freenove_4WD_Car example's settings and the estimate is compared with
+  the known motion.  The program exits with a non-zero status when an
+  error exceeds the limits below.
+**********************************************************************/
+
+#include "R4A_ESP32.h"
+
+//****************************************
+// Constants
+//****************************************
+
+#define ODOMETRY_GRID           4           // Texture grid spacing in pixels
+#define ODOMETRY_HEIGHT         120         // QQVGA
+#define ODOMETRY_LIMIT_DEGREES  0.5         // Largest rotation error
+#define ODOMETRY_LIMIT_PIXELS   0.5         // Largest translation error
+#define ODOMETRY_ROI_Y          60          // Matches the example
+#define ODOMETRY_WIDTH          160         // QQVGA
+
+//****************************************
+// Types
+//****************************************
+
+typedef struct _ODOMETRY_TEST
+{
+    float _dx;                  // Image motion to the right in pixels
+    float _dy;                  // Image motion down in pixels
+    float _degrees;             // Image rotation, positive is clockwise
+} ODOMETRY_TEST;
+
+//****************************************
+// Locals
+//****************************************
+
+const ODOMETRY_TEST odometryTests[] =
+{
+    { 0.0,  0.0,  0.0},
+    { 2.0,  0.0,  0.0},
+    { 0.0, -3.0,  0.0},
+    {-4.0,  1.0,  0.0},
+    { 1.5,  2.5,  0.0},
+    {-0.5, -1.5,  0.0},
+    { 6.0,  4.0,  0.0},
+    { 0.0,  0.0,  2.0},
+    { 0.0,  0.0, -3.0},
+    { 2.0, -1.0, -1.5},
+    {-3.0,  2.0,  2.5},
+};
+
+// Example settings, see examples/Freenove_4WD_Car/OV2640.ino
+R4A_OV2640_ODOMETRY odometry =
+{
+    0,                      // _roiX
+    ODOMETRY_ROI_Y,         // _roiY
+    0,                      // _roiWidth
+    0,                      // _roiHeight
+    1,                      // _levels, 1/2 scale
+    6,                      // _searchRadius
+    200,                    // _minimumTexture
+    nullptr,                // _mailbox
+};
+
+const int odometryGridWidth = 3 * ODOMETRY_WIDTH / ODOMETRY_GRID;
+const int odometryGridHeight = 3 * ODOMETRY_HEIGHT / ODOMETRY_GRID;
+uint8_t * odometryGrid;
+
+//*********************************************************************
+// Get the floor luminance, bilinear interpolation of the texture grid
+float odometryFloor(float x, float y)
+{
+    float fx;
+    float fy;
+    int gx;
+    int gy;
+    const uint8_t * grid;
+
+    // The grid extends one frame beyond each edge
+    x = (x + ODOMETRY_WIDTH) / ODOMETRY_GRID;
+    y = (y + ODOMETRY_HEIGHT) / ODOMETRY_GRID;
+    gx = (int)floorf(x);
+    gy = (int)floorf(y);
+    fx = x - gx;
+    fy = y - gy;
+    if ((gx < 0) || (gy < 0) || (gx >= (odometryGridWidth - 1)) || (gy >= (odometryGridHeight - 1)))
+        return 128;
+    grid = &odometryGrid[(gy * odometryGridWidth) + gx];
+    return ((1 - fy) * (((1 - fx) * grid[0]) + (fx * grid[1])))
+         + (fy * (((1 - fx) * grid[odometryGridWidth])
+                  + (fx * grid[odometryGridWidth + 1])));
+}
+
+//*********************************************************************
+// Render the floor after it moves by the test motion
+void odometryRender(uint8_t * image, const ODOMETRY_TEST * test)
+{
+    float centerX;
+    float centerY;
+    float cosine;
+    float px;
+    float py;
+    float qx;
+    float qy;
+    float sine;
+    float theta;
+    int x;
+    int y;
+
+    // The odometry rotates about the center of the region of interest,
+    // q = R(p - c) + c + t so p = R'(q - c - t) + c
+    centerX = ODOMETRY_WIDTH * 0.5;
+    centerY = (ODOMETRY_ROI_Y + ODOMETRY_HEIGHT) * 0.5;
+    theta = test->_degrees * (M_PI / 180.);
+    cosine = cosf(theta);
+    sine = sinf(theta);
+    for (y = 0; y < ODOMETRY_HEIGHT; y++)
+        for (x = 0; x < ODOMETRY_WIDTH; x++)
+        {
+            // Use the pixel centers
+            qx = x + 0.5 - centerX - test->_dx;
+            qy = y + 0.5 - centerY - test->_dy;
+            px = (cosine * qx) + (sine * qy) + centerX;
+            py = (-sine * qx) + (cosine * qy) + centerY;
+            image[(y * ODOMETRY_WIDTH) + x] = (uint8_t)(odometryFloor(px - 0.5, py - 0.5) + 0.5);
+        }
+}
+
+//*********************************************************************
+// Validate the odometry against the known motion
+int main(int argc, char ** argv)
+{
+    float errorDegrees;
+    float errorPixels;
+    camera_fb_t frameBuffer;
+    int failures;
+    uint8_t * image;
+    int index;
+    float maximumDegrees;
+    float maximumPixels;
+    const ODOMETRY_TEST * test;
+    const ODOMETRY_TEST still = {0, 0, 0};
+    int tests;
+
+    // Build the floor texture
+    srand((argc > 1) ? atoi(argv[1]) : 1);
+    odometryGrid = (uint8_t *)malloc(odometryGridWidth * odometryGridHeight);
+    image = (uint8_t *)malloc(ODOMETRY_WIDTH * ODOMETRY_HEIGHT);
+    if ((!odometryGrid) || (!image))
+    {
+        Serial.println("ERROR: Failed to allocate the buffers!");
+        return 1;
+    }
+    for (index = 0; index < (odometryGridWidth * odometryGridHeight); index++)
+        odometryGrid[index] = 32 + (rand() % 192);
+
+    // Describe the frames
+    memset(&frameBuffer, 0, sizeof(frameBuffer));
+    frameBuffer.buf = image;
+    frameBuffer.len = ODOMETRY_WIDTH * ODOMETRY_HEIGHT;
+    frameBuffer.width = ODOMETRY_WIDTH;
+    frameBuffer.height = ODOMETRY_HEIGHT;
+    frameBuffer.format = PIXFORMAT_GRAYSCALE;
+
+    // Compare each motion with the estimate
+    failures = 0;
+    maximumDegrees = 0;
+    maximumPixels = 0;
+    tests = sizeof(odometryTests) / sizeof(odometryTests[0]);
+    Serial.println("      Motion (dx, dy, degrees)           Estimate         Blocks  Confidence");
+    Serial.println("    ---------------------------  ---------------------------  ------  ----------");
+    for (index = 0; index < tests; index++)
+    {
+        test = &odometryTests[index];
+
+        // Render the floor before and after the motion
+        odometryRender(image, &still);
+        r4aOv2640OdometryUpdate(&odometry, &frameBuffer, &Serial);
+        odometryRender(image, test);
+        r4aOv2640OdometryUpdate(&odometry, &frameBuffer, &Serial);
+
+        // Compare the estimate with the motion
+        errorPixels = hypotf(odometry._result._dx - test->_dx,
+                             odometry._result._dy - test->_dy);
+        errorDegrees = fabsf(odometry._result._rotationDegrees - test->_degrees);
+        if (maximumPixels < errorPixels)
+            maximumPixels = errorPixels;
+        if (maximumDegrees < errorDegrees)
+            maximumDegrees = errorDegrees;
+        if ((!odometry._result._blocks)
+            || (errorPixels > ODOMETRY_LIMIT_PIXELS)
+            || (errorDegrees > ODOMETRY_LIMIT_DEGREES))
+            failures += 1;
+        Serial.printf("    %7.2f, %7.2f, %7.2f  %7.2f, %7.2f, %7.2f  %6d  %10.2f%s\r\n",
+                      test->_dx, test->_dy, test->_degrees,
+                      odometry._result._dx,
+                      odometry._result._dy,
+                      odometry._result._rotationDegrees,
+                      odometry._result._blocks,
+                      odometry._result._confidence,
+                      ((!odometry._result._blocks)
+                       || (errorPixels > ODOMETRY_LIMIT_PIXELS)
+                       || (errorDegrees > ODOMETRY_LIMIT_DEGREES)) ? "  FAIL" : "");
+    }
+
+    // Display the summary
+    Serial.printf("Largest error: %.2f pixels, %.2f degrees\r\n", maximumPixels, maximumDegrees);
+    Serial.printf("%d of %d tests passed\r\n", tests - failures, tests);
+    r4aOv2640OdometryFree(&odometry);
+    free(image);
+    free(odometryGrid);
+    return failures ? 1 : 0;
+}
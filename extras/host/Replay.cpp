@@ -0,0 +1,183 @@
+/**********************************************************************
+  Replay.cpp
+
+  Robots-For-All (R4A)
+  Replay an OV2640 recording on the host computer through the line
+  detection code and display the line location for each frame
+
+  Usage:
+      replay [recording [threshold [dark]]]
+      replay -s recording
+
+  The recording defaults to camera.rec, the file written by the
+  Freenove_4WD_Car example's record menu after it is copied from the
+  LittleFS partition.  The -s option writes a synthetic recording of a
+  dark line drifting across a light floor.
+**********************************************************************/
+
+#include "R4A_ESP32.h"
+
+//****************************************
+// Constants
+//****************************************
+
+#define REPLAY_FILE             "camera.rec"
+#define REPLAY_HEIGHT           120         // QQVGA
+#define REPLAY_SYNTHETIC_FRAMES 30
+#define REPLAY_WIDTH            160         // QQVGA
+
+//****************************************
+// Locals
+//****************************************
+
+// Rows to sample in the bottom half of the QQVGA (160x120) image, see
+// examples/Freenove_4WD_Car/Camera_Line_Following.ino
+const uint16_t replayRows[] = {60, 70, 80, 90, 100, 110};
+
+R4A_OV2640_LINE replayLine =
+{
+    replayRows,                                 // _rows
+    sizeof(replayRows) / sizeof(replayRows[0]), // _rowCount
+    96,                                         // _threshold
+    true,                                       // _lineIsDark
+    3,                                          // _minimumPixels
+};
+
+R4A_OV2640 replayCamera;
+uint32_t replayFramesFound;
+
+//*********************************************************************
+// Locate the line in a recorded frame
+bool replayFrameBuffer(R4A_OV2640 * object,
+                       camera_fb_t * frameBuffer,
+                       Print * display)
+{
+    int64_t captureUsec;
+    bool found;
+
+    captureUsec = ((int64_t)frameBuffer->timestamp.tv_sec * 1000 * 1000)
+                + frameBuffer->timestamp.tv_usec;
+    if (frameBuffer->format == PIXFORMAT_JPEG)
+    {
+        display->printf("%10lld: JPEG frame, %ld bytes, skipped\r\n",
+                        (long long)captureUsec, (long)frameBuffer->len);
+        return false;
+    }
+
+    // Locate the line
+    found = r4aOv2640LineFind(&replayLine, frameBuffer, display);
+    if (found)
+    {
+        replayFramesFound += 1;
+        display->printf("%10lld: %d rows, offset %6.3f, angle %6.1f degrees, %ld uSec\r\n",
+                        (long long)captureUsec,
+                        replayLine._rowsFound,
+                        replayLine._offset,
+                        replayLine._angleDegrees,
+                        (long)replayLine._processUsec);
+    }
+    else
+        display->printf("%10lld: Line not found\r\n", (long long)captureUsec);
+    return found;
+}
+
+//*********************************************************************
+// Write a synthetic recording of a dark line drifting across the floor
+bool replaySynthetic(const char * path)
+{
+    camera_fb_t frameBuffer;
+    int frame;
+    uint8_t * image;
+    int lineX;
+    R4A_OV2640_RECORDER recorder;
+    bool success;
+    int x;
+    int y;
+
+    memset(&recorder, 0, sizeof(recorder));
+    success = false;
+    image = (uint8_t *)malloc(REPLAY_WIDTH * REPLAY_HEIGHT);
+    do
+    {
+        if (!image)
+        {
+            Serial.printf("ERROR: Failed to allocate the image buffer!\r\n");
+            break;
+        }
+        if (!r4aOv2640RecorderBegin(&recorder,
+                                    REPLAY_SYNTHETIC_FRAMES
+                                    * (REPLAY_WIDTH * REPLAY_HEIGHT
+                                       + sizeof(R4A_OV2640_RECORD_HEADER)),
+                                    0,
+                                    &Serial))
+            break;
+
+        // Build the frames, the line leans to the right as it drifts
+        for (frame = 0; frame < REPLAY_SYNTHETIC_FRAMES; frame++)
+        {
+            memset(image, 200, REPLAY_WIDTH * REPLAY_HEIGHT);
+            for (y = 0; y < REPLAY_HEIGHT; y++)
+            {
+                lineX = 20 + (frame * 4) + ((REPLAY_HEIGHT - y) * frame) / 60;
+                for (x = lineX; (x < lineX + 6) && (x < REPLAY_WIDTH); x++)
+                    image[(y * REPLAY_WIDTH) + x] = 30;
+            }
+
+            memset(&frameBuffer, 0, sizeof(frameBuffer));
+            frameBuffer.buf = image;
+            frameBuffer.len = REPLAY_WIDTH * REPLAY_HEIGHT;
+            frameBuffer.width = REPLAY_WIDTH;
+            frameBuffer.height = REPLAY_HEIGHT;
+            frameBuffer.format = PIXFORMAT_GRAYSCALE;
+            frameBuffer.timestamp.tv_usec = frame * 33333;
+            if (!r4aOv2640RecorderAdd(&recorder, &frameBuffer))
+                break;
+        }
+
+        // Write the recording
+        success = r4aOv2640RecorderSave(&recorder, path, &Serial);
+        if (success)
+            Serial.printf("%ld frames written to %s\r\n",
+                          (long)recorder._frames, path);
+    } while (0);
+
+    r4aOv2640RecorderFree(&recorder);
+    free(image);
+    return success;
+}
+
+//*********************************************************************
+// Replay a recording through the line detection
+int main(int argc, char ** argv)
+{
+    uint32_t frames;
+    const char * path;
+    R4A_OV2640_RECORDER recorder;
+
+    // Write a synthetic recording
+    if ((argc == 3) && (strcmp(argv[1], "-s") == 0))
+        return replaySynthetic(argv[2]) ? 0 : 1;
+
+    // Get the line detection parameters
+    path = (argc > 1) ? argv[1] : REPLAY_FILE;
+    if (argc > 2)
+        replayLine._threshold = atoi(argv[2]);
+    if (argc > 3)
+        replayLine._lineIsDark = atoi(argv[3]) != 0;
+
+    // Read the recording
+    memset(&recorder, 0, sizeof(recorder));
+    if (!r4aOv2640RecorderLoad(&recorder, path, &Serial))
+        return 1;
+
+    // Replay the frames
+    frames = r4aOv2640Replay(recorder._buffer,
+                             recorder._length,
+                             &replayCamera,
+                             replayFrameBuffer,
+                             &Serial);
+    Serial.printf("%ld frames replayed, line found in %ld frames\r\n",
+                  (long)frames, (long)replayFramesFound);
+    r4aOv2640RecorderFree(&recorder);
+    return 0;
+}
@@ -0,0 +1,208 @@
+/**********************************************************************
+  Arduino.h
+
+  Robots-For-All (R4A)
+  Host stand-in for the Arduino ESP32 core declarations used by the
+  library, only large enough to build the vision and web server code
+**********************************************************************/
+
+#ifndef __R4A_HOST_ARDUINO_H__
+#define __R4A_HOST_ARDUINO_H__
+
+#include <ctype.h>
+#include <errno.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+//****************************************
+// ESP-IDF types and constants
+//****************************************
+
+typedef int esp_err_t;
+
+#define ESP_OK                      0
+#define ESP_FAIL                    -1
+#define ESP_ERR_NO_MEM              0x101
+#define ESP_ERR_INVALID_ARG         0x102
+#define ESP_ERR_INVALID_STATE       0x103
+#define ESP_ERR_INVALID_SIZE        0x104
+#define ESP_ERR_NOT_FOUND           0x105
+#define ESP_ERR_NOT_SUPPORTED       0x106
+#define ESP_ERR_TIMEOUT             0x107
+
+#define MALLOC_CAP_DMA              (1 << 3)
+#define MALLOC_CAP_8BIT             (1 << 2)
+#define MALLOC_CAP_SPIRAM           (1 << 10)
+#define MALLOC_CAP_INTERNAL         (1 << 11)
+
+void * heap_caps_malloc(size_t size, uint32_t caps);
+void * heap_caps_realloc(void * ptr, size_t size, uint32_t caps);
+void heap_caps_free(void * ptr);
+size_t heap_caps_get_free_size(uint32_t caps);
+size_t heap_caps_get_largest_free_block(uint32_t caps);
+size_t heap_caps_get_minimum_free_size(uint32_t caps);
+
+int64_t esp_timer_get_time();
+uint32_t esp_random();
+
+//****************************************
+// FreeRTOS
+//****************************************
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef void * TaskHandle_t;
+typedef void * QueueHandle_t;
+typedef void * SemaphoreHandle_t;
+typedef void (* TaskFunction_t)(void * parameter);
+
+#define pdFALSE                     0
+#define pdTRUE                      1
+#define pdFAIL                      0
+#define pdPASS                      1
+#define portMAX_DELAY               ((TickType_t)0xffffffff)
+#define portTICK_PERIOD_MS          1
+
+typedef struct
+{
+    volatile int owner;
+    int count;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED    {0, 0}
+
+void vPortEnterCritical(portMUX_TYPE * mux);
+void vPortExitCritical(portMUX_TYPE * mux);
+#define portENTER_CRITICAL(mux)     vPortEnterCritical(mux)
+#define portEXIT_CRITICAL(mux)      vPortExitCritical(mux)
+
+BaseType_t xPortGetCoreID();
+size_t xPortGetFreeHeapSize();
+size_t xPortGetMinimumEverFreeHeapSize();
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function,
+                                   const char * name,
+                                   uint32_t stackBytes,
+                                   void * parameter,
+                                   UBaseType_t priority,
+                                   TaskHandle_t * handle,
+                                   BaseType_t core);
+BaseType_t xTaskGetCoreID(TaskHandle_t task);
+TaskHandle_t xTaskGetCurrentTaskHandle();
+UBaseType_t uxTaskPriorityGet(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+void vTaskDelete(TaskHandle_t task);
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize);
+BaseType_t xQueueReceive(QueueHandle_t queue, void * item, TickType_t ticks);
+BaseType_t xQueueSend(QueueHandle_t queue, const void * item, TickType_t ticks);
+void vQueueDelete(QueueHandle_t queue);
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t maximum, UBaseType_t initial);
+SemaphoreHandle_t xSemaphoreCreateMutex();
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks);
+void vSemaphoreDelete(SemaphoreHandle_t semaphore);
+
+//****************************************
+// Arduino
+//****************************************
+
+#define HEX 16
+#define DEC 10
+
+void delay(uint32_t msec);
+uint32_t millis();
+uint32_t micros();
+
+class String
+{
+  private:
+
+    char * _buffer;
+
+  public:
+
+    String(const char * string = "");
+    String(const String & string);
+    ~String();
+    String & operator=(const String & string);
+    const char * c_str() const;
+    size_t length() const;
+};
+
+class Print
+{
+  public:
+
+    virtual ~Print() {}
+    virtual size_t write(uint8_t data) = 0;
+    virtual size_t write(const uint8_t * buffer, size_t length);
+    size_t write(const char * string);
+    size_t print(const char * string);
+    size_t print(char value);
+    size_t print(int value, int base = DEC);
+    size_t print(unsigned int value, int base = DEC);
+    size_t print(long value, int base = DEC);
+    size_t print(unsigned long value, int base = DEC);
+    size_t print(double value, int digits = 2);
+    size_t print(const String & string);
+    size_t printf(const char * format, ...);
+    size_t println();
+    size_t println(const char * string);
+    size_t println(char value);
+    size_t println(int value, int base = DEC);
+    size_t println(unsigned int value, int base = DEC);
+    size_t println(long value, int base = DEC);
+    size_t println(unsigned long value, int base = DEC);
+    size_t println(double value, int digits = 2);
+    size_t println(const String & string);
+    virtual void flush() {}
+};
+
+class Stream : public Print
+{
+  public:
+
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+};
+
+// Standard output
+class HardwareSerial : public Stream
+{
+  public:
+
+    int available();
+    int peek();
+    int read();
+    size_t write(uint8_t data);
+    size_t write(const uint8_t * buffer, size_t length);
+    using Print::write;
+};
+
+extern HardwareSerial Serial;
+
+// Heap statistics
+class EspClass
+{
+  public:
+
+    uint32_t getFreeHeap();
+    uint32_t getFreePsram();
+};
+
+extern EspClass ESP;
+
+#endif  // __R4A_HOST_ARDUINO_H__
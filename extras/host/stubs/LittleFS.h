@@ -0,0 +1,78 @@
+/**********************************************************************
+  LittleFS.h
+
+  Robots-For-All (R4A)
+  Host stand-in for the LittleFS file system, the files are in the
+  current directory of the host program
+**********************************************************************/
+
+#ifndef __R4A_HOST_LITTLEFS_H__
+#define __R4A_HOST_LITTLEFS_H__
+
+#include <Arduino.h>
+#include <memory>
+
+#define FILE_READ       "r"
+#define FILE_WRITE      "w"
+#define FILE_APPEND     "a"
+
+namespace fs
+{
+
+enum SeekMode
+{
+    SeekSet = 0,
+    SeekCur = 1,
+    SeekEnd = 2
+};
+
+class File : public Stream
+{
+  private:
+
+    std::shared_ptr<FILE> _file;    // Open file, closed by the last copy
+    String _name;                   // Path to the file
+
+  public:
+
+    File(FILE * file = nullptr, const char * name = "");
+    operator bool() const;
+
+    int available();
+    void close();
+    time_t getLastWrite();
+    bool isDirectory() const;
+    const char * name() const;
+    File openNextFile();
+    int peek();
+    size_t position() const;
+    int read();
+    size_t read(uint8_t * buffer, size_t length);
+    bool seek(uint32_t position, SeekMode mode = SeekSet);
+    size_t size() const;
+    size_t write(uint8_t data);
+    size_t write(const uint8_t * buffer, size_t length);
+    using Print::write;
+};
+
+class FS
+{
+  public:
+
+    bool begin(bool formatOnFail = false);
+    bool exists(const char * path);
+    File open(const char * path, const char * mode = FILE_READ, bool create = false);
+    bool remove(const char * path);
+    bool rename(const char * pathFrom, const char * pathTo);
+    size_t totalBytes();
+    size_t usedBytes();
+};
+
+}   // namespace fs
+
+using fs::File;
+using fs::FS;
+
+extern fs::FS LittleFS;
+
+#endif  // __R4A_HOST_LITTLEFS_H__
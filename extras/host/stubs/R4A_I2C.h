@@ -0,0 +1,34 @@
+/**********************************************************************
+  R4A_I2C.h
+
+  Robots-For-All (R4A)
+  Host stand-in for the I2C bus declarations
+**********************************************************************/
+
+#ifndef __R4A_HOST_I2C_H__
+#define __R4A_HOST_I2C_H__
+
+#include <R4A_Robot.h>
+
+typedef struct _R4A_I2C_BUS
+{
+    volatile int _lock;
+    size_t (* _read)(struct _R4A_I2C_BUS * object,
+                     uint8_t deviceI2cAddress,
+                     const uint8_t * cmdBuffer,
+                     size_t cmdByteCount,
+                     uint8_t * readBuffer,
+                     size_t readByteCount,
+                     Print * display,
+                     bool releaseI2cBus);
+    bool (* _writeWithLock)(struct _R4A_I2C_BUS * object,
+                            uint8_t deviceI2cAddress,
+                            const uint8_t * cmdBuffer,
+                            size_t cmdByteCount,
+                            const uint8_t * dataBuffer,
+                            size_t dataByteCount,
+                            Print * display,
+                            bool releaseI2cBus);
+} R4A_I2C_BUS;
+
+#endif  // __R4A_HOST_I2C_H__
@@ -0,0 +1,43 @@
+/**********************************************************************
+  R4A_Robot.h
+
+  Robots-For-All (R4A)
+  Host stand-in for the robot library declarations
+**********************************************************************/
+
+#ifndef __R4A_HOST_ROBOT_H__
+#define __R4A_HOST_ROBOT_H__
+
+#include <Arduino.h>
+
+struct _R4A_MENU_ENTRY;
+
+typedef void (* R4A_MENU_ROUTINE)(const struct _R4A_MENU_ENTRY * menuEntry,
+                                  const char * command,
+                                  Print * display);
+typedef void (* R4A_HELP_ROUTINE)(const struct _R4A_MENU_ENTRY * menuEntry,
+                                  uint8_t align,
+                                  Print * display);
+
+typedef struct _R4A_MENU_ENTRY
+{
+    const char * command;
+    R4A_MENU_ROUTINE processingRoutine;
+    intptr_t menuParameter;
+    R4A_HELP_ROUTINE helpRoutine;
+    int align;
+    const char * helpText;
+} R4A_MENU_ENTRY;
+
+class R4A_SPI
+{
+  public:
+    virtual ~R4A_SPI() {}
+};
+
+void r4aLockAcquire(volatile int * lock);
+void r4aLockRelease(volatile int * lock);
+void r4aDumpBuffer(intptr_t offset, const uint8_t * buffer, int length,
+                   Print * display = &Serial);
+
+#endif  // __R4A_HOST_ROBOT_H__
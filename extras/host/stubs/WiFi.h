@@ -0,0 +1,42 @@
+/**********************************************************************
+  WiFi.h
+
+  Robots-For-All (R4A)
+  Host stand-in for the ESP32 WiFi, SPI and I2C declarations, the host
+  computer's network is used instead of a WiFi station
+**********************************************************************/
+
+#ifndef __R4A_HOST_WIFI_H__
+#define __R4A_HOST_WIFI_H__
+
+#include <Arduino.h>
+
+typedef int arduino_event_id_t;
+
+typedef struct _ARDUINO_EVENT_INFO
+{
+    int unused;
+} arduino_event_info_t;
+
+typedef struct _SPI_T spi_t;
+
+class TwoWire;
+
+class IPAddress
+{
+  public:
+
+    String toString() const;
+};
+
+class WiFiClass
+{
+  public:
+
+    IPAddress localIP();
+    int8_t RSSI();
+};
+
+extern WiFiClass WiFi;
+
+#endif  // __R4A_HOST_WIFI_H__
@@ -0,0 +1,13 @@
+/**********************************************************************
+  WiFiClient.h
+
+  Robots-For-All (R4A)
+  Host stand-in, the declarations are in WiFi.h
+**********************************************************************/
+
+#ifndef __R4A_HOST_WIFICLIENT_H__
+#define __R4A_HOST_WIFICLIENT_H__
+
+#include <WiFi.h>
+
+#endif  // __R4A_HOST_WIFICLIENT_H__
@@ -0,0 +1,143 @@
+/**********************************************************************
+  esp_camera.h
+
+  Robots-For-All (R4A)
+  Host stand-in for the esp32-camera declarations, frames come from
+  recordings instead of the sensor
+**********************************************************************/
+
+#ifndef __R4A_HOST_ESP_CAMERA_H__
+#define __R4A_HOST_ESP_CAMERA_H__
+
+#include <Arduino.h>
+
+typedef enum
+{
+    PIXFORMAT_RGB565,
+    PIXFORMAT_YUV422,
+    PIXFORMAT_YUV420,
+    PIXFORMAT_GRAYSCALE,
+    PIXFORMAT_JPEG,
+    PIXFORMAT_RGB888,
+    PIXFORMAT_RAW,
+    PIXFORMAT_RGB444,
+    PIXFORMAT_RGB555,
+} pixformat_t;
+
+typedef enum
+{
+    FRAMESIZE_96X96,
+    FRAMESIZE_QQVGA,
+    FRAMESIZE_QCIF,
+    FRAMESIZE_HQVGA,
+    FRAMESIZE_240X240,
+    FRAMESIZE_QVGA,
+    FRAMESIZE_CIF,
+    FRAMESIZE_HVGA,
+    FRAMESIZE_VGA,
+    FRAMESIZE_SVGA,
+    FRAMESIZE_XGA,
+    FRAMESIZE_HD,
+    FRAMESIZE_SXGA,
+    FRAMESIZE_UXGA,
+} framesize_t;
+
+typedef enum
+{
+    CAMERA_GRAB_WHEN_EMPTY,
+    CAMERA_GRAB_LATEST,
+} camera_grab_mode_t;
+
+typedef enum
+{
+    LEDC_CHANNEL_0,
+} ledc_channel_t;
+
+typedef enum
+{
+    LEDC_TIMER_0,
+} ledc_timer_t;
+
+typedef struct
+{
+    uint8_t * buf;
+    size_t len;
+    size_t width;
+    size_t height;
+    pixformat_t format;
+    struct timeval timestamp;
+} camera_fb_t;
+
+typedef struct
+{
+    int pin_pwdn;
+    int pin_reset;
+    int pin_xclk;
+    int pin_sccb_sda;
+    int pin_sccb_scl;
+    int pin_d7;
+    int pin_d6;
+    int pin_d5;
+    int pin_d4;
+    int pin_d3;
+    int pin_d2;
+    int pin_d1;
+    int pin_d0;
+    int pin_vsync;
+    int pin_href;
+    int pin_pclk;
+    int xclk_freq_hz;
+    ledc_timer_t ledc_timer;
+    ledc_channel_t ledc_channel;
+    pixformat_t pixel_format;
+    framesize_t frame_size;
+    int jpeg_quality;
+    size_t fb_count;
+    camera_grab_mode_t grab_mode;
+} camera_config_t;
+
+typedef struct
+{
+    uint8_t quality;
+} camera_status_t;
+
+typedef struct _sensor sensor_t;
+struct _sensor
+{
+    camera_status_t status;
+    int (* set_reg)(sensor_t * sensor, int reg, int mask, int value);
+    int (* get_reg)(sensor_t * sensor, int reg, int mask);
+    int (* set_quality)(sensor_t * sensor, int quality);
+    int (* set_hmirror)(sensor_t * sensor, int enable);
+    int (* set_vflip)(sensor_t * sensor, int enable);
+    int (* set_brightness)(sensor_t * sensor, int level);
+    int (* set_saturation)(sensor_t * sensor, int level);
+    int (* set_agc_gain)(sensor_t * sensor, int gain);
+    int (* set_awb_gain)(sensor_t * sensor, int enable);
+    int (* set_gain_ctrl)(sensor_t * sensor, int enable);
+};
+
+typedef size_t (* jpg_out_cb)(void * arg, size_t index, const void * data, size_t len);
+
+// Host computer only, the frame returned by esp_camera_fb_get, nullptr
+// when there is no camera
+extern camera_fb_t * hostCameraFrameBuffer;
+
+esp_err_t esp_camera_init(const camera_config_t * config);
+camera_fb_t * esp_camera_fb_get();
+void esp_camera_fb_return(camera_fb_t * frameBuffer);
+sensor_t * esp_camera_sensor_get();
+
+bool frame2jpg(camera_fb_t * frameBuffer, uint8_t quality, uint8_t ** out, size_t * outLength);
+bool frame2jpg_cb(camera_fb_t * frameBuffer, uint8_t quality, jpg_out_cb callback, void * arg);
+typedef enum
+{
+    JPG_SCALE_NONE,
+    JPG_SCALE_2X,
+    JPG_SCALE_4X,
+    JPG_SCALE_8X,
+} jpg_scale_t;
+
+bool jpg2rgb565(const uint8_t * src, size_t srcLength, uint8_t * out, jpg_scale_t scale);
+
+#endif  // __R4A_HOST_ESP_CAMERA_H__
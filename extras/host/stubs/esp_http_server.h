@@ -0,0 +1,227 @@
+/**********************************************************************
+  esp_http_server.h
+
+  Robots-For-All (R4A)
+  Host stand-in for the ESP-IDF HTTP server declarations, see
+  Host_Httpd.cpp for the implementation
+**********************************************************************/
+
+#ifndef __R4A_HOST_ESP_HTTP_SERVER_H__
+#define __R4A_HOST_ESP_HTTP_SERVER_H__
+
+#include <Arduino.h>
+
+#define ESP_ERR_HTTPD_BASE              0xb000
+#define ESP_ERR_HTTPD_HANDLERS_FULL     (ESP_ERR_HTTPD_BASE + 1)
+#define ESP_ERR_HTTPD_HANDLER_EXISTS    (ESP_ERR_HTTPD_BASE + 2)
+#define ESP_ERR_HTTPD_INVALID_REQ       (ESP_ERR_HTTPD_BASE + 3)
+#define ESP_ERR_HTTPD_RESULT_TRUNC      (ESP_ERR_HTTPD_BASE + 4)
+#define ESP_ERR_HTTPD_RESP_HDR          (ESP_ERR_HTTPD_BASE + 5)
+#define ESP_ERR_HTTPD_RESP_SEND         (ESP_ERR_HTTPD_BASE + 6)
+#define ESP_ERR_HTTPD_ALLOC_MEM         (ESP_ERR_HTTPD_BASE + 7)
+#define ESP_ERR_HTTPD_TASK              (ESP_ERR_HTTPD_BASE + 8)
+
+#define HTTPD_SOCK_ERR_FAIL             -1
+#define HTTPD_SOCK_ERR_INVALID          -2
+#define HTTPD_SOCK_ERR_TIMEOUT          -3
+
+#define HTTPD_RESP_USE_STRLEN           -1
+#define HTTPD_MAX_URI_LEN               512
+
+typedef void * httpd_handle_t;
+typedef void (* httpd_free_ctx_fn_t)(void * ctx);
+typedef void (* httpd_work_fn_t)(void * arg);
+
+typedef enum http_method
+{
+    HTTP_DELETE = 0,
+    HTTP_GET = 1,
+    HTTP_HEAD = 2,
+    HTTP_POST = 3,
+    HTTP_PUT = 4,
+} httpd_method_t;
+
+typedef enum
+{
+    HTTPD_500_INTERNAL_SERVER_ERROR = 0,
+    HTTPD_501_METHOD_NOT_IMPLEMENTED,
+    HTTPD_505_VERSION_NOT_SUPPORTED,
+    HTTPD_400_BAD_REQUEST,
+    HTTPD_401_UNAUTHORIZED,
+    HTTPD_403_FORBIDDEN,
+    HTTPD_404_NOT_FOUND,
+    HTTPD_405_METHOD_NOT_ALLOWED,
+    HTTPD_408_REQ_TIMEOUT,
+    HTTPD_411_LENGTH_REQUIRED,
+    HTTPD_414_URI_TOO_LONG,
+    HTTPD_431_REQ_HDR_FIELDS_TOO_LARGE,
+    HTTPD_ERR_CODE_MAX
+} httpd_err_code_t;
+
+typedef struct httpd_req
+{
+    httpd_handle_t handle;
+    int method;
+    const char uri[HTTPD_MAX_URI_LEN + 1];
+    size_t content_len;
+    void * aux;
+    void * user_ctx;
+    void * sess_ctx;
+    httpd_free_ctx_fn_t free_ctx;
+    bool ignore_sess_ctx_changes;
+} httpd_req_t;
+
+typedef esp_err_t (* httpd_err_handler_func_t)(httpd_req_t * request,
+                                               httpd_err_code_t error);
+
+typedef struct httpd_uri
+{
+    const char * uri;
+    httpd_method_t method;
+    esp_err_t (* handler)(httpd_req_t * request);
+    void * user_ctx;
+    bool is_websocket;
+    bool handle_ws_control_frames;
+    const char * supported_subprotocol;
+} httpd_uri_t;
+
+typedef bool (* httpd_uri_match_func_t)(const char * template_uri,
+                                        const char * uri,
+                                        size_t uri_len);
+
+typedef struct httpd_config
+{
+    unsigned task_priority;
+    size_t stack_size;
+    BaseType_t core_id;
+    uint16_t server_port;
+    uint16_t ctrl_port;
+    uint16_t max_open_sockets;
+    uint16_t max_uri_handlers;
+    uint16_t max_resp_headers;
+    uint16_t backlog_conn;
+    bool lru_purge_enable;
+    uint16_t recv_wait_timeout;
+    uint16_t send_wait_timeout;
+    void * global_user_ctx;
+    httpd_free_ctx_fn_t global_user_ctx_free_fn;
+    void * global_transport_ctx;
+    httpd_free_ctx_fn_t global_transport_ctx_free_fn;
+    httpd_uri_match_func_t uri_match_fn;
+} httpd_config_t;
+
+#define HTTPD_DEFAULT_CONFIG() {                \
+        .task_priority      = 5,                \
+        .stack_size         = 4096,             \
+        .core_id            = 0x7fffffff,       \
+        .server_port        = 80,               \
+        .ctrl_port          = 32768,            \
+        .max_open_sockets   = 7,                \
+        .max_uri_handlers   = 8,                \
+        .max_resp_headers   = 8,                \
+        .backlog_conn       = 5,                \
+        .lru_purge_enable   = false,            \
+        .recv_wait_timeout  = 5,                \
+        .send_wait_timeout  = 5,                \
+        .global_user_ctx = NULL,                \
+        .global_user_ctx_free_fn = NULL,        \
+        .global_transport_ctx = NULL,           \
+        .global_transport_ctx_free_fn = NULL,   \
+        .uri_match_fn = NULL                    \
+}
+
+// WebSocket
+typedef enum
+{
+    HTTPD_WS_TYPE_CONTINUE = 0x0,
+    HTTPD_WS_TYPE_TEXT = 0x1,
+    HTTPD_WS_TYPE_BINARY = 0x2,
+    HTTPD_WS_TYPE_CLOSE = 0x8,
+    HTTPD_WS_TYPE_PING = 0x9,
+    HTTPD_WS_TYPE_PONG = 0xa,
+} httpd_ws_type_t;
+
+typedef enum
+{
+    HTTPD_WS_CLIENT_INVALID = 0x0,
+    HTTPD_WS_CLIENT_HTTP = 0x1,
+    HTTPD_WS_CLIENT_WEBSOCKET = 0x2,
+} httpd_ws_client_info_t;
+
+typedef struct httpd_ws_frame
+{
+    bool final;
+    bool fragmented;
+    httpd_ws_type_t type;
+    uint8_t * payload;
+    size_t len;
+} httpd_ws_frame_t;
+
+typedef void (* transfer_complete_cb)(esp_err_t err, int socket, void * arg);
+
+// Server
+esp_err_t httpd_start(httpd_handle_t * handle, const httpd_config_t * config);
+esp_err_t httpd_stop(httpd_handle_t handle);
+esp_err_t httpd_register_uri_handler(httpd_handle_t handle, const httpd_uri_t * uri);
+esp_err_t httpd_register_err_handler(httpd_handle_t handle,
+                                     httpd_err_code_t error,
+                                     httpd_err_handler_func_t handler);
+bool httpd_uri_match_wildcard(const char * template_uri, const char * uri, size_t uri_len);
+void * httpd_get_global_user_ctx(httpd_handle_t handle);
+esp_err_t httpd_queue_work(httpd_handle_t handle, httpd_work_fn_t work, void * arg);
+esp_err_t httpd_sess_trigger_close(httpd_handle_t handle, int sockfd);
+
+// Request
+esp_err_t httpd_req_async_handler_begin(httpd_req_t * request, httpd_req_t ** copy);
+esp_err_t httpd_req_async_handler_complete(httpd_req_t * request);
+size_t httpd_req_get_hdr_value_len(httpd_req_t * request, const char * field);
+esp_err_t httpd_req_get_hdr_value_str(httpd_req_t * request,
+                                      const char * field,
+                                      char * value,
+                                      size_t valueSize);
+size_t httpd_req_get_url_query_len(httpd_req_t * request);
+esp_err_t httpd_req_get_url_query_str(httpd_req_t * request, char * buffer, size_t bufferSize);
+esp_err_t httpd_query_key_value(const char * query, const char * key, char * value, size_t valueSize);
+int httpd_req_recv(httpd_req_t * request, char * buffer, size_t bufferSize);
+int httpd_req_to_sockfd(httpd_req_t * request);
+
+// Response
+esp_err_t httpd_resp_send(httpd_req_t * request, const char * buffer, ssize_t length);
+esp_err_t httpd_resp_send_chunk(httpd_req_t * request, const char * buffer, ssize_t length);
+esp_err_t httpd_resp_send_err(httpd_req_t * request, httpd_err_code_t error, const char * message);
+esp_err_t httpd_resp_set_hdr(httpd_req_t * request, const char * field, const char * value);
+esp_err_t httpd_resp_set_status(httpd_req_t * request, const char * status);
+esp_err_t httpd_resp_set_type(httpd_req_t * request, const char * type);
+int httpd_send(httpd_req_t * request, const char * buffer, size_t length);
+
+static inline esp_err_t httpd_resp_sendstr(httpd_req_t * request, const char * string)
+{
+    return httpd_resp_send(request, string, string ? strlen(string) : 0);
+}
+
+static inline esp_err_t httpd_resp_sendstr_chunk(httpd_req_t * request, const char * string)
+{
+    return httpd_resp_send_chunk(request, string, string ? strlen(string) : 0);
+}
+
+static inline esp_err_t httpd_resp_send_404(httpd_req_t * request)
+{
+    return httpd_resp_send_err(request, HTTPD_404_NOT_FOUND, NULL);
+}
+
+static inline esp_err_t httpd_resp_send_500(httpd_req_t * request)
+{
+    return httpd_resp_send_err(request, HTTPD_500_INTERNAL_SERVER_ERROR, NULL);
+}
+
+// WebSocket
+httpd_ws_client_info_t httpd_ws_get_fd_info(httpd_handle_t handle, int sockfd);
+esp_err_t httpd_ws_recv_frame(httpd_req_t * request, httpd_ws_frame_t * frame, size_t maximumLength);
+esp_err_t httpd_ws_send_frame_async(httpd_handle_t handle, int sockfd, httpd_ws_frame_t * frame);
+esp_err_t httpd_ws_send_data_async(httpd_handle_t handle,
+                                   int sockfd,
+                                   httpd_ws_frame_t * frame,
+                                   transfer_complete_cb callback,
+                                   void * arg);
+
+#endif  // __R4A_HOST_ESP_HTTP_SERVER_H__
@@ -0,0 +1,13 @@
+/**********************************************************************
+  esp_wifi.h
+
+  Robots-For-All (R4A)
+  Host stand-in, the declarations are in WiFi.h
+**********************************************************************/
+
+#ifndef __R4A_HOST_ESP_WIFI_H__
+#define __R4A_HOST_ESP_WIFI_H__
+
+#include <WiFi.h>
+
+#endif  // __R4A_HOST_ESP_WIFI_H__
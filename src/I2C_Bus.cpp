@@ -57,7 +57,7 @@ size_t r4aEsp32I2cBusRead(R4A_I2C_BUS * object,
         // Empty the I2C RX buffer
         object->_i2cBus->flush();
 
-        // Address the I2C device
+        // Address the I2C device, the write accounts for the transaction
         if (cmdByteCount)
         {
             if (!r4aEsp32I2cBusWriteWithLock(object,
@@ -75,6 +75,13 @@ size_t r4aEsp32I2cBusRead(R4A_I2C_BUS * object,
         bytesRead = object->_i2cBus->requestFrom(deviceI2cAddress, readByteCount);
         object->_i2cBus->endTransmission(releaseI2cBus);
 
+        // Account for the transaction, a register read is a single
+        // transaction
+        if (!cmdByteCount)
+            r4aMetricIncrement(&r4aMetricI2cTransactions);
+        if (bytesRead != readByteCount)
+            r4aMetricIncrement(&r4aMetricI2cErrors);
+
         // Move the data into the read buffer
         for (size_t index = 0; index < bytesRead; index++)
             readBuffer[index] = object->_i2cBus->read();
@@ -109,6 +116,7 @@ bool r4aEsp32I2cBusWriteWithLock(R4A_I2C_BUS * object,
     size_t bytesWritten;
     size_t cmdBytesWritten;
     size_t dataBytesWritten;
+    uint8_t status;
 
     do
     {
@@ -116,6 +124,7 @@ bool r4aEsp32I2cBusWriteWithLock(R4A_I2C_BUS * object,
         bytesWritten = 0;
         cmdBytesWritten = 0;
         dataBytesWritten = 0;
+        status = 0;
 
         // Display the I2C transaction request
         if (display)
@@ -149,21 +158,30 @@ bool r4aEsp32I2cBusWriteWithLock(R4A_I2C_BUS * object,
             bytesWritten += dataBytesWritten;
         }
 
-        // Done sending data to the I2C device
+        // Done sending data to the I2C device.  The write only fills the
+        // TX buffer, the data is sent by endTransmission which returns
+        // non-zero when the device does not acknowledge or the bus
+        // times out.
         if (bytesWritten == (cmdByteCount + dataByteCount))
-            object->_i2cBus->endTransmission(releaseI2cBus);
+            status = object->_i2cBus->endTransmission(releaseI2cBus);
         else
             object->_i2cBus->endTransmission();
     } while (0);
 
+    // Account for the transaction
+    r4aMetricIncrement(&r4aMetricI2cTransactions);
+    if ((bytesWritten != (cmdByteCount + dataByteCount)) || status)
+        r4aMetricIncrement(&r4aMetricI2cErrors);
+
     // Display the I2C transaction results
     if (display)
     {
         display->printf("    cmdBytesWritten: %d\r\n", cmdBytesWritten);
         display->printf("    dataBytesWritten: %d\r\n", dataBytesWritten);
         display->printf("    bytesWritten: %d\r\n", bytesWritten);
+        display->printf("    status: %d\r\n", status);
     }
 
     // Return the write status
-    return (bytesWritten == (cmdByteCount + dataByteCount));
+    return (bytesWritten == (cmdByteCount + dataByteCount)) && (status == 0);
 }
@@ -0,0 +1,82 @@
+/**********************************************************************
+  Mailbox.cpp
+
+  Robots-For-All (R4A)
+  Lock-free mailbox support
+
+  The mailbox holds the most recent message from a single writer.  The
+  sequence number is odd while the writer is updating the message.
+  Readers copy the message and retry when the sequence number changed
+  during the copy.  Neither the writer or readers ever wait for a lock.
+
+  A reader never spins waiting for the writer.  A reader that preempted
+  the writer on the same core would wait forever, so the read returns
+  zero when the writer is updating the message and gives up after
+  R4A_ESP32_MAILBOX_RETRIES copies that changed during the copy.
+**********************************************************************/
+
+#include "R4A_ESP32.h"
+
+//****************************************
+// Constants
+//****************************************
+
+#define R4A_ESP32_MAILBOX_RETRIES   4   // Copies attempted before giving up
+
+//*********************************************************************
+// Post a message to the mailbox
+void r4aEsp32MailboxPost(R4A_ESP32_MAILBOX * mailbox, const void * message)
+{
+    uint32_t sequence;
+
+    // Mark the message as being updated
+    sequence = __atomic_load_n(&mailbox->_sequence, __ATOMIC_RELAXED);
+    __atomic_store_n(&mailbox->_sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    // Update the message
+    memcpy(mailbox->_message, message, mailbox->_length);
+
+    // Mark the message as complete
+    __atomic_store_n(&mailbox->_sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+//*********************************************************************
+// Read the most recent message from the mailbox
+uint32_t r4aEsp32MailboxRead(R4A_ESP32_MAILBOX * mailbox,
+                             void * message,
+                             uint32_t * sequenceNumber)
+{
+    uint32_t after;
+    uint32_t before;
+    int retries;
+
+    for (retries = 0; retries < R4A_ESP32_MAILBOX_RETRIES; retries++)
+    {
+        // Don't wait for the writer to finish the message
+        before = __atomic_load_n(&mailbox->_sequence, __ATOMIC_ACQUIRE);
+        if (before & 1)
+            return 0;
+
+        // Determine if a new message is available
+        if ((before >> 1) == *sequenceNumber)
+            return 0;
+
+        // Copy the message
+        memcpy(message, mailbox->_message, mailbox->_length);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+        // Retry if the message changed during the copy
+        after = __atomic_load_n(&mailbox->_sequence, __ATOMIC_RELAXED);
+        if (before == after)
+        {
+            // Return the number of messages posted since the previous read
+            before = (before >> 1) - *sequenceNumber;
+            *sequenceNumber += before;
+            return before;
+        }
+    }
+
+    // The writer kept changing the message
+    return 0;
+}
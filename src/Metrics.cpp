@@ -0,0 +1,437 @@
+/**********************************************************************
+  Metrics.cpp
+
+  Robots-For-All (R4A)
+  Prometheus style metrics
+
+  Each metric is a statically allocated R4A_METRIC structure.  The
+  counters, gauges and histogram buckets are updated with relaxed atomic
+  operations, the code publishing a metric never waits for a lock.  The
+  /metrics page reads each value once while building the text, so a
+  histogram's buckets may be from slightly different moments; the
+  histogram count is computed from the buckets to keep the +Inf bucket
+  and count equal.
+
+  The library metrics are always published, application metrics are
+  added with r4aMetricRegister.  The heap watermarks and camera frame
+  statistics are read when the page is built.
+**********************************************************************/
+
+#include "R4A_ESP32.h"
+
+//****************************************
+// Constants
+//****************************************
+
+#define R4A_METRICS_BUFFER          1024    // Bytes sent in each chunk
+#define R4A_METRIC_LATENCY_BOUNDS   10
+
+//****************************************
+// Types
+//****************************************
+
+typedef struct _R4A_METRICS_OUTPUT
+{
+    char * _buffer;             // Text buffer
+    size_t _bufferSize;         // Size of the text buffer in bytes
+    size_t _length;             // Number of bytes in the text buffer
+    httpd_req_t * _request;     // Browser request, nullptr when displaying
+    Print * _display;           // Device used for output, nullptr when sending
+    bool _failed;               // True after a send failure
+} R4A_METRICS_OUTPUT;
+
+//****************************************
+// Globals
+//****************************************
+
+const uint32_t r4aMetricLatencyBounds[R4A_METRIC_LATENCY_BOUNDS] =
+{
+    1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000
+};
+const int r4aMetricLatencyBoundCount = R4A_METRIC_LATENCY_BOUNDS;
+
+R4A_METRIC r4aMetricI2cErrors =
+{
+    "r4a_i2c_errors_total",
+    "I2C transactions that failed",
+    R4A_METRIC_COUNTER,
+};
+
+R4A_METRIC r4aMetricI2cTransactions =
+{
+    "r4a_i2c_transactions_total",
+    "I2C transactions performed",
+    R4A_METRIC_COUNTER,
+};
+
+R4A_METRIC r4aMetricNvmWrites =
+{
+    "r4a_nvm_writes_total",
+    "Parameter file writes",
+    R4A_METRIC_COUNTER,
+};
+
+R4A_METRIC r4aMetricWebAsyncBusy =
+{
+    "r4a_web_async_busy_total",
+    "Requests rejected while all async workers were busy",
+    R4A_METRIC_COUNTER,
+};
+
+R4A_METRIC r4aMetricWebAsyncRequests =
+{
+    "r4a_web_async_requests_total",
+    "Requests handled by the async workers",
+    R4A_METRIC_COUNTER,
+};
+
+R4A_METRIC r4aMetricWebBufferMisses =
+{
+    "r4a_web_buffer_misses_total",
+    "Response buffers allocated from the heap while the pool was empty",
+    R4A_METRIC_COUNTER,
+};
+
+R4A_METRIC r4aMetricWebDownloads =
+{
+    "r4a_web_download_seconds",
+    "File download latency",
+    R4A_METRIC_HISTOGRAM,
+    r4aMetricLatencyBounds,
+    R4A_METRIC_LATENCY_BOUNDS,
+};
+
+R4A_METRIC r4aMetricWebErrors =
+{
+    "r4a_web_errors_total",
+    "Web server error responses",
+    R4A_METRIC_COUNTER,
+};
+
+R4A_METRIC r4aMetricWifiDisconnects =
+{
+    "r4a_wifi_disconnects_total",
+    "WiFi station disconnects",
+    R4A_METRIC_COUNTER,
+};
+
+R4A_METRIC r4aMetricWifiReconnects =
+{
+    "r4a_wifi_reconnects_total",
+    "WiFi station reconnection attempts",
+    R4A_METRIC_COUNTER,
+};
+
+//****************************************
+// Locals
+//****************************************
+
+// Metrics published by the library
+static R4A_METRIC * const r4aMetricLibrary[] =
+{
+    &r4aMetricI2cErrors,
+    &r4aMetricI2cTransactions,
+    &r4aMetricNvmWrites,
+    &r4aMetricWebAsyncBusy,
+    &r4aMetricWebAsyncRequests,
+    &r4aMetricWebBufferMisses,
+    &r4aMetricWebDownloads,
+    &r4aMetricWebErrors,
+    &r4aMetricWifiDisconnects,
+    &r4aMetricWifiReconnects,
+};
+static const int r4aMetricLibraryCount = sizeof(r4aMetricLibrary)
+                                       / sizeof(r4aMetricLibrary[0]);
+
+// Application metrics
+static R4A_METRIC * r4aMetricList;
+
+//*********************************************************************
+// Output the buffered text
+static void r4aMetricsFlush(R4A_METRICS_OUTPUT * output)
+{
+    if (output->_length && (!output->_failed))
+    {
+        if (output->_request)
+            output->_failed = (httpd_resp_send_chunk(output->_request,
+                                                     output->_buffer,
+                                                     output->_length) != ESP_OK);
+        else
+            output->_display->write((const uint8_t *)output->_buffer,
+                                    output->_length);
+    }
+    output->_length = 0;
+}
+
+//*********************************************************************
+// Append formatted text to the output
+static void r4aMetricsPrintf(R4A_METRICS_OUTPUT * output,
+                             const char * format,
+                             ...)
+{
+    va_list args;
+    int length;
+    int pass;
+    size_t space;
+
+    // Retry once after flushing a full buffer
+    for (pass = 0; pass < 2; pass++)
+    {
+        space = output->_bufferSize - output->_length;
+        va_start(args, format);
+        length = vsnprintf(&output->_buffer[output->_length], space, format, args);
+        va_end(args);
+        if (length < 0)
+            return;
+        if ((size_t)length < space)
+        {
+            output->_length += length;
+            return;
+        }
+        r4aMetricsFlush(output);
+    }
+
+    // Discard lines longer than the buffer
+    output->_length = 0;
+}
+
+//*********************************************************************
+// Output the HELP and TYPE lines
+static void r4aMetricsHeader(R4A_METRICS_OUTPUT * output,
+                             const char * name,
+                             const char * help,
+                             R4A_METRIC_TYPE type)
+{
+    static const char * const typeName[] = {"counter", "gauge", "histogram"};
+
+    r4aMetricsPrintf(output, "# HELP %s %s\n# TYPE %s %s\n",
+                     name, help, name, typeName[type]);
+}
+
+//*********************************************************************
+// Output a metric
+static void r4aMetricsMetric(R4A_METRICS_OUTPUT * output,
+                             R4A_METRIC * metric)
+{
+    uint32_t bound;
+    uint32_t count;
+    int index;
+    uint64_t sumUsec;
+
+    r4aMetricsHeader(output, metric->_name, metric->_help, metric->_type);
+
+    // Output the counter or gauge value
+    if (metric->_type != R4A_METRIC_HISTOGRAM)
+    {
+        r4aMetricsPrintf(output, "%s %lu\n",
+                         metric->_name,
+                         metric->_source ? *metric->_source
+                                         : __atomic_load_n(&metric->_value, __ATOMIC_RELAXED));
+        return;
+    }
+
+    // Output the cumulative histogram buckets in seconds
+    count = 0;
+    for (index = 0; index <= metric->_boundCount; index++)
+    {
+        count += __atomic_load_n(&metric->_bucket[index], __ATOMIC_RELAXED);
+        if (index < metric->_boundCount)
+        {
+            bound = metric->_bounds[index];
+            r4aMetricsPrintf(output, "%s_bucket{le=\"%lu.%06lu\"} %lu\n",
+                             metric->_name, bound / 1000000, bound % 1000000, count);
+        }
+        else
+            r4aMetricsPrintf(output, "%s_bucket{le=\"+Inf\"} %lu\n",
+                             metric->_name, count);
+    }
+    sumUsec = __atomic_load_n(&metric->_sumUsec, __ATOMIC_RELAXED);
+    r4aMetricsPrintf(output, "%s_sum %llu.%06lu\n%s_count %lu\n",
+                     metric->_name, sumUsec / 1000000, (uint32_t)(sumUsec % 1000000),
+                     metric->_name, count);
+}
+
+//*********************************************************************
+// Output a value read at scrape time
+static void r4aMetricsValue(R4A_METRICS_OUTPUT * output,
+                            const char * name,
+                            const char * help,
+                            R4A_METRIC_TYPE type,
+                            uint32_t value)
+{
+    r4aMetricsHeader(output, name, help, type);
+    r4aMetricsPrintf(output, "%s %lu\n", name, value);
+}
+
+//*********************************************************************
+// Output all of the metrics
+static void r4aMetricsWrite(R4A_METRICS * metrics,
+                            R4A_METRICS_OUTPUT * output)
+{
+    int index;
+    R4A_METRIC * metric;
+    R4A_OV2640 * ov2640;
+
+    // Output the system values
+    r4aMetricsValue(output, "r4a_uptime_milliseconds", "Time since boot",
+                    R4A_METRIC_GAUGE, millis());
+    r4aMetricsValue(output, "r4a_heap_free_bytes", "Free heap",
+                    R4A_METRIC_GAUGE, ESP.getFreeHeap());
+    r4aMetricsValue(output, "r4a_heap_minimum_free_bytes", "Lowest free heap since boot",
+                    R4A_METRIC_GAUGE, xPortGetMinimumEverFreeHeapSize());
+    r4aMetricsValue(output, "r4a_heap_largest_free_block_bytes", "Largest free heap block",
+                    R4A_METRIC_GAUGE, heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+    r4aMetricsValue(output, "r4a_psram_free_bytes", "Free PSRAM",
+                    R4A_METRIC_GAUGE, ESP.getFreePsram());
+
+    // Output the camera frame statistics
+    ov2640 = metrics->_ov2640;
+    if (ov2640)
+    {
+        r4aMetricsValue(output, "r4a_camera_frames_total", "Camera frames processed",
+                        R4A_METRIC_COUNTER, ov2640->_frameNumber);
+        r4aMetricsValue(output, "r4a_camera_frames_dropped_total", "Camera frames dropped",
+                        R4A_METRIC_COUNTER, ov2640->_framesDropped);
+        r4aMetricsValue(output, "r4a_camera_frames_per_second_x100", "Camera frame rate times 100",
+                        R4A_METRIC_GAUGE, ov2640->_framesPerSecondX100);
+        r4aMetricsValue(output, "r4a_camera_queue_depth", "Camera frame buffers waiting",
+                        R4A_METRIC_GAUGE, ov2640->_queueDepth);
+        r4aMetricsValue(output, "r4a_camera_frame_age_microseconds", "Age of the last processed frame",
+                        R4A_METRIC_GAUGE, ov2640->_frameAgeUsec);
+    }
+
+    // Output the library metrics
+    for (index = 0; index < r4aMetricLibraryCount; index++)
+        r4aMetricsMetric(output, r4aMetricLibrary[index]);
+
+    // Output the application metrics
+    for (metric = __atomic_load_n(&r4aMetricList, __ATOMIC_ACQUIRE);
+         metric;
+         metric = metric->_next)
+        r4aMetricsMetric(output, metric);
+
+    // Output the cost of the previous scrape
+    r4aMetricsValue(output, "r4a_metrics_scrapes_total", "Metrics scrapes",
+                    R4A_METRIC_COUNTER, metrics->_scrapes);
+    r4aMetricsValue(output, "r4a_metrics_scrape_microseconds", "Time to send the previous scrape",
+                    R4A_METRIC_GAUGE, metrics->_scrapeUsec);
+    r4aMetricsFlush(output);
+}
+
+//*********************************************************************
+// Add a value to a counter or gauge
+void r4aMetricAdd(R4A_METRIC * metric, uint32_t value)
+{
+    __atomic_add_fetch(&metric->_value, value, __ATOMIC_RELAXED);
+}
+
+//*********************************************************************
+// Increment a counter
+void r4aMetricIncrement(R4A_METRIC * metric)
+{
+    __atomic_add_fetch(&metric->_value, 1, __ATOMIC_RELAXED);
+}
+
+//*********************************************************************
+// Add a time to a histogram
+void r4aMetricObserve(R4A_METRIC * metric, uint32_t usec)
+{
+    int index;
+
+    // Locate the bucket, the last bucket is +Inf
+    for (index = 0; index < metric->_boundCount; index++)
+        if (usec <= metric->_bounds[index])
+            break;
+    __atomic_add_fetch(&metric->_bucket[index], 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&metric->_sumUsec, usec, __ATOMIC_RELAXED);
+}
+
+//*********************************************************************
+// Add an application metric to the registry
+void r4aMetricRegister(R4A_METRIC * metric)
+{
+    if (metric->_registered)
+        return;
+    if (metric->_boundCount > R4A_METRIC_BUCKETS_MAX)
+    {
+        Serial.printf("ERROR: Metric %s has more than %d buckets!\r\n",
+                      metric->_name, R4A_METRIC_BUCKETS_MAX);
+        return;
+    }
+
+    // Add the metric to the head of the list, the scrape may be walking
+    // the list
+    metric->_registered = true;
+    metric->_next = r4aMetricList;
+    __atomic_store_n(&r4aMetricList, metric, __ATOMIC_RELEASE);
+}
+
+//*********************************************************************
+// Set the value of a gauge
+void r4aMetricSet(R4A_METRIC * metric, uint32_t value)
+{
+    __atomic_store_n(&metric->_value, value, __ATOMIC_RELAXED);
+}
+
+//*********************************************************************
+// Display the metrics in the Prometheus text format
+void r4aMetricsDisplay(R4A_METRICS * metrics, Print * display)
+{
+    char buffer[256];
+    R4A_METRICS_OUTPUT output;
+
+    output._buffer = buffer;
+    output._bufferSize = sizeof(buffer);
+    output._length = 0;
+    output._request = nullptr;
+    output._display = display;
+    output._failed = false;
+    r4aMetricsWrite(metrics, &output);
+}
+
+//*********************************************************************
+// Return the metrics in the Prometheus text format
+esp_err_t r4aMetricsHandler(httpd_req_t *request)
+{
+    static char buffer[R4A_METRICS_BUFFER];
+    R4A_METRICS * metrics;
+    R4A_METRICS_OUTPUT output;
+    int64_t startUsec;
+
+    // Get the metrics data structure address
+    metrics = (R4A_METRICS *)request->user_ctx;
+
+    // Send the metrics, the buffer is only used by the web server task
+    startUsec = esp_timer_get_time();
+    httpd_resp_set_type(request, "text/plain; version=0.0.4");
+    httpd_resp_set_hdr(request, "Cache-Control", "no-store");
+    output._buffer = buffer;
+    output._bufferSize = sizeof(buffer);
+    output._length = 0;
+    output._request = request;
+    output._display = nullptr;
+    output._failed = false;
+    r4aMetricsWrite(metrics, &output);
+
+    // Account for the scrape
+    metrics->_scrapes += 1;
+    metrics->_scrapeUsec = (uint32_t)(esp_timer_get_time() - startUsec);
+    if (output._failed)
+    {
+        if (r4aWebServerDebug)
+            r4aWebServerDebug->printf("ERROR: Failed to send the metrics to the browser\r\n");
+        return ESP_FAIL;
+    }
+
+    // Send the final chunk
+    return httpd_resp_send_chunk(request, NULL, 0);
+}
+
+//*********************************************************************
+// Display the metrics in the Prometheus text format
+void r4aMetricsMenuDisplay(const struct _R4A_MENU_ENTRY * menuEntry,
+                           const char * command,
+                           Print * display)
+{
+    r4aMetricsDisplay((R4A_METRICS *)menuEntry->menuParameter, display);
+}
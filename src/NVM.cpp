@@ -1837,6 +1837,7 @@ bool r4aEsp32NvmWriteParameters(const char * filePath,
 
         // Done with the file
         parameterFile.close();
+        r4aMetricIncrement(&r4aMetricNvmWrites);
     }
     return success;
 }
@@ -7,13 +7,86 @@
 
 #include "R4A_ESP32.h"
 
+//****************************************
+// Constants
+//****************************************
+
+// The socket buffer accepts a small image without waiting for the
+// network, so the throughput is measured from the start of the first
+// send to the end of the last send over several images
+#define R4A_OV2640_JPEG_RATE_SENDS      8               // Images in the throughput window
+#define R4A_OV2640_JPEG_RATE_IDLE_USEC  (500 * 1000)    // Idle time that restarts the window
+
+// Registers
+#define R4A_OV2640_DSP_QS               0x44    // JPEG quantization scale
+#define R4A_OV2640_SENSOR_YAVG          0x2f    // Average luminance
+
+// DSP register groups displayed by r4aOv2640DumpRegisters, {first, count}
+static const uint8_t r4aOv2640DumpGroups[][2] =
+{
+    {0x05, 1},
+    {0x44, 1},
+    {0x50, 8},
+    {0x5a, 3},
+    {0x7c, 2},
+    {0x86, 2},
+    {0x8c, 1},
+    {0xc0, 4},
+    {0xd3, 1},
+    {0xda, 1},
+    {0xe0, 1},
+    {0xf0, 1},
+    {0xf7, 1},
+};
+#define R4A_OV2640_DUMP_GROUPS  (sizeof(r4aOv2640DumpGroups) / sizeof(r4aOv2640DumpGroups[0]))
+
 //****************************************
 // Locals
 //****************************************
 
 uint8_t r4aOV2640PixelFormat = PIXFORMAT_RGB565;
 
-bool r4aOV2640JpegDisplayTime;  // Set to true to display the JPEG conversion time
+bool r4aOv2640JpegDisplayTime;  // Set to true to display the JPEG conversion time
+uint32_t r4aOv2640JpegLatencyMsec;  // Target JPEG send time, zero disables
+uint32_t r4aOv2640JpegTargetBytes;  // Target JPEG size in bytes, zero disables
+
+//*********************************************************************
+// Display the frame timing statistics
+void r4aOv2640DisplayFrameStats(R4A_OV2640 * object,
+                                Print * display)
+{
+    uint8_t luminance;
+
+    display->printf("OV2640 %s latency mode\r\n",
+                    object->_lowLatency ? "Low" : "Normal");
+    if (object->_taskHandle)
+        display->printf("    Processing task on core %d, priority %d\r\n",
+                        xTaskGetCoreID(object->_taskHandle),
+                        uxTaskPriorityGet(object->_taskHandle));
+    display->printf("    Frames processed: %lu\r\n", object->_frameNumber);
+    display->printf("    Frame rate: %lu.%02lu frames/sec\r\n",
+                    object->_framesPerSecondX100 / 100,
+                    object->_framesPerSecondX100 % 100);
+    display->printf("    Queue depth: %lu frames\r\n", object->_queueDepth);
+    display->printf("    Frames dropped: %lu\r\n", object->_framesDropped);
+    display->printf("    Frame period: %lu uSec\r\n", object->_framePeriodUsec);
+    display->printf("    Frame age: %lu uSec\r\n", object->_frameAgeUsec);
+    display->printf("    Average frame age: %lu uSec\r\n", object->_frameAgeAverageUsec);
+    display->printf("    Maximum frame age: %lu uSec\r\n", object->_frameAgeMaximumUsec);
+    if (object->_jpegBytes)
+    {
+        display->printf("JPEG quality: %d\r\n", object->_jpegQuality);
+        display->printf("    Images encoded: %lu\r\n", object->_jpegEncodes);
+        display->printf("    Cache hits: %lu\r\n", object->_jpegCacheHits);
+        display->printf("    Image size: %lu bytes\r\n", object->_jpegBytes);
+        display->printf("    Send time: %lu uSec\r\n", object->_jpegSendUsec);
+        display->printf("    Bit rate: %lu bits/sec\r\n", object->_jpegBytesPerSecond * 8);
+    }
+    if (r4aOv2640RegisterRead(object, R4A_OV2640_BANK_SENSOR, R4A_OV2640_SENSOR_YAVG, &luminance))
+        display->printf("Average luminance: %d\r\n", luminance);
+    display->printf("Register I2C transactions: %lu\r\n", object->_registerTransactions);
+    display->printf("    Transactions saved: %lu\r\n", object->_registerTransactionsSaved);
+}
 
 //*********************************************************************
 // Display a group of registers
@@ -54,11 +127,22 @@ void r4aOv2640DisplayRegisters(R4A_OV2640 * object,
 void r4aOv2640DumpRegisters(R4A_OV2640 * object,
                             Print * display)
 {
-    size_t bytesToRead;
-    uint32_t offset;
+    const uint8_t * data;
+    int index;
+    uint32_t transactions;
 
     do
     {
+        // Read the DSP registers using a bank select and two bulk reads
+        // instead of a transaction for each group of registers
+        transactions = object->_registerTransactions;
+        if (!r4aOv2640RegisterCacheFill(object, R4A_OV2640_BANK_DSP, display))
+            break;
+        transactions = object->_registerTransactions - transactions;
+        if (transactions < R4A_OV2640_DUMP_GROUPS)
+            object->_registerTransactionsSaved += R4A_OV2640_DUMP_GROUPS - transactions;
+        data = object->_registerShadow[R4A_OV2640_BANK_DSP];
+
         // Display the header
         display->println("OV2640 Registers");
         display->println("----------------");
@@ -66,70 +150,12 @@ void r4aOv2640DumpRegisters(R4A_OV2640 * object,
         display->println("             0  1  2  3  4  5  6  7  8  9  a  b  c  d  e  f  0123456789abcdef");
         display->println("            -- -- -- -- -- -- -- -- -- -- -- -- -- -- -- --  ----------------");
 
-        // Display register 5
-        offset = 5;
-        bytesToRead = 1;
-        r4aOv2640DisplayRegisters(object, offset, bytesToRead, display);
-
-        // Display register 0x44
-        offset = 0x44;
-        bytesToRead = 1;
-        r4aOv2640DisplayRegisters(object, offset, bytesToRead, display);
-
-        // Display register 0x50 - 0x57
-        offset = 0x50;
-        bytesToRead = 8;
-        r4aOv2640DisplayRegisters(object, offset, bytesToRead, display);
-
-        // Display register 0x5a - 0x57c
-        offset = 0x5a;
-        bytesToRead = 3;
-        r4aOv2640DisplayRegisters(object, offset, bytesToRead, display);
-
-        // Display register 0x7c - 0x7d
-        offset = 0x7c;
-        bytesToRead = 2;
-        r4aOv2640DisplayRegisters(object, offset, bytesToRead, display);
-
-        // Display register 0x86 - 0x87
-        offset = 0x86;
-        bytesToRead = 2;
-        r4aOv2640DisplayRegisters(object, offset, bytesToRead, display);
-
-        // Display register 0x8c
-        offset = 0x8c;
-        bytesToRead = 1;
-        r4aOv2640DisplayRegisters(object, offset, bytesToRead, display);
-
-        // Display register 0xc0 - 0xc3
-        offset = 0xc0;
-        bytesToRead = 4;
-        r4aOv2640DisplayRegisters(object, offset, bytesToRead, display);
-
-        // Display register 0xd3
-        offset = 0xd3;
-        bytesToRead = 1;
-        r4aOv2640DisplayRegisters(object, offset, bytesToRead, display);
-
-        // Display register 0xda
-        offset = 0xda;
-        bytesToRead = 1;
-        r4aOv2640DisplayRegisters(object, offset, bytesToRead, display);
-
-        // Display register 0xe0
-        offset = 0xe0;
-        bytesToRead = 1;
-        r4aOv2640DisplayRegisters(object, offset, bytesToRead, display);
-
-        // Display register 0xf0
-        offset = 0xf0;
-        bytesToRead = 1;
-        r4aOv2640DisplayRegisters(object, offset, bytesToRead, display);
-
-        // Display register 0xf7
-        offset = 0xf7;
-        bytesToRead = 1;
-        r4aOv2640DisplayRegisters(object, offset, bytesToRead, display);
+        // Display the groups of registers
+        for (index = 0; index < (int)R4A_OV2640_DUMP_GROUPS; index++)
+            r4aDumpBuffer(r4aOv2640DumpGroups[index][0],
+                          &data[r4aOv2640DumpGroups[index][0]],
+                          r4aOv2640DumpGroups[index][1],
+                          display);
 
         // Display the offset header
         display->println("            -- -- -- -- -- -- -- -- -- -- -- -- -- -- -- --  ----------------");
@@ -137,11 +163,99 @@ void r4aOv2640DumpRegisters(R4A_OV2640 * object,
     } while (0);
 }
 
+//*********************************************************************
+// Get the time when the sensor captured the frame
+int64_t r4aOv2640FrameCaptureUsec(camera_fb_t * frameBuffer)
+{
+    // The camera driver stamps the frame using esp_timer_get_time
+    return (((int64_t)frameBuffer->timestamp.tv_sec) * 1000 * 1000)
+           + frameBuffer->timestamp.tv_usec;
+}
+
+//*********************************************************************
+// Time stamp the frame as it is handed to the processing routine
+void r4aOv2640FrameHandoff(R4A_OV2640 * object, camera_fb_t * frameBuffer)
+{
+    int64_t captureUsec;
+    uint32_t frameAgeUsec;
+    int64_t frameIntervalUsec;
+    uint32_t framesMissed;
+
+    // Get the capture and handoff times
+    captureUsec = r4aOv2640FrameCaptureUsec(frameBuffer);
+    object->_frameHandoffUsec = esp_timer_get_time();
+
+    // Determine the interval since the previous frame
+    if (object->_frameNumber)
+    {
+        frameIntervalUsec = captureUsec - object->_frameCaptureUsec;
+        if (frameIntervalUsec > 0)
+        {
+            // Track the sensor frame period
+            if ((!object->_framePeriodUsec)
+                || (frameIntervalUsec < object->_framePeriodUsec))
+                object->_framePeriodUsec = frameIntervalUsec;
+
+            // Count the frames that were dropped before processing,
+            // allow half a frame period of jitter
+            framesMissed = (frameIntervalUsec + (object->_framePeriodUsec >> 1))
+                         / object->_framePeriodUsec;
+            if (framesMissed > 1)
+                object->_framesDropped += framesMissed - 1;
+        }
+    }
+    object->_frameCaptureUsec = captureUsec;
+    object->_frameNumber += 1;
+    __atomic_add_fetch(&object->_captureNumber, 1, __ATOMIC_RELAXED);
+
+    // Compute the age of the frame at processing
+    frameAgeUsec = (uint32_t)(object->_frameHandoffUsec - captureUsec);
+    object->_frameAgeUsec = frameAgeUsec;
+    r4aOv2640StageAdd(object, R4A_OV2640_STAGE_AGE, frameAgeUsec);
+    if (object->_frameAgeMaximumUsec < frameAgeUsec)
+        object->_frameAgeMaximumUsec = frameAgeUsec;
+
+    // Average the frame age over approximately the last 8 frames
+    if (object->_frameNumber == 1)
+        object->_frameAgeAverageUsec = frameAgeUsec;
+    else
+        object->_frameAgeAverageUsec = object->_frameAgeAverageUsec
+                                     - (object->_frameAgeAverageUsec >> 3)
+                                     + (frameAgeUsec >> 3);
+
+    // Estimate the number of frames the sensor produced while this
+    // frame waited to be processed
+    if (object->_framePeriodUsec)
+        object->_queueDepth = frameAgeUsec / object->_framePeriodUsec;
+
+    // Compute the frame rate once a second
+    frameIntervalUsec = object->_frameHandoffUsec - object->_fpsStartUsec;
+    if (frameIntervalUsec >= (1000 * 1000))
+    {
+        if (object->_fpsStartUsec)
+            object->_framesPerSecondX100 = (uint32_t)
+                ((((int64_t)(object->_frameNumber - object->_fpsFrameNumber))
+                  * 100 * 1000 * 1000) / frameIntervalUsec);
+        object->_fpsStartUsec = object->_frameHandoffUsec;
+        object->_fpsFrameNumber = object->_frameNumber;
+    }
+}
+
+//*********************************************************************
+// Display the frame timing statistics
+void r4aOv2640MenuDisplayFrameStats(const struct _R4A_MENU_ENTRY * menuEntry,
+                                    const char * command,
+                                    Print * display)
+{
+    r4aOv2640DisplayFrameStats((R4A_OV2640 *)menuEntry->menuParameter, display);
+}
+
 //*********************************************************************
 // Initialize the camera
 bool r4aOv2640Setup(R4A_OV2640 * object,
                     pixformat_t pixelFormat,
-                    Print * display)
+                    Print * display,
+                    bool lowLatency)
 {
     sensor_t * ov2640Camera;
     esp_err_t status;
@@ -201,9 +315,12 @@ bool r4aOv2640Setup(R4A_OV2640 * object,
 //    config.frame_size = FRAMESIZE_SXGA;     // 1280x1024
 //    config.frame_size = FRAMESIZE_UXGA;     // 1600x1200
 
-    // When to take the picture
-    config.grab_mode = CAMERA_GRAB_LATEST;
-    config.grab_mode = CAMERA_GRAB_WHEN_EMPTY;
+    // When to take the picture.  CAMERA_GRAB_LATEST discards the older
+    // frames in the queue and requires more than one frame buffer.
+    // CAMERA_GRAB_WHEN_EMPTY returns the frames in order, which may be
+    // stale by the time they are processed.
+    object->_lowLatency = lowLatency;
+    config.grab_mode = lowLatency ? CAMERA_GRAB_LATEST : CAMERA_GRAB_WHEN_EMPTY;
 
     // Initialize the camera
     status = esp_camera_init(&config);
@@ -233,6 +350,63 @@ bool r4aOv2640Setup(R4A_OV2640 * object,
     ov2640Camera->set_agc_gain(ov2640Camera, 30);
     ov2640Camera->set_awb_gain(ov2640Camera, 1);
     ov2640Camera->set_gain_ctrl(ov2640Camera, 1);
+
+    // The camera driver wrote the registers
+    r4aOv2640RegisterCacheInvalidate(object);
+
+    // Initialize the pipeline stage timing
+    r4aOv2640StageStatsReset(object);
+    return true;
+}
+
+//*********************************************************************
+// Camera processing task
+void r4aOv2640Task(void * parameter)
+{
+    R4A_OV2640 * object;
+
+    // Process the camera frames
+    object = (R4A_OV2640 *)parameter;
+    while (1)
+    {
+        // esp_camera_fb_get waits for the next frame
+        if ((!object->_taskEnable) || *object->_taskEnable)
+            r4aOv2640Update(object);
+        else
+            delay(10);
+    }
+}
+
+//*********************************************************************
+// Start a task to process the camera frames
+bool r4aOv2640TaskStart(R4A_OV2640 * object,
+                        BaseType_t core,
+                        UBaseType_t priority,
+                        volatile bool * enable,
+                        Print * display)
+{
+    BaseType_t status;
+
+    // Determine if the task is already running
+    if (object->_taskHandle)
+        return true;
+
+    // Start the camera processing task
+    object->_taskEnable = enable;
+    status = xTaskCreatePinnedToCore(r4aOv2640Task,   // Function to implement the task
+                                     "OV2640",        // Name of the task
+                                     8192,            // Stack size in bytes
+                                     object,          // Task input parameter
+                                     priority,        // Priority of the task
+                                     &object->_taskHandle, // Task handle
+                                     core);           // Core where the task should run
+    if (status != pdPASS)
+    {
+        object->_taskHandle = nullptr;
+        if (display)
+            display->println("ERROR: Failed to create the OV2640 task!");
+        return false;
+    }
     return true;
 }
 
@@ -242,19 +416,152 @@ void r4aOv2640Update(R4A_OV2640 * object,
                      Print * display)
 {
     camera_fb_t * frameBuffer;
+    camera_fb_t * processFrameBuffer;
+    int64_t startUsec;
 
     // Get a frame buffer
+    startUsec = esp_timer_get_time();
     frameBuffer = esp_camera_fb_get();
     if (!frameBuffer)
         return;
+    r4aOv2640StageAdd(object, R4A_OV2640_STAGE_ACQUIRE,
+                      (uint32_t)(esp_timer_get_time() - startUsec));
+
+    // Record the frame capture and handoff times
+    r4aOv2640FrameHandoff(object, frameBuffer);
+
+    // Skip the frames that have not changed
+    if (object->_gate && (!r4aOv2640GateCheck(object->_gate, frameBuffer)))
+    {
+        esp_camera_fb_return(frameBuffer);
+        return;
+    }
 
     // Process the frame buffer
-    object->_processFrameBuffer(object, frameBuffer, display);
+    startUsec = esp_timer_get_time();
+    processFrameBuffer = frameBuffer;
+    if (object->_jpegDecode && (frameBuffer->format == PIXFORMAT_JPEG))
+    {
+        // Process the luminance of the JPEG image
+        processFrameBuffer = nullptr;
+        if (r4aOv2640JpegToY8(object->_jpegDecode, frameBuffer->buf, frameBuffer->len, display))
+        {
+            processFrameBuffer = &object->_jpegDecode->_frameBuffer;
+            processFrameBuffer->timestamp = frameBuffer->timestamp;
+        }
+    }
+    if (processFrameBuffer)
+        object->_processFrameBuffer(object, processFrameBuffer, display);
+    r4aOv2640StageAdd(object, R4A_OV2640_STAGE_PROCESS,
+                      (uint32_t)(esp_timer_get_time() - startUsec));
 
     // Return the frame buffer
     esp_camera_fb_return(frameBuffer);
 }
 
+//*********************************************************************
+// Get the JPEG quality for the next image
+uint8_t r4aOv2640JpegQuality(R4A_OV2640 * object)
+{
+    uint8_t quality;
+
+    quality = __atomic_load_n(&object->_jpegQuality, __ATOMIC_RELAXED);
+    return quality ? quality : R4A_OV2640_JPEG_QUALITY;
+}
+
+//*********************************************************************
+// Update the JPEG quality based upon the previous image
+// Inputs:
+//   object: Address of a R4A_OV2640 data structure
+//   bytes: Number of bytes in the image
+//   startUsec: Time the send started
+//   endUsec: Time the send completed
+void r4aOv2640JpegRateUpdate(R4A_OV2640 * object,
+                             uint32_t bytes,
+                             int64_t startUsec,
+                             int64_t endUsec)
+{
+    uint64_t bytesPerSecond;
+    int32_t quality;
+    int32_t step;
+    uint64_t target;
+    int64_t windowUsec;
+
+    // The async workers send images concurrently
+    r4aLockAcquire(&object->_jpegCacheLock);
+    do
+    {
+        // Save the image statistics
+        object->_jpegBytes = bytes;
+        object->_jpegSendUsec = (uint32_t)(endUsec - startUsec);
+
+        // Start a new window after an idle period, the time between
+        // requests is not network time
+        if ((!object->_jpegWindowSends)
+            || ((startUsec - object->_jpegWindowEndUsec) > R4A_OV2640_JPEG_RATE_IDLE_USEC))
+        {
+            object->_jpegWindowStartUsec = startUsec;
+            object->_jpegWindowBytes = 0;
+            object->_jpegWindowSends = 0;
+        }
+
+        // Measure the network throughput over the window, the time
+        // includes emptying the socket buffer between the sends
+        object->_jpegWindowBytes += bytes;
+        object->_jpegWindowSends += 1;
+        if (object->_jpegWindowEndUsec < endUsec)
+            object->_jpegWindowEndUsec = endUsec;
+        if (object->_jpegWindowSends >= R4A_OV2640_JPEG_RATE_SENDS)
+        {
+            windowUsec = object->_jpegWindowEndUsec - object->_jpegWindowStartUsec;
+            if (windowUsec > 0)
+                object->_jpegBytesPerSecond = (uint32_t)
+                    ((((uint64_t)object->_jpegWindowBytes) * 1000 * 1000) / windowUsec);
+            object->_jpegWindowSends = 0;
+        }
+
+        // Determine the target image size
+        target = r4aOv2640JpegTargetBytes;
+        if (r4aOv2640JpegLatencyMsec && object->_jpegBytesPerSecond)
+        {
+            bytesPerSecond = (((uint64_t)object->_jpegBytesPerSecond)
+                              * r4aOv2640JpegLatencyMsec) / 1000;
+            if ((!target) || (bytesPerSecond < target))
+                target = bytesPerSecond;
+        }
+
+        // Use the default quality when rate control is disabled
+        if ((!target) || (!bytes))
+        {
+            __atomic_store_n(&object->_jpegQuality, R4A_OV2640_JPEG_QUALITY, __ATOMIC_RELAXED);
+            break;
+        }
+
+        // Ignore errors less than 10 percent
+        quality = r4aOv2640JpegQuality(object);
+        if ((bytes > (target - (target / 10))) && (bytes < (target + (target / 10))))
+            break;
+
+        // Move the quality by half of the relative size error, limiting
+        // the step to avoid oscillation
+        step = (int32_t)((((int64_t)target - (int64_t)bytes) * quality)
+                         / (2 * (int64_t)bytes));
+        if (step > 10)
+            step = 10;
+        else if (step < -10)
+            step = -10;
+        else if (step == 0)
+            step = (target > bytes) ? 1 : -1;
+        quality += step;
+        if (quality < R4A_OV2640_JPEG_QUALITY_MIN)
+            quality = R4A_OV2640_JPEG_QUALITY_MIN;
+        else if (quality > R4A_OV2640_JPEG_QUALITY_MAX)
+            quality = R4A_OV2640_JPEG_QUALITY_MAX;
+        __atomic_store_n(&object->_jpegQuality, (uint8_t)quality, __ATOMIC_RELAXED);
+    } while (0);
+    r4aLockRelease(&object->_jpegCacheLock);
+}
+
 //*********************************************************************
 // Encode the JPEG image
 size_t r4aOV2640SendJpegChunk(void * arg,
@@ -262,47 +569,305 @@ size_t r4aOV2640SendJpegChunk(void * arg,
                               const void* data,
                               size_t len)
 {
+    int64_t startUsec;
+    esp_err_t status;
+
     R4A_JPEG_CHUNKING_T * chunk = (R4A_JPEG_CHUNKING_T *)arg;
     if(!index){
         chunk->length = 0;
+        chunk->sendUsec = 0;
     }
-    if(httpd_resp_send_chunk(chunk->req, (const char *)data, len) != ESP_OK){
+    startUsec = esp_timer_get_time();
+    status = httpd_resp_send_chunk(chunk->req, (const char *)data, len);
+    chunk->sendUsec += esp_timer_get_time() - startUsec;
+    if(status != ESP_OK){
         return 0;
     }
     chunk->length += len;
     return len;
 }
 
+//*********************************************************************
+// Append the JPEG data to the cache entry
+size_t r4aOv2640JpegCacheChunk(void * arg,
+                               size_t index,
+                               const void * data,
+                               size_t len)
+{
+    uint8_t * buffer;
+    R4A_OV2640_JPEG_CACHE * entry;
+    size_t size;
+
+    entry = (R4A_OV2640_JPEG_CACHE *)arg;
+    if (!index)
+        entry->_length = 0;
+
+    // Grow the PSRAM buffer if necessary
+    if ((entry->_length + len) > entry->_size)
+    {
+        size = (entry->_length + len) * 2;
+        buffer = (uint8_t *)heap_caps_realloc(entry->_buffer, size, MALLOC_CAP_SPIRAM);
+        if (!buffer)
+            return 0;
+        entry->_buffer = buffer;
+        entry->_size = size;
+    }
+
+    // Save the JPEG data
+    memcpy(&entry->_buffer[entry->_length], data, len);
+    entry->_length += len;
+    return len;
+}
+
+//*********************************************************************
+// Encode the frame into an unused cache entry
+// Inputs:
+//   object: Address of a R4A_OV2640 data structure
+//   frameBuffer: Buffer containing the raw image data
+//   captureNumber: Capture sequence number of the frame
+// Outputs:
+//   Returns the address of the cache entry with one user or nullptr
+//   if all of the cache entries are in use or the encode failed
+R4A_OV2640_JPEG_CACHE * r4aOv2640JpegCacheEncode(R4A_OV2640 * object,
+                                                 camera_fb_t * frameBuffer,
+                                                 uint32_t captureNumber)
+{
+    R4A_OV2640_JPEG_CACHE * entry;
+    int index;
+    int64_t startUsec;
+
+    // Reserve an entry that is not being sent
+    entry = nullptr;
+    r4aLockAcquire(&object->_jpegCacheLock);
+    for (index = 0; index < R4A_OV2640_JPEG_CACHE_ENTRIES; index++)
+        if ((!object->_jpegCache[index]._users)
+            && (&object->_jpegCache[index] != object->_jpegCacheCurrent))
+        {
+            entry = &object->_jpegCache[index];
+            break;
+        }
+    if ((!entry) && object->_jpegCacheCurrent
+        && (!object->_jpegCacheCurrent->_users))
+        entry = object->_jpegCacheCurrent;
+    if (entry)
+    {
+        entry->_users = 1;
+        if (entry == object->_jpegCacheCurrent)
+            object->_jpegCacheCurrent = nullptr;
+    }
+    r4aLockRelease(&object->_jpegCacheLock);
+    if (!entry)
+        return nullptr;
+
+    // Encode the image into the PSRAM buffer
+    entry->_quality = r4aOv2640JpegQuality(object);
+    startUsec = esp_timer_get_time();
+    if (!frame2jpg_cb(frameBuffer,
+                      entry->_quality,
+                      r4aOv2640JpegCacheChunk,
+                      entry))
+    {
+        r4aLockAcquire(&object->_jpegCacheLock);
+        entry->_users = 0;
+        r4aLockRelease(&object->_jpegCacheLock);
+        return nullptr;
+    }
+    entry->_captureNumber = captureNumber;
+    entry->_captureUsec = r4aOv2640FrameCaptureUsec(frameBuffer);
+    entry->_encodeUsec = esp_timer_get_time();
+    object->_jpegEncodes += 1;
+    r4aOv2640StageAdd(object, R4A_OV2640_STAGE_ENCODE,
+                      (uint32_t)(entry->_encodeUsec - startUsec));
+
+    // Make this the current image
+    r4aLockAcquire(&object->_jpegCacheLock);
+    object->_jpegCacheCurrent = entry;
+    r4aLockRelease(&object->_jpegCacheLock);
+    return entry;
+}
+
+//*********************************************************************
+// Get the current image from the cache
+// Inputs:
+//   object: Address of a R4A_OV2640 data structure
+//   encoder: Address of a bool set true when the caller must capture
+//            and encode the next image and then call
+//            r4aOv2640JpegCacheEncodeDone
+// Outputs:
+//   Returns the address of the cache entry with the user count
+//   incremented, or nullptr if the current image is out of date
+R4A_OV2640_JPEG_CACHE * r4aOv2640JpegCacheGet(R4A_OV2640 * object,
+                                              bool * encoder)
+{
+    R4A_OV2640_JPEG_CACHE * entry;
+    int64_t maximumAgeUsec;
+    bool processing;
+    uint32_t waitMsec;
+
+    // Without frame processing the frame period is unknown
+    maximumAgeUsec = object->_framePeriodUsec;
+    if (!maximumAgeUsec)
+        maximumAgeUsec = R4A_OV2640_JPEG_CACHE_USEC;
+
+    *encoder = false;
+    for (waitMsec = 0; ; waitMsec++)
+    {
+        // The image is current while it belongs to the latest frame
+        // processed by the camera task or a newer frame can not exist yet
+        processing = object->_taskHandle
+                  && ((!object->_taskEnable) || *object->_taskEnable);
+        r4aLockAcquire(&object->_jpegCacheLock);
+        entry = object->_jpegCacheCurrent;
+        if (entry
+            && ((processing
+                 && (entry->_captureNumber == __atomic_load_n(&object->_captureNumber,
+                                                              __ATOMIC_RELAXED)))
+                || ((esp_timer_get_time() - entry->_encodeUsec) < maximumAgeUsec)))
+        {
+            entry->_users += 1;
+            object->_jpegCacheHits += 1;
+        }
+        else
+        {
+            // Only one request captures and encodes the next image, the
+            // others wait for it
+            entry = nullptr;
+            if ((!object->_jpegCacheEncoding)
+                || (waitMsec >= R4A_OV2640_JPEG_CACHE_WAIT_MSEC))
+            {
+                *encoder = !object->_jpegCacheEncoding;
+                object->_jpegCacheEncoding = true;
+                r4aLockRelease(&object->_jpegCacheLock);
+                break;
+            }
+        }
+        r4aLockRelease(&object->_jpegCacheLock);
+        if (entry)
+            break;
+
+        // Wait for the encode to complete
+        delay(1);
+    }
+    return entry;
+}
+
+//*********************************************************************
+// Done capturing and encoding the next image
+void r4aOv2640JpegCacheEncodeDone(R4A_OV2640 * object)
+{
+    r4aLockAcquire(&object->_jpegCacheLock);
+    object->_jpegCacheEncoding = false;
+    r4aLockRelease(&object->_jpegCacheLock);
+}
+
+//*********************************************************************
+// Done sending the image from the cache
+void r4aOv2640JpegCacheRelease(R4A_OV2640 * object,
+                               R4A_OV2640_JPEG_CACHE * entry)
+{
+    r4aLockAcquire(&object->_jpegCacheLock);
+    entry->_users -= 1;
+    r4aLockRelease(&object->_jpegCacheLock);
+}
+
 //*********************************************************************
 // JPEG image web page handler
 esp_err_t r4aOV2640JpegHandler(httpd_req_t *request)
 {
+    char bitRate[16];
+    int64_t captureUsec;
+    uint32_t captureNumber;
     int64_t endTime;
+    R4A_OV2640_JPEG_CACHE * entry;
+    bool encoder;
     camera_fb_t * frameBuffer;
+    const uint8_t * jpegData = nullptr;
+    size_t jpegLength = 0;
+    int64_t sendUsec;
+    sensor_t * sensor;
+    uint8_t sensorQuality;
+    int64_t stageUsec;
     int64_t startTime;
     esp_err_t status;
+    uint8_t quality;
+    char qualityString[8];
     R4A_OV2640 * object;
 
+    // Encode and send the image from an async worker
+    status = r4aWebServerAsync(request, r4aOV2640JpegHandler);
+    if (status != ESP_ERR_NOT_FOUND)
+        return status;
+
     // Get the OV2640 data structure address
     object = (R4A_OV2640 *)request->user_ctx;
 
     do
     {
         startTime = esp_timer_get_time();
+        entry = nullptr;
         frameBuffer = nullptr;
         status = ESP_FAIL;
 
-        // Allocate the frame buffer
-        frameBuffer = esp_camera_fb_get();
-        if (!frameBuffer)
+        // Send the cached image when a new frame has not been processed
+        entry = r4aOv2640JpegCacheGet(object, &encoder);
+        if (entry)
         {
-            Serial.println("ERROR: Failed to capture the image");
-            httpd_resp_send_500(request);
-            break;
+            jpegData = entry->_buffer;
+            jpegLength = entry->_length;
+            captureUsec = entry->_captureUsec;
+            quality = entry->_quality;
+        }
+        else
+        {
+            // Allocate the frame buffer
+            stageUsec = esp_timer_get_time();
+            frameBuffer = esp_camera_fb_get();
+            if (!frameBuffer)
+            {
+                Serial.println("ERROR: Failed to capture the image");
+                httpd_resp_send_500(request);
+                break;
+            }
+            captureNumber = __atomic_add_fetch(&object->_captureNumber, 1, __ATOMIC_RELAXED);
+            captureUsec = r4aOv2640FrameCaptureUsec(frameBuffer);
+            r4aOv2640StageAdd(object, R4A_OV2640_STAGE_ACQUIRE,
+                              (uint32_t)(esp_timer_get_time() - stageUsec));
+
+            // Process the frame buffer
+            stageUsec = esp_timer_get_time();
+            object->_processWebServerFrameBuffer(object, frameBuffer);
+            r4aOv2640StageAdd(object, R4A_OV2640_STAGE_PROCESS,
+                              (uint32_t)(esp_timer_get_time() - stageUsec));
+
+            // The sensor already encoded the image
+            quality = r4aOv2640JpegQuality(object);
+            if (frameBuffer->format == PIXFORMAT_JPEG)
+            {
+                jpegData = frameBuffer->buf;
+                jpegLength = frameBuffer->len;
+            }
+            else
+            {
+                // Encode the image once into the cache
+                entry = r4aOv2640JpegCacheEncode(object, frameBuffer, captureNumber);
+                if (entry)
+                {
+                    jpegData = entry->_buffer;
+                    jpegLength = entry->_length;
+
+                    // Done with the frame buffer
+                    esp_camera_fb_return(frameBuffer);
+                    frameBuffer = nullptr;
+                }
+            }
+
+            // Let the waiting requests use the new image
+            if (encoder)
+            {
+                r4aOv2640JpegCacheEncodeDone(object);
+                encoder = false;
+            }
         }
-
-        // Process the frame buffer
-        object->_processWebServerFrameBuffer(object, frameBuffer);
 
         // Build the response header
         httpd_resp_set_type(request, "image/jpeg");
@@ -312,22 +877,53 @@ esp_err_t r4aOV2640JpegHandler(httpd_req_t *request)
         // Add the timestamp to the header
         char timestamp[32];
         snprintf(timestamp, sizeof(timestamp), "%lld.%06ld",
-                 frameBuffer->timestamp.tv_sec, frameBuffer->timestamp.tv_usec);
+                 captureUsec / (1000 * 1000), (long)(captureUsec % (1000 * 1000)));
         httpd_resp_set_hdr(request, "X-Timestamp", (const char *)timestamp);
 
+        // Add the JPEG quality and measured bit rate to the header
+        snprintf(qualityString, sizeof(qualityString), "%d", quality);
+        httpd_resp_set_hdr(request, "X-Quality", (const char *)qualityString);
+        snprintf(bitRate, sizeof(bitRate), "%lu", object->_jpegBytesPerSecond * 8);
+        httpd_resp_set_hdr(request, "X-Bitrate", (const char *)bitRate);
+
         // Send the captured image
-        if (frameBuffer->format == PIXFORMAT_JPEG)
+        if (entry || (frameBuffer->format == PIXFORMAT_JPEG))
         {
-            status = httpd_resp_send(request, (const char *)frameBuffer->buf, frameBuffer->len);
+            // Send the JPEG image without copying it
+            sendUsec = esp_timer_get_time();
+            status = httpd_resp_send(request, (const char *)jpegData, jpegLength);
             if (status != ESP_OK)
                 break;
+            endTime = esp_timer_get_time();
+            r4aOv2640StageAdd(object, R4A_OV2640_STAGE_SEND, (uint32_t)(endTime - sendUsec));
+            r4aOv2640JpegRateUpdate(object, jpegLength, sendUsec, endTime);
+
+            // The sensor encodes the image, quality 0 (best) - 63 (worst),
+            // values below 10 may overflow the frame buffer.  Write the
+            // register directly, like the driver's set_quality routine,
+            // to keep the shadow copy valid.
+            if ((!entry) && (quality != r4aOv2640JpegQuality(object)))
+            {
+                sensorQuality = 63 - ((r4aOv2640JpegQuality(object) * 53) / 100);
+                if (r4aOv2640RegisterWrite(object,
+                                           R4A_OV2640_BANK_DSP,
+                                           R4A_OV2640_DSP_QS,
+                                           sensorQuality))
+                {
+                    sensor = esp_camera_sensor_get();
+                    if (sensor)
+                        sensor->status.quality = sensorQuality;
+                }
+            }
         }
         else
         {
-            // Break the image into multiple chunks
-            R4A_JPEG_CHUNKING_T jchunk = {request, 0};
+            // All of the cache entries are in use, break the image into
+            // multiple chunks
+            R4A_JPEG_CHUNKING_T jchunk = {request, 0, 0};
+            sendUsec = esp_timer_get_time();
             status = frame2jpg_cb(frameBuffer,
-                                  80,
+                                  quality,
                                   r4aOV2640SendJpegChunk,
                                   &jchunk) ? ESP_OK : ESP_FAIL;
             if (status != ESP_OK)
@@ -335,14 +931,33 @@ esp_err_t r4aOV2640JpegHandler(httpd_req_t *request)
             status = httpd_resp_send_chunk(request, NULL, 0);
             if (status != ESP_OK)
                 break;
+            endTime = esp_timer_get_time();
+
+            // The encode time is the time not spent sending the chunks
+            r4aOv2640StageAdd(object, R4A_OV2640_STAGE_ENCODE,
+                              (uint32_t)(endTime - sendUsec - jchunk.sendUsec));
+            r4aOv2640StageAdd(object, R4A_OV2640_STAGE_SEND, (uint32_t)jchunk.sendUsec);
+
+            // Select the quality for the next image, the chunks were sent
+            // during the encode
+            r4aOv2640JpegRateUpdate(object, jchunk.length, sendUsec, endTime);
         }
         endTime = esp_timer_get_time();
-        if (r4aOV2640JpegDisplayTime)
-            Serial.printf("JPG: %lu bytes %lu mSec", (uint32_t)(frameBuffer->len),
+        if (r4aOv2640JpegDisplayTime)
+            Serial.printf("JPG: %lu bytes, quality %d, %lu mSec\r\n",
+                          object->_jpegBytes, quality,
                           (uint32_t)((endTime - startTime) / 1000));
         status = ESP_OK;
     } while (0);
 
+    // Let another request capture the image
+    if (encoder)
+        r4aOv2640JpegCacheEncodeDone(object);
+
+    // Done with the cached image
+    if (entry)
+        r4aOv2640JpegCacheRelease(object, entry);
+
     // Return the frame buffer
     if (frameBuffer)
         esp_camera_fb_return(frameBuffer);
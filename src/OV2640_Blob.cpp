@@ -0,0 +1,383 @@
+/**********************************************************************
+  OV2640_Blob.cpp
+
+  Robots-For-All (R4A)
+  OV2640 camera connected component (blob) detection
+
+  Each row of the frame is classified using a 256 entry selection table
+  indexed by the pixel luminance or hue bin and the selected pixels are
+  collected into runs.  Runs that touch a run in the previous row
+  (8-connected) share its label, labels joined by a later run are
+  merged with a union-find table.  The area, centroid sums and bounding
+  box are accumulated in the root label as the runs are found, so the
+  frame is only read once and only two rows of runs are kept.  The
+  memory is sized for QVGA (320 x 240) frames and a fixed number of
+  labels, runs found after the labels run out are dropped.
+**********************************************************************/
+
+#include "R4A_ESP32.h"
+
+//****************************************
+// Constants
+//****************************************
+
+#define R4A_OV2640_BLOB_NO_LABEL    0xffff  // Run was dropped
+
+//****************************************
+// Types
+//****************************************
+
+// Label statistics, valid in the root label
+typedef struct _R4A_OV2640_BLOB_LABEL
+{
+    uint16_t _parent;           // Parent label, root labels are their own parent
+    uint16_t _left;             // Leftmost column
+    uint16_t _top;              // Top row
+    uint16_t _right;            // Rightmost column
+    uint16_t _bottom;           // Bottom row
+    uint32_t _area;             // Number of pixels
+    uint32_t _sumX;             // Sum of the pixel columns
+    uint32_t _sumY;             // Sum of the pixel rows
+} R4A_OV2640_BLOB_LABEL;
+
+// Horizontal run of selected pixels
+typedef struct _R4A_OV2640_BLOB_RUN
+{
+    uint16_t _start;            // First column
+    uint16_t _end;              // Last column
+    uint16_t _label;            // Label number
+} R4A_OV2640_BLOB_RUN;
+
+// Work area allocated by r4aOv2640BlobFind
+typedef struct _R4A_OV2640_BLOB_WORK
+{
+    uint8_t _select[256];       // Non-zero for the selected pixel values
+    uint8_t _row[R4A_OV2640_BLOB_MAX_WIDTH];    // Luminance or hue bins
+    R4A_OV2640_BLOB_RUN _run[2][(R4A_OV2640_BLOB_MAX_WIDTH / 2) + 1]; // Previous and current row
+    R4A_OV2640_BLOB_LABEL _label[R4A_OV2640_BLOB_MAX_LABELS];
+} R4A_OV2640_BLOB_WORK;
+
+//*********************************************************************
+// Locate the root label
+static inline uint16_t r4aOv2640BlobRoot(R4A_OV2640_BLOB_LABEL * label,
+                                         uint16_t index)
+{
+    // Halve the path length while walking to the root
+    while (label[index]._parent != index)
+    {
+        label[index]._parent = label[label[index]._parent]._parent;
+        index = label[index]._parent;
+    }
+    return index;
+}
+
+//*********************************************************************
+// Merge two labels, returning the root label
+static uint16_t r4aOv2640BlobMerge(R4A_OV2640_BLOB_LABEL * label,
+                                   uint16_t a,
+                                   uint16_t b)
+{
+    R4A_OV2640_BLOB_LABEL * child;
+    R4A_OV2640_BLOB_LABEL * root;
+    uint16_t temp;
+
+    a = r4aOv2640BlobRoot(label, a);
+    b = r4aOv2640BlobRoot(label, b);
+    if (a == b)
+        return a;
+
+    // Keep the older label as the root
+    if (b < a)
+    {
+        temp = a;
+        a = b;
+        b = temp;
+    }
+    root = &label[a];
+    child = &label[b];
+    child->_parent = a;
+
+    // Combine the statistics
+    root->_area += child->_area;
+    root->_sumX += child->_sumX;
+    root->_sumY += child->_sumY;
+    if (root->_left > child->_left)
+        root->_left = child->_left;
+    if (root->_top > child->_top)
+        root->_top = child->_top;
+    if (root->_right < child->_right)
+        root->_right = child->_right;
+    if (root->_bottom < child->_bottom)
+        root->_bottom = child->_bottom;
+    return a;
+}
+
+//*********************************************************************
+// Display the blobs
+void r4aOv2640BlobDisplay(R4A_OV2640_BLOBS * blobs,
+                          Print * display)
+{
+    R4A_OV2640_BLOB * blob;
+    uint8_t index;
+
+    display->printf("Blobs: %d\r\n", blobs->_blobCount);
+    for (index = 0; index < blobs->_blobCount; index++)
+    {
+        blob = &blobs->_blob[index];
+        display->printf("    %d: %lu pixels at (%.1f, %.1f), (%d, %d) - (%d, %d)\r\n",
+                        index, blob->_area, blob->_centroidX, blob->_centroidY,
+                        blob->_left, blob->_top, blob->_right, blob->_bottom);
+    }
+    display->printf("    Labels: %d, Runs: %lu, Runs dropped: %lu\r\n",
+                    blobs->_labels, blobs->_runs, blobs->_runsDropped);
+    display->printf("    Processing time: %lu uSec\r\n", blobs->_processUsec);
+}
+
+//*********************************************************************
+// Locate the blobs in the frame
+bool r4aOv2640BlobFind(R4A_OV2640_BLOBS * blobs,
+                       camera_fb_t * frameBuffer,
+                       Print * display)
+{
+    R4A_OV2640_BLOB * blob;
+    R4A_OV2640_BLOB_RUN * current;
+    uint16_t currentCount;
+    uint16_t end;
+    uint16_t height;
+    int index;
+    uint16_t label;
+    R4A_OV2640_BLOB_LABEL * labels;
+    uint16_t labelCount;
+    uint16_t length;
+    uint16_t next;
+    uint16_t overlap;
+    R4A_OV2640_BLOB_RUN * previous;
+    uint16_t previousCount;
+    const uint8_t * row;
+    uint32_t runs;
+    uint32_t runsDropped;
+    uint8_t * select;
+    uint16_t start;
+    int64_t startUsec;
+    R4A_OV2640_BLOB_RUN * temp;
+    int value;
+    uint16_t width;
+    R4A_OV2640_BLOB_WORK * work;
+    uint16_t x;
+    uint16_t y;
+
+    startUsec = esp_timer_get_time();
+    blobs->_blobCount = 0;
+
+    // Validate the frame
+    width = frameBuffer->width;
+    height = frameBuffer->height;
+    if ((frameBuffer->format != PIXFORMAT_GRAYSCALE)
+        && (frameBuffer->format != PIXFORMAT_RGB565))
+    {
+        if (display)
+            display->printf("ERROR: Unsupported pixel format %d for blob detection!\r\n",
+                            frameBuffer->format);
+        return false;
+    }
+    if (width > R4A_OV2640_BLOB_MAX_WIDTH)
+    {
+        if (display)
+            display->printf("ERROR: Frame width %d > %d for blob detection!\r\n",
+                            width, R4A_OV2640_BLOB_MAX_WIDTH);
+        return false;
+    }
+
+    // Allocate the work area
+    if (!blobs->_workArea)
+    {
+        blobs->_workArea = malloc(sizeof(R4A_OV2640_BLOB_WORK));
+        if (!blobs->_workArea)
+        {
+            if (display)
+                display->println("ERROR: Failed to allocate the blob work area!");
+            return false;
+        }
+    }
+    work = (R4A_OV2640_BLOB_WORK *)blobs->_workArea;
+    labels = work->_label;
+    select = work->_select;
+
+    // Build the selection table
+    for (value = 0; value < 256; value++)
+    {
+        if (blobs->_hueBins && (frameBuffer->format == PIXFORMAT_RGB565))
+        {
+            if (value == R4A_OV2640_HUE_NONE)
+                select[value] = 0;
+            else if (blobs->_hueFirst <= blobs->_hueLast)
+                select[value] = (value >= blobs->_hueFirst) && (value <= blobs->_hueLast);
+            else
+                // The hue range wraps through red
+                select[value] = (value >= blobs->_hueFirst) || (value <= blobs->_hueLast);
+        }
+        else if (blobs->_isDark)
+            select[value] = (value < blobs->_threshold);
+        else
+            select[value] = (value >= blobs->_threshold);
+    }
+
+    // Walk the rows
+    labelCount = 0;
+    previous = work->_run[0];
+    current = work->_run[1];
+    previousCount = 0;
+    runs = 0;
+    runsDropped = 0;
+    for (y = 0; y < height; y++)
+    {
+        // Get the luminance or hue of the row
+        if (frameBuffer->format == PIXFORMAT_GRAYSCALE)
+            row = &frameBuffer->buf[y * width];
+        else
+        {
+            if (blobs->_hueBins)
+                r4aOv2640Rgb565ToHue(&frameBuffer->buf[y * width * 2],
+                                     work->_row,
+                                     width,
+                                     blobs->_hueBins,
+                                     blobs->_minimumChroma);
+            else
+                r4aOv2640Rgb565ToY8(&frameBuffer->buf[y * width * 2],
+                                    work->_row,
+                                    width);
+            row = work->_row;
+        }
+
+        // Locate the runs in the row
+        currentCount = 0;
+        overlap = 0;
+        for (x = 0; x < width; )
+        {
+            // Skip the background pixels
+            while ((x < width) && (!select[row[x]]))
+                x += 1;
+            if (x >= width)
+                break;
+            start = x;
+            while ((x < width) && select[row[x]])
+                x += 1;
+            end = x - 1;
+            length = x - start;
+            runs += 1;
+
+            // Skip the previous runs that end before this run, the
+            // previous runs touching this run may also touch the next run
+            while ((overlap < previousCount) && ((previous[overlap]._end + 1) < start))
+                overlap += 1;
+
+            // Join the labels of the touching runs in the previous row
+            label = R4A_OV2640_BLOB_NO_LABEL;
+            for (next = overlap;
+                 (next < previousCount) && (previous[next]._start <= (end + 1));
+                 next++)
+            {
+                if (previous[next]._label == R4A_OV2640_BLOB_NO_LABEL)
+                    continue;
+                if (label == R4A_OV2640_BLOB_NO_LABEL)
+                    label = r4aOv2640BlobRoot(labels, previous[next]._label);
+                else
+                    label = r4aOv2640BlobMerge(labels, label, previous[next]._label);
+            }
+
+            // Start a new label
+            if (label == R4A_OV2640_BLOB_NO_LABEL)
+            {
+                if (labelCount >= R4A_OV2640_BLOB_MAX_LABELS)
+                {
+                    runsDropped += 1;
+                    current[currentCount]._start = start;
+                    current[currentCount]._end = end;
+                    current[currentCount++]._label = R4A_OV2640_BLOB_NO_LABEL;
+                    continue;
+                }
+                label = labelCount++;
+                labels[label]._parent = label;
+                labels[label]._left = start;
+                labels[label]._top = y;
+                labels[label]._right = end;
+                labels[label]._bottom = y;
+                labels[label]._area = 0;
+                labels[label]._sumX = 0;
+                labels[label]._sumY = 0;
+            }
+
+            // Add the run to the label
+            labels[label]._area += length;
+            labels[label]._sumX += ((uint32_t)(start + end) * length) >> 1;
+            labels[label]._sumY += (uint32_t)y * length;
+            if (labels[label]._left > start)
+                labels[label]._left = start;
+            if (labels[label]._right < end)
+                labels[label]._right = end;
+            labels[label]._bottom = y;
+            current[currentCount]._start = start;
+            current[currentCount]._end = end;
+            current[currentCount++]._label = label;
+        }
+
+        // The current row becomes the previous row
+        temp = previous;
+        previous = current;
+        current = temp;
+        previousCount = currentCount;
+    }
+
+    // Keep the largest blobs, sorted by decreasing area
+    for (label = 0; label < labelCount; label++)
+    {
+        if ((labels[label]._parent != label)
+            || (labels[label]._area < blobs->_minimumArea))
+            continue;
+        index = blobs->_blobCount;
+        if (index == R4A_OV2640_BLOB_MAX)
+        {
+            if (labels[label]._area <= blobs->_blob[index - 1]._area)
+                continue;
+            index -= 1;
+        }
+        else
+            blobs->_blobCount += 1;
+        for (; (index > 0) && (blobs->_blob[index - 1]._area < labels[label]._area); index--)
+            blobs->_blob[index] = blobs->_blob[index - 1];
+
+        // Describe the blob
+        blob = &blobs->_blob[index];
+        blob->_area = labels[label]._area;
+        blob->_centroidX = (float)labels[label]._sumX / (float)blob->_area;
+        blob->_centroidY = (float)labels[label]._sumY / (float)blob->_area;
+        blob->_left = labels[label]._left;
+        blob->_top = labels[label]._top;
+        blob->_right = labels[label]._right;
+        blob->_bottom = labels[label]._bottom;
+    }
+
+    blobs->_labels = labelCount;
+    blobs->_runs = runs;
+    blobs->_runsDropped = runsDropped;
+    blobs->_processUsec = (uint32_t)(esp_timer_get_time() - startUsec);
+    return (blobs->_blobCount != 0);
+}
+
+//*********************************************************************
+// Free the blob work area
+void r4aOv2640BlobFree(R4A_OV2640_BLOBS * blobs)
+{
+    if (blobs->_workArea)
+        free(blobs->_workArea);
+    blobs->_workArea = nullptr;
+}
+
+//*********************************************************************
+// Display the blobs
+void r4aOv2640BlobMenuDisplay(const struct _R4A_MENU_ENTRY * menuEntry,
+                              const char * command,
+                              Print * display)
+{
+    r4aOv2640BlobDisplay((R4A_OV2640_BLOBS *)menuEntry->menuParameter, display);
+}
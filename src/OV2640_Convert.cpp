@@ -0,0 +1,307 @@
+/**********************************************************************
+  OV2640_Convert.cpp
+
+  Robots-For-All (R4A)
+  OV2640 camera pixel format conversion
+
+  The conversion routines read two pixels from each 32-bit word and
+  write the results into a caller provided buffer.  The RGB565 pixels
+  are sent by the camera with the high byte (RRRRRGGG) first followed
+  by the low byte (GGGBBBBB).  Since luminance is a linear combination
+  of red, green and blue, the contribution of each byte is looked up
+  separately and summed.
+**********************************************************************/
+
+#include "R4A_ESP32.h"
+
+//****************************************
+// Locals
+//****************************************
+
+static bool r4aOv2640ConvertTablesBuilt;
+
+// Luminance contribution (8.8 fixed point) of the RGB565 high byte
+static uint16_t r4aOv2640YHighByte[256];
+
+// Luminance contribution (8.8 fixed point) of the RGB565 low byte
+static uint16_t r4aOv2640YLowByte[256];
+
+//*********************************************************************
+// Build the conversion tables
+void r4aOv2640ConvertTablesInit()
+{
+    float blue;
+    float green;
+    int index;
+    float red;
+
+    if (r4aOv2640ConvertTablesBuilt)
+        return;
+
+    // Y = 0.299 R + 0.587 G + 0.114 B, with the components scaled to 0 - 255
+    for (index = 0; index < 256; index++)
+    {
+        // High byte: RRRRRGGG, red and the upper 3 bits of green
+        red = (index >> 3) * (255. / 31.);
+        green = ((index & 7) << 3) * (255. / 63.);
+        r4aOv2640YHighByte[index] = (uint16_t)(((0.299 * red) + (0.587 * green)) * 256. + 0.5);
+
+        // Low byte: GGGBBBBB, the lower 3 bits of green and blue
+        green = (index >> 5) * (255. / 63.);
+        blue = (index & 0x1f) * (255. / 31.);
+        r4aOv2640YLowByte[index] = (uint16_t)(((0.587 * green) + (0.114 * blue)) * 256. + 0.5);
+    }
+    r4aOv2640ConvertTablesBuilt = true;
+}
+
+//*********************************************************************
+// Convert RGB565 pixels to luminance
+void r4aOv2640Rgb565ToY8(const uint8_t * src,
+                         uint8_t * dst,
+                         size_t pixelCount)
+{
+    const uint16_t * high;
+    const uint16_t * low;
+    uint32_t luminance;
+    uint32_t pixels;
+    const uint32_t * srcWord;
+    uint32_t * dstWord;
+
+    r4aOv2640ConvertTablesInit();
+    high = r4aOv2640YHighByte;
+    low = r4aOv2640YLowByte;
+
+    // Convert four pixels (two words) at a time
+    srcWord = (const uint32_t *)src;
+    dstWord = (uint32_t *)dst;
+    for (; pixelCount >= 4; pixelCount -= 4)
+    {
+        pixels = *srcWord++;
+        luminance = ((high[pixels & 0xff] + low[(pixels >> 8) & 0xff] + 0x80) >> 8)
+                  | (((high[(pixels >> 16) & 0xff] + low[pixels >> 24] + 0x80) & 0xff00));
+        pixels = *srcWord++;
+        luminance |= (((high[pixels & 0xff] + low[(pixels >> 8) & 0xff] + 0x80) & 0xff00) << 8)
+                   | (((high[(pixels >> 16) & 0xff] + low[pixels >> 24] + 0x80) & 0xff00) << 16);
+        *dstWord++ = luminance;
+    }
+
+    // Convert the remaining pixels
+    src = (const uint8_t *)srcWord;
+    dst = (uint8_t *)dstWord;
+    while (pixelCount--)
+    {
+        *dst++ = (high[src[0]] + low[src[1]] + 0x80) >> 8;
+        src += 2;
+    }
+}
+
+//*********************************************************************
+// Convert RGB565 pixels to hue bins
+void r4aOv2640Rgb565ToHue(const uint8_t * src,
+                          uint8_t * dst,
+                          size_t pixelCount,
+                          uint8_t bins,
+                          uint8_t minimumChroma)
+{
+    uint32_t blue;
+    uint32_t chroma;
+    uint32_t green;
+    int index;
+    uint32_t maximum;
+    uint32_t minimum;
+    int32_t numerator;
+    uint32_t pixel;
+    uint32_t pixels;
+    uint32_t reciprocal[32];
+    uint32_t red;
+    const uint32_t * srcWord;
+
+    // Build the reciprocal table, the bin number is computed by
+    // multiplying the hue numerator (0 - 6 * chroma) by the reciprocal
+    // bins / (6 * chroma) in 16.16 fixed point.  Round the reciprocal
+    // up, a truncated reciprocal places a hue that falls exactly on a
+    // bin boundary into the lower bin.  The rounding error times the
+    // numerator (below 6 * 31) stays under the 1 / (6 * chroma) spacing
+    // of the exact quotients, so the bin number always matches
+    // (numerator * bins) / (6 * chroma).
+    reciprocal[0] = 0;
+    for (index = 1; index < 32; index++)
+        reciprocal[index] = ((((uint32_t)bins) << 16) + (6 * index) - 1) / (6 * index);
+
+    // Convert two pixels (one word) at a time
+    srcWord = (const uint32_t *)src;
+    while (pixelCount)
+    {
+        pixels = *srcWord++;
+        for (index = 0; (index < 2) && pixelCount; index++, pixelCount--)
+        {
+            // Get the 5-bit color components
+            pixel = pixels & 0xffff;
+            pixels >>= 16;
+            red = (pixel >> 3) & 0x1f;
+            green = (((pixel & 7) << 3) | ((pixel >> 13) & 7)) >> 1;
+            blue = (pixel >> 8) & 0x1f;
+
+            // Determine the chroma
+            maximum = red;
+            if (maximum < green)
+                maximum = green;
+            if (maximum < blue)
+                maximum = blue;
+            minimum = red;
+            if (minimum > green)
+                minimum = green;
+            if (minimum > blue)
+                minimum = blue;
+            chroma = maximum - minimum;
+
+            // Gray pixels do not have a hue
+            if ((chroma == 0) || (chroma < minimumChroma))
+            {
+                *dst++ = R4A_OV2640_HUE_NONE;
+                continue;
+            }
+
+            // Compute the hue numerator in the range of 0 to 6 * chroma
+            if (maximum == red)
+            {
+                numerator = (int32_t)green - (int32_t)blue;
+                if (numerator < 0)
+                    numerator += 6 * chroma;
+            }
+            else if (maximum == green)
+                numerator = (2 * chroma) + blue - red;
+            else
+                numerator = (4 * chroma) + red - green;
+
+            // Scale the hue to the bin number
+            *dst++ = (numerator * reciprocal[chroma]) >> 16;
+        }
+    }
+}
+
+//*********************************************************************
+// Convert YUV422 pixels to luminance
+void r4aOv2640Yuv422ToY8(const uint8_t * src,
+                         uint8_t * dst,
+                         size_t pixelCount)
+{
+    uint32_t luminance;
+    uint32_t pixels;
+    const uint32_t * srcWord;
+    uint32_t * dstWord;
+
+    // Each word contains Y0 U Y1 V, convert four pixels (two words)
+    // at a time
+    srcWord = (const uint32_t *)src;
+    dstWord = (uint32_t *)dst;
+    for (; pixelCount >= 4; pixelCount -= 4)
+    {
+        pixels = *srcWord++;
+        luminance = (pixels & 0xff) | ((pixels >> 8) & 0xff00);
+        pixels = *srcWord++;
+        luminance |= ((pixels & 0xff) << 16) | ((pixels << 8) & 0xff000000);
+        *dstWord++ = luminance;
+    }
+
+    // Convert the remaining pixels
+    src = (const uint8_t *)srcWord;
+    dst = (uint8_t *)dstWord;
+    while (pixelCount--)
+    {
+        *dst++ = *src;
+        src += 2;
+    }
+}
+
+//*********************************************************************
+// Measure the cost of the pixel conversion routines
+void r4aOv2640ConvertBenchmark(Print * display)
+{
+    const size_t pixelCount = 320 * 240;
+    const int passes = 10;
+    uint8_t * dst;
+    size_t index;
+    int pass;
+    uint8_t * src;
+    int64_t startUsec;
+    int64_t usec;
+    R4A_OV2640_VIEW view;
+    R4A_OV2640_VIEW viewHalf;
+
+    // Allocate the buffers
+    src = (uint8_t *)heap_caps_malloc(pixelCount * 2, MALLOC_CAP_SPIRAM);
+    dst = (uint8_t *)heap_caps_malloc(pixelCount, MALLOC_CAP_SPIRAM);
+    do
+    {
+        if ((!src) || (!dst))
+        {
+            display->println("ERROR: Failed to allocate the benchmark buffers!");
+            break;
+        }
+
+        // Fill the source image
+        for (index = 0; index < (pixelCount * 2); index++)
+            src[index] = (uint8_t)esp_random();
+        r4aOv2640ConvertTablesInit();
+
+        display->printf("QVGA frames, %d passes, PSRAM buffers\r\n", passes);
+        display->println("    uSec/Mpixel  Conversion");
+        display->println("    -----------  ----------");
+
+        // RGB565 to Y8
+        startUsec = esp_timer_get_time();
+        for (pass = 0; pass < passes; pass++)
+            r4aOv2640Rgb565ToY8(src, dst, pixelCount);
+        usec = esp_timer_get_time() - startUsec;
+        display->printf("    %11lld  RGB565 --> Y8\r\n",
+                        (usec * 1000 * 1000) / (pixelCount * passes));
+
+        // RGB565 to hue bins
+        startUsec = esp_timer_get_time();
+        for (pass = 0; pass < passes; pass++)
+            r4aOv2640Rgb565ToHue(src, dst, pixelCount, 12, 2);
+        usec = esp_timer_get_time() - startUsec;
+        display->printf("    %11lld  RGB565 --> Hue bins\r\n",
+                        (usec * 1000 * 1000) / (pixelCount * passes));
+
+        // YUV422 to Y8
+        startUsec = esp_timer_get_time();
+        for (pass = 0; pass < passes; pass++)
+            r4aOv2640Yuv422ToY8(src, dst, pixelCount);
+        usec = esp_timer_get_time() - startUsec;
+        display->printf("    %11lld  YUV422 --> Y8\r\n",
+                        (usec * 1000 * 1000) / (pixelCount * passes));
+
+        // RGB565 to 1/2 scale RGB565
+        view._buf = src;
+        view._width = 320;
+        view._height = 240;
+        view._stride = 320 * 2;
+        view._format = PIXFORMAT_RGB565;
+        view._bytesPerPixel = 2;
+        viewHalf._buf = dst;
+        viewHalf._stride = 160 * 2;
+        startUsec = esp_timer_get_time();
+        for (pass = 0; pass < passes; pass++)
+            r4aOv2640ViewDownsample2x(&view, &viewHalf);
+        usec = esp_timer_get_time() - startUsec;
+        display->printf("    %11lld  RGB565 --> 1/2 scale RGB565\r\n",
+                        (usec * 1000 * 1000) / (pixelCount * passes));
+    } while (0);
+
+    // Free the buffers
+    if (dst)
+        heap_caps_free(dst);
+    if (src)
+        heap_caps_free(src);
+}
+
+//*********************************************************************
+// Measure the cost of the pixel conversion routines
+void r4aOv2640ConvertMenuBenchmark(const struct _R4A_MENU_ENTRY * menuEntry,
+                                   const char * command,
+                                   Print * display)
+{
+    r4aOv2640ConvertBenchmark(display);
+}
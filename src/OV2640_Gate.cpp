@@ -0,0 +1,217 @@
+/**********************************************************************
+  OV2640_Gate.cpp
+
+  Robots-For-All (R4A)
+  OV2640 camera frame difference gating
+
+  A sparse grid of words is sampled from each frame and compared with
+  the same words from the last processed frame.  The sum of absolute
+  differences (SAD) is computed in two 16-bit lanes of each word, the
+  lanes are folded into the total before they can overflow.  Frames
+  whose mean difference is below the threshold are not processed.
+**********************************************************************/
+
+#include "R4A_ESP32.h"
+
+//****************************************
+// Constants
+//****************************************
+
+#define R4A_OV2640_GATE_FOLD        64  // Words summed before the lanes overflow
+#define R4A_OV2640_GATE_ROW_STEP    8   // Default rows between samples
+#define R4A_OV2640_GATE_WORD_STEP   4   // Default words between samples
+
+//*********************************************************************
+// Compute the absolute difference of the 16-bit lanes, lane values
+// must be less than 0x8000
+static inline uint32_t r4aOv2640GateSad16(uint32_t a, uint32_t b)
+{
+    uint32_t difference;
+    uint32_t mask;
+    uint32_t maximum;
+
+    // Bit 15 of each lane is set when a >= b
+    difference = (a | 0x80008000) - b;
+    mask = ((difference >> 15) & 0x00010001) * 0xffff;
+
+    // Subtract the smaller value from the larger, no borrows between lanes
+    maximum = (a & mask) | (b & ~mask);
+    return maximum - (a ^ b ^ maximum);
+}
+
+//*********************************************************************
+// Convert two RGB565 pixels into luminance (0 - 125) lanes
+static inline uint32_t r4aOv2640GateLuminance(uint32_t pixels)
+{
+    // The camera sends the high byte (RRRRRGGG) first followed by the
+    // low byte (GGGBBBBB), compute R5 + G6 + B5 for each pixel
+    return ((pixels >> 3) & 0x001f001f)
+         + (((pixels & 0x00070007) << 3) | ((pixels >> 13) & 0x00070007))
+         + ((pixels >> 8) & 0x001f001f);
+}
+
+//*********************************************************************
+// Determine if the frame changed enough to be processed
+bool r4aOv2640GateCheck(R4A_OV2640_GATE * gate,
+                        camera_fb_t * frameBuffer)
+{
+    uint32_t accumulator;
+    uint32_t * current;
+    uint32_t fold;
+    uint32_t index;
+    uint32_t pixels;
+    uint32_t pixelsPerWord;
+    bool process;
+    uint32_t * reference;
+    uint16_t row;
+    size_t rowBytes;
+    uint8_t rowStep;
+    uint64_t sad;
+    uint32_t samples;
+    int64_t startUsec;
+    const uint32_t * word;
+    uint32_t wordIndex;
+    uint8_t wordStep;
+    uint32_t wordsPerRow;
+
+    // JPEG frames can't be sampled
+    if ((frameBuffer->format == PIXFORMAT_JPEG) || (!frameBuffer->height))
+        return true;
+    startUsec = esp_timer_get_time();
+
+    // Determine the sample grid
+    rowStep = gate->_rowStep ? gate->_rowStep : R4A_OV2640_GATE_ROW_STEP;
+    wordStep = gate->_wordStep ? gate->_wordStep : R4A_OV2640_GATE_WORD_STEP;
+    rowBytes = frameBuffer->len / frameBuffer->height;
+    wordsPerRow = rowBytes >> 2;
+    samples = ((frameBuffer->height + rowStep - 1) / rowStep)
+            * ((wordsPerRow + wordStep - 1) / wordStep);
+    pixelsPerWord = 4 / (rowBytes / frameBuffer->width);
+
+    // Allocate the sample buffers when the frame size changes
+    if ((samples != gate->_samples) || (frameBuffer->format != gate->_format))
+    {
+        if (gate->_sampleBuffer)
+            free(gate->_sampleBuffer);
+        gate->_sampleBuffer = (uint32_t *)malloc(2 * samples * sizeof(uint32_t));
+        gate->_samples = gate->_sampleBuffer ? samples : 0;
+        gate->_format = frameBuffer->format;
+        gate->_valid = false;
+        if (!gate->_sampleBuffer)
+            return true;
+    }
+    reference = &gate->_sampleBuffer[gate->_current * samples];
+    current = &gate->_sampleBuffer[(gate->_current ^ 1) * samples];
+
+    // Compare the samples with the last processed frame
+    accumulator = 0;
+    fold = 0;
+    index = 0;
+    sad = 0;
+    for (row = 0; row < frameBuffer->height; row += rowStep)
+    {
+        word = (const uint32_t *)&frameBuffer->buf[row * rowBytes];
+        for (wordIndex = 0; wordIndex < wordsPerRow; wordIndex += wordStep)
+        {
+            pixels = word[wordIndex];
+            if (frameBuffer->format == PIXFORMAT_RGB565)
+            {
+                pixels = r4aOv2640GateLuminance(pixels);
+                accumulator += r4aOv2640GateSad16(pixels, reference[index]);
+            }
+            else
+            {
+                // Split the bytes into even and odd lanes
+                accumulator += r4aOv2640GateSad16(pixels & 0x00ff00ff,
+                                                  reference[index] & 0x00ff00ff)
+                             + r4aOv2640GateSad16((pixels >> 8) & 0x00ff00ff,
+                                                  (reference[index] >> 8) & 0x00ff00ff);
+            }
+            current[index++] = pixels;
+
+            // Fold the lanes into the total before they overflow
+            if (++fold == R4A_OV2640_GATE_FOLD)
+            {
+                sad += (accumulator & 0xffff) + (accumulator >> 16);
+                accumulator = 0;
+                fold = 0;
+            }
+        }
+    }
+    sad += (accumulator & 0xffff) + (accumulator >> 16);
+
+    // Compute the mean difference per pixel in 1/16 luminance (0 - 255) steps
+    if (frameBuffer->format == PIXFORMAT_RGB565)
+        sad = (sad * 255) / 125;
+    gate->_differenceX16 = (uint32_t)((sad * 16) / (samples * pixelsPerWord));
+
+    // Process the frame when it changed or was skipped too long
+    process = (!gate->_valid)
+            || (gate->_differenceX16 >= (gate->_threshold * 16))
+            || (gate->_skipCount >= gate->_maximumSkip);
+    if (process)
+    {
+        // Make this frame the reference
+        gate->_current ^= 1;
+        gate->_valid = true;
+        gate->_skipCount = 0;
+        gate->_framesProcessed += 1;
+    }
+    else
+    {
+        gate->_skipCount += 1;
+        gate->_framesSkipped += 1;
+    }
+    gate->_checkUsec += esp_timer_get_time() - startUsec;
+    return process;
+}
+
+//*********************************************************************
+// Display the frame difference gating statistics
+void r4aOv2640GateDisplay(R4A_OV2640 * object,
+                          Print * display)
+{
+    uint32_t checks;
+    uint32_t count;
+    R4A_OV2640_GATE * gate;
+    R4A_OV2640_HISTOGRAM * histogram;
+    uint32_t processUsec;
+    int64_t savedUsec;
+
+    gate = object->_gate;
+    if (!gate)
+    {
+        display->println("OV2640 frame gating disabled");
+        return;
+    }
+
+    // Estimate the time saved using the average processing time
+    histogram = &object->_stageHistogram[R4A_OV2640_STAGE_PROCESS];
+    count = __atomic_load_n(&histogram->_count, __ATOMIC_ACQUIRE);
+    processUsec = count
+                ? (__atomic_load_n(&histogram->_totalUsec, __ATOMIC_RELAXED) / count)
+                : 0;
+    savedUsec = ((int64_t)gate->_framesSkipped * processUsec) - gate->_checkUsec;
+    checks = gate->_framesProcessed + gate->_framesSkipped;
+
+    display->println("OV2640 frame gating");
+    display->printf("    Threshold: %d\r\n", gate->_threshold);
+    display->printf("    Last difference: %lu.%02lu\r\n",
+                    gate->_differenceX16 >> 4,
+                    ((gate->_differenceX16 & 0xf) * 100) >> 4);
+    display->printf("    Frames processed: %lu\r\n", gate->_framesProcessed);
+    display->printf("    Frames skipped: %lu\r\n", gate->_framesSkipped);
+    if (checks)
+        display->printf("    Check time: %llu uSec/frame\r\n", gate->_checkUsec / checks);
+    display->printf("    Average processing time: %lu uSec\r\n", processUsec);
+    display->printf("    CPU time saved: %lld mSec\r\n", savedUsec / 1000);
+}
+
+//*********************************************************************
+// Display the frame difference gating statistics
+void r4aOv2640GateMenuDisplay(const struct _R4A_MENU_ENTRY * menuEntry,
+                              const char * command,
+                              Print * display)
+{
+    r4aOv2640GateDisplay((R4A_OV2640 *)menuEntry->menuParameter, display);
+}
@@ -0,0 +1,889 @@
+/**********************************************************************
+  OV2640_Jpeg.cpp
+
+  Robots-For-All (R4A)
+  OV2640 camera reduced resolution JPEG decode
+
+  The luminance of a baseline JPEG image is decoded at 1/8 or 1/4 scale
+  without an inverse DCT.  Every coefficient is Huffman decoded, since
+  that is the only way to locate the next block, but only the DC
+  coefficient is dequantized for 1/8 scale.  The DC coefficient is 8
+  times the average of the 8 x 8 block, producing one output pixel per
+  block.  For 1/4 scale the three lowest frequency AC coefficients are
+  also kept and each 4 x 4 quadrant of the block is the average of the
+  IDCT over that quadrant, producing 2 x 2 output pixels per block.
+  The chrominance blocks are decoded and discarded.
+
+  The decoder state and the Y8 image buffer are allocated by the first
+  decode and reused for the following frames.  r4aOv2640Update decodes
+  the JPEG frames before processing when R4A_OV2640::_jpegDecode is set.
+**********************************************************************/
+
+#include "R4A_ESP32.h"
+
+//****************************************
+// Constants
+//****************************************
+
+// Quadrant average of the first cosine basis function divided by
+// 4 * sqrt(2) for the 1/4 scale IDCT, 12-bit fixed point
+#define R4A_OV2640_JPEG_K1      464
+
+// Square of the quadrant average divided by 4, 12-bit fixed point
+#define R4A_OV2640_JPEG_K2      420
+
+// JPEG standard Huffman tables (ITU T.81 Annex K.3), used when the
+// image does not contain the DHT marker
+static const uint8_t r4aOv2640JpegDcBits[2][16] =
+{
+    {0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0},   // Luminance
+    {0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0},   // Chrominance
+};
+
+static const uint8_t r4aOv2640JpegDcValues[12] =
+{
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11
+};
+
+static const uint8_t r4aOv2640JpegAcBits[2][16] =
+{
+    {0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d},   // Luminance
+    {0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77},   // Chrominance
+};
+
+static const uint8_t r4aOv2640JpegAcValues[2][162] =
+{
+    {   // Luminance
+        0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12,
+        0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+        0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08,
+        0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+        0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16,
+        0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+        0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39,
+        0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+        0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59,
+        0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+        0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79,
+        0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+        0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98,
+        0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+        0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6,
+        0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+        0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4,
+        0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+        0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea,
+        0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+        0xf9, 0xfa
+    },
+    {   // Chrominance
+        0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21,
+        0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+        0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91,
+        0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0,
+        0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34,
+        0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+        0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38,
+        0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+        0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58,
+        0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+        0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78,
+        0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+        0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96,
+        0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+        0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4,
+        0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+        0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2,
+        0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+        0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9,
+        0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+        0xf9, 0xfa
+    },
+};
+
+//****************************************
+// Types
+//****************************************
+
+// Huffman decode table
+typedef struct _R4A_OV2640_JPEG_HUFFMAN
+{
+    bool _defined;              // True when the table was loaded
+    uint16_t _lookup[256];      // (length << 8) | value for codes of 8 bits or less
+    int32_t _maxCode[17];       // Largest code of each length, -1 if none
+    int32_t _valueOffset[17];   // Index of the first value minus the first code
+    uint8_t _values[256];       // Symbol values
+} R4A_OV2640_JPEG_HUFFMAN;
+
+// Image component
+typedef struct _R4A_OV2640_JPEG_COMPONENT
+{
+    uint8_t _id;                // Component identifier
+    uint8_t _h;                 // Horizontal blocks per MCU
+    uint8_t _v;                 // Vertical blocks per MCU
+    uint8_t _quantTable;        // Quantization table number
+    uint8_t _dcTable;           // DC Huffman table number
+    uint8_t _acTable;           // AC Huffman table number
+    int32_t _dcPrediction;      // Previous DC value
+} R4A_OV2640_JPEG_COMPONENT;
+
+// Decoder state
+typedef struct _R4A_OV2640_JPEG_DECODER
+{
+    const uint8_t * _data;      // Next byte of entropy coded data
+    const uint8_t * _end;       // End of the JPEG image
+    uint32_t _bits;             // Bit buffer, next bit in bit 31
+    int _bitCount;              // Number of bits in the bit buffer
+    bool _marker;               // True when a marker ends the entropy data
+    bool _error;                // True when an invalid code was found
+    uint16_t _quant[4][64];     // Quantization tables in zigzag order
+    R4A_OV2640_JPEG_HUFFMAN _huffman[2][2]; // [DC, AC][table]
+    R4A_OV2640_JPEG_COMPONENT _component[3];
+    uint8_t _componentCount;    // Number of components in the frame
+    uint16_t _width;            // Image width in pixels
+    uint16_t _height;           // Image height in pixels
+    uint16_t _restartInterval;  // MCUs between restart markers
+} R4A_OV2640_JPEG_DECODER;
+
+//*********************************************************************
+// Build a Huffman decode table
+// Inputs:
+//   table: Address of the Huffman decode table
+//   bits: Number of codes of each length (1 - 16)
+//   values: Symbol values in code order
+//   valueCount: Number of symbol values
+// Outputs:
+//   Returns true if the code lengths are valid and false otherwise
+static bool r4aOv2640JpegHuffmanBuild(R4A_OV2640_JPEG_HUFFMAN * table,
+                                      const uint8_t * bits,
+                                      const uint8_t * values,
+                                      int valueCount)
+{
+    int code;
+    int count;
+    int fill;
+    int index;
+    int length;
+
+    memcpy(table->_values, values, valueCount);
+    memset(table->_lookup, 0, sizeof(table->_lookup));
+
+    // Assign the canonical codes in order of increasing length
+    code = 0;
+    index = 0;
+    for (length = 1; length <= 16; length++)
+    {
+        table->_valueOffset[length] = index - code;
+        table->_maxCode[length] = bits[length - 1] ? (code + bits[length - 1] - 1) : -1;
+        for (count = 0; count < bits[length - 1]; count++)
+        {
+            // Too many codes for this length
+            if (code >= (1 << length))
+                return false;
+
+            // Fill the lookup entries for the short codes
+            if (length <= 8)
+                for (fill = 0; fill < (1 << (8 - length)); fill++)
+                    table->_lookup[(code << (8 - length)) | fill] = (length << 8) | values[index];
+            code += 1;
+            index += 1;
+        }
+        code <<= 1;
+    }
+    table->_defined = true;
+    return true;
+}
+
+//*********************************************************************
+// Fill the bit buffer with at least 25 bits
+static inline void r4aOv2640JpegFill(R4A_OV2640_JPEG_DECODER * decoder)
+{
+    uint32_t byte;
+
+    while (decoder->_bitCount <= 24)
+    {
+        // Supply zeros after the end of the entropy coded data
+        byte = 0;
+        if ((!decoder->_marker) && (decoder->_data < decoder->_end))
+        {
+            byte = *decoder->_data;
+            if (byte != 0xff)
+                decoder->_data += 1;
+            else if (((decoder->_data + 1) < decoder->_end) && (decoder->_data[1] == 0))
+                decoder->_data += 2;    // Stuffed zero byte
+            else
+            {
+                // Stop at the marker
+                decoder->_marker = true;
+                byte = 0;
+            }
+        }
+        decoder->_bits |= byte << (24 - decoder->_bitCount);
+        decoder->_bitCount += 8;
+    }
+}
+
+//*********************************************************************
+// Get the next bits from the entropy coded data
+static inline uint32_t r4aOv2640JpegBits(R4A_OV2640_JPEG_DECODER * decoder,
+                                         int count)
+{
+    uint32_t value;
+
+    if (!count)
+        return 0;
+    r4aOv2640JpegFill(decoder);
+    value = decoder->_bits >> (32 - count);
+    decoder->_bits <<= count;
+    decoder->_bitCount -= count;
+    return value;
+}
+
+//*********************************************************************
+// Convert the bits into a signed coefficient value
+static inline int32_t r4aOv2640JpegExtend(uint32_t value, int count)
+{
+    if (count && (value < (1u << (count - 1))))
+        return (int32_t)value - (1 << count) + 1;
+    return value;
+}
+
+//*********************************************************************
+// Decode the next Huffman symbol
+static inline uint8_t r4aOv2640JpegHuffman(R4A_OV2640_JPEG_DECODER * decoder,
+                                           const R4A_OV2640_JPEG_HUFFMAN * table)
+{
+    int32_t code;
+    uint16_t entry;
+    int length;
+
+    // Look up the short codes
+    r4aOv2640JpegFill(decoder);
+    entry = table->_lookup[decoder->_bits >> 24];
+    if (entry >> 8)
+    {
+        length = entry >> 8;
+        decoder->_bits <<= length;
+        decoder->_bitCount -= length;
+        return entry & 0xff;
+    }
+
+    // Search the longer codes
+    for (length = 9; length <= 16; length++)
+    {
+        code = decoder->_bits >> (32 - length);
+        if (code <= table->_maxCode[length])
+        {
+            decoder->_bits <<= length;
+            decoder->_bitCount -= length;
+            return table->_values[code + table->_valueOffset[length]];
+        }
+    }
+    decoder->_error = true;
+    return 0;
+}
+
+//*********************************************************************
+// Decode a block, returning the lowest frequency coefficients
+// Inputs:
+//   decoder: Address of the decoder state
+//   component: Address of the component description
+//   coefficients: Address of the buffer to receive the first 5
+//                 coefficients in zigzag order
+static void r4aOv2640JpegBlock(R4A_OV2640_JPEG_DECODER * decoder,
+                               R4A_OV2640_JPEG_COMPONENT * component,
+                               int32_t * coefficients)
+{
+    int index;
+    uint8_t runSize;
+    int size;
+
+    // Decode the DC difference, the bit buffer holds at most 16 bits
+    size = r4aOv2640JpegHuffman(decoder, &decoder->_huffman[0][component->_dcTable]);
+    if (size > 16)
+    {
+        decoder->_error = true;
+        return;
+    }
+    component->_dcPrediction += r4aOv2640JpegExtend(r4aOv2640JpegBits(decoder, size), size);
+    coefficients[0] = component->_dcPrediction;
+    coefficients[1] = 0;
+    coefficients[2] = 0;
+    coefficients[3] = 0;
+    coefficients[4] = 0;
+
+    // Decode the AC coefficients, keeping only the lowest frequencies
+    for (index = 1; index < 64; index++)
+    {
+        runSize = r4aOv2640JpegHuffman(decoder, &decoder->_huffman[1][component->_acTable]);
+        size = runSize & 0xf;
+        if (!size)
+        {
+            // End of block, or 16 zeros
+            if (runSize != 0xf0)
+                break;
+            index += 15;
+            continue;
+        }
+        index += runSize >> 4;
+        if (index <= 4)
+            coefficients[index] = r4aOv2640JpegExtend(r4aOv2640JpegBits(decoder, size), size);
+        else
+            r4aOv2640JpegBits(decoder, size);
+    }
+}
+
+//*********************************************************************
+// Limit the pixel value to 0 - 255
+static inline uint8_t r4aOv2640JpegClamp(int32_t value)
+{
+    if (value < 0)
+        return 0;
+    if (value > 255)
+        return 255;
+    return value;
+}
+
+//*********************************************************************
+// Decode the entropy coded data
+static bool r4aOv2640JpegScan(R4A_OV2640_JPEG_DECODER * decoder,
+                              uint8_t scale,
+                              R4A_OV2640_VIEW * view)
+{
+    uint16_t blockX;
+    uint16_t blockY;
+    int32_t both;
+    int bx;
+    int by;
+    int32_t coefficients[5];
+    int componentIndex;
+    R4A_OV2640_JPEG_COMPONENT * component;
+    int32_t dc;
+    int32_t horizontal;
+    uint8_t maxH;
+    uint8_t maxV;
+    uint32_t mcu;
+    uint16_t mcusX;
+    uint16_t mcusY;
+    uint16_t mcuX;
+    uint16_t mcuY;
+    uint8_t * pixel;
+    const uint16_t * quant;
+    int32_t vertical;
+    uint16_t x;
+    uint16_t y;
+
+    // Determine the MCU size, a single component scan uses one block
+    maxH = 1;
+    maxV = 1;
+    if (decoder->_componentCount > 1)
+        for (componentIndex = 0; componentIndex < decoder->_componentCount; componentIndex++)
+        {
+            if (maxH < decoder->_component[componentIndex]._h)
+                maxH = decoder->_component[componentIndex]._h;
+            if (maxV < decoder->_component[componentIndex]._v)
+                maxV = decoder->_component[componentIndex]._v;
+        }
+    else
+    {
+        decoder->_component[0]._h = 1;
+        decoder->_component[0]._v = 1;
+    }
+    mcusX = (decoder->_width + (8 * maxH) - 1) / (8 * maxH);
+    mcusY = (decoder->_height + (8 * maxV) - 1) / (8 * maxV);
+    quant = decoder->_quant[decoder->_component[0]._quantTable];
+
+    // Walk the MCUs
+    mcu = 0;
+    for (mcuY = 0; mcuY < mcusY; mcuY++)
+        for (mcuX = 0; mcuX < mcusX; mcuX++, mcu++)
+        {
+            // Handle the restart marker
+            if (decoder->_restartInterval && mcu && (!(mcu % decoder->_restartInterval)))
+            {
+                // Discard the remaining bits and locate the RSTn marker
+                decoder->_bits = 0;
+                decoder->_bitCount = 0;
+                while (((decoder->_data + 1) < decoder->_end)
+                       && ((decoder->_data[0] != 0xff)
+                           || ((decoder->_data[1] & 0xf8) != 0xd0)))
+                    decoder->_data += 1;
+                decoder->_data += 2;
+                decoder->_marker = false;
+                for (componentIndex = 0; componentIndex < decoder->_componentCount; componentIndex++)
+                    decoder->_component[componentIndex]._dcPrediction = 0;
+            }
+
+            // Decode each of the blocks in the MCU
+            for (componentIndex = 0; componentIndex < decoder->_componentCount; componentIndex++)
+            {
+                component = &decoder->_component[componentIndex];
+                for (by = 0; by < component->_v; by++)
+                    for (bx = 0; bx < component->_h; bx++)
+                    {
+                        r4aOv2640JpegBlock(decoder, component, coefficients);
+                        if (decoder->_error)
+                            return false;
+                        if (componentIndex)
+                            continue;
+
+                        // Output the luminance block
+                        blockX = (mcuX * component->_h) + bx;
+                        blockY = (mcuY * component->_v) + by;
+                        dc = coefficients[0] * quant[0];
+                        if (scale == R4A_OV2640_JPEG_SCALE_1_8)
+                        {
+                            if ((blockX < view->_width) && (blockY < view->_height))
+                                view->_buf[(blockY * view->_stride) + blockX] =
+                                    r4aOv2640JpegClamp(((dc + 4) >> 3) + 128);
+                            continue;
+                        }
+
+                        // Compute the average of each quadrant, F01 is the
+                        // horizontal and F10 is the vertical frequency
+                        x = blockX * 2;
+                        y = blockY * 2;
+                        if ((x >= view->_width) || (y >= view->_height))
+                            continue;
+                        dc = (dc * 512) + (128 << 12) + (1 << 11);
+                        horizontal = coefficients[1] * quant[1] * R4A_OV2640_JPEG_K1;
+                        vertical = coefficients[2] * quant[2] * R4A_OV2640_JPEG_K1;
+                        both = coefficients[4] * quant[4] * R4A_OV2640_JPEG_K2;
+                        pixel = &view->_buf[(y * view->_stride) + x];
+                        pixel[0] = r4aOv2640JpegClamp((dc + horizontal + vertical + both) >> 12);
+                        if ((x + 1) < view->_width)
+                            pixel[1] = r4aOv2640JpegClamp((dc - horizontal + vertical - both) >> 12);
+                        if ((y + 1) < view->_height)
+                        {
+                            pixel += view->_stride;
+                            pixel[0] = r4aOv2640JpegClamp((dc + horizontal - vertical - both) >> 12);
+                            if ((x + 1) < view->_width)
+                                pixel[1] = r4aOv2640JpegClamp((dc - horizontal - vertical + both) >> 12);
+                        }
+                    }
+            }
+        }
+    return true;
+}
+
+//*********************************************************************
+// Free the JPEG decode work areas
+void r4aOv2640JpegDecodeFree(R4A_OV2640_JPEG_DECODE * decode)
+{
+    if (decode->_workArea)
+        free(decode->_workArea);
+    decode->_workArea = nullptr;
+    if (decode->_buffer)
+        heap_caps_free(decode->_buffer);
+    decode->_buffer = nullptr;
+    decode->_size = 0;
+}
+
+//*********************************************************************
+// Decode the luminance of a JPEG image at reduced resolution
+bool r4aOv2640JpegToY8(R4A_OV2640_JPEG_DECODE * decode,
+                       const uint8_t * jpeg,
+                       size_t length,
+                       Print * display)
+{
+    uint8_t * buffer;
+    int componentIndex;
+    int count;
+    R4A_OV2640_JPEG_DECODER * decoder;
+    int index;
+    uint8_t marker;
+    uint8_t * row;
+    uint8_t scale;
+    const uint8_t * segment;
+    size_t segmentLength;
+    size_t size;
+    int64_t startUsec;
+    bool success;
+    int table;
+    int tableBytes;
+    int tableClass;
+    int total;
+    R4A_OV2640_VIEW * view;
+    uint16_t x;
+    uint16_t y;
+
+    // Validate the parameters
+    startUsec = esp_timer_get_time();
+    scale = decode->_scale;
+    if ((scale != R4A_OV2640_JPEG_SCALE_1_8) && (scale != R4A_OV2640_JPEG_SCALE_1_4))
+    {
+        if (display)
+            display->printf("ERROR: Unsupported JPEG scale 1/%d!\r\n", scale);
+        return false;
+    }
+    if ((length < 4) || (jpeg[0] != 0xff) || (jpeg[1] != 0xd8))
+    {
+        if (display)
+            display->println("ERROR: Not a JPEG image!");
+        return false;
+    }
+
+    // Allocate the work area
+    if (!decode->_workArea)
+    {
+        decode->_workArea = malloc(sizeof(R4A_OV2640_JPEG_DECODER));
+        if (!decode->_workArea)
+        {
+            if (display)
+                display->println("ERROR: Failed to allocate the JPEG decoder!");
+            return false;
+        }
+    }
+    decoder = (R4A_OV2640_JPEG_DECODER *)decode->_workArea;
+    memset(decoder, 0, sizeof(*decoder));
+    view = &decode->_view;
+
+    // Walk the markers
+    success = false;
+    decoder->_end = &jpeg[length];
+    segment = &jpeg[2];
+    do
+    {
+        // Locate the next marker
+        while ((segment < decoder->_end) && (*segment != 0xff))
+            segment += 1;
+        while ((segment < decoder->_end) && (*segment == 0xff))
+            segment += 1;
+        if ((segment + 3) > decoder->_end)
+        {
+            if (display)
+                display->println("ERROR: JPEG image is truncated!");
+            break;
+        }
+        marker = *segment++;
+        segmentLength = (segment[0] << 8) | segment[1];
+        if ((segmentLength < 2) || ((segment + segmentLength) > decoder->_end))
+        {
+            if (display)
+                display->printf("ERROR: Invalid JPEG marker 0x%02x length!\r\n", marker);
+            break;
+        }
+
+        // Define quantization tables
+        if (marker == 0xdb)
+        {
+            for (index = 2; index < (int)segmentLength; )
+            {
+                table = segment[index] & 3;
+                tableBytes = (segment[index] >> 4) ? 128 : 64;
+                if ((index + 1 + tableBytes) > (int)segmentLength)
+                    break;
+                if (tableBytes == 128)
+                {
+                    // 16-bit values
+                    for (count = 0; count < 64; count++)
+                        decoder->_quant[table][count] = (segment[index + 1 + count * 2] << 8)
+                                                      | segment[index + 2 + count * 2];
+                }
+                else
+                {
+                    for (count = 0; count < 64; count++)
+                        decoder->_quant[table][count] = segment[index + 1 + count];
+                }
+                index += 1 + tableBytes;
+            }
+            if (index != (int)segmentLength)
+            {
+                if (display)
+                    display->println("ERROR: Invalid JPEG quantization table!");
+                break;
+            }
+        }
+
+        // Define Huffman tables
+        else if (marker == 0xc4)
+        {
+            for (index = 2; (index + 17) <= (int)segmentLength; )
+            {
+                tableClass = (segment[index] >> 4) & 1;
+                table = segment[index] & 1;
+                total = 0;
+                for (count = 0; count < 16; count++)
+                    total += segment[index + 1 + count];
+                if ((total > 256) || ((index + 17 + total) > (int)segmentLength))
+                    break;
+                if (!r4aOv2640JpegHuffmanBuild(&decoder->_huffman[tableClass][table],
+                                               &segment[index + 1],
+                                               &segment[index + 17],
+                                               total))
+                    break;
+                index += 17 + total;
+            }
+            if (index != (int)segmentLength)
+            {
+                if (display)
+                    display->println("ERROR: Invalid JPEG Huffman table!");
+                break;
+            }
+        }
+
+        // Baseline and extended sequential frames
+        else if ((marker == 0xc0) || (marker == 0xc1))
+        {
+            if (segmentLength < 8)
+            {
+                if (display)
+                    display->println("ERROR: Unsupported JPEG frame!");
+                break;
+            }
+            decoder->_height = (segment[3] << 8) | segment[4];
+            decoder->_width = (segment[5] << 8) | segment[6];
+            decoder->_componentCount = segment[7];
+            if ((segment[2] != 8) || (!decoder->_componentCount)
+                || (decoder->_componentCount > 3)
+                || (segmentLength < (8 + (3 * (size_t)decoder->_componentCount))))
+            {
+                if (display)
+                    display->println("ERROR: Unsupported JPEG frame!");
+                break;
+            }
+            for (componentIndex = 0; componentIndex < decoder->_componentCount; componentIndex++)
+            {
+                decoder->_component[componentIndex]._id = segment[8 + componentIndex * 3];
+                decoder->_component[componentIndex]._h = segment[9 + componentIndex * 3] >> 4;
+                decoder->_component[componentIndex]._v = segment[9 + componentIndex * 3] & 0xf;
+                decoder->_component[componentIndex]._quantTable = segment[10 + componentIndex * 3] & 3;
+            }
+        }
+
+        // Progressive, lossless and arithmetic coded frames
+        else if (((marker & 0xf0) == 0xc0) && (marker != 0xc4) && (marker != 0xc8)
+                 && (marker != 0xcc))
+        {
+            if (display)
+                display->printf("ERROR: Unsupported JPEG frame type 0x%02x!\r\n", marker);
+            break;
+        }
+
+        // Define restart interval
+        else if (marker == 0xdd)
+        {
+            if (segmentLength < 4)
+            {
+                if (display)
+                    display->println("ERROR: Invalid JPEG restart interval!");
+                break;
+            }
+            decoder->_restartInterval = (segment[2] << 8) | segment[3];
+        }
+
+        // Start of scan
+        else if (marker == 0xda)
+        {
+            if ((!decoder->_componentCount) || (segmentLength < 3)
+                || (segment[2] != decoder->_componentCount)
+                || (segmentLength < (3 + (2 * (size_t)decoder->_componentCount))))
+            {
+                if (display)
+                    display->println("ERROR: Unsupported JPEG scan!");
+                break;
+            }
+            for (componentIndex = 0; componentIndex < decoder->_componentCount; componentIndex++)
+            {
+                decoder->_component[componentIndex]._dcTable = (segment[4 + componentIndex * 2] >> 4) & 1;
+                decoder->_component[componentIndex]._acTable = segment[4 + componentIndex * 2] & 1;
+            }
+
+            // Use the standard Huffman tables when the image has none
+            for (table = 0; table < 2; table++)
+            {
+                if (!decoder->_huffman[0][table]._defined)
+                    r4aOv2640JpegHuffmanBuild(&decoder->_huffman[0][table],
+                                              r4aOv2640JpegDcBits[table],
+                                              r4aOv2640JpegDcValues,
+                                              sizeof(r4aOv2640JpegDcValues));
+                if (!decoder->_huffman[1][table]._defined)
+                    r4aOv2640JpegHuffmanBuild(&decoder->_huffman[1][table],
+                                              r4aOv2640JpegAcBits[table],
+                                              r4aOv2640JpegAcValues[table],
+                                              sizeof(r4aOv2640JpegAcValues[table]));
+            }
+
+            // Describe the output image
+            view->_width = (decoder->_width + scale - 1) / scale;
+            view->_height = (decoder->_height + scale - 1) / scale;
+            view->_stride = (view->_width + 3) & ~3;
+            view->_format = PIXFORMAT_GRAYSCALE;
+            view->_bytesPerPixel = 1;
+
+            // Reuse the buffer when possible
+            size = view->_stride * view->_height;
+            if (size > decode->_size)
+            {
+                buffer = (uint8_t *)heap_caps_realloc(decode->_buffer, size, MALLOC_CAP_SPIRAM);
+                if (!buffer)
+                {
+                    if (display)
+                        display->printf("ERROR: Failed to allocate %d bytes for the %d x %d image!\r\n",
+                                        size, view->_width, view->_height);
+                    break;
+                }
+                decode->_buffer = buffer;
+                decode->_size = size;
+            }
+            view->_buf = decode->_buffer;
+
+            // Decode the image
+            decoder->_data = segment + segmentLength;
+            success = r4aOv2640JpegScan(decoder, scale, view);
+            if (!success)
+            {
+                if (display)
+                    display->println("ERROR: Invalid JPEG Huffman code!");
+                break;
+            }
+
+            // Repeat the last column in the padding, the frame buffer
+            // width is the stride
+            if (view->_width)
+                for (y = 0; y < view->_height; y++)
+                {
+                    row = &view->_buf[y * view->_stride];
+                    for (x = view->_width; x < view->_stride; x++)
+                        row[x] = row[view->_width - 1];
+                }
+
+            // Describe the image in the camera driver's format
+            decode->_frameBuffer.buf = view->_buf;
+            decode->_frameBuffer.len = size;
+            decode->_frameBuffer.width = view->_stride;
+            decode->_frameBuffer.height = view->_height;
+            decode->_frameBuffer.format = PIXFORMAT_GRAYSCALE;
+            break;
+        }
+
+        // End of image before the scan
+        else if (marker == 0xd9)
+        {
+            if (display)
+                display->println("ERROR: JPEG image has no scan!");
+            break;
+        }
+
+        // Skip to the next marker
+        segment += segmentLength;
+    } while (1);
+
+    decode->_decodeUsec = (uint32_t)(esp_timer_get_time() - startUsec);
+    return success;
+}
+
+//*********************************************************************
+// Compare the reduced resolution JPEG decode with the full decode
+void r4aOv2640JpegDecodeBenchmark(Print * display)
+{
+    uint8_t * buffer;
+    R4A_OV2640_JPEG_DECODE decode;
+    camera_fb_t * frameBuffer;
+    uint8_t * jpeg;
+    size_t jpegLength;
+    uint16_t height;
+    int pass;
+    const int passes = 10;
+    size_t pixels;
+    uint8_t * rgb565;
+    int64_t startUsec;
+    int64_t usec;
+    uint16_t width;
+
+    buffer = nullptr;
+    memset(&decode, 0, sizeof(decode));
+    frameBuffer = nullptr;
+    jpeg = nullptr;
+    rgb565 = nullptr;
+    do
+    {
+        // Get a JPEG image
+        frameBuffer = esp_camera_fb_get();
+        if (!frameBuffer)
+        {
+            display->println("ERROR: Failed to capture the image");
+            break;
+        }
+        width = frameBuffer->width;
+        height = frameBuffer->height;
+        pixels = width * height;
+        if (frameBuffer->format == PIXFORMAT_JPEG)
+        {
+            jpegLength = frameBuffer->len;
+            jpeg = (uint8_t *)heap_caps_malloc(jpegLength, MALLOC_CAP_SPIRAM);
+            if (jpeg)
+                memcpy(jpeg, frameBuffer->buf, jpegLength);
+        }
+        else if (!frame2jpg(frameBuffer, R4A_OV2640_JPEG_QUALITY, &jpeg, &jpegLength))
+            jpeg = nullptr;
+        esp_camera_fb_return(frameBuffer);
+        frameBuffer = nullptr;
+        if (!jpeg)
+        {
+            display->println("ERROR: Failed to get the JPEG image!");
+            break;
+        }
+
+        // Allocate the output buffers
+        buffer = (uint8_t *)heap_caps_malloc(pixels, MALLOC_CAP_SPIRAM);
+        rgb565 = (uint8_t *)heap_caps_malloc(pixels * 2, MALLOC_CAP_SPIRAM);
+        if ((!buffer) || (!rgb565))
+        {
+            display->println("ERROR: Failed to allocate the benchmark buffers!");
+            break;
+        }
+
+        display->printf("%d x %d JPEG image, %d bytes, %d passes\r\n",
+                        width, height, jpegLength, passes);
+        display->println("    uSec/frame  Decode");
+        display->println("    ----------  ------");
+
+        // 1/8 scale decode
+        decode._scale = R4A_OV2640_JPEG_SCALE_1_8;
+        startUsec = esp_timer_get_time();
+        for (pass = 0; pass < passes; pass++)
+            r4aOv2640JpegToY8(&decode, jpeg, jpegLength, display);
+        usec = esp_timer_get_time() - startUsec;
+        display->printf("    %10lld  JPEG --> 1/8 scale Y8, %d x %d\r\n",
+                        usec / passes, decode._view._width, decode._view._height);
+
+        // 1/4 scale decode
+        decode._scale = R4A_OV2640_JPEG_SCALE_1_4;
+        startUsec = esp_timer_get_time();
+        for (pass = 0; pass < passes; pass++)
+            r4aOv2640JpegToY8(&decode, jpeg, jpegLength, display);
+        usec = esp_timer_get_time() - startUsec;
+        display->printf("    %10lld  JPEG --> 1/4 scale Y8, %d x %d\r\n",
+                        usec / passes, decode._view._width, decode._view._height);
+
+        // Full decode
+        startUsec = esp_timer_get_time();
+        for (pass = 0; pass < passes; pass++)
+        {
+            jpg2rgb565(jpeg, jpegLength, rgb565, JPG_SCALE_NONE);
+            r4aOv2640Rgb565ToY8(rgb565, buffer, pixels);
+        }
+        usec = esp_timer_get_time() - startUsec;
+        display->printf("    %10lld  JPEG --> RGB565 --> Y8, %d x %d\r\n",
+                        usec / passes, width, height);
+    } while (0);
+
+    // Free the buffers
+    r4aOv2640JpegDecodeFree(&decode);
+    if (rgb565)
+        heap_caps_free(rgb565);
+    if (buffer)
+        heap_caps_free(buffer);
+    if (jpeg)
+        free(jpeg);
+}
+
+//*********************************************************************
+// Compare the reduced resolution JPEG decode with the full decode
+void r4aOv2640JpegMenuDecodeBenchmark(const struct _R4A_MENU_ENTRY * menuEntry,
+                                      const char * command,
+                                      Print * display)
+{
+    r4aOv2640JpegDecodeBenchmark(display);
+}
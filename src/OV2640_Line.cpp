@@ -0,0 +1,573 @@
+/**********************************************************************
+  OV2640_Line.cpp
+
+  Robots-For-All (R4A)
+  OV2640 camera line detection
+
+  The selected rows of the frame are thresholded using word parallel
+  (SWAR) arithmetic.  Each 32-bit word holds either four grayscale
+  pixels or two RGB565 pixels.  The threshold comparison produces a
+  mask bit for each pixel which is gathered into a nibble and used to
+  index the pixel count and position tables.
+
+  r4aOv2640LineBenchmark compares the SWAR routines with a one pixel at
+  a time reference on random rows, locates lines drawn into synthetic
+  grayscale and RGB565 frames and measures the time per QQVGA frame.
+**********************************************************************/
+
+#include "R4A_ESP32.h"
+
+//****************************************
+// Constants
+//****************************************
+
+// Number of line pixels in the nibble
+static const uint8_t r4aOv2640LinePixelCount[16] =
+{
+    0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4
+};
+
+// Sum of the line pixel offsets (0 - 3) in the nibble
+static const uint8_t r4aOv2640LinePixelSum[16] =
+{
+    0, 0, 1, 1, 2, 2, 3, 3, 3, 3, 4, 4, 5, 5, 6, 6
+};
+
+//*********************************************************************
+// Threshold a row of grayscale pixels
+// Inputs:
+//   row: Address of the first pixel in the row, 32-bit aligned
+//   width: Number of pixels in the row
+//   threshold: Luminance threshold, 0 - 255
+//   lineIsDark: True when the line pixels are below the threshold
+//   sumX: Address of the value to receive the sum of the line pixel offsets
+// Outputs:
+//   Returns the number of line pixels in the row
+static uint32_t r4aOv2640LineRowGray(const uint8_t * row,
+                                     uint16_t width,
+                                     uint8_t threshold,
+                                     bool lineIsDark,
+                                     uint32_t * sumX)
+{
+    uint32_t count;
+    uint32_t invert;
+    uint32_t mask;
+    uint32_t nibble;
+    uint32_t sum;
+    uint32_t thresholdWord;
+    const uint32_t * word;
+    uint16_t x;
+
+    // Drop the least significant bit of each pixel so that the sum of
+    // the pixel and the threshold fits within the byte, bit 7 is set
+    // when the pixel is at or above the threshold
+    thresholdWord = (0x80 - (threshold >> 1)) * 0x01010101;
+    invert = lineIsDark ? 0x80808080 : 0;
+
+    // Process four pixels at a time
+    count = 0;
+    sum = 0;
+    word = (const uint32_t *)row;
+    for (x = 0; (x + 4) <= width; x += 4)
+    {
+        mask = ((((*word++) >> 1) & 0x7f7f7f7f) + thresholdWord) & 0x80808080;
+        mask ^= invert;
+        if (mask)
+        {
+            // Gather the mask bits, pixel n in bit n
+            nibble = ((mask >> 7) * 0x01020408) >> 24;
+            count += r4aOv2640LinePixelCount[nibble];
+            sum += r4aOv2640LinePixelSum[nibble]
+                 + (r4aOv2640LinePixelCount[nibble] * x);
+        }
+    }
+
+    // Process the remaining pixels
+    for (; x < width; x++)
+        if ((((row[x] >> 1) >= (threshold >> 1)) ^ lineIsDark))
+        {
+            count += 1;
+            sum += x;
+        }
+
+    *sumX = sum;
+    return count;
+}
+
+//*********************************************************************
+// Threshold a row one pixel at a time, reference for the SWAR routines
+// Inputs:
+//   row: Address of the first pixel in the row
+//   width: Number of pixels in the row
+//   format: PIXFORMAT_GRAYSCALE or PIXFORMAT_RGB565
+//   threshold: Luminance threshold, 0 - 255
+//   lineIsDark: True when the line pixels are below the threshold
+//   sumX: Address of the value to receive the sum of the line pixel offsets
+// Outputs:
+//   Returns the number of line pixels in the row
+static uint32_t r4aOv2640LineRowReference(const uint8_t * row,
+                                          uint16_t width,
+                                          pixformat_t format,
+                                          uint8_t threshold,
+                                          bool lineIsDark,
+                                          uint32_t * sumX)
+{
+    uint32_t count;
+    bool isLine;
+    uint32_t luminance;
+    uint32_t pixel;
+    uint32_t sum;
+    uint16_t x;
+
+    count = 0;
+    sum = 0;
+    for (x = 0; x < width; x++)
+    {
+        // Use the same precision as the SWAR routines
+        if (format == PIXFORMAT_GRAYSCALE)
+            isLine = ((row[x] >> 1) >= (threshold >> 1));
+        else
+        {
+            pixel = (row[x * 2] << 8) | row[x * 2 + 1];
+            luminance = (pixel >> 11) + ((pixel >> 5) & 0x3f) + (pixel & 0x1f);
+            isLine = (luminance >= (uint32_t)(((threshold * 125) + 127) / 255));
+        }
+        if (isLine ^ lineIsDark)
+        {
+            count += 1;
+            sum += x;
+        }
+    }
+
+    *sumX = sum;
+    return count;
+}
+
+//*********************************************************************
+// Threshold a row of RGB565 pixels
+// Inputs:
+//   row: Address of the first pixel in the row, 32-bit aligned
+//   width: Number of pixels in the row
+//   threshold: Luminance threshold, 0 - 255
+//   lineIsDark: True when the line pixels are below the threshold
+//   sumX: Address of the value to receive the sum of the line pixel offsets
+// Outputs:
+//   Returns the number of line pixels in the row
+static uint32_t r4aOv2640LineRowRgb565(const uint8_t * row,
+                                       uint16_t width,
+                                       uint8_t threshold,
+                                       bool lineIsDark,
+                                       uint32_t * sumX)
+{
+    uint32_t count;
+    uint32_t invert;
+    uint32_t luminance;
+    uint32_t mask;
+    uint32_t nibble;
+    uint32_t pixels;
+    uint32_t sum;
+    uint32_t threshold7;
+    uint32_t thresholdWord;
+    const uint32_t * word;
+    uint16_t x;
+
+    // The camera sends the high byte (RRRRRGGG) first followed by the
+    // low byte (GGGBBBBB).  The luminance approximation R5 + G6 + B5
+    // ranges from 0 to 125 and is computed in each 16-bit half of the
+    // word.  Bit 7 of each half is set when the luminance is at or
+    // above the scaled threshold.
+    threshold7 = ((threshold * 125) + 127) / 255;
+    thresholdWord = (0x80 - threshold7) * 0x00010001;
+    invert = lineIsDark ? 0x00800080 : 0;
+
+    // Process four pixels (two words) at a time
+    count = 0;
+    sum = 0;
+    word = (const uint32_t *)row;
+    for (x = 0; (x + 4) <= width; x += 4)
+    {
+        // Pixels 0 and 1
+        pixels = *word++;
+        luminance = ((pixels >> 3) & 0x001f001f)                // Red
+                  + (((pixels & 0x00070007) << 3)
+                     | ((pixels >> 13) & 0x00070007))           // Green
+                  + ((pixels >> 8) & 0x001f001f);               // Blue
+        mask = ((luminance + thresholdWord) & 0x00800080) ^ invert;
+        nibble = ((mask >> 7) & 1) | ((mask >> 22) & 2);
+
+        // Pixels 2 and 3
+        pixels = *word++;
+        luminance = ((pixels >> 3) & 0x001f001f)
+                  + (((pixels & 0x00070007) << 3)
+                     | ((pixels >> 13) & 0x00070007))
+                  + ((pixels >> 8) & 0x001f001f);
+        mask = ((luminance + thresholdWord) & 0x00800080) ^ invert;
+        nibble |= ((mask >> 5) & 4) | ((mask >> 20) & 8);
+
+        // Account for the line pixels
+        if (nibble)
+        {
+            count += r4aOv2640LinePixelCount[nibble];
+            sum += r4aOv2640LinePixelSum[nibble]
+                 + (r4aOv2640LinePixelCount[nibble] * x);
+        }
+    }
+
+    // Process the remaining pixels
+    for (; x < width; x++)
+    {
+        pixels = (row[x * 2 + 1] << 8) | row[x * 2];
+        luminance = ((pixels >> 3) & 0x1f)
+                  + (((pixels & 7) << 3) | ((pixels >> 13) & 7))
+                  + ((pixels >> 8) & 0x1f);
+        if ((luminance >= threshold7) ^ lineIsDark)
+        {
+            count += 1;
+            sum += x;
+        }
+    }
+
+    *sumX = sum;
+    return count;
+}
+
+//*********************************************************************
+// Draw a line into a synthetic frame
+// Inputs:
+//   frameBuffer: Frame to fill
+//   centerX: Line position at the center row in pixels
+//   angleDegrees: Line heading, positive leans to the right
+//   lineWidth: Width of the line in pixels
+//   floor: Luminance of the floor
+//   line: Luminance of the line
+static void r4aOv2640LineDraw(camera_fb_t * frameBuffer,
+                              float centerX,
+                              float angleDegrees,
+                              int lineWidth,
+                              uint8_t floor,
+                              uint8_t line)
+{
+    uint16_t column;
+    uint8_t * pixel;
+    uint16_t rgb565;
+    uint16_t row;
+    float slope;
+    float x;
+    uint8_t y;
+
+    slope = tanf(angleDegrees * (M_PI / 180.));
+    pixel = frameBuffer->buf;
+    for (row = 0; row < frameBuffer->height; row++)
+    {
+        // Rows above the center are further right for a positive angle
+        x = centerX + slope * ((int)(frameBuffer->height >> 1) - (int)row);
+        for (column = 0; column < frameBuffer->width; column++)
+        {
+            y = (fabsf(column - x) < (lineWidth * 0.5)) ? line : floor;
+            if (frameBuffer->format == PIXFORMAT_GRAYSCALE)
+                *pixel++ = y;
+            else
+            {
+                // High byte first
+                rgb565 = ((y >> 3) << 11) | ((y >> 2) << 5) | (y >> 3);
+                *pixel++ = rgb565 >> 8;
+                *pixel++ = rgb565;
+            }
+        }
+    }
+}
+
+//*********************************************************************
+// Verify the line detection kernels and measure their speed
+bool r4aOv2640LineBenchmark(Print * display)
+{
+    static const uint16_t rows[] = {10, 25, 40, 55, 70, 85, 100, 115}; // Average 62.5
+    const float angles[] = {-30, -10, 0, 15, 35};
+    const uint16_t height = 120;
+    const int passes = 1000;
+    const uint16_t width = 160;
+    const uint16_t widths[] = {160, 157};
+    bool checksFailed;
+    uint32_t countRef;
+    uint32_t countSwar;
+    uint8_t * frame;
+    float expectedX;
+    camera_fb_t frameBuffer;
+    int failures;
+    pixformat_t format;
+    int index;
+    R4A_OV2640_LINE line;
+    bool lineIsDark;
+    int pass;
+    volatile uint32_t pixels;
+    int64_t referenceUsec;
+    uint16_t rowWidth;
+    int64_t startUsec;
+    uint32_t sumRef;
+    uint32_t sumSwar;
+    uint8_t threshold;
+    int trial;
+    int64_t usec;
+
+    // Allocate the QQVGA frame
+    frame = (uint8_t *)heap_caps_malloc(width * height * 2, MALLOC_CAP_SPIRAM);
+    if (!frame)
+    {
+        display->println("ERROR: Failed to allocate the benchmark frame!");
+        return false;
+    }
+    memset(&frameBuffer, 0, sizeof(frameBuffer));
+    frameBuffer.buf = frame;
+    frameBuffer.width = width;
+    frameBuffer.height = height;
+
+    // Compare the SWAR kernels with the reference using random rows,
+    // thresholds and row widths that are not a multiple of four pixels
+    checksFailed = false;
+    failures = 0;
+    for (trial = 0; trial < 400; trial++)
+    {
+        for (index = 0; index < (width * 2); index++)
+            frame[index] = (uint8_t)esp_random();
+        format = (trial & 1) ? PIXFORMAT_RGB565 : PIXFORMAT_GRAYSCALE;
+        threshold = (uint8_t)esp_random();
+        lineIsDark = (trial & 2) != 0;
+        rowWidth = widths[(trial >> 2) & 1];
+        if (format == PIXFORMAT_GRAYSCALE)
+            countSwar = r4aOv2640LineRowGray(frame, rowWidth, threshold, lineIsDark, &sumSwar);
+        else
+            countSwar = r4aOv2640LineRowRgb565(frame, rowWidth, threshold, lineIsDark, &sumSwar);
+        countRef = r4aOv2640LineRowReference(frame, rowWidth, format, threshold,
+                                             lineIsDark, &sumRef);
+        if ((countSwar != countRef) || (sumSwar != sumRef))
+        {
+            if (failures++ < 4)
+                display->printf("ERROR: %s row, width %d, threshold %d: SWAR %lu/%lu, reference %lu/%lu\r\n",
+                                (format == PIXFORMAT_GRAYSCALE) ? "Gray" : "RGB565",
+                                rowWidth, threshold, countSwar, sumSwar, countRef, sumRef);
+        }
+    }
+    display->printf("Random rows: %s\r\n", failures ? "FAILED" : "Passed");
+    checksFailed |= (failures != 0);
+
+    // Locate lines drawn at known positions and angles
+    failures = 0;
+    memset(&line, 0, sizeof(line));
+    line._rows = rows;
+    line._rowCount = sizeof(rows) / sizeof(rows[0]);
+    line._threshold = 128;
+    line._lineIsDark = true;
+    line._minimumPixels = 3;
+    for (trial = 0; trial < (int)(2 * sizeof(angles) / sizeof(angles[0])); trial++)
+    {
+        frameBuffer.format = (trial & 1) ? PIXFORMAT_RGB565 : PIXFORMAT_GRAYSCALE;
+        frameBuffer.len = width * height * ((trial & 1) ? 2 : 1);
+        r4aOv2640LineDraw(&frameBuffer, 70, angles[trial >> 1], 10, 200, 40);
+
+        // The centroid is the line position at the average sampled row
+        expectedX = 70 + tanf(angles[trial >> 1] * (M_PI / 180.)) * ((height >> 1) - 62.5);
+        if ((!r4aOv2640LineFind(&line, &frameBuffer))
+            || (line._rowsFound != line._rowCount)
+            || (fabsf(line._centroidX - expectedX) > 1.0)
+            || (fabsf(line._angleDegrees - angles[trial >> 1]) > 1.0))
+        {
+            failures += 1;
+            display->printf("ERROR: %s line at %.0f degrees: found %d rows, %.1f pixels, %.1f degrees\r\n",
+                            (trial & 1) ? "RGB565" : "Gray", angles[trial >> 1],
+                            line._rowsFound, line._centroidX, line._angleDegrees);
+        }
+    }
+    display->printf("Synthetic lines: %s\r\n", failures ? "FAILED" : "Passed");
+    checksFailed |= (failures != 0);
+
+    // Measure the time to locate the line in QQVGA frames
+    display->printf("QQVGA frames, %d rows, %d passes\r\n", line._rowCount, passes);
+    display->println("    nSec/frame  Reference  Format");
+    display->println("    ----------  ---------  ------");
+    for (trial = 0; trial < 2; trial++)
+    {
+        frameBuffer.format = trial ? PIXFORMAT_RGB565 : PIXFORMAT_GRAYSCALE;
+        r4aOv2640LineDraw(&frameBuffer, 70, 15, 10, 200, 40);
+
+        // SWAR kernel
+        startUsec = esp_timer_get_time();
+        for (pass = 0; pass < passes; pass++)
+            r4aOv2640LineFind(&line, &frameBuffer);
+        usec = esp_timer_get_time() - startUsec;
+
+        // Reference, sum the results so that the work is not discarded
+        pixels = 0;
+        startUsec = esp_timer_get_time();
+        for (pass = 0; pass < passes; pass++)
+            for (index = 0; index < line._rowCount; index++)
+                pixels += r4aOv2640LineRowReference(&frame[rows[index] * width * (trial + 1)],
+                                          width,
+                                          frameBuffer.format,
+                                          line._threshold,
+                                          line._lineIsDark,
+                                          &sumRef);
+        referenceUsec = esp_timer_get_time() - startUsec;
+        display->printf("    %10lld  %9lld  %s\r\n",
+                        (usec * 1000) / passes, (referenceUsec * 1000) / passes,
+                        trial ? "RGB565" : "Gray");
+    }
+
+    // Free the frame
+    heap_caps_free(frame);
+    return !checksFailed;
+}
+
+//*********************************************************************
+// Display the line detection results
+void r4aOv2640LineDisplay(R4A_OV2640_LINE * line,
+                          Print * display)
+{
+    uint8_t index;
+
+    display->printf("Line: %s, %d of %d rows\r\n",
+                    line->_rowsFound ? "Found" : "Not found",
+                    line->_rowsFound, line->_rowCount);
+    if (line->_rowsFound)
+    {
+        display->printf("    Centroid: %.1f pixels\r\n", line->_centroidX);
+        display->printf("    Offset: %.3f\r\n", line->_offset);
+        display->printf("    Angle: %.1f degrees\r\n", line->_angleDegrees);
+    }
+    for (index = 0; index < line->_rowCount; index++)
+        display->printf("    Row %3d: %d\r\n",
+                        line->_rows[index], line->_rowCentroidX[index]);
+    display->printf("    Processing time: %lu uSec\r\n", line->_processUsec);
+}
+
+//*********************************************************************
+// Locate the line in the frame
+bool r4aOv2640LineFind(R4A_OV2640_LINE * line,
+                       camera_fb_t * frameBuffer,
+                       Print * display)
+{
+    size_t bytesPerPixel;
+    uint32_t count;
+    float denominator;
+    uint16_t height;
+    uint8_t index;
+    uint32_t maximumPixels;
+    uint16_t row;
+    uint8_t rowsFound;
+    int64_t startUsec;
+    uint32_t sumX;
+    float sumXf;
+    float sumXY;
+    float sumY;
+    float sumYY;
+    uint16_t width;
+    float x;
+    float y;
+
+    startUsec = esp_timer_get_time();
+
+    // Assume the line is not found
+    line->_rowsFound = 0;
+    line->_centroidX = 0;
+    line->_offset = 0;
+    line->_angleDegrees = 0;
+
+    // Validate the pixel format
+    if (frameBuffer->format == PIXFORMAT_GRAYSCALE)
+        bytesPerPixel = 1;
+    else if (frameBuffer->format == PIXFORMAT_RGB565)
+        bytesPerPixel = 2;
+    else
+    {
+        if (display)
+            display->printf("ERROR: Unsupported pixel format %d for line detection!\r\n",
+                            frameBuffer->format);
+        return false;
+    }
+    if (line->_rowCount > R4A_OV2640_LINE_MAX_ROWS)
+    {
+        if (display)
+            display->printf("ERROR: _rowCount > %d!\r\n", R4A_OV2640_LINE_MAX_ROWS);
+        return false;
+    }
+
+    // A row that is mostly line is a shadow or the end of the course
+    width = frameBuffer->width;
+    height = frameBuffer->height;
+    maximumPixels = width >> 1;
+
+    // Locate the line in each of the selected rows
+    rowsFound = 0;
+    sumXf = 0;
+    sumXY = 0;
+    sumY = 0;
+    sumYY = 0;
+    for (index = 0; index < line->_rowCount; index++)
+    {
+        line->_rowCentroidX[index] = -1;
+        row = line->_rows[index];
+        if (row >= height)
+            continue;
+
+        // Threshold the row
+        if (bytesPerPixel == 1)
+            count = r4aOv2640LineRowGray(&frameBuffer->buf[row * width],
+                                         width,
+                                         line->_threshold,
+                                         line->_lineIsDark,
+                                         &sumX);
+        else
+            count = r4aOv2640LineRowRgb565(&frameBuffer->buf[row * width * 2],
+                                           width,
+                                           line->_threshold,
+                                           line->_lineIsDark,
+                                           &sumX);
+        if ((count < line->_minimumPixels) || (count > maximumPixels))
+            continue;
+
+        // Accumulate the values for the least squares fit
+        x = (float)sumX / (float)count;
+        y = row;
+        line->_rowCentroidX[index] = (int16_t)(x + 0.5);
+        rowsFound += 1;
+        sumXf += x;
+        sumY += y;
+        sumXY += x * y;
+        sumYY += y * y;
+    }
+
+    // Compute the line position
+    if (rowsFound)
+    {
+        line->_rowsFound = rowsFound;
+        line->_centroidX = sumXf / rowsFound;
+        line->_offset = (line->_centroidX - (width >> 1)) / (float)(width >> 1);
+
+        // Fit x = slope * y + intercept, rows increase towards the robot
+        // so a line leaning to the right has a negative slope
+        denominator = (rowsFound * sumYY) - (sumY * sumY);
+        if ((rowsFound > 1) && (denominator != 0))
+            line->_angleDegrees = -atanf(((rowsFound * sumXY) - (sumXf * sumY))
+                                         / denominator) * (180. / M_PI);
+    }
+
+    line->_processUsec = (uint32_t)(esp_timer_get_time() - startUsec);
+    return (rowsFound != 0);
+}
+
+//*********************************************************************
+// Verify the line detection kernels and measure their speed
+void r4aOv2640LineMenuBenchmark(const struct _R4A_MENU_ENTRY * menuEntry,
+                                const char * command,
+                                Print * display)
+{
+    r4aOv2640LineBenchmark(display);
+}
+
+//*********************************************************************
+// Display the line detection results
+void r4aOv2640LineMenuDisplay(const struct _R4A_MENU_ENTRY * menuEntry,
+                              const char * command,
+                              Print * display)
+{
+    r4aOv2640LineDisplay((R4A_OV2640_LINE *)menuEntry->menuParameter, display);
+}
@@ -0,0 +1,503 @@
+/**********************************************************************
+  OV2640_Odometry.cpp
+
+  Robots-For-All (R4A)
+  OV2640 camera block matching visual odometry
+
+  The region of interest is downsampled with the image pyramid and
+  converted to luminance.  The most textured 8 x 8 blocks of the
+  previous image are located in the current image by searching the
+  nearby positions for the smallest sum of absolute differences (SAD).
+  The SAD is computed in 16-bit lanes, four pixels at a time, and the
+  best position is refined to a fraction of a pixel by fitting a
+  parabola through the neighboring SAD values.  Blocks whose motion
+  disagrees with the median motion are discarded and a rotation plus
+  translation is fit to the remaining blocks.
+**********************************************************************/
+
+#include "R4A_ESP32.h"
+
+//****************************************
+// Constants
+//****************************************
+
+#define R4A_OV2640_ODOMETRY_OUTLIER     2.0     // Pixels from the median motion
+#define R4A_OV2640_ODOMETRY_SEARCH_MAX  8       // Largest search radius
+#define R4A_OV2640_ODOMETRY_UNIQUE      0.1     // Minimum SAD distinctiveness
+
+//****************************************
+// Types
+//****************************************
+
+// Block motion
+typedef struct _R4A_OV2640_ODOMETRY_MATCH
+{
+    uint16_t _x;                // Block column in the previous image
+    uint16_t _y;                // Block row in the previous image
+    float _dx;                  // Motion to the right in pixels
+    float _dy;                  // Motion down in pixels
+    float _unique;              // SAD distinctiveness, 0 - 1
+} R4A_OV2640_ODOMETRY_MATCH;
+
+//*********************************************************************
+// Compute the absolute difference of the 16-bit lanes, same as
+// r4aOv2640GateSad16
+static inline uint32_t r4aOv2640OdometrySad16(uint32_t a, uint32_t b)
+{
+    uint32_t difference;
+    uint32_t mask;
+    uint32_t maximum;
+
+    difference = (a | 0x80008000) - b;
+    mask = ((difference >> 15) & 0x00010001) * 0xffff;
+    maximum = (a & mask) | (b & ~mask);
+    return maximum - (a ^ b ^ maximum);
+}
+
+//*********************************************************************
+// Compute the SAD between the aligned block of the previous image and
+// the unaligned block of the current image
+static uint32_t r4aOv2640OdometryBlockSad(const uint8_t * previous,
+                                          const uint8_t * current,
+                                          size_t stride)
+{
+    uint32_t a;
+    uint32_t b;
+    const uint32_t * currentWord;
+    uint32_t lanes;
+    const uint32_t * previousWord;
+    uint16_t row;
+    int shift;
+    uint32_t word0;
+    uint32_t word1;
+    uint32_t word2;
+
+    // Build the unaligned words from aligned loads
+    shift = ((uintptr_t)current & 3) * 8;
+    currentWord = (const uint32_t *)((uintptr_t)current & ~3);
+    previousWord = (const uint32_t *)previous;
+    lanes = 0;
+    for (row = 0; row < R4A_OV2640_ODOMETRY_BLOCK; row++)
+    {
+        word0 = currentWord[0];
+        word1 = currentWord[1];
+        if (shift)
+        {
+            word2 = currentWord[2];
+            word0 = (word0 >> shift) | (word1 << (32 - shift));
+            word1 = (word1 >> shift) | (word2 << (32 - shift));
+        }
+
+        // Split the bytes into even and odd lanes, the 64 differences
+        // of the block fit in the 16-bit lanes
+        a = previousWord[0];
+        b = word0;
+        lanes += r4aOv2640OdometrySad16(a & 0x00ff00ff, b & 0x00ff00ff)
+               + r4aOv2640OdometrySad16((a >> 8) & 0x00ff00ff, (b >> 8) & 0x00ff00ff);
+        a = previousWord[1];
+        b = word1;
+        lanes += r4aOv2640OdometrySad16(a & 0x00ff00ff, b & 0x00ff00ff)
+               + r4aOv2640OdometrySad16((a >> 8) & 0x00ff00ff, (b >> 8) & 0x00ff00ff);
+        previousWord = (const uint32_t *)((const uint8_t *)previousWord + stride);
+        currentWord = (const uint32_t *)((const uint8_t *)currentWord + stride);
+    }
+    return (lanes & 0xffff) + (lanes >> 16);
+}
+
+//*********************************************************************
+// Compute the amount of texture in the block
+static uint32_t r4aOv2640OdometryTexture(const uint8_t * block,
+                                         size_t stride)
+{
+    int x;
+    int y;
+    uint32_t texture;
+
+    texture = 0;
+    for (y = 0; y < R4A_OV2640_ODOMETRY_BLOCK; y++)
+        for (x = 0; x < R4A_OV2640_ODOMETRY_BLOCK; x++)
+            texture += abs(block[(y * stride) + x] - block[(y * stride) + x + 1])
+                     + abs(block[(y * stride) + x] - block[((y + 1) * stride) + x]);
+    return texture;
+}
+
+//*********************************************************************
+// Refine the best position using a parabola through the SAD values
+static inline float r4aOv2640OdometrySubpixel(uint32_t before,
+                                              uint32_t best,
+                                              uint32_t after)
+{
+    int32_t denominator;
+
+    denominator = (int32_t)before + (int32_t)after - (2 * (int32_t)best);
+    if (denominator <= 0)
+        return 0;
+    return 0.5 * ((int32_t)before - (int32_t)after) / denominator;
+}
+
+//*********************************************************************
+// Locate the block in the current image
+static bool r4aOv2640OdometryMatch(R4A_OV2640_ODOMETRY * odometry,
+                                   const uint8_t * previous,
+                                   const uint8_t * current,
+                                   R4A_OV2640_ODOMETRY_MATCH * match)
+{
+    uint32_t best;
+    int bestX;
+    int bestY;
+    const uint8_t * block;
+    int dx;
+    int dy;
+    int radius;
+    uint32_t sad[(2 * R4A_OV2640_ODOMETRY_SEARCH_MAX) + 1][(2 * R4A_OV2640_ODOMETRY_SEARCH_MAX) + 1];
+    uint32_t second;
+    size_t stride;
+
+    // Compute the SAD for each position in the search window
+    radius = odometry->_searchRadius;
+    stride = odometry->_stride;
+    block = &previous[(match->_y * stride) + match->_x];
+    best = 0xffffffff;
+    bestX = 0;
+    bestY = 0;
+    for (dy = -radius; dy <= radius; dy++)
+        for (dx = -radius; dx <= radius; dx++)
+        {
+            sad[dy + radius][dx + radius] =
+                r4aOv2640OdometryBlockSad(block,
+                                          &current[((match->_y + dy) * stride) + match->_x + dx],
+                                          stride);
+            if (best > sad[dy + radius][dx + radius])
+            {
+                best = sad[dy + radius][dx + radius];
+                bestX = dx;
+                bestY = dy;
+            }
+        }
+
+    // The motion may be outside of the search window
+    if ((abs(bestX) == radius) || (abs(bestY) == radius))
+        return false;
+
+    // Determine how much better the best match is than the next best
+    // match that is not next to it
+    second = 0xffffffff;
+    for (dy = -radius; dy <= radius; dy++)
+        for (dx = -radius; dx <= radius; dx++)
+            if (((abs(dx - bestX) > 1) || (abs(dy - bestY) > 1))
+                && (second > sad[dy + radius][dx + radius]))
+                second = sad[dy + radius][dx + radius];
+    match->_unique = second ? ((float)(second - best) / (float)second) : 0;
+    if (match->_unique < R4A_OV2640_ODOMETRY_UNIQUE)
+        return false;
+
+    // Refine the motion
+    match->_dx = bestX + r4aOv2640OdometrySubpixel(sad[bestY + radius][bestX + radius - 1],
+                                                   best,
+                                                   sad[bestY + radius][bestX + radius + 1]);
+    match->_dy = bestY + r4aOv2640OdometrySubpixel(sad[bestY + radius - 1][bestX + radius],
+                                                   best,
+                                                   sad[bestY + radius + 1][bestX + radius]);
+    return true;
+}
+
+//*********************************************************************
+// Sort the values, used to find the median
+static void r4aOv2640OdometrySort(float * values,
+                                  int count)
+{
+    int i;
+    int j;
+    float value;
+
+    for (i = 1; i < count; i++)
+    {
+        value = values[i];
+        for (j = i; (j > 0) && (values[j - 1] > value); j--)
+            values[j] = values[j - 1];
+        values[j] = value;
+    }
+}
+
+//*********************************************************************
+// Display the visual odometry results
+void r4aOv2640OdometryDisplay(R4A_OV2640_ODOMETRY * odometry,
+                              Print * display)
+{
+    R4A_OV2640_ODOMETRY_RESULT * result;
+
+    result = &odometry->_result;
+    display->println("OV2640 visual odometry");
+    display->printf("    Image: %d x %d\r\n", odometry->_width, odometry->_height);
+    display->printf("    Frames: %lu\r\n", odometry->_frames);
+    display->printf("    Motion: %.2f, %.2f pixels, %.2f degrees\r\n",
+                    result->_dx, result->_dy, result->_rotationDegrees);
+    display->printf("    Confidence: %.2f, %d blocks\r\n",
+                    result->_confidence, result->_blocks);
+    display->printf("    Total: %.1f, %.1f pixels, %.1f degrees\r\n",
+                    odometry->_totalX, odometry->_totalY, odometry->_totalDegrees);
+    display->printf("    Processing time: %lu uSec\r\n", odometry->_processUsec);
+}
+
+//*********************************************************************
+// Free the visual odometry buffers
+void r4aOv2640OdometryFree(R4A_OV2640_ODOMETRY * odometry)
+{
+    odometry->_valid = false;
+    if (odometry->_buffer)
+        heap_caps_free(odometry->_buffer);
+    odometry->_buffer = nullptr;
+    odometry->_imageSize = 0;
+    r4aOv2640PyramidFree(&odometry->_pyramid);
+}
+
+//*********************************************************************
+// Display the visual odometry results
+void r4aOv2640OdometryMenuDisplay(const struct _R4A_MENU_ENTRY * menuEntry,
+                                  const char * command,
+                                  Print * display)
+{
+    r4aOv2640OdometryDisplay((R4A_OV2640_ODOMETRY *)menuEntry->menuParameter, display);
+}
+
+//*********************************************************************
+// Estimate the image motion since the previous frame
+bool r4aOv2640OdometryUpdate(R4A_OV2640_ODOMETRY * odometry,
+                             camera_fb_t * frameBuffer,
+                             Print * display)
+{
+    uint8_t * buffer;
+    uint16_t blocks;
+    uint32_t blockTexture[R4A_OV2640_ODOMETRY_BLOCKS];
+    float centerX;
+    float centerY;
+    const uint8_t * current;
+    float dx[R4A_OV2640_ODOMETRY_BLOCKS];
+    float dy[R4A_OV2640_ODOMETRY_BLOCKS];
+    R4A_OV2640_VIEW frameView;
+    uint16_t index;
+    uint16_t inliers;
+    R4A_OV2640_VIEW * level;
+    uint16_t margin;
+    R4A_OV2640_ODOMETRY_MATCH match[R4A_OV2640_ODOMETRY_BLOCKS];
+    uint16_t matches;
+    float medianX;
+    float medianY;
+    int position;
+    const uint8_t * previous;
+    float px;
+    float py;
+    float qx;
+    float qy;
+    R4A_OV2640_ODOMETRY_RESULT * result;
+    R4A_OV2640_VIEW roi;
+    uint16_t row;
+    float scale;
+    float sumCross;
+    float sumDot;
+    float sumPx;
+    float sumPy;
+    float sumQx;
+    float sumQy;
+    float sumUnique;
+    size_t size;
+    int64_t startUsec;
+    size_t stride;
+    uint32_t texture;
+    float theta;
+    uint16_t x;
+    uint16_t y;
+
+    startUsec = esp_timer_get_time();
+    result = &odometry->_result;
+    result->_captureUsec = r4aOv2640FrameCaptureUsec(frameBuffer);
+    result->_dx = 0;
+    result->_dy = 0;
+    result->_rotationDegrees = 0;
+    result->_confidence = 0;
+    result->_blocks = 0;
+
+    // Downsample the region of interest
+    if ((!r4aOv2640ViewFrame(&frameView, frameBuffer, display))
+        || (!r4aOv2640ViewRoi(&roi,
+                              &frameView,
+                              odometry->_roiX,
+                              odometry->_roiY,
+                              odometry->_roiWidth ? odometry->_roiWidth : frameView._width,
+                              odometry->_roiHeight ? odometry->_roiHeight : frameView._height))
+        || (!r4aOv2640PyramidBuild(&odometry->_pyramid, &roi, odometry->_levels, display)))
+    {
+        odometry->_valid = false;
+        return false;
+    }
+    level = &odometry->_pyramid._level[odometry->_levels - 1];
+
+    // Allocate the previous and current luminance images
+    stride = (level->_width + 3) & ~3;
+    size = stride * (level->_height + 1);
+    if ((level->_width != odometry->_width) || (level->_height != odometry->_height))
+    {
+        odometry->_valid = false;
+        if (size > odometry->_imageSize)
+        {
+            buffer = (uint8_t *)heap_caps_realloc(odometry->_buffer, 2 * size, MALLOC_CAP_SPIRAM);
+            if (!buffer)
+            {
+                if (display)
+                    display->printf("ERROR: Failed to allocate the %d byte odometry buffer!\r\n",
+                                    2 * size);
+                return false;
+            }
+            memset(buffer, 0, 2 * size);
+            odometry->_buffer = buffer;
+            odometry->_imageSize = size;
+        }
+        odometry->_width = level->_width;
+        odometry->_height = level->_height;
+        odometry->_stride = stride;
+    }
+
+    // Convert the current image to luminance
+    odometry->_current ^= 1;
+    buffer = &odometry->_buffer[odometry->_current * odometry->_imageSize];
+    for (row = 0; row < level->_height; row++)
+    {
+        if (level->_format == PIXFORMAT_GRAYSCALE)
+            memcpy(&buffer[row * stride], &level->_buf[row * level->_stride], level->_width);
+        else
+            r4aOv2640Rgb565ToY8(&level->_buf[row * level->_stride],
+                                &buffer[row * stride],
+                                level->_width);
+    }
+    current = buffer;
+    previous = &odometry->_buffer[(odometry->_current ^ 1) * odometry->_imageSize];
+    if (!odometry->_valid)
+    {
+        odometry->_valid = true;
+        odometry->_processUsec = (uint32_t)(esp_timer_get_time() - startUsec);
+        return false;
+    }
+
+    // Select the most textured blocks away from the image edges, keeping
+    // the blocks on a 32-bit boundary
+    if (odometry->_searchRadius > R4A_OV2640_ODOMETRY_SEARCH_MAX)
+        odometry->_searchRadius = R4A_OV2640_ODOMETRY_SEARCH_MAX;
+    if (odometry->_searchRadius < 2)
+        odometry->_searchRadius = 2;
+    margin = (odometry->_searchRadius + 4) & ~3;
+    blocks = 0;
+    for (y = margin;
+         (y + R4A_OV2640_ODOMETRY_BLOCK + margin) <= level->_height;
+         y += R4A_OV2640_ODOMETRY_BLOCK)
+        for (x = margin;
+             (x + R4A_OV2640_ODOMETRY_BLOCK + margin) <= level->_width;
+             x += R4A_OV2640_ODOMETRY_BLOCK)
+        {
+            texture = r4aOv2640OdometryTexture(&previous[(y * stride) + x], stride);
+            if (texture < odometry->_minimumTexture)
+                continue;
+
+            // Keep the blocks sorted by decreasing texture
+            position = blocks;
+            if (position == R4A_OV2640_ODOMETRY_BLOCKS)
+            {
+                if (texture <= blockTexture[position - 1])
+                    continue;
+                position -= 1;
+            }
+            else
+                blocks += 1;
+            for (; (position > 0) && (blockTexture[position - 1] < texture); position--)
+            {
+                blockTexture[position] = blockTexture[position - 1];
+                match[position] = match[position - 1];
+            }
+            blockTexture[position] = texture;
+            match[position]._x = x;
+            match[position]._y = y;
+        }
+
+    // Locate the blocks in the current image
+    matches = 0;
+    for (index = 0; index < blocks; index++)
+        if (r4aOv2640OdometryMatch(odometry, previous, current, &match[index]))
+            match[matches++] = match[index];
+
+    // Discard the blocks that disagree with the median motion
+    for (index = 0; index < matches; index++)
+    {
+        dx[index] = match[index]._dx;
+        dy[index] = match[index]._dy;
+    }
+    r4aOv2640OdometrySort(dx, matches);
+    r4aOv2640OdometrySort(dy, matches);
+    medianX = matches ? dx[matches >> 1] : 0;
+    medianY = matches ? dy[matches >> 1] : 0;
+    inliers = 0;
+    sumPx = 0;
+    sumPy = 0;
+    sumQx = 0;
+    sumQy = 0;
+    sumUnique = 0;
+    for (index = 0; index < matches; index++)
+    {
+        if ((fabsf(match[index]._dx - medianX) > R4A_OV2640_ODOMETRY_OUTLIER)
+            || (fabsf(match[index]._dy - medianY) > R4A_OV2640_ODOMETRY_OUTLIER))
+            continue;
+        match[inliers++] = match[index];
+        px = match[index]._x + (R4A_OV2640_ODOMETRY_BLOCK / 2);
+        py = match[index]._y + (R4A_OV2640_ODOMETRY_BLOCK / 2);
+        sumPx += px;
+        sumPy += py;
+        sumQx += px + match[index]._dx;
+        sumQy += py + match[index]._dy;
+        sumUnique += match[index]._unique;
+    }
+
+    // Fit the rotation and translation, q = R(p - c) + c + t
+    if (inliers >= 3)
+    {
+        sumPx /= inliers;
+        sumPy /= inliers;
+        sumQx /= inliers;
+        sumQy /= inliers;
+        sumCross = 0;
+        sumDot = 0;
+        for (index = 0; index < inliers; index++)
+        {
+            px = match[index]._x + (R4A_OV2640_ODOMETRY_BLOCK / 2) - sumPx;
+            py = match[index]._y + (R4A_OV2640_ODOMETRY_BLOCK / 2) - sumPy;
+            qx = px + match[index]._dx - (sumQx - sumPx);
+            qy = py + match[index]._dy - (sumQy - sumPy);
+            sumCross += (px * qy) - (py * qx);
+            sumDot += (px * qx) + (py * qy);
+        }
+        theta = atan2f(sumCross, sumDot);
+
+        // Compute the translation of the image center
+        centerX = level->_width * 0.5;
+        centerY = level->_height * 0.5;
+        scale = 1 << odometry->_levels;
+        result->_dx = scale * (sumQx - centerX
+                               - ((cosf(theta) * (sumPx - centerX))
+                                  - (sinf(theta) * (sumPy - centerY))));
+        result->_dy = scale * (sumQy - centerY
+                               - ((sinf(theta) * (sumPx - centerX))
+                                  + (cosf(theta) * (sumPy - centerY))));
+        result->_rotationDegrees = theta * (180. / M_PI);
+        result->_blocks = inliers;
+        result->_confidence = (sumUnique / inliers) * ((float)inliers / (float)blocks);
+
+        // Accumulate the motion
+        odometry->_totalX += result->_dx;
+        odometry->_totalY += result->_dy;
+        odometry->_totalDegrees += result->_rotationDegrees;
+    }
+
+    // Publish the results
+    odometry->_frames += 1;
+    if (odometry->_mailbox)
+        r4aEsp32MailboxPost(odometry->_mailbox, result);
+    odometry->_processUsec = (uint32_t)(esp_timer_get_time() - startUsec);
+    return (result->_blocks != 0);
+}
@@ -0,0 +1,343 @@
+/**********************************************************************
+  OV2640_Recorder.cpp
+
+  Robots-For-All (R4A)
+  OV2640 camera frame recording and replay
+
+  The recording is a sequence of frames, each frame is a
+  R4A_OV2640_RECORD_HEADER followed by the raw or JPEG image data
+  padded to a 32-bit boundary.  The recording is built in PSRAM and
+  may be written to and read from LittleFS.  The replay program in
+  extras/host builds this file on a host computer to feed recorded
+  frames into the vision code.
+**********************************************************************/
+
+#include "R4A_ESP32.h"
+
+//****************************************
+// Constants
+//****************************************
+
+#define R4A_OV2640_RECORD_MAGIC     0x46413452  // "R4AF"
+
+//*********************************************************************
+// Append the JPEG data to the recording
+static size_t r4aOv2640RecorderJpegChunk(void * arg,
+                                         size_t index,
+                                         const void * data,
+                                         size_t len)
+{
+    R4A_OV2640_RECORDER * recorder;
+
+    // Discard the frame when the recording is full, leave room to pad
+    // the frame to a 32-bit boundary
+    recorder = (R4A_OV2640_RECORDER *)arg;
+    if ((recorder->_length
+        + ((sizeof(R4A_OV2640_RECORD_HEADER) + recorder->_jpegLength + len + 3) & ~3))
+        > recorder->_size)
+        return 0;
+
+    // Save the JPEG data after the frame header
+    memcpy(&recorder->_buffer[recorder->_length + sizeof(R4A_OV2640_RECORD_HEADER)
+                              + recorder->_jpegLength],
+           data,
+           len);
+    recorder->_jpegLength += len;
+    return len;
+}
+
+//*********************************************************************
+// Add a frame to the recording
+bool r4aOv2640RecorderAdd(R4A_OV2640_RECORDER * recorder,
+                          camera_fb_t * frameBuffer)
+{
+    size_t frameLength;
+    R4A_OV2640_RECORD_HEADER * header;
+    size_t length;
+    bool success;
+
+    // Claim the buffer before checking the recording flag,
+    // r4aOv2640RecorderStop clears the flag and then waits for the
+    // claim to end
+    __atomic_store_n(&recorder->_adding, true, __ATOMIC_SEQ_CST);
+    success = false;
+    do
+    {
+        if (!__atomic_load_n(&recorder->_recording, __ATOMIC_SEQ_CST))
+            break;
+
+        // Skip the frame when the header does not fit
+        if ((recorder->_length + sizeof(*header)) > recorder->_size)
+        {
+            recorder->_framesSkipped += 1;
+            break;
+        }
+
+        // Zero the reserved bytes
+        header = (R4A_OV2640_RECORD_HEADER *)&recorder->_buffer[recorder->_length];
+        memset(header, 0, sizeof(*header));
+
+        // Copy or compress the image data into the recording
+        if (recorder->_jpegQuality && (frameBuffer->format != PIXFORMAT_JPEG))
+        {
+            recorder->_jpegLength = 0;
+            if (!frame2jpg_cb(frameBuffer,
+                              recorder->_jpegQuality,
+                              r4aOv2640RecorderJpegChunk,
+                              recorder))
+            {
+                recorder->_framesSkipped += 1;
+                break;
+            }
+            length = recorder->_jpegLength;
+            header->_format = PIXFORMAT_JPEG;
+        }
+        else
+        {
+            length = frameBuffer->len;
+            if ((recorder->_length + ((sizeof(*header) + length + 3) & ~3))
+                > recorder->_size)
+            {
+                recorder->_framesSkipped += 1;
+                break;
+            }
+            memcpy(&header[1], frameBuffer->buf, length);
+            header->_format = frameBuffer->format;
+        }
+
+        // Describe the frame
+        header->_magic = R4A_OV2640_RECORD_MAGIC;
+        header->_length = length;
+        header->_captureUsec = r4aOv2640FrameCaptureUsec(frameBuffer);
+        header->_width = frameBuffer->width;
+        header->_height = frameBuffer->height;
+
+        // Zero the padding that keeps the next frame on a 32-bit boundary
+        frameLength = (sizeof(*header) + length + 3) & ~3;
+        memset(&recorder->_buffer[recorder->_length + sizeof(*header) + length],
+               0,
+               frameLength - sizeof(*header) - length);
+        recorder->_length += frameLength;
+        recorder->_frames += 1;
+        success = true;
+    } while (0);
+
+    // Release the buffer
+    __atomic_store_n(&recorder->_adding, false, __ATOMIC_RELEASE);
+    return success;
+}
+
+//*********************************************************************
+// Allocate the recording buffer and start recording
+bool r4aOv2640RecorderBegin(R4A_OV2640_RECORDER * recorder,
+                            size_t size,
+                            uint8_t jpegQuality,
+                            Print * display)
+{
+    uint8_t * buffer;
+
+    // Wait until the camera task is done with the buffer
+    r4aOv2640RecorderStop(recorder);
+
+    // Allocate the buffer in PSRAM
+    if (size > recorder->_size)
+    {
+        buffer = (uint8_t *)heap_caps_realloc(recorder->_buffer, size, MALLOC_CAP_SPIRAM);
+        if (!buffer)
+        {
+            if (display)
+                display->printf("ERROR: Failed to allocate the %d byte recording buffer!\r\n",
+                                size);
+            return false;
+        }
+        recorder->_buffer = buffer;
+        recorder->_size = size;
+    }
+
+    // Start a new recording
+    recorder->_length = 0;
+    recorder->_frames = 0;
+    recorder->_framesSkipped = 0;
+    recorder->_jpegQuality = jpegQuality;
+    __atomic_store_n(&recorder->_recording, true, __ATOMIC_RELEASE);
+    return true;
+}
+
+//*********************************************************************
+// Display the recording status
+void r4aOv2640RecorderDisplay(R4A_OV2640_RECORDER * recorder,
+                              Print * display)
+{
+    display->printf("OV2640 recording: %s\r\n", recorder->_recording ? "Active" : "Stopped");
+    display->printf("    Frames: %lu\r\n", recorder->_frames);
+    display->printf("    Frames skipped: %lu\r\n", recorder->_framesSkipped);
+    display->printf("    Bytes: %d of %d\r\n", recorder->_length, recorder->_size);
+    if (recorder->_jpegQuality)
+        display->printf("    JPEG quality: %d\r\n", recorder->_jpegQuality);
+}
+
+//*********************************************************************
+// Free the recording buffer
+void r4aOv2640RecorderFree(R4A_OV2640_RECORDER * recorder)
+{
+    r4aOv2640RecorderStop(recorder);
+    if (recorder->_buffer)
+        heap_caps_free(recorder->_buffer);
+    recorder->_buffer = nullptr;
+    recorder->_size = 0;
+    recorder->_length = 0;
+}
+
+//*********************************************************************
+// Read a recording from a file
+bool r4aOv2640RecorderLoad(R4A_OV2640_RECORDER * recorder,
+                           const char * path,
+                           Print * display)
+{
+    uint8_t * buffer;
+    File file;
+    size_t length;
+    bool success;
+
+    success = false;
+    do
+    {
+        r4aOv2640RecorderStop(recorder);
+
+        // Open the file
+        file = LittleFS.open(path, FILE_READ);
+        if (!file)
+        {
+            if (display)
+                display->printf("ERROR: Failed to open file %s\r\n", path);
+            break;
+        }
+
+        // Allocate the buffer in PSRAM
+        length = file.size();
+        if (length > recorder->_size)
+        {
+            buffer = (uint8_t *)heap_caps_realloc(recorder->_buffer, length, MALLOC_CAP_SPIRAM);
+            if (!buffer)
+            {
+                if (display)
+                    display->printf("ERROR: Failed to allocate the %d byte recording buffer!\r\n",
+                                    length);
+                break;
+            }
+            recorder->_buffer = buffer;
+            recorder->_size = length;
+        }
+
+        // Read the recording
+        if (file.read(recorder->_buffer, length) != length)
+        {
+            if (display)
+                display->printf("ERROR: Failed to read file %s\r\n", path);
+            break;
+        }
+        recorder->_length = length;
+        recorder->_frames = 0;
+        recorder->_framesSkipped = 0;
+        success = true;
+    } while (0);
+
+    // Close the file
+    if (file)
+        file.close();
+    return success;
+}
+
+//*********************************************************************
+// Write the recording to a file
+bool r4aOv2640RecorderSave(R4A_OV2640_RECORDER * recorder,
+                           const char * path,
+                           Print * display)
+{
+    File file;
+    bool success;
+
+    success = false;
+    do
+    {
+        // Stop the recording
+        r4aOv2640RecorderStop(recorder);
+
+        // Create the file
+        file = LittleFS.open(path, FILE_WRITE);
+        if (!file)
+        {
+            if (display)
+                display->printf("ERROR: Failed to create file %s\r\n", path);
+            break;
+        }
+
+        // Write the recording
+        if (file.write(recorder->_buffer, recorder->_length) != recorder->_length)
+        {
+            if (display)
+                display->printf("ERROR: Failed to write file %s\r\n", path);
+            break;
+        }
+        success = true;
+    } while (0);
+
+    // Close the file
+    if (file)
+        file.close();
+    return success;
+}
+
+//*********************************************************************
+// Stop recording and wait until r4aOv2640RecorderAdd is done with the
+// recording buffer
+void r4aOv2640RecorderStop(R4A_OV2640_RECORDER * recorder)
+{
+    __atomic_store_n(&recorder->_recording, false, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&recorder->_adding, __ATOMIC_SEQ_CST))
+        delay(1);
+}
+
+//*********************************************************************
+// Pass the recorded frames to the frame processing routine
+uint32_t r4aOv2640Replay(const uint8_t * buffer,
+                         size_t length,
+                         R4A_OV2640 * object,
+                         R4A_OV2640_PROCESS_FRAME_BUFFER processFrameBuffer,
+                         Print * display)
+{
+    camera_fb_t frameBuffer;
+    uint32_t frames;
+    R4A_OV2640_RECORD_HEADER header;
+    size_t offset;
+
+    frames = 0;
+    for (offset = 0; (offset + sizeof(header)) <= length; )
+    {
+        // Validate the frame header
+        memcpy(&header, &buffer[offset], sizeof(header));
+        if ((header._magic != R4A_OV2640_RECORD_MAGIC)
+            || ((offset + sizeof(header) + header._length) > length))
+        {
+            if (display)
+                display->printf("ERROR: Invalid frame header at offset %d!\r\n", offset);
+            break;
+        }
+
+        // Describe the frame in the camera driver's format
+        memset(&frameBuffer, 0, sizeof(frameBuffer));
+        frameBuffer.buf = (uint8_t *)&buffer[offset + sizeof(header)];
+        frameBuffer.len = header._length;
+        frameBuffer.width = header._width;
+        frameBuffer.height = header._height;
+        frameBuffer.format = (pixformat_t)header._format;
+        frameBuffer.timestamp.tv_sec = header._captureUsec / (1000 * 1000);
+        frameBuffer.timestamp.tv_usec = header._captureUsec % (1000 * 1000);
+
+        // Process the frame
+        processFrameBuffer(object, &frameBuffer, display);
+        frames += 1;
+        offset += (sizeof(header) + header._length + 3) & ~3;
+    }
+    return frames;
+}
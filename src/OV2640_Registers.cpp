@@ -0,0 +1,341 @@
+/**********************************************************************
+  OV2640_Registers.cpp
+
+  Robots-For-All (R4A)
+  OV2640 camera register shadow cache
+
+  The OV2640 has two banks of 256 registers, register 0xff selects the
+  bank.  A shadow copy of each bank is filled by a bulk read and updated
+  by each write.  Register reads are served from the shadow copy unless
+  the register is marked volatile.  Register lists are written while
+  holding the I2C bus lock once, skipping the registers that already
+  contain the requested value and the bank selects that are not needed.
+  SCCB writes one register per transaction, so each register that
+  changes is still a separate I2C transaction.
+
+  The esp32-camera driver caches the value of the bank select register
+  and only writes it when the bank changes.  To keep the driver's copy
+  correct the bank is always selected through the driver's get_reg
+  routine, register 0xff is never written directly.  The driver's
+  sensor_t routines write the registers without updating the shadow
+  copy, call r4aOv2640RegisterCacheInvalidate after using them.
+**********************************************************************/
+
+#include "R4A_ESP32.h"
+
+//****************************************
+// Constants
+//****************************************
+
+#define R4A_OV2640_BANK_SELECT      0xff    // Bank select register
+#define R4A_OV2640_READ_CHUNK       128     // Wire buffer size
+
+// Registers updated by the sensor, {bank, register}
+static const uint8_t r4aOv2640VolatileRegisters[][2] =
+{
+    {R4A_OV2640_BANK_SENSOR, 0x00}, // GAIN, set by automatic gain control
+    {R4A_OV2640_BANK_SENSOR, 0x04}, // REG04, AEC low bits
+    {R4A_OV2640_BANK_SENSOR, 0x10}, // AEC, set by automatic exposure control
+    {R4A_OV2640_BANK_SENSOR, 0x2f}, // YAVG, average luminance
+    {R4A_OV2640_BANK_SENSOR, 0x45}, // REG45, AEC high bits
+};
+
+//*********************************************************************
+// Determine if the register is marked volatile
+static bool r4aOv2640RegisterIsVolatile(R4A_OV2640 * object,
+                                        uint8_t bank,
+                                        uint8_t reg)
+{
+    return (object->_registerVolatile[bank][reg >> 3] >> (reg & 7)) & 1;
+}
+
+//*********************************************************************
+// Determine if the register value is in the shadow copy
+static bool r4aOv2640RegisterIsValid(R4A_OV2640 * object,
+                                     uint8_t bank,
+                                     uint8_t reg)
+{
+    return (object->_registerValid[bank][reg >> 3] >> (reg & 7)) & 1;
+}
+
+//*********************************************************************
+// Write a register, entered with the I2C bus lock held
+static bool r4aOv2640RegisterWriteWithLock(R4A_OV2640 * object,
+                                           uint8_t reg,
+                                           uint8_t value,
+                                           Print * display)
+{
+    bool success;
+
+    success = object->_i2cBus->_writeWithLock(object->_i2cBus,
+                                              object->_i2cAddress,
+                                              &reg,
+                                              sizeof(reg),
+                                              &value,
+                                              sizeof(value),
+                                              nullptr,
+                                              true);
+    object->_registerTransactions += 1;
+    if ((!success) && display)
+        display->printf("ERROR: Failed to write OV2640 register 0x%02x\r\n", reg);
+    return success;
+}
+
+//*********************************************************************
+// Select the register bank, entered with the I2C bus lock held
+static bool r4aOv2640RegisterBankSelect(R4A_OV2640 * object,
+                                        uint8_t bank,
+                                        Print * display)
+{
+    sensor_t * sensor;
+
+    // Determine if the bank is already selected
+    if (object->_registerBank == bank)
+    {
+        object->_registerTransactionsSaved += 1;
+        return true;
+    }
+
+    // Reading the bank select register through the camera driver writes
+    // the bank select register when the driver's bank is different
+    sensor = esp_camera_sensor_get();
+    if ((!sensor)
+        || (sensor->get_reg(sensor, (bank << 8) | R4A_OV2640_BANK_SELECT, 0xff) < 0))
+    {
+        object->_registerBank = R4A_OV2640_BANK_UNKNOWN;
+        if (display)
+            display->printf("ERROR: Failed to select OV2640 register bank %d\r\n", bank);
+        return false;
+    }
+
+    // Count the bank select write and the read
+    object->_registerTransactions += 2;
+    object->_registerBank = bank;
+    return true;
+}
+
+//*********************************************************************
+// Read a bank of registers into the shadow copy
+bool r4aOv2640RegisterCacheFill(R4A_OV2640 * object,
+                                uint8_t bank,
+                                Print * display)
+{
+    size_t bytesRead;
+    uint16_t reg;
+    uint8_t registerAddress;
+    bool success;
+
+    if (!object->_registerCacheInitialized)
+        r4aOv2640RegisterCacheInvalidate(object);
+
+    // Hold the I2C bus for the bank select and the reads
+    r4aLockAcquire(&object->_i2cBus->_lock);
+    do
+    {
+        // Select the bank
+        success = r4aOv2640RegisterBankSelect(object, bank, display);
+        if (!success)
+            break;
+
+        // Read the registers, the Wire buffer limits the length of each read
+        for (reg = 0; reg < 256; reg += R4A_OV2640_READ_CHUNK)
+        {
+            registerAddress = reg;
+            bytesRead = object->_i2cBus->_read(object->_i2cBus,
+                                               object->_i2cAddress,
+                                               &registerAddress,
+                                               sizeof(registerAddress),
+                                               &object->_registerShadow[bank][reg],
+                                               R4A_OV2640_READ_CHUNK,
+                                               nullptr,
+                                               true);
+            object->_registerTransactions += 1;
+            if (bytesRead != R4A_OV2640_READ_CHUNK)
+            {
+                if (display)
+                    display->printf("ERROR: Failed to read OV2640 registers 0x%02x - 0x%02x\r\n",
+                                    reg, reg + R4A_OV2640_READ_CHUNK - 1);
+                success = false;
+                break;
+            }
+        }
+        if (!success)
+            break;
+
+        // The reads do not change the bank select register
+        object->_registerShadow[bank][R4A_OV2640_BANK_SELECT] = bank;
+        memset(object->_registerValid[bank], 0xff, sizeof(object->_registerValid[bank]));
+    } while (0);
+    r4aLockRelease(&object->_i2cBus->_lock);
+    return success;
+}
+
+//*********************************************************************
+// Discard the shadow copy of the registers
+void r4aOv2640RegisterCacheInvalidate(R4A_OV2640 * object)
+{
+    int index;
+
+    memset(object->_registerValid, 0, sizeof(object->_registerValid));
+
+    // The driver may have changed the bank
+    object->_registerBank = R4A_OV2640_BANK_UNKNOWN;
+
+    // Mark the registers updated by the sensor
+    memset(object->_registerVolatile, 0, sizeof(object->_registerVolatile));
+    for (index = 0; index < (int)(sizeof(r4aOv2640VolatileRegisters)
+                                  / sizeof(r4aOv2640VolatileRegisters[0])); index++)
+        r4aOv2640RegisterVolatile(object,
+                                  r4aOv2640VolatileRegisters[index][0],
+                                  r4aOv2640VolatileRegisters[index][1],
+                                  true);
+    object->_registerCacheInitialized = true;
+}
+
+//*********************************************************************
+// Read a register
+bool r4aOv2640RegisterRead(R4A_OV2640 * object,
+                           uint8_t bank,
+                           uint8_t reg,
+                           uint8_t * value,
+                           Print * display)
+{
+    size_t bytesRead;
+    bool success;
+
+    if (!object->_registerCacheInitialized)
+        r4aOv2640RegisterCacheInvalidate(object);
+
+    // Use the shadow copy when possible
+    if (r4aOv2640RegisterIsValid(object, bank, reg)
+        && (!r4aOv2640RegisterIsVolatile(object, bank, reg)))
+    {
+        *value = object->_registerShadow[bank][reg];
+        object->_registerTransactionsSaved += 2;
+        return true;
+    }
+
+    // Hold the I2C bus for the bank select and the read
+    r4aLockAcquire(&object->_i2cBus->_lock);
+    do
+    {
+        // Select the bank
+        success = r4aOv2640RegisterBankSelect(object, bank, display);
+        if (!success)
+            break;
+
+        // Read the register
+        bytesRead = object->_i2cBus->_read(object->_i2cBus,
+                                           object->_i2cAddress,
+                                           &reg,
+                                           sizeof(reg),
+                                           value,
+                                           sizeof(*value),
+                                           nullptr,
+                                           true);
+        object->_registerTransactions += 1;
+        if (bytesRead != sizeof(*value))
+        {
+            if (display)
+                display->printf("ERROR: Failed to read OV2640 register 0x%02x\r\n", reg);
+            success = false;
+            break;
+        }
+
+        // Update the shadow copy
+        object->_registerShadow[bank][reg] = *value;
+        object->_registerValid[bank][reg >> 3] |= 1 << (reg & 7);
+    } while (0);
+    r4aLockRelease(&object->_i2cBus->_lock);
+    return success;
+}
+
+//*********************************************************************
+// Mark a register as volatile
+void r4aOv2640RegisterVolatile(R4A_OV2640 * object,
+                               uint8_t bank,
+                               uint8_t reg,
+                               bool isVolatile)
+{
+    if (isVolatile)
+        object->_registerVolatile[bank][reg >> 3] |= 1 << (reg & 7);
+    else
+        object->_registerVolatile[bank][reg >> 3] &= ~(1 << (reg & 7));
+}
+
+//*********************************************************************
+// Write a register
+bool r4aOv2640RegisterWrite(R4A_OV2640 * object,
+                            uint8_t bank,
+                            uint8_t reg,
+                            uint8_t value,
+                            Print * display)
+{
+    const uint8_t list[2][2] =
+    {
+        {R4A_OV2640_BANK_SELECT, bank},
+        {reg, value},
+    };
+
+    return r4aOv2640RegisterWriteList(object, list, 2, display);
+}
+
+//*********************************************************************
+// Write a list of registers
+bool r4aOv2640RegisterWriteList(R4A_OV2640 * object,
+                                const uint8_t (*list)[2],
+                                size_t entries,
+                                Print * display)
+{
+    uint8_t bank;
+    size_t index;
+    uint8_t reg;
+    bool success;
+    uint8_t value;
+
+    if (!object->_registerCacheInitialized)
+        r4aOv2640RegisterCacheInvalidate(object);
+
+    // Hold the I2C bus for the entire list
+    bank = R4A_OV2640_BANK_DSP;
+    success = true;
+    r4aLockAcquire(&object->_i2cBus->_lock);
+    for (index = 0; index < entries; index++)
+    {
+        reg = list[index][0];
+        value = list[index][1];
+
+        // Delay selecting the bank until a register is written
+        if (reg == R4A_OV2640_BANK_SELECT)
+        {
+            bank = value & 1;
+            continue;
+        }
+
+        // Skip the write when the register already has the value
+        if (r4aOv2640RegisterIsValid(object, bank, reg)
+            && (!r4aOv2640RegisterIsVolatile(object, bank, reg))
+            && (object->_registerShadow[bank][reg] == value))
+        {
+            object->_registerTransactionsSaved += 1;
+            continue;
+        }
+
+        // Select the bank
+        success = r4aOv2640RegisterBankSelect(object, bank, display);
+        if (!success)
+            break;
+
+        // Write the register and update the shadow copy
+        success = r4aOv2640RegisterWriteWithLock(object, reg, value, display);
+        if (!success)
+        {
+            object->_registerValid[bank][reg >> 3] &= ~(1 << (reg & 7));
+            break;
+        }
+        object->_registerShadow[bank][reg] = value;
+        object->_registerValid[bank][reg >> 3] |= 1 << (reg & 7);
+    }
+    r4aLockRelease(&object->_i2cBus->_lock);
+    return success;
+}
@@ -0,0 +1,333 @@
+/**********************************************************************
+  OV2640_Remap.cpp
+
+  Robots-For-All (R4A)
+  OV2640 camera floor remap
+
+  Converts image points into distances on the floor (inverse
+  perspective) for a pinhole camera at a known height, pitched down by
+  the tilt servo and turned by the pan servo.  For a camera that is
+  only pitched, every pixel in a row sees the floor at the same forward
+  distance and the lateral distance is proportional to the column
+  offset from the image center.  The forward distance and the lateral
+  scale are precomputed for each row, along with a radial table that
+  removes the lens barrel distortion.  The tables are rebuilt only when
+  the frame size or the servo positions change, and are applied to the
+  few feature points found in each frame rather than warping the frame.
+**********************************************************************/
+
+#include "R4A_ESP32.h"
+
+//****************************************
+// Constants
+//****************************************
+
+// Minimum ray depression below the horizon, rows closer to the horizon
+// map to distances too far away to be useful
+#define R4A_OV2640_REMAP_MINIMUM_DOWN   0.01
+
+//*********************************************************************
+// Compute the floor position of an image row
+// Inputs:
+//   remap: Address of a R4A_OV2640_REMAP data structure
+//   y: Undistorted image row
+//   forwardMm: Address of the value to receive the forward distance
+//              of the center column
+//   lateralScale: Address of the value to receive the lateral distance
+//                 per pixel from the center column
+// Outputs:
+//   Returns true if the row sees the floor and false otherwise
+static bool r4aOv2640RemapRow(const R4A_OV2640_REMAP * remap,
+                              float y,
+                              float * forwardMm,
+                              float * lateralScale)
+{
+    float down;
+    float yn;
+
+    // Rotate the ray through the row by the camera pitch
+    yn = (y - remap->_centerY) / remap->_focalPixels;
+    down = (yn * remap->_pitchCos) + remap->_pitchSin;
+    if (down < R4A_OV2640_REMAP_MINIMUM_DOWN)
+    {
+        // The row is at or above the horizon
+        *forwardMm = -1;
+        *lateralScale = 0;
+        return false;
+    }
+
+    // Scale the ray to reach the floor
+    *forwardMm = remap->_cameraHeightMm
+               * (remap->_pitchCos - (yn * remap->_pitchSin)) / down;
+    *lateralScale = remap->_cameraHeightMm / (remap->_focalPixels * down);
+    return true;
+}
+
+//*********************************************************************
+// Display the floor remap tables
+void r4aOv2640RemapDisplay(R4A_OV2640_REMAP * remap,
+                           Print * display)
+{
+    uint16_t row;
+    uint16_t step;
+
+    if (!remap->_valid)
+    {
+        display->println("OV2640 floor remap not built");
+        return;
+    }
+
+    display->println("OV2640 floor remap");
+    display->printf("    Frame: %d x %d\r\n", remap->_width, remap->_height);
+    display->printf("    Pan: %d degrees, Tilt: %d degrees\r\n",
+                    remap->_panDegrees, remap->_tiltDegrees);
+    display->printf("    Horizon row: %.1f\r\n", remap->_horizonRow);
+    display->printf("    Rebuilds: %lu, %lu uSec\r\n",
+                    remap->_rebuilds, remap->_buildUsec);
+
+    // Display a sample of the rows
+    display->println("    Row  Forward mm  mm/pixel");
+    display->println("    ---  ----------  --------");
+    step = (remap->_height + 15) >> 4;
+    for (row = 0; row < remap->_height; row += step)
+    {
+        if (remap->_rowForwardMm[row] < 0)
+            display->printf("    %3d  Above the horizon\r\n", row);
+        else
+            display->printf("    %3d  %10.1f  %8.2f\r\n",
+                            row,
+                            remap->_rowForwardMm[row],
+                            remap->_rowLateralScale[row]);
+    }
+}
+
+//*********************************************************************
+// Free the floor remap tables
+void r4aOv2640RemapFree(R4A_OV2640_REMAP * remap)
+{
+    remap->_valid = false;
+    if (remap->_rowForwardMm)
+        free(remap->_rowForwardMm);
+    remap->_rowForwardMm = nullptr;
+    remap->_rowLateralScale = nullptr;
+    remap->_radialScale = nullptr;
+    remap->_rows = 0;
+    remap->_radialEntries = 0;
+}
+
+//*********************************************************************
+// Convert the line detection results into floor distances
+bool r4aOv2640RemapLine(const R4A_OV2640_REMAP * remap,
+                        const R4A_OV2640_LINE * line,
+                        float * lateralMm,
+                        float * angleDegrees)
+{
+    float denominator;
+    float forwardMm;
+    uint8_t index;
+    float lateral;
+    uint8_t points;
+    float sumF;
+    float sumFF;
+    float sumFL;
+    float sumL;
+
+    *lateralMm = 0;
+    *angleDegrees = 0;
+
+    // Map the line position in each row onto the floor
+    points = 0;
+    sumF = 0;
+    sumFF = 0;
+    sumFL = 0;
+    sumL = 0;
+    for (index = 0; index < line->_rowCount; index++)
+    {
+        if (line->_rowCentroidX[index] < 0)
+            continue;
+        if (!r4aOv2640RemapPoint(remap,
+                                 line->_rowCentroidX[index],
+                                 line->_rows[index],
+                                 &forwardMm,
+                                 &lateral))
+            continue;
+        points += 1;
+        sumF += forwardMm;
+        sumL += lateral;
+        sumFF += forwardMm * forwardMm;
+        sumFL += forwardMm * lateral;
+    }
+    if (!points)
+        return false;
+
+    // Fit lateral = slope * forward + intercept, a line leaning to the
+    // right moves right as the distance increases
+    *lateralMm = sumL / points;
+    denominator = (points * sumFF) - (sumF * sumF);
+    if ((points > 1) && (denominator != 0))
+        *angleDegrees = atanf(((points * sumFL) - (sumF * sumL)) / denominator)
+                      * (180. / M_PI);
+    return true;
+}
+
+//*********************************************************************
+// Display the floor remap tables
+void r4aOv2640RemapMenuDisplay(const struct _R4A_MENU_ENTRY * menuEntry,
+                               const char * command,
+                               Print * display)
+{
+    r4aOv2640RemapDisplay((R4A_OV2640_REMAP *)menuEntry->menuParameter, display);
+}
+
+//*********************************************************************
+// Convert an image point into a floor position
+bool r4aOv2640RemapPoint(const R4A_OV2640_REMAP * remap,
+                         float x,
+                         float y,
+                         float * forwardMm,
+                         float * lateralMm)
+{
+    float dx;
+    float dy;
+    float forward;
+    float fraction;
+    uint16_t index;
+    float lateral;
+    float lateralScale;
+    float radius;
+    float scale;
+
+    if (!remap->_valid)
+        return false;
+
+    // Remove the lens distortion
+    dx = x - remap->_centerX;
+    dy = y - remap->_centerY;
+    if (remap->_radialEntries)
+    {
+        radius = sqrtf((dx * dx) + (dy * dy));
+        index = (uint16_t)radius;
+        if (index >= (remap->_radialEntries - 1))
+            scale = remap->_radialScale[remap->_radialEntries - 1];
+        else
+        {
+            fraction = radius - index;
+            scale = remap->_radialScale[index]
+                  + (fraction * (remap->_radialScale[index + 1] - remap->_radialScale[index]));
+        }
+        dx *= scale;
+        dy *= scale;
+        y = remap->_centerY + dy;
+    }
+
+    // Look up the row, interpolating between the table entries
+    index = (uint16_t)y;
+    if ((y >= 0) && ((index + 1) < remap->_height)
+        && (remap->_rowForwardMm[index] >= 0)
+        && (remap->_rowForwardMm[index + 1] >= 0))
+    {
+        fraction = y - index;
+        forward = remap->_rowForwardMm[index]
+                + (fraction * (remap->_rowForwardMm[index + 1] - remap->_rowForwardMm[index]));
+        lateralScale = remap->_rowLateralScale[index]
+                     + (fraction * (remap->_rowLateralScale[index + 1] - remap->_rowLateralScale[index]));
+    }
+
+    // The undistorted point is outside the table or near the horizon
+    else if (!r4aOv2640RemapRow(remap, y, &forward, &lateralScale))
+        return false;
+    lateral = dx * lateralScale;
+
+    // Rotate by the camera pan into the robot's frame of reference
+    *forwardMm = (forward * remap->_panCos) - (lateral * remap->_panSin);
+    *lateralMm = (forward * remap->_panSin) + (lateral * remap->_panCos);
+    return true;
+}
+
+//*********************************************************************
+// Rebuild the floor remap tables when the frame size or camera pose
+// changes
+bool r4aOv2640RemapUpdate(R4A_OV2640_REMAP * remap,
+                          uint16_t width,
+                          uint16_t height,
+                          uint8_t panDegrees,
+                          uint8_t tiltDegrees,
+                          Print * display)
+{
+    float * buffer;
+    uint16_t entries;
+    uint16_t index;
+    float pan;
+    float pitch;
+    float radius;
+    uint16_t row;
+    int64_t startUsec;
+
+    // Use the existing tables when nothing changed
+    if (remap->_valid
+        && (remap->_width == width) && (remap->_height == height)
+        && (remap->_panDegrees == panDegrees) && (remap->_tiltDegrees == tiltDegrees))
+        return true;
+    startUsec = esp_timer_get_time();
+    remap->_valid = false;
+
+    // Allocate the tables
+    entries = 0;
+    if (remap->_lensK1 != 0)
+        entries = (uint16_t)sqrtf((float)(width * width + height * height) / 4.) + 2;
+    if ((height != remap->_rows) || (entries != remap->_radialEntries))
+    {
+        buffer = (float *)realloc(remap->_rowForwardMm,
+                                  ((2 * height) + entries) * sizeof(float));
+        if (!buffer)
+        {
+            r4aOv2640RemapFree(remap);
+            if (display)
+                display->println("ERROR: Failed to allocate the floor remap tables!");
+            return false;
+        }
+        remap->_rowForwardMm = buffer;
+        remap->_rowLateralScale = &buffer[height];
+        remap->_radialScale = entries ? &buffer[2 * height] : nullptr;
+        remap->_rows = height;
+        remap->_radialEntries = entries;
+    }
+
+    // Describe the camera
+    remap->_width = width;
+    remap->_height = height;
+    remap->_panDegrees = panDegrees;
+    remap->_tiltDegrees = tiltDegrees;
+    remap->_centerX = (width - 1) * 0.5;
+    remap->_centerY = (height - 1) * 0.5;
+    remap->_focalPixels = (width * 0.5) / tanf(remap->_fovDegrees * (M_PI / 360.));
+    pitch = remap->_tiltDirection * ((int)tiltDegrees - (int)remap->_tiltLevelDegrees)
+          * (M_PI / 180.);
+    pan = remap->_panDirection * ((int)panDegrees - (int)remap->_panForwardDegrees)
+        * (M_PI / 180.);
+    remap->_pitchCos = cosf(pitch);
+    remap->_pitchSin = sinf(pitch);
+    remap->_panCos = cosf(pan);
+    remap->_panSin = sinf(pan);
+    remap->_horizonRow = remap->_centerY - (remap->_focalPixels * tanf(pitch));
+
+    // Build the row tables
+    for (row = 0; row < height; row++)
+        r4aOv2640RemapRow(remap,
+                          row,
+                          &remap->_rowForwardMm[row],
+                          &remap->_rowLateralScale[row]);
+
+    // Build the radial table, the distortion is normalized to the half
+    // width of the image
+    for (index = 0; index < entries; index++)
+    {
+        radius = index / (width * 0.5);
+        remap->_radialScale[index] = 1. + (remap->_lensK1 * radius * radius);
+    }
+
+    remap->_valid = true;
+    remap->_rebuilds += 1;
+    remap->_buildUsec = (uint32_t)(esp_timer_get_time() - startUsec);
+    return true;
+}
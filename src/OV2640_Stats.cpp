@@ -0,0 +1,273 @@
+/**********************************************************************
+  OV2640_Stats.cpp
+
+  Robots-For-All (R4A)
+  OV2640 camera pipeline stage timing
+
+  Each stage of the camera pipeline records its duration in a
+  histogram with logarithmic buckets.  Bucket zero holds the times
+  below 16 microseconds, bucket n holds the times from 2^(n+3) up to
+  2^(n+4) microseconds and the last bucket holds all longer times.
+
+  The web server tasks and the camera processing task record times
+  concurrently, so each field is updated with an atomic operation
+  instead of a lock that a higher priority task could spin on.  The
+  count is updated last and read first, so a copy never includes a
+  time that is missing from the minimum and maximum.
+**********************************************************************/
+
+#include "R4A_ESP32.h"
+
+//****************************************
+// Constants
+//****************************************
+
+// Stage names, indexed by R4A_OV2640_STAGE_*
+static const char * const r4aOv2640StageName[R4A_OV2640_STAGE_MAX] =
+{
+    "acquire",
+    "age",
+    "process",
+    "encode",
+    "send",
+};
+
+//*********************************************************************
+// Get the upper bound of the bucket
+static uint32_t r4aOv2640HistogramBucketUsec(uint8_t bucket)
+{
+    return 1 << (bucket + 4);
+}
+
+//*********************************************************************
+// Copy the histogram while the times are being recorded
+static void r4aOv2640HistogramCopy(R4A_OV2640_HISTOGRAM * copy,
+                                   R4A_OV2640_HISTOGRAM * histogram)
+{
+    uint8_t bucket;
+
+    copy->_count = __atomic_load_n(&histogram->_count, __ATOMIC_ACQUIRE);
+    copy->_minimumUsec = __atomic_load_n(&histogram->_minimumUsec, __ATOMIC_RELAXED);
+    copy->_maximumUsec = __atomic_load_n(&histogram->_maximumUsec, __ATOMIC_RELAXED);
+    copy->_totalUsec = __atomic_load_n(&histogram->_totalUsec, __ATOMIC_RELAXED);
+    for (bucket = 0; bucket < R4A_OV2640_HISTOGRAM_BUCKETS; bucket++)
+        copy->_bucket[bucket] = __atomic_load_n(&histogram->_bucket[bucket],
+                                                __ATOMIC_RELAXED);
+}
+
+//*********************************************************************
+// Estimate the percentile from the histogram buckets
+static uint32_t r4aOv2640HistogramPercentile(const R4A_OV2640_HISTOGRAM * histogram,
+                                             uint32_t percent)
+{
+    uint8_t bucket;
+    uint32_t count;
+    uint32_t target;
+    uint32_t usec;
+
+    // Locate the bucket containing the percentile
+    target = (((uint64_t)histogram->_count * percent) + 99) / 100;
+    count = 0;
+    for (bucket = 0; bucket < R4A_OV2640_HISTOGRAM_BUCKETS; bucket++)
+    {
+        count += histogram->_bucket[bucket];
+        if (count >= target)
+            break;
+    }
+
+    // Limit the estimate to the measured range
+    usec = r4aOv2640HistogramBucketUsec(bucket);
+    if (usec > histogram->_maximumUsec)
+        usec = histogram->_maximumUsec;
+    if (usec < histogram->_minimumUsec)
+        usec = histogram->_minimumUsec;
+    return usec;
+}
+
+//*********************************************************************
+// Display the pipeline stage timing
+void r4aOv2640DisplayStageStats(R4A_OV2640 * object,
+                                Print * display)
+{
+    R4A_OV2640_HISTOGRAM histogram;
+    uint8_t stage;
+
+    display->printf("OV2640 pipeline: %lu frames, %lu dropped\r\n",
+                    object->_frameNumber, object->_framesDropped);
+    display->println("    Stage       Count    Min uSec    Avg uSec    P50 uSec    P90 uSec    P99 uSec    Max uSec");
+    display->println("    -------  --------  ----------  ----------  ----------  ----------  ----------  ----------");
+    for (stage = 0; stage < R4A_OV2640_STAGE_MAX; stage++)
+    {
+        // Get a copy of the histogram
+        r4aOv2640HistogramCopy(&histogram, &object->_stageHistogram[stage]);
+        if (!histogram._count)
+        {
+            display->printf("    %-7s  %8lu\r\n", r4aOv2640StageName[stage], 0UL);
+            continue;
+        }
+        display->printf("    %-7s  %8lu  %10lu  %10lu  %10lu  %10lu  %10lu  %10lu\r\n",
+                        r4aOv2640StageName[stage],
+                        histogram._count,
+                        histogram._minimumUsec,
+                        (uint32_t)(histogram._totalUsec / histogram._count),
+                        r4aOv2640HistogramPercentile(&histogram, 50),
+                        r4aOv2640HistogramPercentile(&histogram, 90),
+                        r4aOv2640HistogramPercentile(&histogram, 99),
+                        histogram._maximumUsec);
+    }
+}
+
+//*********************************************************************
+// Display the pipeline stage timing
+void r4aOv2640MenuDisplayStageStats(const struct _R4A_MENU_ENTRY * menuEntry,
+                                    const char * command,
+                                    Print * display)
+{
+    r4aOv2640DisplayStageStats((R4A_OV2640 *)menuEntry->menuParameter, display);
+}
+
+//*********************************************************************
+// Clear the pipeline stage timing
+void r4aOv2640MenuStageStatsReset(const struct _R4A_MENU_ENTRY * menuEntry,
+                                  const char * command,
+                                  Print * display)
+{
+    r4aOv2640StageStatsReset((R4A_OV2640 *)menuEntry->menuParameter);
+}
+
+//*********************************************************************
+// Record the duration of a pipeline stage
+void r4aOv2640StageAdd(R4A_OV2640 * object,
+                       uint8_t stage,
+                       uint32_t usec)
+{
+    int bucket;
+    R4A_OV2640_HISTOGRAM * histogram;
+    uint32_t maximum;
+    uint32_t minimum;
+
+    // Determine the bucket
+    bucket = 0;
+    if (usec >= 16)
+    {
+        bucket = 31 - __builtin_clz(usec) - 3;
+        if (bucket >= R4A_OV2640_HISTOGRAM_BUCKETS)
+            bucket = R4A_OV2640_HISTOGRAM_BUCKETS - 1;
+    }
+
+    // Update the limits, the web server and the processing task may
+    // record times at the same time
+    histogram = &object->_stageHistogram[stage];
+    minimum = __atomic_load_n(&histogram->_minimumUsec, __ATOMIC_RELAXED);
+    while ((minimum > usec)
+           && (!__atomic_compare_exchange_n(&histogram->_minimumUsec,
+                                            &minimum,
+                                            usec,
+                                            false,
+                                            __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED)));
+    maximum = __atomic_load_n(&histogram->_maximumUsec, __ATOMIC_RELAXED);
+    while ((maximum < usec)
+           && (!__atomic_compare_exchange_n(&histogram->_maximumUsec,
+                                            &maximum,
+                                            usec,
+                                            false,
+                                            __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED)));
+
+    // Update the histogram, count the time last
+    __atomic_add_fetch(&histogram->_totalUsec, usec, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&histogram->_bucket[bucket], 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&histogram->_count, 1, __ATOMIC_RELEASE);
+}
+
+//*********************************************************************
+// Return the pipeline stage timing as a JSON document
+esp_err_t r4aOv2640StageStatsHandler(httpd_req_t *request)
+{
+    uint8_t bucket;
+    char buffer[384];
+    R4A_OV2640_HISTOGRAM histogram;
+    int length;
+    R4A_OV2640 * object;
+    uint8_t stage;
+    esp_err_t status;
+
+    // Get the OV2640 data structure address
+    object = (R4A_OV2640 *)request->user_ctx;
+
+    do
+    {
+        httpd_resp_set_type(request, "application/json");
+        httpd_resp_set_hdr(request, "Access-Control-Allow-Origin", "*");
+        httpd_resp_set_hdr(request, "Cache-Control", "no-store");
+
+        // Send the frame counts and bucket limits
+        length = snprintf(buffer, sizeof(buffer),
+                          "{\"frames\":%lu,\"dropped\":%lu,\"fpsX100\":%lu,"
+                          "\"queueDepth\":%lu,\"bucketUsec\":[",
+                          object->_frameNumber,
+                          object->_framesDropped,
+                          object->_framesPerSecondX100,
+                          object->_queueDepth);
+        for (bucket = 0; bucket < R4A_OV2640_HISTOGRAM_BUCKETS; bucket++)
+            length += snprintf(&buffer[length], sizeof(buffer) - length, "%s%lu",
+                               bucket ? "," : "",
+                               r4aOv2640HistogramBucketUsec(bucket));
+        snprintf(&buffer[length], sizeof(buffer) - length, "],\"stages\":{");
+        status = httpd_resp_sendstr_chunk(request, buffer);
+        if (status != ESP_OK)
+            break;
+
+        // Send each of the stages
+        for (stage = 0; stage < R4A_OV2640_STAGE_MAX; stage++)
+        {
+            r4aOv2640HistogramCopy(&histogram, &object->_stageHistogram[stage]);
+            length = snprintf(buffer, sizeof(buffer),
+                              "%s\"%s\":{\"count\":%lu,\"minUsec\":%lu,\"avgUsec\":%lu,"
+                              "\"p50Usec\":%lu,\"p90Usec\":%lu,\"p99Usec\":%lu,"
+                              "\"maxUsec\":%lu,\"buckets\":[",
+                              stage ? "," : "",
+                              r4aOv2640StageName[stage],
+                              histogram._count,
+                              histogram._count ? histogram._minimumUsec : 0,
+                              histogram._count
+                                  ? (uint32_t)(histogram._totalUsec / histogram._count) : 0,
+                              histogram._count ? r4aOv2640HistogramPercentile(&histogram, 50) : 0,
+                              histogram._count ? r4aOv2640HistogramPercentile(&histogram, 90) : 0,
+                              histogram._count ? r4aOv2640HistogramPercentile(&histogram, 99) : 0,
+                              histogram._maximumUsec);
+            for (bucket = 0; bucket < R4A_OV2640_HISTOGRAM_BUCKETS; bucket++)
+                length += snprintf(&buffer[length], sizeof(buffer) - length, "%s%lu",
+                                   bucket ? "," : "",
+                                   histogram._bucket[bucket]);
+            snprintf(&buffer[length], sizeof(buffer) - length, "]}");
+            status = httpd_resp_sendstr_chunk(request, buffer);
+            if (status != ESP_OK)
+                break;
+        }
+        if (status != ESP_OK)
+            break;
+
+        // Finish the document
+        status = httpd_resp_sendstr_chunk(request, "}}");
+        if (status != ESP_OK)
+            break;
+        status = httpd_resp_sendstr_chunk(request, nullptr);
+    } while (0);
+    return status;
+}
+
+//*********************************************************************
+// Clear the pipeline stage timing
+void r4aOv2640StageStatsReset(R4A_OV2640 * object)
+{
+    uint8_t stage;
+
+    // The first time recorded becomes the minimum
+    memset(object->_stageHistogram, 0, sizeof(object->_stageHistogram));
+    for (stage = 0; stage < R4A_OV2640_STAGE_MAX; stage++)
+        __atomic_store_n(&object->_stageHistogram[stage]._minimumUsec,
+                         0xffffffff,
+                         __ATOMIC_RELAXED);
+}
@@ -0,0 +1,294 @@
+/**********************************************************************
+  OV2640_View.cpp
+
+  Robots-For-All (R4A)
+  OV2640 camera frame views and image pyramid
+
+  A view describes a rectangle of pixels within a frame buffer without
+  copying them.  The stride is the number of bytes between the start of
+  adjacent rows so a view of a region of interest (ROI) shares the
+  frame buffer's pixels.  The pyramid holds 1/2 and 1/4 scale copies
+  of a view, each output pixel is the average of a 2 x 2 block of input
+  pixels.
+**********************************************************************/
+
+#include "R4A_ESP32.h"
+
+//*********************************************************************
+// Downsample two rows of grayscale pixels
+// Inputs:
+//   row0: Address of the first pixel in the upper row
+//   row1: Address of the first pixel in the lower row
+//   dst: Address of the buffer to receive the output pixels
+//   dstWidth: Number of output pixels
+static void r4aOv2640ViewRowGray(const uint8_t * row0,
+                                 const uint8_t * row1,
+                                 uint8_t * dst,
+                                 uint16_t dstWidth)
+{
+    uint32_t lower;
+    uint32_t pixels;
+    uint32_t sum;
+    uint32_t upper;
+    const uint32_t * word0;
+    const uint32_t * word1;
+    uint32_t * dstWord;
+    uint16_t x;
+
+    x = 0;
+    if (!(((uintptr_t)row0 | (uintptr_t)row1 | (uintptr_t)dst) & 3))
+    {
+        // Sum the pixel pairs within 16-bit lanes, each word of input
+        // produces two output pixels
+        word0 = (const uint32_t *)row0;
+        word1 = (const uint32_t *)row1;
+        dstWord = (uint32_t *)dst;
+        for (; (x + 4) <= dstWidth; x += 4)
+        {
+            // Output pixels 0 and 1
+            upper = *word0++;
+            lower = *word1++;
+            sum = (upper & 0x00ff00ff) + ((upper >> 8) & 0x00ff00ff)
+                + (lower & 0x00ff00ff) + ((lower >> 8) & 0x00ff00ff)
+                + 0x00020002;
+            pixels = ((sum >> 2) & 0xff) | ((sum >> 10) & 0xff00);
+
+            // Output pixels 2 and 3
+            upper = *word0++;
+            lower = *word1++;
+            sum = (upper & 0x00ff00ff) + ((upper >> 8) & 0x00ff00ff)
+                + (lower & 0x00ff00ff) + ((lower >> 8) & 0x00ff00ff)
+                + 0x00020002;
+            pixels |= ((sum << 14) & 0xff0000) | ((sum << 6) & 0xff000000);
+            *dstWord++ = pixels;
+        }
+    }
+
+    // Downsample the remaining pixels
+    for (; x < dstWidth; x++)
+        dst[x] = (row0[x * 2] + row0[x * 2 + 1]
+                  + row1[x * 2] + row1[x * 2 + 1] + 2) >> 2;
+}
+
+//*********************************************************************
+// Downsample two rows of RGB565 pixels
+// Inputs:
+//   row0: Address of the first pixel in the upper row
+//   row1: Address of the first pixel in the lower row
+//   dst: Address of the buffer to receive the output pixels
+//   dstWidth: Number of output pixels
+static void r4aOv2640ViewRowRgb565(const uint8_t * row0,
+                                   const uint8_t * row1,
+                                   uint8_t * dst,
+                                   uint16_t dstWidth)
+{
+    uint32_t pixel;
+    uint32_t sum;
+    uint16_t x;
+
+    // The camera sends the high byte (RRRRRGGG) first followed by the
+    // low byte (GGGBBBBB).  Spreading the pixel across a word as
+    // 00000GGG GGG00000 RRRRR000 000BBBBB leaves room between the
+    // components to add four pixels at once.
+#define R4A_OV2640_SPREAD(src)  \
+    ((((src)[0] << 8) | (src)[1] | ((((src)[0] << 8) | (src)[1]) << 16)) & 0x07e0f81f)
+
+    for (x = 0; x < dstWidth; x++)
+    {
+        sum = R4A_OV2640_SPREAD(&row0[x * 4])
+            + R4A_OV2640_SPREAD(&row0[x * 4 + 2])
+            + R4A_OV2640_SPREAD(&row1[x * 4])
+            + R4A_OV2640_SPREAD(&row1[x * 4 + 2])
+            + 0x00401002;
+        sum = (sum >> 2) & 0x07e0f81f;
+        pixel = (sum & 0xffff) | (sum >> 16);
+        dst[x * 2] = pixel >> 8;
+        dst[x * 2 + 1] = pixel;
+    }
+
+#undef  R4A_OV2640_SPREAD
+}
+
+//*********************************************************************
+// Downsample the view by two in each direction
+bool r4aOv2640ViewDownsample2x(const R4A_OV2640_VIEW * src,
+                               R4A_OV2640_VIEW * dst,
+                               Print * display)
+{
+    uint16_t row;
+
+    // Validate the pixel format
+    if ((src->_format != PIXFORMAT_GRAYSCALE) && (src->_format != PIXFORMAT_RGB565))
+    {
+        if (display)
+            display->printf("ERROR: Unsupported pixel format %d for downsampling!\r\n",
+                            src->_format);
+        return false;
+    }
+
+    // Describe the output image
+    dst->_width = src->_width >> 1;
+    dst->_height = src->_height >> 1;
+    dst->_format = src->_format;
+    dst->_bytesPerPixel = src->_bytesPerPixel;
+
+    // Average each 2 x 2 block of pixels
+    for (row = 0; row < dst->_height; row++)
+    {
+        if (src->_format == PIXFORMAT_GRAYSCALE)
+            r4aOv2640ViewRowGray(&src->_buf[(row * 2) * src->_stride],
+                                 &src->_buf[(row * 2 + 1) * src->_stride],
+                                 &dst->_buf[row * dst->_stride],
+                                 dst->_width);
+        else
+            r4aOv2640ViewRowRgb565(&src->_buf[(row * 2) * src->_stride],
+                                   &src->_buf[(row * 2 + 1) * src->_stride],
+                                   &dst->_buf[row * dst->_stride],
+                                   dst->_width);
+    }
+    return true;
+}
+
+//*********************************************************************
+// Describe the frame buffer with a view
+bool r4aOv2640ViewFrame(R4A_OV2640_VIEW * view,
+                        camera_fb_t * frameBuffer,
+                        Print * display)
+{
+    uint8_t bytesPerPixel;
+
+    // Determine the pixel size
+    if (frameBuffer->format == PIXFORMAT_GRAYSCALE)
+        bytesPerPixel = 1;
+    else if ((frameBuffer->format == PIXFORMAT_RGB565)
+        || (frameBuffer->format == PIXFORMAT_YUV422))
+        bytesPerPixel = 2;
+    else
+    {
+        if (display)
+            display->printf("ERROR: Unsupported pixel format %d for a view!\r\n",
+                            frameBuffer->format);
+        return false;
+    }
+
+    // Describe the entire frame
+    view->_buf = frameBuffer->buf;
+    view->_width = frameBuffer->width;
+    view->_height = frameBuffer->height;
+    view->_stride = frameBuffer->width * bytesPerPixel;
+    view->_format = frameBuffer->format;
+    view->_bytesPerPixel = bytesPerPixel;
+    return true;
+}
+
+//*********************************************************************
+// Describe a region of interest within another view
+bool r4aOv2640ViewRoi(R4A_OV2640_VIEW * view,
+                      const R4A_OV2640_VIEW * parent,
+                      uint16_t x,
+                      uint16_t y,
+                      uint16_t width,
+                      uint16_t height)
+{
+    // Clip the region to the parent view
+    if ((x >= parent->_width) || (y >= parent->_height))
+        return false;
+    if (width > (parent->_width - x))
+        width = parent->_width - x;
+    if (height > (parent->_height - y))
+        height = parent->_height - y;
+    if ((!width) || (!height))
+        return false;
+
+    // Share the parent's pixels
+    view->_buf = &parent->_buf[(y * parent->_stride) + (x * parent->_bytesPerPixel)];
+    view->_width = width;
+    view->_height = height;
+    view->_stride = parent->_stride;
+    view->_format = parent->_format;
+    view->_bytesPerPixel = parent->_bytesPerPixel;
+    return true;
+}
+
+//*********************************************************************
+// Build the image pyramid
+bool r4aOv2640PyramidBuild(R4A_OV2640_PYRAMID * pyramid,
+                           const R4A_OV2640_VIEW * view,
+                           uint8_t levels,
+                           Print * display)
+{
+    uint8_t * buffer;
+    uint16_t height;
+    uint8_t index;
+    size_t offset;
+    size_t size;
+    int64_t startUsec;
+    size_t stride[R4A_OV2640_PYRAMID_LEVELS];
+    uint16_t width;
+
+    startUsec = esp_timer_get_time();
+    if ((levels < 1) || (levels > R4A_OV2640_PYRAMID_LEVELS))
+    {
+        if (display)
+            display->printf("ERROR: levels must be in the range 1 - %d!\r\n",
+                            R4A_OV2640_PYRAMID_LEVELS);
+        return false;
+    }
+
+    // Determine the buffer size, start each row on a 32-bit boundary
+    size = 0;
+    width = view->_width;
+    height = view->_height;
+    for (index = 0; index < levels; index++)
+    {
+        width >>= 1;
+        height >>= 1;
+        stride[index] = ((width * view->_bytesPerPixel) + 3) & ~3;
+        size += stride[index] * height;
+    }
+
+    // Reuse the buffer when possible
+    if (size > pyramid->_size)
+    {
+        buffer = (uint8_t *)heap_caps_realloc(pyramid->_buffer, size, MALLOC_CAP_SPIRAM);
+        if (!buffer)
+        {
+            if (display)
+                display->printf("ERROR: Failed to allocate the %d byte pyramid buffer!\r\n",
+                                size);
+            return false;
+        }
+        pyramid->_buffer = buffer;
+        pyramid->_size = size;
+    }
+
+    // Build each level from the previous level
+    offset = 0;
+    height = view->_height;
+    pyramid->_levels = 0;
+    for (index = 0; index < levels; index++)
+    {
+        height >>= 1;
+        pyramid->_level[index]._buf = &pyramid->_buffer[offset];
+        pyramid->_level[index]._stride = stride[index];
+        if (!r4aOv2640ViewDownsample2x(index ? &pyramid->_level[index - 1] : view,
+                                       &pyramid->_level[index],
+                                       display))
+            return false;
+        offset += stride[index] * height;
+        pyramid->_levels = index + 1;
+    }
+    pyramid->_buildUsec = (uint32_t)(esp_timer_get_time() - startUsec);
+    return true;
+}
+
+//*********************************************************************
+// Free the image pyramid buffer
+void r4aOv2640PyramidFree(R4A_OV2640_PYRAMID * pyramid)
+{
+    if (pyramid->_buffer)
+        heap_caps_free(pyramid->_buffer);
+    pyramid->_buffer = nullptr;
+    pyramid->_size = 0;
+    pyramid->_levels = 0;
+}
@@ -0,0 +1,442 @@
+/**********************************************************************
+  OV2640_WebSocket.cpp
+
+  Robots-For-All (R4A)
+  OV2640 camera WebSocket channel for the vision results
+
+  The browsers open a WebSocket to subscribe to the results.  After
+  each processed frame the line, blob and thumbnail results are
+  serialized once into a compact binary message and a single work item
+  is queued to the web server task which sends the message to each of
+  the subscribers.  While the message is being sent the following
+  frames are dropped rather than queued, the browsers only want the
+  most recent results.
+
+  The subscriber list is only changed by the web server task, in the
+  handler and in the queued work, so it needs no lock.  The camera task
+  only reads the server handle and the subscriber count with atomic
+  loads to decide whether to build a message.
+
+  Message format, little endian:
+
+    Header, 24 bytes
+         0  uint8_t   Version, R4A_OV2640_WEB_SOCKET_VERSION
+         1  uint8_t   Number of line rows that follow
+         2  uint8_t   Number of blobs that follow
+         3  uint8_t   Number of rows containing the line
+         4  uint32_t  Sequence number
+         8  uint16_t  Frame width in pixels
+        10  uint16_t  Frame height in pixels
+        12  uint8_t   Thumbnail width in pixels
+        13  uint8_t   Thumbnail height in pixels
+        14  uint16_t  Reserved, zero
+        16  float     Line centroid in pixels, -1 if not found
+        20  float     Line angle in degrees, positive leans right
+
+    Line rows, 4 bytes each
+         0  uint16_t  Row
+         2  int16_t   Line position in pixels, -1 if not found
+
+    Blobs, 16 bytes each, largest first
+         0  uint32_t  Area in pixels
+         4  uint16_t  Bounding box left, top, right and bottom
+        12  uint16_t  Centroid column and row in 1/8 pixels
+
+    Thumbnail, width * height luminance pixels
+**********************************************************************/
+
+#include "R4A_ESP32.h"
+
+//****************************************
+// Constants
+//****************************************
+
+#define R4A_OV2640_WEB_SOCKET_HEADER    24
+#define R4A_OV2640_WEB_SOCKET_ROW       4
+#define R4A_OV2640_WEB_SOCKET_BLOB      16
+#define R4A_OV2640_WEB_SOCKET_RECEIVE   64  // Largest browser message
+
+#define R4A_OV2640_WEB_SOCKET_MESSAGE   (R4A_OV2640_WEB_SOCKET_HEADER           \
+    + (R4A_OV2640_LINE_MAX_ROWS * R4A_OV2640_WEB_SOCKET_ROW)                    \
+    + (R4A_OV2640_BLOB_MAX * R4A_OV2640_WEB_SOCKET_BLOB)                        \
+    + (R4A_OV2640_WEB_SOCKET_THUMB_WIDTH * R4A_OV2640_WEB_SOCKET_THUMB_HEIGHT))
+
+//*********************************************************************
+// Write a 16-bit value into the message
+static inline uint8_t * r4aOv2640WebSocketPut16(uint8_t * data, uint16_t value)
+{
+    *data++ = value;
+    *data++ = value >> 8;
+    return data;
+}
+
+//*********************************************************************
+// Write a 32-bit value into the message
+static inline uint8_t * r4aOv2640WebSocketPut32(uint8_t * data, uint32_t value)
+{
+    data = r4aOv2640WebSocketPut16(data, value);
+    return r4aOv2640WebSocketPut16(data, value >> 16);
+}
+
+//*********************************************************************
+// Write a float value into the message
+static inline uint8_t * r4aOv2640WebSocketPutFloat(uint8_t * data, float value)
+{
+    uint32_t bits;
+
+    memcpy(&bits, &value, sizeof(bits));
+    return r4aOv2640WebSocketPut32(data, bits);
+}
+
+//*********************************************************************
+// Remove a subscriber, runs in the web server task
+static void r4aOv2640WebSocketRemove(R4A_OV2640_WEB_SOCKET * webSocket,
+                                     int fd)
+{
+    uint8_t clients;
+    uint8_t index;
+
+    clients = webSocket->_clientCount;
+    for (index = 0; index < clients; index++)
+        if (webSocket->_clientFd[index] == fd)
+        {
+            clients -= 1;
+            webSocket->_clientFd[index] = webSocket->_clientFd[clients];
+            __atomic_store_n(&webSocket->_clientCount, clients, __ATOMIC_RELAXED);
+            break;
+        }
+}
+
+//*********************************************************************
+// Send the message to each of the subscribers, runs in the web server
+// task
+static void r4aOv2640WebSocketSend(void * arg)
+{
+    int clientFd[R4A_OV2640_WEB_SOCKET_CLIENTS];
+    uint8_t clients;
+    httpd_ws_frame_t frame;
+    uint8_t index;
+    httpd_handle_t server;
+    R4A_OV2640_WEB_SOCKET * webSocket;
+
+    webSocket = (R4A_OV2640_WEB_SOCKET *)arg;
+
+    // Copy the subscriber list, the subscribers are removed while
+    // walking the list
+    server = webSocket->_server;
+    clients = webSocket->_clientCount;
+    memcpy(clientFd, webSocket->_clientFd, clients * sizeof(clientFd[0]));
+
+    // Describe the message
+    memset(&frame, 0, sizeof(frame));
+    frame.final = true;
+    frame.type = HTTPD_WS_TYPE_BINARY;
+    frame.payload = webSocket->_message;
+    frame.len = webSocket->_messageLength;
+
+    // Send the same message to each of the subscribers
+    for (index = 0; index < clients; index++)
+    {
+        // Drop the subscribers that closed their WebSocket
+        if (httpd_ws_get_fd_info(server, clientFd[index]) != HTTPD_WS_CLIENT_WEBSOCKET)
+            r4aOv2640WebSocketRemove(webSocket, clientFd[index]);
+
+        // Drop the subscribers that are not accepting data
+        else if (httpd_ws_send_frame_async(server, clientFd[index], &frame) != ESP_OK)
+        {
+            webSocket->_sendErrors += 1;
+            r4aOv2640WebSocketRemove(webSocket, clientFd[index]);
+        }
+    }
+
+    // Allow the next message to be built
+    __atomic_store_n(&webSocket->_sending, false, __ATOMIC_RELEASE);
+}
+
+//*********************************************************************
+// Build the luminance thumbnail
+static uint8_t * r4aOv2640WebSocketThumbnail(camera_fb_t * frameBuffer,
+                                             uint8_t * data,
+                                             uint8_t width,
+                                             uint8_t height)
+{
+    uint16_t column[R4A_OV2640_WEB_SOCKET_THUMB_WIDTH];
+    const uint16_t * pixels;
+    uint32_t rgb565[R4A_OV2640_WEB_SOCKET_THUMB_WIDTH / 2];
+    const uint8_t * row;
+    uint8_t x;
+    uint8_t y;
+    uint32_t y8[R4A_OV2640_WEB_SOCKET_THUMB_WIDTH / 4];
+
+    // Sample the center of each thumbnail pixel
+    for (x = 0; x < width; x++)
+        column[x] = ((((2 * x) + 1) * frameBuffer->width) / (2 * width));
+
+    for (y = 0; y < height; y++)
+    {
+        row = &frameBuffer->buf[((((2 * y) + 1) * frameBuffer->height) / (2 * height))
+                                * frameBuffer->width
+                                * ((frameBuffer->format == PIXFORMAT_RGB565) ? 2 : 1)];
+        if (frameBuffer->format == PIXFORMAT_GRAYSCALE)
+        {
+            for (x = 0; x < width; x++)
+                *data++ = row[column[x]];
+        }
+        else
+        {
+            // Gather the RGB565 pixels and convert them together
+            pixels = (const uint16_t *)row;
+            for (x = 0; x < width; x++)
+                ((uint16_t *)rgb565)[x] = pixels[column[x]];
+            r4aOv2640Rgb565ToY8((uint8_t *)rgb565, (uint8_t *)y8, width);
+            memcpy(data, y8, width);
+            data += width;
+        }
+    }
+    return data;
+}
+
+//*********************************************************************
+// Display the WebSocket channel status
+void r4aOv2640WebSocketDisplay(R4A_OV2640_WEB_SOCKET * webSocket,
+                               Print * display)
+{
+    uint8_t index;
+
+    display->println("OV2640 WebSocket");
+    display->printf("    Subscribers: %d\r\n", webSocket->_clientCount);
+    for (index = 0; index < webSocket->_clientCount; index++)
+        display->printf("        Socket %d\r\n", webSocket->_clientFd[index]);
+    display->printf("    Messages: %lu, %d bytes, %lu uSec\r\n",
+                    webSocket->_sequence,
+                    webSocket->_messageLength,
+                    webSocket->_serializeUsec);
+    display->printf("    Frames dropped: %lu\r\n", webSocket->_framesDropped);
+    display->printf("    Send errors: %lu\r\n", webSocket->_sendErrors);
+}
+
+//*********************************************************************
+// Free the WebSocket message buffer
+void r4aOv2640WebSocketFree(R4A_OV2640_WEB_SOCKET * webSocket)
+{
+    // Don't free the buffer while it is being sent
+    if (__atomic_load_n(&webSocket->_sending, __ATOMIC_ACQUIRE))
+        return;
+    if (webSocket->_message)
+        free(webSocket->_message);
+    webSocket->_message = nullptr;
+    webSocket->_messageLength = 0;
+}
+
+//*********************************************************************
+// Subscribe a browser to the vision results
+esp_err_t r4aOv2640WebSocketHandler(httpd_req_t *request)
+{
+    uint8_t buffer[R4A_OV2640_WEB_SOCKET_RECEIVE];
+    int fd;
+    httpd_ws_frame_t frame;
+    uint8_t index;
+    esp_err_t status;
+    R4A_OV2640_WEB_SOCKET * webSocket;
+
+    // Get the WebSocket data structure address
+    webSocket = (R4A_OV2640_WEB_SOCKET *)request->user_ctx;
+
+    // The handshake is complete, add the subscriber
+    if (request->method == HTTP_GET)
+    {
+        // Only add the WebSocket connections, a plain HTTP request would
+        // receive the binary frames
+        fd = httpd_req_to_sockfd(request);
+        if (httpd_ws_get_fd_info(request->handle, fd) != HTTPD_WS_CLIENT_WEBSOCKET)
+        {
+            httpd_resp_send_err(request, HTTPD_400_BAD_REQUEST, "WebSocket upgrade required");
+            return ESP_FAIL;
+        }
+
+        // Forget the subscribers of a previous server, clear the count
+        // before the camera task sees the new server
+        if (webSocket->_server != request->handle)
+        {
+            __atomic_store_n(&webSocket->_clientCount, 0, __ATOMIC_RELAXED);
+            __atomic_store_n(&webSocket->_server, request->handle, __ATOMIC_RELEASE);
+        }
+
+        // Don't add the subscriber twice
+        for (index = 0; index < webSocket->_clientCount; index++)
+            if (webSocket->_clientFd[index] == fd)
+                break;
+        if (index >= webSocket->_clientCount)
+        {
+            if (webSocket->_clientCount >= R4A_OV2640_WEB_SOCKET_CLIENTS)
+            {
+                if (r4aWebServerDebug)
+                    r4aWebServerDebug->printf("ERROR: Too many WebSocket subscribers!\r\n");
+                return ESP_FAIL;
+            }
+            webSocket->_clientFd[index] = fd;
+            __atomic_store_n(&webSocket->_clientCount, index + 1, __ATOMIC_RELAXED);
+        }
+        if (r4aWebServerDebug)
+            r4aWebServerDebug->printf("WebSocket subscriber added, socket %d\r\n", fd);
+        return ESP_OK;
+    }
+
+    // Get the length of the message from the browser
+    memset(&frame, 0, sizeof(frame));
+    status = httpd_ws_recv_frame(request, &frame, 0);
+    if ((status != ESP_OK) || (frame.len == 0))
+        return status;
+
+    // Discard the message, the channel only sends data to the browser
+    if (frame.len > sizeof(buffer))
+        return ESP_FAIL;
+    frame.payload = buffer;
+    return httpd_ws_recv_frame(request, &frame, frame.len);
+}
+
+//*********************************************************************
+// Display the WebSocket channel status
+void r4aOv2640WebSocketMenuDisplay(const struct _R4A_MENU_ENTRY * menuEntry,
+                                   const char * command,
+                                   Print * display)
+{
+    r4aOv2640WebSocketDisplay((R4A_OV2640_WEB_SOCKET *)menuEntry->menuParameter,
+                              display);
+}
+
+//*********************************************************************
+// Push the vision results for a frame to the WebSocket subscribers
+bool r4aOv2640WebSocketPublish(R4A_OV2640_WEB_SOCKET * webSocket,
+                               camera_fb_t * frameBuffer,
+                               const R4A_OV2640_LINE * line,
+                               const R4A_OV2640_BLOBS * blobs,
+                               Print * display)
+{
+    const R4A_OV2640_BLOB * blob;
+    uint8_t blobCount;
+    uint8_t * data;
+    uint8_t index;
+    uint8_t rowCount;
+    httpd_handle_t server;
+    int64_t startUsec;
+    uint8_t thumbnailHeight;
+    uint8_t thumbnailWidth;
+
+    // The queued work was discarded when the web server stopped or
+    // restarted
+    server = webSocket->_webServer ? webSocket->_webServer->_webServer : nullptr;
+    if (server != webSocket->_publishServer)
+    {
+        webSocket->_publishServer = server;
+        __atomic_store_n(&webSocket->_sending, false, __ATOMIC_RELEASE);
+    }
+
+    // Nothing to do without subscribers, the subscribers of a previous
+    // server are ignored until the handler forgets them
+    if ((!server)
+        || (__atomic_load_n(&webSocket->_server, __ATOMIC_ACQUIRE) != server)
+        || (!__atomic_load_n(&webSocket->_clientCount, __ATOMIC_RELAXED)))
+        return true;
+
+    // Drop the frame while the previous message is being sent
+    if (__atomic_load_n(&webSocket->_sending, __ATOMIC_ACQUIRE))
+    {
+        webSocket->_framesDropped += 1;
+        return false;
+    }
+    startUsec = esp_timer_get_time();
+
+    // Allocate the message buffer, use internal memory for the network
+    if (!webSocket->_message)
+    {
+        webSocket->_message = (uint8_t *)malloc(R4A_OV2640_WEB_SOCKET_MESSAGE);
+        if (!webSocket->_message)
+        {
+            if (display)
+                display->println("ERROR: Failed to allocate the WebSocket message buffer!");
+            return false;
+        }
+    }
+
+    // Determine the thumbnail size
+    thumbnailWidth = 0;
+    thumbnailHeight = 0;
+    if ((frameBuffer->format == PIXFORMAT_GRAYSCALE)
+        || (frameBuffer->format == PIXFORMAT_RGB565))
+    {
+        thumbnailWidth = webSocket->_thumbnailWidth;
+        if (thumbnailWidth > R4A_OV2640_WEB_SOCKET_THUMB_WIDTH)
+            thumbnailWidth = R4A_OV2640_WEB_SOCKET_THUMB_WIDTH;
+        if (thumbnailWidth > frameBuffer->width)
+            thumbnailWidth = frameBuffer->width;
+        thumbnailHeight = webSocket->_thumbnailHeight;
+        if (thumbnailHeight > R4A_OV2640_WEB_SOCKET_THUMB_HEIGHT)
+            thumbnailHeight = R4A_OV2640_WEB_SOCKET_THUMB_HEIGHT;
+        if (thumbnailHeight > frameBuffer->height)
+            thumbnailHeight = frameBuffer->height;
+        if ((!thumbnailWidth) || (!thumbnailHeight))
+        {
+            thumbnailWidth = 0;
+            thumbnailHeight = 0;
+        }
+    }
+    rowCount = line ? line->_rowCount : 0;
+    blobCount = blobs ? blobs->_blobCount : 0;
+
+    // Build the header
+    data = webSocket->_message;
+    *data++ = R4A_OV2640_WEB_SOCKET_VERSION;
+    *data++ = rowCount;
+    *data++ = blobCount;
+    *data++ = line ? line->_rowsFound : 0;
+    data = r4aOv2640WebSocketPut32(data, webSocket->_sequence);
+    data = r4aOv2640WebSocketPut16(data, frameBuffer->width);
+    data = r4aOv2640WebSocketPut16(data, frameBuffer->height);
+    *data++ = thumbnailWidth;
+    *data++ = thumbnailHeight;
+    data = r4aOv2640WebSocketPut16(data, 0);
+    data = r4aOv2640WebSocketPutFloat(data, (line && line->_rowsFound) ? line->_centroidX : -1);
+    data = r4aOv2640WebSocketPutFloat(data, (line && line->_rowsFound) ? line->_angleDegrees : 0);
+
+    // Add the line position in each of the rows
+    for (index = 0; index < rowCount; index++)
+    {
+        data = r4aOv2640WebSocketPut16(data, line->_rows[index]);
+        data = r4aOv2640WebSocketPut16(data, line->_rowCentroidX[index]);
+    }
+
+    // Add the blobs
+    for (index = 0; index < blobCount; index++)
+    {
+        blob = &blobs->_blob[index];
+        data = r4aOv2640WebSocketPut32(data, blob->_area);
+        data = r4aOv2640WebSocketPut16(data, blob->_left);
+        data = r4aOv2640WebSocketPut16(data, blob->_top);
+        data = r4aOv2640WebSocketPut16(data, blob->_right);
+        data = r4aOv2640WebSocketPut16(data, blob->_bottom);
+        data = r4aOv2640WebSocketPut16(data, (uint16_t)(blob->_centroidX * 8 + 0.5));
+        data = r4aOv2640WebSocketPut16(data, (uint16_t)(blob->_centroidY * 8 + 0.5));
+    }
+
+    // Add the thumbnail
+    if (thumbnailWidth)
+        data = r4aOv2640WebSocketThumbnail(frameBuffer,
+                                           data,
+                                           thumbnailWidth,
+                                           thumbnailHeight);
+    webSocket->_messageLength = data - webSocket->_message;
+    webSocket->_sequence += 1;
+    webSocket->_serializeUsec = (uint32_t)(esp_timer_get_time() - startUsec);
+
+    // Send the message from the web server task
+    __atomic_store_n(&webSocket->_sending, true, __ATOMIC_RELEASE);
+    if (httpd_queue_work(server, r4aOv2640WebSocketSend, webSocket) != ESP_OK)
+    {
+        __atomic_store_n(&webSocket->_sending, false, __ATOMIC_RELEASE);
+        if (display)
+            display->println("ERROR: Failed to queue the WebSocket message!");
+        return false;
+    }
+    return true;
+}
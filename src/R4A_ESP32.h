@@ -192,10 +192,21 @@ extern const httpd_err_code_t r4aHttpError[];
 extern const int r4aHttpErrorCount;
 extern const char * r4aHttpErrorName[];
 
+// File extension to MIME type mapping
+typedef struct _R4A_HTTP_MIME_TYPE
+{
+    const char * _extension;    // Lower case extension without the period
+    const char * _type;         // Value for the Content-Type header
+} R4A_HTTP_MIME_TYPE;
+
+extern const R4A_HTTP_MIME_TYPE r4aHttpMimeType[];
+extern const int r4aHttpMimeTypeCount;
+
 typedef struct _R4A_JPEG_CHUNKING_T
 {
         httpd_req_t *req;
         size_t length;
+        int64_t sendUsec;   // Time spent sending the chunks
 } R4A_JPEG_CHUNKING_T;
 
 typedef struct _R4A_TAG_NAME_T
@@ -268,6 +279,157 @@ bool r4aEsp32I2cBusWriteWithLock(R4A_I2C_BUS * object,
                                  Print * display = nullptr,
                                  bool releaseI2cBus = true);
 
+//****************************************
+// Mailbox API
+//****************************************
+
+// Lock-free mailbox holding the most recent message from a single writer
+typedef struct _R4A_ESP32_MAILBOX
+{
+    // Constants, set during structure initialization
+    void * _message;        // Buffer to hold the message
+    size_t _length;         // Length of the message in bytes
+
+    // Mailbox state
+    uint32_t _sequence;     // Twice the messages posted, odd during an update
+} R4A_ESP32_MAILBOX;
+
+// Post a message to the mailbox, replacing any unread message
+// Inputs:
+//   mailbox: Address of a R4A_ESP32_MAILBOX data structure
+//   message: Address of the message to copy into the mailbox
+void r4aEsp32MailboxPost(R4A_ESP32_MAILBOX * mailbox, const void * message);
+
+// Read the most recent message from the mailbox
+// Inputs:
+//   mailbox: Address of a R4A_ESP32_MAILBOX data structure
+//   message: Address of the buffer to receive the message
+//   sequenceNumber: Address of the reader's sequence number, initially
+//                   zero, updated when a new message is read
+// Outputs:
+//   Returns the number of messages posted since the previous read.
+//   Values greater than one indicate that messages were replaced before
+//   they were read.  Returns zero (0) without waiting when no new message
+//   is available or the writer is updating the message.  The message
+//   buffer is unchanged unless the writer changed the message during
+//   each of the copy attempts, the buffer contents are then invalid.
+uint32_t r4aEsp32MailboxRead(R4A_ESP32_MAILBOX * mailbox,
+                             void * message,
+                             uint32_t * sequenceNumber);
+
+//****************************************
+// Metrics API
+//****************************************
+
+#define R4A_METRIC_BUCKETS_MAX      12  // Maximum histogram bucket bounds
+
+enum R4A_METRIC_TYPE
+{
+    R4A_METRIC_COUNTER = 0,     // Value only increases
+    R4A_METRIC_GAUGE,           // Value goes up and down
+    R4A_METRIC_HISTOGRAM,       // Distribution of times in microseconds
+};
+
+// Metric published by the /metrics page.  The values are updated with
+// atomic operations, no locks are taken when updating a metric.
+typedef struct _R4A_METRIC
+{
+    // Constants, set during structure initialization
+    const char * _name;         // Prometheus metric name, counters end in _total
+    const char * _help;         // Description of the metric
+    R4A_METRIC_TYPE _type;      // Type of metric
+    const uint32_t * _bounds;   // Histogram bucket upper bounds in microseconds, ascending
+    uint8_t _boundCount;        // Number of bounds, up to R4A_METRIC_BUCKETS_MAX
+    const volatile uint32_t * _source; // Value read at scrape time, may be nullptr
+
+    // Values
+    uint32_t _value;            // Counter or gauge value, used when _source is nullptr
+    uint64_t _sumUsec;          // Histogram sum in microseconds
+    uint32_t _bucket[R4A_METRIC_BUCKETS_MAX + 1]; // Histogram observations per bucket, last is +Inf
+
+    // Registry
+    struct _R4A_METRIC * _next; // Next registered metric
+    bool _registered;           // True once added to the registry
+} R4A_METRIC;
+
+// Scrape state for the /metrics page
+typedef struct _R4A_METRICS
+{
+    // Constants, set during structure initialization
+    struct _R4A_OV2640 * _ov2640; // Camera frame statistics, may be nullptr
+
+    // Statistics
+    uint32_t _scrapes;          // Number of scrapes
+    uint32_t _scrapeUsec;       // Time to send the last scrape
+} R4A_METRICS;
+
+extern const uint32_t r4aMetricLatencyBounds[]; // Default latency bucket bounds in microseconds
+extern const int r4aMetricLatencyBoundCount;
+
+// Library metrics
+extern R4A_METRIC r4aMetricI2cErrors;       // I2C transactions that failed
+extern R4A_METRIC r4aMetricI2cTransactions; // I2C transactions performed
+extern R4A_METRIC r4aMetricNvmWrites;       // Parameter file writes
+extern R4A_METRIC r4aMetricWebAsyncBusy;    // Requests rejected while all workers were busy
+extern R4A_METRIC r4aMetricWebAsyncRequests;    // Requests passed to the async workers
+extern R4A_METRIC r4aMetricWebBufferMisses; // Response buffers allocated from the heap
+extern R4A_METRIC r4aMetricWebDownloads;    // File download latency
+extern R4A_METRIC r4aMetricWebErrors;       // Web server errors
+extern R4A_METRIC r4aMetricWifiDisconnects; // WiFi station disconnects
+extern R4A_METRIC r4aMetricWifiReconnects;  // WiFi station reconnection attempts
+
+// Add a value to a counter or gauge
+// Inputs:
+//   metric: Address of a R4A_METRIC data structure
+//   value: Value to add
+void r4aMetricAdd(R4A_METRIC * metric, uint32_t value);
+
+// Increment a counter
+// Inputs:
+//   metric: Address of a R4A_METRIC data structure
+void r4aMetricIncrement(R4A_METRIC * metric);
+
+// Add a time to a histogram
+// Inputs:
+//   metric: Address of a R4A_METRIC data structure
+//   usec: Time in microseconds
+void r4aMetricObserve(R4A_METRIC * metric, uint32_t usec);
+
+// Add an application metric to the registry, call from setup
+// Inputs:
+//   metric: Address of a R4A_METRIC data structure
+void r4aMetricRegister(R4A_METRIC * metric);
+
+// Set the value of a gauge
+// Inputs:
+//   metric: Address of a R4A_METRIC data structure
+//   value: New value for the gauge
+void r4aMetricSet(R4A_METRIC * metric, uint32_t value);
+
+// Display the metrics in the Prometheus text format
+// Inputs:
+//   metrics: Address of a R4A_METRICS data structure
+//   display: Address of Print object for output
+void r4aMetricsDisplay(R4A_METRICS * metrics, Print * display = &Serial);
+
+// Return the metrics in the Prometheus text format
+// Inputs:
+//   request: Request from the browser, user_ctx contains the address
+//            of the R4A_METRICS object
+// Outputs:
+//   Returns the status of sending the response
+esp_err_t r4aMetricsHandler(httpd_req_t *request);
+
+// Display the metrics in the Prometheus text format
+// Inputs:
+//   menuEntry: Address of the object describing the menu entry,
+//              menuParam contains the address of the R4A_METRICS object
+//   command: Zero terminated command string
+//   display: Device used for output
+void r4aMetricsMenuDisplay(const struct _R4A_MENU_ENTRY * menuEntry,
+                           const char * command,
+                           Print * display);
+
 //****************************************
 // NVM API
 //****************************************
@@ -700,6 +862,76 @@ typedef bool (* R4A_OV2640_PROCESS_FRAME_BUFFER)(struct _R4A_OV2640 * object,
 typedef bool (* R4A_OV2640_PROCESS_WEB_SERVER_FRAME_BUFFER)(struct _R4A_OV2640 * object,
                                                             camera_fb_t * frameBuffer);
 
+// JPEG image cache entry, the image is encoded once and sent to all
+// requests until the next frame is processed
+typedef struct _R4A_OV2640_JPEG_CACHE
+{
+    uint8_t * _buffer;          // PSRAM buffer containing the JPEG image
+    size_t _size;               // Size of the buffer in bytes
+    size_t _length;             // Length of the JPEG image in bytes
+    uint32_t _captureNumber;    // Capture sequence number of the frame
+    int64_t _captureUsec;       // Time the sensor captured the frame
+    int64_t _encodeUsec;        // Time the image was encoded
+    uint8_t _quality;           // JPEG quality of the image
+    uint8_t _users;             // Number of requests sending the image
+} R4A_OV2640_JPEG_CACHE;
+
+#define R4A_OV2640_JPEG_CACHE_ENTRIES   2
+#define R4A_OV2640_JPEG_CACHE_USEC      (40 * 1000) // Image lifetime without frame processing
+#define R4A_OV2640_JPEG_CACHE_WAIT_MSEC 250         // Longest wait for another request's encode
+
+// Pipeline stage timing histogram, see OV2640_Stats.cpp for the buckets
+#define R4A_OV2640_HISTOGRAM_BUCKETS    16
+
+typedef struct _R4A_OV2640_HISTOGRAM
+{
+    uint32_t _count;            // Number of times recorded
+    uint32_t _minimumUsec;      // Shortest time, 0xffffffff until a time is recorded
+    uint32_t _maximumUsec;      // Longest time
+    uint64_t _totalUsec;        // Sum of the times
+    uint32_t _bucket[R4A_OV2640_HISTOGRAM_BUCKETS]; // Number of times within each bucket
+} R4A_OV2640_HISTOGRAM;
+
+// Pipeline stages
+enum
+{
+    R4A_OV2640_STAGE_ACQUIRE = 0,   // Waiting in esp_camera_fb_get
+    R4A_OV2640_STAGE_AGE,           // Sensor timestamp to processing handoff
+    R4A_OV2640_STAGE_PROCESS,       // Frame processing callback
+    R4A_OV2640_STAGE_ENCODE,        // JPEG encode
+    R4A_OV2640_STAGE_SEND,          // Sending the JPEG image to the browser
+    // Add new stages above this line
+    R4A_OV2640_STAGE_MAX
+};
+
+// Frame difference gating, skip processing frames that have not changed
+typedef struct _R4A_OV2640_GATE
+{
+    // Constants, set during structure initialization
+    uint8_t _rowStep;           // Rows between samples, zero uses 8
+    uint8_t _wordStep;          // 32-bit words between samples, zero uses 4
+    uint8_t _threshold;         // Mean luminance difference needed for processing
+    uint8_t _maximumSkip;       // Maximum number of frames skipped in a row
+
+    // State, updated by r4aOv2640GateCheck
+    uint32_t * _sampleBuffer;   // Reference and current samples
+    uint32_t _samples;          // Number of samples in each frame
+    pixformat_t _format;        // Pixel format of the samples
+    uint8_t _current;           // Index of the reference samples
+    bool _valid;                // True when the reference samples are valid
+    uint8_t _skipCount;         // Number of frames skipped in a row
+    uint32_t _differenceX16;    // Mean difference of the last frame times 16
+    uint32_t _framesProcessed;  // Number of frames processed
+    uint32_t _framesSkipped;    // Number of frames skipped
+    uint64_t _checkUsec;        // Total time spent checking the frames
+} R4A_OV2640_GATE;
+
+// Register banks, selected by writing register 0xff
+#define R4A_OV2640_BANK_DSP     0
+#define R4A_OV2640_BANK_SENSOR  1
+#define R4A_OV2640_BANKS        2
+#define R4A_OV2640_BANK_UNKNOWN 0xff    // Bank selected by another routine
+
 // OV2640 data structure declaration
 typedef struct _R4A_OV2640
 {
@@ -711,8 +943,345 @@ typedef struct _R4A_OV2640
     R4A_I2C_BUS * _i2cBus;    // I2C bus to access the OV2640
     uint8_t  _i2cAddress;     // Address of the OV2640
     const R4A_OV2640_PINS * _pins; // ESP32 GPIO pins for the 0V2640 camera
+
+    // Frame timing, updated by r4aOv2640Update
+    bool _lowLatency;               // True when only the newest frame is returned
+    uint32_t _frameNumber;          // Number of frames handed to processing
+    uint32_t _framesDropped;        // Frames the sensor produced but were never processed
+    int64_t _frameCaptureUsec;      // esp_timer time when the sensor finished the frame
+    int64_t _frameHandoffUsec;      // esp_timer time when the frame was handed to processing
+    uint32_t _framePeriodUsec;      // Shortest interval seen between sensor frames
+    uint32_t _frameAgeUsec;         // Age of the current frame at processing
+    uint32_t _frameAgeAverageUsec;  // Running average of the frame age
+    uint32_t _frameAgeMaximumUsec;  // Largest frame age seen
+    uint32_t _framesPerSecondX100;  // Frames processed per second times 100
+    int64_t _fpsStartUsec;          // Start of the frame rate measurement
+    uint32_t _fpsFrameNumber;       // Frame number at start of the measurement
+    uint32_t _queueDepth;           // Sensor frames produced while this frame waited
+
+    // JPEG rate control, see r4aOv2640JpegTargetBytes, protected by
+    // _jpegCacheLock
+    uint8_t _jpegQuality;           // Quality for the next image (1 - 100), zero for default
+    uint32_t _jpegBytes;            // Size of the previous image
+    uint32_t _jpegSendUsec;         // Time to send the previous image
+    uint32_t _jpegBytesPerSecond;   // Network throughput over the last window
+    int64_t _jpegWindowStartUsec;   // Start of the first send in the window
+    int64_t _jpegWindowEndUsec;     // End of the most recent send in the window
+    uint32_t _jpegWindowBytes;      // Bytes sent during the window
+    uint8_t _jpegWindowSends;       // Images sent during the window
+
+    // JPEG cache, see r4aOV2640JpegHandler
+    uint32_t _captureNumber;        // Incremented for each frame captured
+    R4A_OV2640_JPEG_CACHE _jpegCache[R4A_OV2640_JPEG_CACHE_ENTRIES];
+    R4A_OV2640_JPEG_CACHE * _jpegCacheCurrent; // Newest image, nullptr if none
+    volatile int _jpegCacheLock;    // Lock protecting the cache entries and rate control
+    bool _jpegCacheEncoding;        // A request is capturing and encoding the next image
+    uint32_t _jpegCacheHits;        // Requests sent from the cache
+    uint32_t _jpegEncodes;          // Images encoded
+
+    // Processing task, see r4aOv2640TaskStart
+    TaskHandle_t _taskHandle;       // Task handle, nullptr when not running
+    volatile bool * _taskEnable;    // Process frames when true
+
+    // Pipeline stage timing, see r4aOv2640DisplayStageStats, updated
+    // with atomic operations
+    R4A_OV2640_HISTOGRAM _stageHistogram[R4A_OV2640_STAGE_MAX];
+
+    // Register shadow cache, see r4aOv2640RegisterRead
+    bool _registerCacheInitialized; // Volatile registers are marked
+    uint8_t _registerShadow[R4A_OV2640_BANKS][256];  // Copy of the registers
+    uint8_t _registerValid[R4A_OV2640_BANKS][32];    // Bit set when shadow is valid
+    uint8_t _registerVolatile[R4A_OV2640_BANKS][32]; // Bit set when always read
+    uint8_t _registerBank;                  // Bank selected by the camera driver
+    uint32_t _registerTransactions;         // I2C transactions performed
+    uint32_t _registerTransactionsSaved;    // I2C transactions avoided
+
+    // Frame difference gating, nullptr processes all frames
+    R4A_OV2640_GATE * _gate;
+
+    // Luminance decode of the JPEG frames before processing, nullptr
+    // passes the JPEG frames to the processing routine
+    struct _R4A_OV2640_JPEG_DECODE * _jpegDecode;
 } R4A_OV2640;
 
+#define R4A_OV2640_HUE_NONE     0xff    // Hue bin value for gray pixels
+
+// Connected component (blob) detection, memory is sized for QVGA frames
+#define R4A_OV2640_BLOB_MAX         8       // Number of blobs reported
+#define R4A_OV2640_BLOB_MAX_LABELS  512     // Labels available in each frame
+#define R4A_OV2640_BLOB_MAX_WIDTH   320     // Widest frame in pixels
+
+typedef struct _R4A_OV2640_BLOB
+{
+    uint32_t _area;             // Number of pixels
+    float _centroidX;           // Average column
+    float _centroidY;           // Average row
+    uint16_t _left;             // Bounding box leftmost column
+    uint16_t _top;              // Bounding box top row
+    uint16_t _right;            // Bounding box rightmost column
+    uint16_t _bottom;           // Bounding box bottom row
+} R4A_OV2640_BLOB;
+
+typedef struct _R4A_OV2640_BLOBS
+{
+    // Constants, set during structure initialization
+    uint8_t _threshold;         // Luminance threshold (0 - 255)
+    bool _isDark;               // True when the blob is darker than the background
+    uint8_t _hueBins;           // RGB565 hue bins, zero selects by luminance
+    uint8_t _hueFirst;          // First selected hue bin
+    uint8_t _hueLast;           // Last selected hue bin, may wrap through red
+    uint8_t _minimumChroma;     // Minimum chroma for a hue bin, see r4aOv2640Rgb565ToHue
+    uint16_t _minimumArea;      // Smallest blob reported in pixels
+
+    // Work area, allocated by r4aOv2640BlobFind
+    void * _workArea;
+
+    // Results, updated by r4aOv2640BlobFind
+    uint8_t _blobCount;         // Number of blobs found
+    R4A_OV2640_BLOB _blob[R4A_OV2640_BLOB_MAX]; // Largest blobs first
+    uint16_t _labels;           // Labels used in the frame
+    uint32_t _runs;             // Runs found in the frame
+    uint32_t _runsDropped;      // Runs dropped after the labels ran out
+    uint32_t _processUsec;      // Time to locate the blobs
+} R4A_OV2640_BLOBS;
+
+// Frame view, a rectangle of pixels within a frame buffer or pyramid level
+typedef struct _R4A_OV2640_VIEW
+{
+    uint8_t * _buf;             // Address of the upper left pixel
+    uint16_t _width;            // Width of the view in pixels
+    uint16_t _height;           // Height of the view in pixels
+    size_t _stride;             // Number of bytes between the start of each row
+    pixformat_t _format;        // Pixel format
+    uint8_t _bytesPerPixel;     // Number of bytes in each pixel
+} R4A_OV2640_VIEW;
+
+// Image pyramid, the buffer is reused for each frame
+#define R4A_OV2640_PYRAMID_LEVELS   2   // 1/2 and 1/4 scale images
+
+typedef struct _R4A_OV2640_PYRAMID
+{
+    uint8_t * _buffer;          // PSRAM buffer containing the levels
+    size_t _size;               // Size of the buffer in bytes
+    uint8_t _levels;            // Number of valid levels
+    R4A_OV2640_VIEW _level[R4A_OV2640_PYRAMID_LEVELS]; // 1/2 scale, 1/4 scale
+    uint32_t _buildUsec;        // Time to build the pyramid
+} R4A_OV2640_PYRAMID;
+
+// Block matching visual odometry
+#define R4A_OV2640_ODOMETRY_BLOCK   8   // Block size in pixels
+#define R4A_OV2640_ODOMETRY_BLOCKS  24  // Most textured blocks matched per frame
+
+// Motion between frames, posted to the mailbox
+typedef struct _R4A_OV2640_ODOMETRY_RESULT
+{
+    int64_t _captureUsec;       // Capture time of the current frame
+    float _dx;                  // Image motion to the right in frame pixels
+    float _dy;                  // Image motion down in frame pixels
+    float _rotationDegrees;     // Image rotation, positive is clockwise
+    float _confidence;          // 0 (no estimate) to 1
+    uint8_t _blocks;            // Blocks used for the estimate
+} R4A_OV2640_ODOMETRY_RESULT;
+
+typedef struct _R4A_OV2640_ODOMETRY
+{
+    // Constants, set during structure initialization
+    uint16_t _roiX;             // Region of interest left column
+    uint16_t _roiY;             // Region of interest top row
+    uint16_t _roiWidth;         // Region of interest width, 0 = to the right edge
+    uint16_t _roiHeight;        // Region of interest height, 0 = to the bottom edge
+    uint8_t _levels;            // Downsampling, 1 = 1/2 scale, 2 = 1/4 scale
+    uint8_t _searchRadius;      // Search distance in downsampled pixels (2 - 8)
+    uint16_t _minimumTexture;   // Minimum gradient sum for a block
+    R4A_ESP32_MAILBOX * _mailbox; // Receives R4A_OV2640_ODOMETRY_RESULT, may be nullptr
+
+    // State, updated by r4aOv2640OdometryUpdate
+    R4A_OV2640_PYRAMID _pyramid;    // Downsampled region of interest
+    uint8_t * _buffer;          // Previous and current luminance images
+    size_t _imageSize;          // Size of each image in bytes
+    uint16_t _width;            // Image width in pixels
+    uint16_t _height;           // Image height in pixels
+    size_t _stride;             // Bytes between the start of each row
+    uint8_t _current;           // Index of the current image
+    bool _valid;                // True when the previous image is valid
+    R4A_OV2640_ODOMETRY_RESULT _result; // Most recent result
+    float _totalX;              // Sum of the motion to the right in pixels
+    float _totalY;              // Sum of the motion down in pixels
+    float _totalDegrees;        // Sum of the rotation
+    uint32_t _frames;           // Number of frames compared
+    uint32_t _processUsec;      // Time to process the frame
+} R4A_OV2640_ODOMETRY;
+
+// Reduced resolution JPEG decode, see r4aOv2640JpegToY8
+#define R4A_OV2640_JPEG_SCALE_1_4   4   // 2 x 2 pixels per 8 x 8 block
+#define R4A_OV2640_JPEG_SCALE_1_8   8   // 1 pixel per 8 x 8 block
+
+typedef struct _R4A_OV2640_JPEG_DECODE
+{
+    // Constants, set during structure initialization
+    uint8_t _scale;             // R4A_OV2640_JPEG_SCALE_1_4 or R4A_OV2640_JPEG_SCALE_1_8
+
+    // Work areas, allocated by r4aOv2640JpegToY8 and reused for each frame
+    void * _workArea;           // Marker and Huffman decode state
+    uint8_t * _buffer;          // PSRAM buffer containing the Y8 image
+    size_t _size;               // Size of the buffer in bytes
+
+    // Results, updated by r4aOv2640JpegToY8
+    R4A_OV2640_VIEW _view;      // Y8 image, rows start on a 32-bit boundary
+    camera_fb_t _frameBuffer;   // Y8 image in the camera driver's format
+    uint32_t _decodeUsec;       // Time to decode the image
+} R4A_OV2640_JPEG_DECODE;
+
+// Display the blobs
+// Inputs:
+//   blobs: Address of a R4A_OV2640_BLOBS data structure
+//   display: Address of Print object for output
+void r4aOv2640BlobDisplay(R4A_OV2640_BLOBS * blobs,
+                          Print * display = &Serial);
+
+// Locate the connected groups of selected pixels (blobs) in the frame
+// Inputs:
+//   blobs: Address of a R4A_OV2640_BLOBS data structure
+//   frameBuffer: Buffer containing PIXFORMAT_RGB565 or PIXFORMAT_GRAYSCALE
+//                image data, rows must start on a 32-bit boundary
+//   display: Address of Print object for error output, may be nullptr
+// Outputs:
+//   Returns true if any blobs were found and false otherwise
+bool r4aOv2640BlobFind(R4A_OV2640_BLOBS * blobs,
+                       camera_fb_t * frameBuffer,
+                       Print * display = nullptr);
+
+// Free the blob work area
+// Inputs:
+//   blobs: Address of a R4A_OV2640_BLOBS data structure
+void r4aOv2640BlobFree(R4A_OV2640_BLOBS * blobs);
+
+// Display the blobs
+// Inputs:
+//   menuEntry: Address of the object describing the menu entry,
+//              menuParam contains the address of the R4A_OV2640_BLOBS object
+//   command: Zero terminated command string
+//   display: Device used for output
+void r4aOv2640BlobMenuDisplay(const struct _R4A_MENU_ENTRY * menuEntry,
+                              const char * command,
+                              Print * display);
+
+// Measure the cost of the pixel conversion routines
+// Inputs:
+//   display: Address of Print object for output
+void r4aOv2640ConvertBenchmark(Print * display = &Serial);
+
+// Measure the cost of the pixel conversion routines
+// Inputs:
+//   menuEntry: Address of the object describing the menu entry
+//   command: Zero terminated command string
+//   display: Device used for output
+void r4aOv2640ConvertMenuBenchmark(const struct _R4A_MENU_ENTRY * menuEntry,
+                                   const char * command,
+                                   Print * display);
+
+// Build the pixel conversion tables, called automatically by the
+// conversion routines
+void r4aOv2640ConvertTablesInit();
+
+// Display the frame timing statistics
+// Inputs:
+//   object: Address of a R4A_OV2640 data structure
+//   display: Address of Print object for output
+void r4aOv2640DisplayFrameStats(R4A_OV2640 * object,
+                                Print * display = &Serial);
+
+// Line detection data structure declaration
+#define R4A_OV2640_LINE_MAX_ROWS    16  // Maximum number of rows to sample
+
+typedef struct _R4A_OV2640_LINE
+{
+    // Constants, set during structure initialization
+    const uint16_t * _rows;     // Rows to sample, row zero is the top of the image
+    uint8_t _rowCount;          // Number of entries in the _rows list
+    uint8_t _threshold;         // Luminance threshold (0 - 255)
+    bool _lineIsDark;           // True when the line is darker than the floor
+    uint16_t _minimumPixels;    // Minimum line pixels needed in a row
+
+    // Results, updated by r4aOv2640LineFind
+    uint8_t _rowsFound;         // Number of rows containing the line
+    float _centroidX;           // Average line position in pixels
+    float _offset;              // Line position, -1 (left) to 1 (right)
+    float _angleDegrees;        // Line heading, positive leans to the right
+    int16_t _rowCentroidX[R4A_OV2640_LINE_MAX_ROWS]; // Line position, -1 if not found
+    uint32_t _processUsec;      // Time to locate the line
+} R4A_OV2640_LINE;
+
+// Floor remap, converts image points into floor distances
+typedef struct _R4A_OV2640_REMAP
+{
+    // Constants, set during structure initialization
+    float _cameraHeightMm;      // Height of the lens above the floor
+    float _fovDegrees;          // Horizontal field of view
+    float _lensK1;              // Radial distortion, r = rd * (1 + k1 * rd^2) with
+                                // rd normalized to the half width, positive for
+                                // barrel distortion, 0 = none
+    uint8_t _panForwardDegrees; // Pan servo position when looking forward
+    int8_t _panDirection;       // 1: Increasing pan turns right, -1: left
+    uint8_t _tiltLevelDegrees;  // Tilt servo position when looking level
+    int8_t _tiltDirection;      // 1: Increasing tilt looks down, -1: up
+
+    // Pose, updated by r4aOv2640RemapUpdate
+    bool _valid;                // True when the tables are built
+    uint16_t _width;            // Frame width in pixels
+    uint16_t _height;           // Frame height in pixels
+    uint8_t _panDegrees;        // Pan servo position
+    uint8_t _tiltDegrees;       // Tilt servo position
+    float _centerX;             // Image center column
+    float _centerY;             // Image center row
+    float _focalPixels;         // Focal length in pixels
+    float _pitchCos;            // Cosine of the angle below level
+    float _pitchSin;            // Sine of the angle below level
+    float _panCos;              // Cosine of the angle right of forward
+    float _panSin;              // Sine of the angle right of forward
+    float _horizonRow;          // Rows above the horizon do not see the floor
+
+    // Tables, allocated by r4aOv2640RemapUpdate
+    float * _rowForwardMm;      // Forward distance of each row, -1 above the horizon
+    float * _rowLateralScale;   // Lateral mm per pixel from the center column
+    float * _radialScale;       // Undistortion scale indexed by radius in pixels
+    uint16_t _rows;             // Number of row table entries
+    uint16_t _radialEntries;    // Number of radial table entries
+    uint32_t _rebuilds;         // Number of times the tables were built
+    uint32_t _buildUsec;        // Time to build the tables
+} R4A_OV2640_REMAP;
+
+// WebSocket channel pushing the vision results to the browsers
+#define R4A_OV2640_WEB_SOCKET_CLIENTS       4   // Maximum subscribers
+#define R4A_OV2640_WEB_SOCKET_THUMB_WIDTH   80  // Widest thumbnail in pixels
+#define R4A_OV2640_WEB_SOCKET_THUMB_HEIGHT  60  // Tallest thumbnail in pixels
+#define R4A_OV2640_WEB_SOCKET_VERSION       1   // Message format version
+
+typedef struct _R4A_OV2640_WEB_SOCKET
+{
+    // Constants, set during structure initialization
+    uint8_t _thumbnailWidth;    // Thumbnail width in pixels, zero for none
+    uint8_t _thumbnailHeight;   // Thumbnail height in pixels
+    struct _R4A_WEB_SERVER * _webServer; // Web server hosting the channel
+
+    // Subscribers, only updated by the web server task
+    httpd_handle_t _server;     // Server owning the subscriber sockets
+    int _clientFd[R4A_OV2640_WEB_SOCKET_CLIENTS]; // Subscriber sockets
+    uint8_t _clientCount;       // Number of subscribers
+
+    // Message, serialized once per frame and sent to each subscriber
+    httpd_handle_t _publishServer; // Server receiving the queued messages
+    uint8_t * _message;         // Message buffer
+    size_t _messageLength;      // Number of bytes in the message
+    volatile bool _sending;     // True while the message is being sent
+
+    // Statistics
+    uint32_t _sequence;         // Number of messages serialized
+    uint32_t _framesDropped;    // Frames skipped while the previous message was sent
+    uint32_t _sendErrors;       // Subscribers dropped after a send failure
+    uint32_t _serializeUsec;    // Time to serialize the last message
+} R4A_OV2640_WEB_SOCKET;
+
 // Display a group of registers
 // Inputs:
 //   object: Address of a R4A_OV2640 data structure
@@ -724,6 +1293,13 @@ void r4aOv2640DisplayRegisters(R4A_OV2640 * object,
                                size_t bytesToRead,
                                Print * display);
 
+// Display the pipeline stage timing
+// Inputs:
+//   object: Address of a R4A_OV2640 data structure
+//   display: Address of Print object for output
+void r4aOv2640DisplayStageStats(R4A_OV2640 * object,
+                                Print * display = &Serial);
+
 // Dump all of the OV2640 registers in hexadecimal
 // Inputs:
 //   object: Address of a R4A_OV2640 data structure
@@ -731,14 +1307,533 @@ void r4aOv2640DisplayRegisters(R4A_OV2640 * object,
 void r4aOv2640DumpRegisters(R4A_OV2640 * object,
                             Print * display);
 
+// Get the time when the sensor captured the frame
+// Inputs:
+//   frameBuffer: Buffer containing the raw image data
+// Outputs:
+//   Returns the capture time in esp_timer microseconds
+int64_t r4aOv2640FrameCaptureUsec(camera_fb_t * frameBuffer);
+
+// Determine if the frame changed enough to be processed
+// Inputs:
+//   gate: Address of a R4A_OV2640_GATE data structure
+//   frameBuffer: Buffer containing the raw image data, rows must start
+//                on a 32-bit boundary
+// Outputs:
+//   Returns true if the frame should be processed and false if the
+//   frame is too similar to the last processed frame
+bool r4aOv2640GateCheck(R4A_OV2640_GATE * gate,
+                        camera_fb_t * frameBuffer);
+
+// Display the frame difference gating statistics
+// Inputs:
+//   object: Address of a R4A_OV2640 data structure
+//   display: Address of Print object for output
+void r4aOv2640GateDisplay(R4A_OV2640 * object,
+                          Print * display = &Serial);
+
+// Display the frame difference gating statistics
+// Inputs:
+//   menuEntry: Address of the object describing the menu entry,
+//              menuParam contains the address of the R4A_OV2640 object
+//   command: Zero terminated command string
+//   display: Device used for output
+void r4aOv2640GateMenuDisplay(const struct _R4A_MENU_ENTRY * menuEntry,
+                              const char * command,
+                              Print * display);
+
+// Compare the reduced resolution JPEG decode with the full decode
+// Inputs:
+//   display: Address of Print object for output
+void r4aOv2640JpegDecodeBenchmark(Print * display = &Serial);
+
+// Compare the reduced resolution JPEG decode with the full decode
+// Inputs:
+//   menuEntry: Address of the object describing the menu entry
+//   command: Zero terminated command string
+//   display: Device used for output
+void r4aOv2640JpegMenuDecodeBenchmark(const struct _R4A_MENU_ENTRY * menuEntry,
+                                      const char * command,
+                                      Print * display);
+
+// Free the JPEG decode work areas
+// Inputs:
+//   decode: Address of a R4A_OV2640_JPEG_DECODE data structure
+void r4aOv2640JpegDecodeFree(R4A_OV2640_JPEG_DECODE * decode);
+
+// Decode the luminance of a baseline JPEG image at reduced resolution
+// without an inverse DCT, the chrominance is discarded
+// Inputs:
+//   decode: Address of a R4A_OV2640_JPEG_DECODE data structure, _scale
+//           R4A_OV2640_JPEG_SCALE_1_8 uses only the DC coefficient,
+//           R4A_OV2640_JPEG_SCALE_1_4 adds the three lowest frequency
+//           AC coefficients.  The PIXFORMAT_GRAYSCALE image is returned
+//           in _view and _frameBuffer, the frame buffer width is the
+//           row stride and the padding pixels repeat the last column.
+//   jpeg: Address of the JPEG image
+//   length: Number of bytes in the JPEG image
+//   display: Address of Print object for error output, may be nullptr
+// Outputs:
+//   Returns true if the image was decoded and false upon error
+bool r4aOv2640JpegToY8(R4A_OV2640_JPEG_DECODE * decode,
+                       const uint8_t * jpeg,
+                       size_t length,
+                       Print * display = nullptr);
+
+// Verify the line detection kernels on synthetic frames and measure
+// their speed
+// Inputs:
+//   display: Address of Print object for output
+// Outputs:
+//   Returns true if the kernels match the reference and the synthetic
+//   lines are located, false otherwise
+bool r4aOv2640LineBenchmark(Print * display = &Serial);
+
+// Display the line detection results
+// Inputs:
+//   line: Address of a R4A_OV2640_LINE data structure
+//   display: Address of Print object for output
+void r4aOv2640LineDisplay(R4A_OV2640_LINE * line,
+                          Print * display = &Serial);
+
+// Locate the line in the frame
+// Inputs:
+//   line: Address of a R4A_OV2640_LINE data structure
+//   frameBuffer: Buffer containing PIXFORMAT_RGB565 or PIXFORMAT_GRAYSCALE
+//                image data, rows must start on a 32-bit boundary
+//   display: Address of Print object for error output, may be nullptr
+// Outputs:
+//   Returns true if the line was found and false otherwise
+bool r4aOv2640LineFind(R4A_OV2640_LINE * line,
+                       camera_fb_t * frameBuffer,
+                       Print * display = nullptr);
+
+// Verify the line detection kernels on synthetic frames and measure
+// their speed
+// Inputs:
+//   menuEntry: Address of the object describing the menu entry
+//   command: Zero terminated command string
+//   display: Device used for output
+void r4aOv2640LineMenuBenchmark(const struct _R4A_MENU_ENTRY * menuEntry,
+                                const char * command,
+                                Print * display);
+
+// Display the line detection results
+// Inputs:
+//   menuEntry: Address of the object describing the menu entry,
+//              menuParam contains the address of the R4A_OV2640_LINE object
+//   command: Zero terminated command string
+//   display: Device used for output
+void r4aOv2640LineMenuDisplay(const struct _R4A_MENU_ENTRY * menuEntry,
+                              const char * command,
+                              Print * display);
+
+// Display the frame timing statistics
+// Inputs:
+//   menuEntry: Address of the object describing the menu entry,
+//              menuParam contains the address of the R4A_OV2640 object
+//   command: Zero terminated command string
+//   display: Device used for output
+void r4aOv2640MenuDisplayFrameStats(const struct _R4A_MENU_ENTRY * menuEntry,
+                                    const char * command,
+                                    Print * display);
+
+// Display the pipeline stage timing
+// Inputs:
+//   menuEntry: Address of the object describing the menu entry,
+//              menuParam contains the address of the R4A_OV2640 object
+//   command: Zero terminated command string
+//   display: Device used for output
+void r4aOv2640MenuDisplayStageStats(const struct _R4A_MENU_ENTRY * menuEntry,
+                                    const char * command,
+                                    Print * display);
+
+// Clear the pipeline stage timing
+// Inputs:
+//   menuEntry: Address of the object describing the menu entry,
+//              menuParam contains the address of the R4A_OV2640 object
+//   command: Zero terminated command string
+//   display: Device used for output
+void r4aOv2640MenuStageStatsReset(const struct _R4A_MENU_ENTRY * menuEntry,
+                                  const char * command,
+                                  Print * display);
+
+// Display the visual odometry results
+// Inputs:
+//   odometry: Address of a R4A_OV2640_ODOMETRY data structure
+//   display: Address of Print object for output
+void r4aOv2640OdometryDisplay(R4A_OV2640_ODOMETRY * odometry,
+                              Print * display = &Serial);
+
+// Free the visual odometry buffers
+// Inputs:
+//   odometry: Address of a R4A_OV2640_ODOMETRY data structure
+void r4aOv2640OdometryFree(R4A_OV2640_ODOMETRY * odometry);
+
+// Display the visual odometry results
+// Inputs:
+//   menuEntry: Address of the object describing the menu entry,
+//              menuParam contains the address of the R4A_OV2640_ODOMETRY object
+//   command: Zero terminated command string
+//   display: Device used for output
+void r4aOv2640OdometryMenuDisplay(const struct _R4A_MENU_ENTRY * menuEntry,
+                                  const char * command,
+                                  Print * display);
+
+// Estimate the image motion since the previous frame
+// Inputs:
+//   odometry: Address of a R4A_OV2640_ODOMETRY data structure, zero the
+//             state before the first call
+//   frameBuffer: Buffer containing PIXFORMAT_RGB565 or PIXFORMAT_GRAYSCALE
+//                image data, rows must start on a 32-bit boundary
+//   display: Address of Print object for error output, may be nullptr
+// Outputs:
+//   Returns true if the motion was estimated and false otherwise
+bool r4aOv2640OdometryUpdate(R4A_OV2640_ODOMETRY * odometry,
+                             camera_fb_t * frameBuffer,
+                             Print * display = nullptr);
+
+// Build the image pyramid
+// Inputs:
+//   pyramid: Address of a R4A_OV2640_PYRAMID data structure, zero the
+//            structure before the first call
+//   view: Address of the PIXFORMAT_RGB565 or PIXFORMAT_GRAYSCALE view
+//         to downsample
+//   levels: Number of levels to build, 1 (1/2 scale) or 2 (1/4 scale)
+//   display: Address of Print object for error output, may be nullptr
+// Outputs:
+//   Returns true if the pyramid was built and false upon error
+bool r4aOv2640PyramidBuild(R4A_OV2640_PYRAMID * pyramid,
+                           const R4A_OV2640_VIEW * view,
+                           uint8_t levels,
+                           Print * display = nullptr);
+
+// Free the image pyramid buffer
+// Inputs:
+//   pyramid: Address of a R4A_OV2640_PYRAMID data structure
+void r4aOv2640PyramidFree(R4A_OV2640_PYRAMID * pyramid);
+
+// Frame recording, see OV2640_Recorder.cpp for the layout
+typedef struct _R4A_OV2640_RECORD_HEADER
+{
+    uint32_t _magic;            // Marks the start of the frame
+    uint32_t _length;           // Number of image data bytes
+    int64_t _captureUsec;       // Time the sensor captured the frame
+    uint16_t _width;            // Width of the image in pixels
+    uint16_t _height;           // Height of the image in pixels
+    uint8_t _format;            // Pixel format, pixformat_t
+    uint8_t _reserved[11];      // Zero, pads the header to 32 bytes
+} R4A_OV2640_RECORD_HEADER;
+
+static_assert(sizeof(R4A_OV2640_RECORD_HEADER) == 32,
+              "The recording file format requires a 32 byte frame header");
+
+typedef struct _R4A_OV2640_RECORDER
+{
+    uint8_t * _buffer;          // PSRAM buffer containing the recording
+    size_t _size;               // Size of the buffer in bytes
+    size_t _length;             // Number of bytes recorded
+    uint32_t _frames;           // Number of frames recorded
+    uint32_t _framesSkipped;    // Frames that did not fit in the buffer
+    size_t _jpegLength;         // Length of the JPEG image being recorded
+    uint8_t _jpegQuality;       // JPEG quality, zero records raw frames
+    volatile bool _recording;   // True while recording frames
+    volatile bool _adding;      // True while r4aOv2640RecorderAdd uses the buffer
+} R4A_OV2640_RECORDER;
+
+// Add a frame to the recording
+// Inputs:
+//   recorder: Address of a R4A_OV2640_RECORDER data structure
+//   frameBuffer: Buffer containing the image data
+// Outputs:
+//   Returns true if the frame was recorded and false otherwise
+bool r4aOv2640RecorderAdd(R4A_OV2640_RECORDER * recorder,
+                          camera_fb_t * frameBuffer);
+
+// Allocate the recording buffer and start recording
+// Inputs:
+//   recorder: Address of a R4A_OV2640_RECORDER data structure
+//   size: Size of the recording buffer in bytes
+//   jpegQuality: Quality (1 - 100) used to compress the frames, zero
+//                records the raw frames
+//   display: Address of Print object for error output, may be nullptr
+// Outputs:
+//   Returns true if recording started and false upon failure
+bool r4aOv2640RecorderBegin(R4A_OV2640_RECORDER * recorder,
+                            size_t size,
+                            uint8_t jpegQuality,
+                            Print * display = nullptr);
+
+// Display the recording status
+// Inputs:
+//   recorder: Address of a R4A_OV2640_RECORDER data structure
+//   display: Address of Print object for output
+void r4aOv2640RecorderDisplay(R4A_OV2640_RECORDER * recorder,
+                              Print * display = &Serial);
+
+// Free the recording buffer
+// Inputs:
+//   recorder: Address of a R4A_OV2640_RECORDER data structure
+void r4aOv2640RecorderFree(R4A_OV2640_RECORDER * recorder);
+
+// Read a recording from a file
+// Inputs:
+//   recorder: Address of a R4A_OV2640_RECORDER data structure
+//   path: Path to the LittleFS file
+//   display: Address of Print object for error output, may be nullptr
+// Outputs:
+//   Returns true if successful and false upon failure
+bool r4aOv2640RecorderLoad(R4A_OV2640_RECORDER * recorder,
+                           const char * path,
+                           Print * display = nullptr);
+
+// Stop recording and write the recording to a file
+// Inputs:
+//   recorder: Address of a R4A_OV2640_RECORDER data structure
+//   path: Path to the LittleFS file
+//   display: Address of Print object for error output, may be nullptr
+// Outputs:
+//   Returns true if successful and false upon failure
+bool r4aOv2640RecorderSave(R4A_OV2640_RECORDER * recorder,
+                           const char * path,
+                           Print * display = nullptr);
+
+// Stop recording and wait until r4aOv2640RecorderAdd is done with the
+// recording buffer
+// Inputs:
+//   recorder: Address of a R4A_OV2640_RECORDER data structure
+void r4aOv2640RecorderStop(R4A_OV2640_RECORDER * recorder);
+
+// Pass the recorded frames to a frame processing routine as fast as
+// they are processed
+// Inputs:
+//   buffer: Address of the recording
+//   length: Number of bytes in the recording
+//   object: Address of a R4A_OV2640 data structure passed to the routine
+//   processFrameBuffer: Routine to process each frame
+//   display: Address of Print object for output, may be nullptr
+// Outputs:
+//   Returns the number of frames processed
+uint32_t r4aOv2640Replay(const uint8_t * buffer,
+                         size_t length,
+                         R4A_OV2640 * object,
+                         R4A_OV2640_PROCESS_FRAME_BUFFER processFrameBuffer,
+                         Print * display = nullptr);
+
+// Read a bank of registers into the shadow copy
+// Inputs:
+//   object: Address of a R4A_OV2640 data structure
+//   bank: Register bank, R4A_OV2640_BANK_DSP or R4A_OV2640_BANK_SENSOR
+//   display: Address of Print object for error output, may be nullptr
+// Outputs:
+//   Returns true if successful and false upon failure
+bool r4aOv2640RegisterCacheFill(R4A_OV2640 * object,
+                                uint8_t bank,
+                                Print * display = nullptr);
+
+// Discard the shadow copy of the registers, call after using the
+// camera driver's sensor_t routines
+// Inputs:
+//   object: Address of a R4A_OV2640 data structure
+void r4aOv2640RegisterCacheInvalidate(R4A_OV2640 * object);
+
+// Read a register, the value comes from the shadow copy unless the
+// register is volatile or has not been read
+// Inputs:
+//   object: Address of a R4A_OV2640 data structure
+//   bank: Register bank, R4A_OV2640_BANK_DSP or R4A_OV2640_BANK_SENSOR
+//   reg: Register address
+//   value: Address of the byte to receive the register value
+//   display: Address of Print object for error output, may be nullptr
+// Outputs:
+//   Returns true if successful and false upon failure
+bool r4aOv2640RegisterRead(R4A_OV2640 * object,
+                           uint8_t bank,
+                           uint8_t reg,
+                           uint8_t * value,
+                           Print * display = nullptr);
+
+// Mark a register as volatile, volatile registers are always read from
+// the camera
+// Inputs:
+//   object: Address of a R4A_OV2640 data structure
+//   bank: Register bank, R4A_OV2640_BANK_DSP or R4A_OV2640_BANK_SENSOR
+//   reg: Register address
+//   isVolatile: Set to true if the camera changes the register value
+void r4aOv2640RegisterVolatile(R4A_OV2640 * object,
+                               uint8_t bank,
+                               uint8_t reg,
+                               bool isVolatile);
+
+// Write a register
+// Inputs:
+//   object: Address of a R4A_OV2640 data structure
+//   bank: Register bank, R4A_OV2640_BANK_DSP or R4A_OV2640_BANK_SENSOR
+//   reg: Register address
+//   value: Value to write into the register
+//   display: Address of Print object for error output, may be nullptr
+// Outputs:
+//   Returns true if successful and false upon failure
+bool r4aOv2640RegisterWrite(R4A_OV2640 * object,
+                            uint8_t bank,
+                            uint8_t reg,
+                            uint8_t value,
+                            Print * display = nullptr);
+
+// Write a list of registers while holding the I2C bus, registers that
+// already contain the value are skipped, each register written is an I2C
+// transaction
+// Inputs:
+//   object: Address of a R4A_OV2640 data structure
+//   list: Address of the {register, value} list, register 0xff selects
+//         the bank for the following entries, starts in the DSP bank
+//   entries: Number of entries in the list
+//   display: Address of Print object for error output, may be nullptr
+// Outputs:
+//   Returns true if successful and false upon failure
+bool r4aOv2640RegisterWriteList(R4A_OV2640 * object,
+                                const uint8_t (*list)[2],
+                                size_t entries,
+                                Print * display = nullptr);
+
+// Display the floor remap tables
+// Inputs:
+//   remap: Address of a R4A_OV2640_REMAP data structure
+//   display: Address of Print object for output
+void r4aOv2640RemapDisplay(R4A_OV2640_REMAP * remap,
+                           Print * display = &Serial);
+
+// Free the floor remap tables
+// Inputs:
+//   remap: Address of a R4A_OV2640_REMAP data structure
+void r4aOv2640RemapFree(R4A_OV2640_REMAP * remap);
+
+// Convert the line detection results into floor distances
+// Inputs:
+//   remap: Address of a R4A_OV2640_REMAP data structure
+//   line: Address of a R4A_OV2640_LINE data structure
+//   lateralMm: Address of the value to receive the average distance of
+//              the line to the right of the camera
+//   angleDegrees: Address of the value to receive the line heading on
+//                 the floor, positive leans to the right
+// Outputs:
+//   Returns true if any of the line points are on the floor
+bool r4aOv2640RemapLine(const R4A_OV2640_REMAP * remap,
+                        const R4A_OV2640_LINE * line,
+                        float * lateralMm,
+                        float * angleDegrees);
+
+// Display the floor remap tables
+// Inputs:
+//   menuEntry: Address of the object describing the menu entry,
+//              menuParam contains the address of the R4A_OV2640_REMAP object
+//   command: Zero terminated command string
+//   display: Device used for output
+void r4aOv2640RemapMenuDisplay(const struct _R4A_MENU_ENTRY * menuEntry,
+                               const char * command,
+                               Print * display);
+
+// Convert an image point into a floor position
+// Inputs:
+//   remap: Address of a R4A_OV2640_REMAP data structure
+//   x: Image column
+//   y: Image row, row zero is the top of the image
+//   forwardMm: Address of the value to receive the distance in front
+//              of the camera
+//   lateralMm: Address of the value to receive the distance to the
+//              right of the camera
+// Outputs:
+//   Returns true if the point is on the floor and false otherwise
+bool r4aOv2640RemapPoint(const R4A_OV2640_REMAP * remap,
+                         float x,
+                         float y,
+                         float * forwardMm,
+                         float * lateralMm);
+
+// Rebuild the floor remap tables when the frame size or camera pose
+// changes
+// Inputs:
+//   remap: Address of a R4A_OV2640_REMAP data structure
+//   width: Frame width in pixels
+//   height: Frame height in pixels
+//   panDegrees: Pan servo position
+//   tiltDegrees: Tilt servo position
+//   display: Address of Print object for error output, may be nullptr
+// Outputs:
+//   Returns true if the tables are valid and false upon error
+bool r4aOv2640RemapUpdate(R4A_OV2640_REMAP * remap,
+                          uint16_t width,
+                          uint16_t height,
+                          uint8_t panDegrees,
+                          uint8_t tiltDegrees,
+                          Print * display = nullptr);
+
+// Convert RGB565 pixels to hue bins
+// Inputs:
+//   src: Address of the RGB565 pixels, 32-bit aligned
+//   dst: Address of the buffer to receive one bin number per pixel
+//   pixelCount: Number of pixels to convert
+//   bins: Number of hue bins (1 - 255), bin zero starts at red
+//   minimumChroma: Minimum difference between the largest and smallest
+//                  5-bit color components, pixels with less chroma are
+//                  set to R4A_OV2640_HUE_NONE
+void r4aOv2640Rgb565ToHue(const uint8_t * src,
+                          uint8_t * dst,
+                          size_t pixelCount,
+                          uint8_t bins,
+                          uint8_t minimumChroma);
+
+// Convert RGB565 pixels to luminance
+// Inputs:
+//   src: Address of the RGB565 pixels, 32-bit aligned
+//   dst: Address of the buffer to receive the Y8 pixels, 32-bit aligned
+//   pixelCount: Number of pixels to convert
+void r4aOv2640Rgb565ToY8(const uint8_t * src,
+                         uint8_t * dst,
+                         size_t pixelCount);
+
 // Initialize the camera
 // Inputs:
 //   object: Address of a R4A_OV2640 data structure
 //   pixelFormat: Pixel format to use for the image
 //   display: Address of Print object for debug output, may be nullptr
+//   lowLatency: Set to true to always process the newest frame, older
+//               frames are dropped by the camera driver
 bool r4aOv2640Setup(R4A_OV2640 * object,
                     pixformat_t pixelFormat,
-                    Print * display = nullptr);
+                    Print * display = nullptr,
+                    bool lowLatency = false);
+
+// Record the duration of a pipeline stage
+// Inputs:
+//   object: Address of a R4A_OV2640 data structure
+//   stage: Pipeline stage, R4A_OV2640_STAGE_*
+//   usec: Duration of the stage in microseconds
+void r4aOv2640StageAdd(R4A_OV2640 * object,
+                       uint8_t stage,
+                       uint32_t usec);
+
+// Clear the pipeline stage timing
+// Inputs:
+//   object: Address of a R4A_OV2640 data structure
+void r4aOv2640StageStatsReset(R4A_OV2640 * object);
+
+// Start a task to process the camera frames, replaces calling
+// r4aOv2640Update from loop
+// Inputs:
+//   object: Address of a R4A_OV2640 data structure
+//   core: CPU core number for the task
+//   priority: Priority for the task, loop runs at priority 1
+//   enable: Address of a bool that enables frame processing when true,
+//           may be nullptr to always process frames
+//   display: Address of Print object for error output, may be nullptr
+// Outputs:
+//   Returns true if the task was started and false upon failure
+bool r4aOv2640TaskStart(R4A_OV2640 * object,
+                        BaseType_t core,
+                        UBaseType_t priority,
+                        volatile bool * enable,
+                        Print * display = nullptr);
 
 // Update the camera processing state
 // Inputs:
@@ -747,12 +1842,122 @@ bool r4aOv2640Setup(R4A_OV2640 * object,
 void r4aOv2640Update(R4A_OV2640 * object,
                      Print * display = nullptr);
 
+// Downsample the view by two in each direction using a 2 x 2 box filter
+// Inputs:
+//   src: Address of the PIXFORMAT_RGB565 or PIXFORMAT_GRAYSCALE view
+//   dst: Address of the output view, _buf and _stride must be set by
+//        the caller, the buffer must hold (src->_height / 2) rows
+//   display: Address of Print object for error output, may be nullptr
+// Outputs:
+//   Returns true if successful and false upon error
+bool r4aOv2640ViewDownsample2x(const R4A_OV2640_VIEW * src,
+                               R4A_OV2640_VIEW * dst,
+                               Print * display = nullptr);
+
+// Describe the frame buffer with a view
+// Inputs:
+//   view: Address of the R4A_OV2640_VIEW to initialize
+//   frameBuffer: Buffer containing the raw image data
+//   display: Address of Print object for error output, may be nullptr
+// Outputs:
+//   Returns true if successful and false for compressed pixel formats
+bool r4aOv2640ViewFrame(R4A_OV2640_VIEW * view,
+                        camera_fb_t * frameBuffer,
+                        Print * display = nullptr);
+
+// Describe a region of interest within another view without copying
+// the pixels
+// Inputs:
+//   view: Address of the R4A_OV2640_VIEW to initialize
+//   parent: Address of the view containing the region
+//   x: Left column of the region within the parent view
+//   y: Top row of the region within the parent view
+//   width: Width of the region in pixels, clipped to the parent
+//   height: Height of the region in pixels, clipped to the parent
+// Outputs:
+//   Returns true if successful and false if the region is empty
+bool r4aOv2640ViewRoi(R4A_OV2640_VIEW * view,
+                      const R4A_OV2640_VIEW * parent,
+                      uint16_t x,
+                      uint16_t y,
+                      uint16_t width,
+                      uint16_t height);
+
+// Display the WebSocket channel status
+// Inputs:
+//   webSocket: Address of a R4A_OV2640_WEB_SOCKET data structure
+//   display: Address of Print object for output
+void r4aOv2640WebSocketDisplay(R4A_OV2640_WEB_SOCKET * webSocket,
+                               Print * display = &Serial);
+
+// Free the WebSocket message buffer
+// Inputs:
+//   webSocket: Address of a R4A_OV2640_WEB_SOCKET data structure
+void r4aOv2640WebSocketFree(R4A_OV2640_WEB_SOCKET * webSocket);
+
+// Display the WebSocket channel status
+// Inputs:
+//   menuEntry: Address of the object describing the menu entry,
+//              menuParam contains the address of the R4A_OV2640_WEB_SOCKET object
+//   command: Zero terminated command string
+//   display: Device used for output
+void r4aOv2640WebSocketMenuDisplay(const struct _R4A_MENU_ENTRY * menuEntry,
+                                   const char * command,
+                                   Print * display);
+
+// Push the vision results for a frame to the WebSocket subscribers
+// Inputs:
+//   webSocket: Address of a R4A_OV2640_WEB_SOCKET data structure
+//   frameBuffer: Buffer containing the processed image, the thumbnail
+//                is only built for PIXFORMAT_RGB565 or PIXFORMAT_GRAYSCALE
+//   line: Address of the line detection results, may be nullptr
+//   blobs: Address of the blob detection results, may be nullptr
+//   display: Address of Print object for error output, may be nullptr
+// Outputs:
+//   Returns true if the message was queued or there are no subscribers
+//   and false if the frame was dropped or upon error
+bool r4aOv2640WebSocketPublish(R4A_OV2640_WEB_SOCKET * webSocket,
+                               camera_fb_t * frameBuffer,
+                               const R4A_OV2640_LINE * line,
+                               const R4A_OV2640_BLOBS * blobs,
+                               Print * display = nullptr);
+
+// Convert YUV422 (Y0 U Y1 V) pixels to luminance
+// Inputs:
+//   src: Address of the YUV422 pixels, 32-bit aligned
+//   dst: Address of the buffer to receive the Y8 pixels, 32-bit aligned
+//   pixelCount: Number of pixels to convert
+void r4aOv2640Yuv422ToY8(const uint8_t * src,
+                         uint8_t * dst,
+                         size_t pixelCount);
+
 // Return a webpage to the requester containing a JPEG image
 // Inputs:
 //   request: Request from the browser
 esp_err_t r4aOV2640JpegHandler(httpd_req_t *request);
 
+// Return a JSON document containing the pipeline stage timing
+// Inputs:
+//   request: Request from the browser, user_ctx contains the address
+//            of the R4A_OV2640 object
+esp_err_t r4aOv2640StageStatsHandler(httpd_req_t *request);
+
+// Subscribe a browser to the vision results
+// Inputs:
+//   request: Request from the browser, user_ctx contains the address
+//            of the R4A_OV2640_WEB_SOCKET object
+esp_err_t r4aOv2640WebSocketHandler(httpd_req_t *request);
+
 extern bool r4aOv2640JpegDisplayTime;   // Set to true to display the JPEG conversion time
+
+// The JPEG quality is adjusted for each image to approach the smaller of
+// the two targets.  When both values are zero the quality is fixed at
+// R4A_OV2640_JPEG_QUALITY.
+#define R4A_OV2640_JPEG_QUALITY         80  // Default JPEG quality
+#define R4A_OV2640_JPEG_QUALITY_MIN     10  // Lowest adaptive JPEG quality
+#define R4A_OV2640_JPEG_QUALITY_MAX     95  // Highest adaptive JPEG quality
+extern uint32_t r4aOv2640JpegTargetBytes;   // Target JPEG size in bytes, zero disables
+extern uint32_t r4aOv2640JpegLatencyMsec;   // Target JPEG send time, zero disables
 extern const R4A_OV2640_PINS r4aOV2640Pins; // ESP32 WRover camera pins
 
 //****************************************
@@ -795,6 +2000,198 @@ class R4A_ESP32_SPI : public R4A_SPI
     void transfer(const uint8_t * txBuffer, uint8_t * rxBuffer, uint32_t length);
 };
 
+//****************************************
+// Telemetry API
+//****************************************
+
+class R4A_WIFI;
+
+// Add the application values to the telemetry snapshot
+// Inputs:
+//   telemetry: Address of a R4A_TELEMETRY data structure
+typedef void (* R4A_TELEMETRY_SNAPSHOT)(struct _R4A_TELEMETRY * telemetry);
+
+typedef struct _R4A_TELEMETRY
+{
+    // Constants, set during structure initialization
+    char * _buffer;             // Preallocated snapshot buffer
+    size_t _bufferSize;         // Size of the snapshot buffer in bytes
+    R4A_TELEMETRY_SNAPSHOT _snapshot; // Add application values, may be nullptr
+    R4A_WIFI * _wifi;           // WiFi state, may be nullptr
+    R4A_OV2640 * _ov2640;       // Camera frame statistics, may be nullptr
+
+    // Snapshot state
+    size_t _length;             // Number of bytes in the snapshot
+    bool _first;                // No values in the current object yet
+    bool _overflow;             // Snapshot did not fit in the buffer
+
+    // Statistics
+    uint32_t _snapshots;        // Number of snapshots built
+    uint32_t _overflows;        // Number of snapshots that did not fit
+    uint32_t _buildUsec;        // Time to build the last snapshot
+    uint32_t _maximumUsec;      // Longest time to build a snapshot
+} R4A_TELEMETRY;
+
+// Server-Sent Events (SSE) telemetry stream
+#define R4A_TELEMETRY_STREAM_CLIENTS    8   // Maximum subscribers
+#define R4A_TELEMETRY_STREAM_SKIPS      8   // Consecutive skipped samples before dropping a subscriber
+
+typedef struct _R4A_TELEMETRY_CLIENT
+{
+    struct _R4A_TELEMETRY_STREAM * _stream; // Stream owning the client
+    int _fd;                    // Client socket
+    bool _active;               // True when the entry is in use
+    bool _closing;              // True after the close is requested
+    uint8_t _skipped;           // Consecutive samples skipped
+    uint32_t _sent;             // Samples sent to the client
+    uint32_t _dropped;          // Samples skipped while the client was busy
+} R4A_TELEMETRY_CLIENT;
+
+typedef struct _R4A_TELEMETRY_STREAM
+{
+    // Constants, set during structure initialization
+    R4A_TELEMETRY * _telemetry; // Snapshot builder, not shared with r4aTelemetryHandler
+    char * _message;            // Preallocated event buffer
+    size_t _messageSize;        // Size of the event buffer in bytes
+    struct _R4A_WEB_SERVER * _webServer; // Web server hosting the stream
+
+    // Subscribers, only changed by the web server task
+    httpd_handle_t _server;     // Server owning the client sockets
+    R4A_TELEMETRY_CLIENT _client[R4A_TELEMETRY_STREAM_CLIENTS];
+
+    // Event, serialized once and sent to each of the subscribers
+    size_t _messageLength;      // Number of bytes in the event
+    volatile bool _sending;     // True while the event is being sent
+    uint32_t _lastMsec;         // Time of the last sample
+
+    // Statistics
+    uint32_t _samples;          // Samples sent to the subscribers
+    uint32_t _samplesDropped;   // Samples skipped while the previous event was sent
+    uint32_t _clientsDropped;   // Slow subscribers disconnected
+    uint32_t _publishUsec;      // Time to build the last event
+    uint32_t _sendUsec;         // Time to send the last event to all subscribers
+    uint32_t _maximumSendUsec;  // Longest time to send an event
+} R4A_TELEMETRY_STREAM;
+
+// Add a boolean value to the telemetry snapshot
+// Inputs:
+//   telemetry: Address of a R4A_TELEMETRY data structure
+//   name: Zero terminated name of the value
+//   value: Value to add
+void r4aTelemetryBool(R4A_TELEMETRY * telemetry, const char * name, bool value);
+
+// Display the telemetry statistics
+// Inputs:
+//   telemetry: Address of a R4A_TELEMETRY data structure
+//   display: Address of Print object for output
+void r4aTelemetryDisplay(R4A_TELEMETRY * telemetry, Print * display = &Serial);
+
+// Add a floating point value to the telemetry snapshot
+// Inputs:
+//   telemetry: Address of a R4A_TELEMETRY data structure
+//   name: Zero terminated name of the value
+//   value: Value to add
+//   decimals: Number of digits following the decimal point
+void r4aTelemetryFloat(R4A_TELEMETRY * telemetry,
+                       const char * name,
+                       double value,
+                       uint8_t decimals);
+
+// Return a JSON document containing the telemetry snapshot
+// Inputs:
+//   request: Request from the browser, user_ctx contains the address
+//            of the R4A_TELEMETRY object
+esp_err_t r4aTelemetryHandler(httpd_req_t *request);
+
+// Add a signed integer value to the telemetry snapshot
+// Inputs:
+//   telemetry: Address of a R4A_TELEMETRY data structure
+//   name: Zero terminated name of the value
+//   value: Value to add
+void r4aTelemetryInt(R4A_TELEMETRY * telemetry, const char * name, int32_t value);
+
+// Display the telemetry statistics
+// Inputs:
+//   menuEntry: Address of the object describing the menu entry,
+//              menuParam contains the address of the R4A_TELEMETRY object
+//   command: Zero terminated command string
+//   display: Device used for output
+void r4aTelemetryMenuDisplay(const struct _R4A_MENU_ENTRY * menuEntry,
+                             const char * command,
+                             Print * display);
+
+// Start an object within the telemetry snapshot
+// Inputs:
+//   telemetry: Address of a R4A_TELEMETRY data structure
+//   name: Zero terminated name of the object
+void r4aTelemetryObjectBegin(R4A_TELEMETRY * telemetry, const char * name);
+
+// End an object within the telemetry snapshot
+// Inputs:
+//   telemetry: Address of a R4A_TELEMETRY data structure
+void r4aTelemetryObjectEnd(R4A_TELEMETRY * telemetry);
+
+// Build the telemetry snapshot in the preallocated buffer, no heap is
+// allocated.  The snapshot contains the uptime, heap, WiFi and camera
+// values followed by the application values and the time needed to
+// build the previous snapshot.
+// Inputs:
+//   telemetry: Address of a R4A_TELEMETRY data structure, only one
+//              snapshot may be built at a time
+// Outputs:
+//   Returns true if the snapshot fit in the buffer and false otherwise
+bool r4aTelemetrySnapshot(R4A_TELEMETRY * telemetry);
+
+// Display the telemetry stream status
+// Inputs:
+//   stream: Address of a R4A_TELEMETRY_STREAM data structure
+//   display: Address of Print object for output
+void r4aTelemetryStreamDisplay(R4A_TELEMETRY_STREAM * stream,
+                               Print * display = &Serial);
+
+// Subscribe a browser to the telemetry stream
+// Inputs:
+//   request: Request from the browser, user_ctx contains the address
+//            of the R4A_TELEMETRY_STREAM object
+esp_err_t r4aTelemetryStreamHandler(httpd_req_t *request);
+
+// Display the telemetry stream status
+// Inputs:
+//   menuEntry: Address of the object describing the menu entry,
+//              menuParam contains the address of the R4A_TELEMETRY_STREAM object
+//   command: Zero terminated command string
+//   display: Device used for output
+void r4aTelemetryStreamMenuDisplay(const struct _R4A_MENU_ENTRY * menuEntry,
+                                   const char * command,
+                                   Print * display);
+
+// Publish a telemetry sample to the stream subscribers, call from loop.
+// The sample is serialized once and the send is queued to the web
+// server task, the caller never waits for the subscribers.
+// Inputs:
+//   stream: Address of a R4A_TELEMETRY_STREAM data structure
+//   currentMsec: Number of milliseconds since boot
+//   intervalMsec: Milliseconds between samples, zero disables the stream
+void r4aTelemetryStreamUpdate(R4A_TELEMETRY_STREAM * stream,
+                              uint32_t currentMsec,
+                              uint32_t intervalMsec);
+
+// Add a string value to the telemetry snapshot
+// Inputs:
+//   telemetry: Address of a R4A_TELEMETRY data structure
+//   name: Zero terminated name of the value
+//   value: Zero terminated string to add, nullptr adds null
+void r4aTelemetryString(R4A_TELEMETRY * telemetry,
+                        const char * name,
+                        const char * value);
+
+// Add an unsigned integer value to the telemetry snapshot
+// Inputs:
+//   telemetry: Address of a R4A_TELEMETRY data structure
+//   name: Zero terminated name of the value
+//   value: Value to add
+void r4aTelemetryUint(R4A_TELEMETRY * telemetry, const char * name, uint32_t value);
+
 //****************************************
 // Timer API
 //****************************************
@@ -893,7 +2290,11 @@ bool r4aEsp32WpReadPoint(File * file,
 // Web Server API
 //****************************************
 
-// Update the configuration
+#define R4A_WEB_SERVER_ASYNC_WORKERS_MAX    4   // Maximum async worker tasks
+#define R4A_WEB_SERVER_BUFFERS_MAX          32  // Maximum response buffers, bits in _bufferFree
+
+// Update the configuration, may also set the async worker pool and
+// response buffer pool fields of the R4A_WEB_SERVER data structure
 // Inputs:
 //   object: Address of a R4A_WEB_SERVER data structure
 //   config: Address of the HTTP config object
@@ -916,6 +2317,13 @@ typedef bool (* R4A_WEB_SERVER_REGISTER_ERROR_HANDLERS)(struct _R4A_WEB_SERVER *
 //   false upon failure
 typedef bool (* R4A_WEB_SERVER_REGISTER_URI_HANDLERS)(struct _R4A_WEB_SERVER * object);
 
+// Handle a request from the browser
+// Inputs:
+//   request: Address of a HTTP request object
+// Outputs:
+//   Returns the request status
+typedef esp_err_t (* R4A_WEB_SERVER_HANDLER)(httpd_req_t *request);
+
 typedef struct _R4A_WEB_SERVER
 {
     R4A_WEB_SERVER_CONFIG_UPDATE _configUpdate;
@@ -923,11 +2331,79 @@ typedef struct _R4A_WEB_SERVER
     R4A_WEB_SERVER_REGISTER_URI_HANDLERS _registerUriHandlers;
     uint16_t _port;             // Port number for the web server
     httpd_handle_t _webServer;  // HTTP server object
+
+    // Async worker pool configuration, set by _configUpdate
+    uint8_t _asyncWorkers;      // Worker tasks, zero runs the handlers in the server task
+    BaseType_t _asyncCore;      // Core for the worker tasks, tskNO_AFFINITY for either core
+    UBaseType_t _asyncPriority; // Worker task priority, zero uses the server task priority
+
+    // Async worker pool, created once and kept across server restarts
+    QueueHandle_t _asyncQueue;  // Requests waiting for a worker
+    SemaphoreHandle_t _asyncIdle;   // Counts the idle workers
+    TaskHandle_t _asyncTask[R4A_WEB_SERVER_ASYNC_WORKERS_MAX]; // Worker tasks
+
+    // Response buffer pool configuration, set by _configUpdate
+    uint8_t _bufferCount;       // Number of buffers, zero allocates each buffer from the heap
+    size_t _bufferSize;         // Size of each buffer in bytes
+
+    // Response buffer pool, allocated once and kept across server restarts
+    uint8_t * _bufferPool;      // Preallocated buffers, PSRAM when available
+    uint32_t _bufferFree;       // Bit mask of the available buffers
 } R4A_WEB_SERVER;
 
 extern Print * r4aWebServerDebug;   // Address of a Print object for web server debugging
 extern const char * r4aWebServerDownloadArea;   // Directory path for the download area
 extern const char * r4aWebServerNvmArea;   // Directory path for the NVM download area
+extern const char * r4aWebServerStaticArea;    // Directory path for the static web content
+extern uint32_t r4aWebServerUploadMaximum;      // Largest file upload in bytes, zero for no limit
+
+// Run a long request handler on an async worker task, allowing the
+// server task to handle other requests.  Called at the start of the
+// handler, the handler continues when ESP_ERR_NOT_FOUND is returned.
+// Inputs:
+//   request: Address of a HTTP request object
+//   handler: Handler to call on the worker task with a copy of the request
+// Outputs:
+//   Returns ESP_ERR_NOT_FOUND when the caller must handle the request:
+//   the worker pool is not running or the caller is already a worker.
+//   Otherwise returns the status of passing the request to a worker or
+//   of sending the busy (503) response when all workers are in use.
+esp_err_t r4aWebServerAsync(httpd_req_t *request, R4A_WEB_SERVER_HANDLER handler);
+
+// Start the async worker tasks, called by r4aWebServerStart after
+// _configUpdate.  The tasks are started once and remain running.
+// Inputs:
+//   object: Address of a R4A_WEB_SERVER data structure
+//   config: Address of the HTTP config object
+// Outputs:
+//   Returns true if the workers are running or disabled and false upon
+//   failure, the handlers then run in the server task
+bool r4aWebServerAsyncStart(R4A_WEB_SERVER * object, httpd_config_t * config);
+
+// Get a response buffer from the web server's buffer pool, without
+// taking a lock.  The buffer is allocated from the heap when the pool
+// is empty or not configured.
+// Inputs:
+//   request: Address of a HTTP request object
+//   length: Address to receive the buffer length in bytes
+// Outputs:
+//   Returns the address of the buffer or nullptr upon failure
+uint8_t * r4aWebServerBufferGet(httpd_req_t *request, size_t * length);
+
+// Allocate the response buffer pool, called by r4aWebServerStart after
+// _configUpdate.  The pool is allocated once and remains allocated.
+// Inputs:
+//   object: Address of a R4A_WEB_SERVER data structure
+// Outputs:
+//   Returns true if the pool is allocated or not configured and false
+//   upon failure, the buffers are then allocated from the heap
+bool r4aWebServerBufferPoolAllocate(R4A_WEB_SERVER * object);
+
+// Return a buffer obtained from r4aWebServerBufferGet
+// Inputs:
+//   request: Address of a HTTP request object
+//   buffer: Address of the buffer
+void r4aWebServerBufferRelease(httpd_req_t *request, uint8_t * buffer);
 
 // Check for extension
 // Inputs:
@@ -956,6 +2432,73 @@ esp_err_t r4aWebServerError (httpd_req_t *request, httpd_err_code_t error);
 //   Returns the file download status
 esp_err_t r4aWebServerFileDownload(httpd_req_t *request);
 
+// Send part of a file to the browser as one or more chunks, the caller
+// sends the final (empty) chunk
+// Inputs:
+//   request: Address of a HTTP request object
+//   file: Address of an open file positioned at the first byte to send
+//   length: Number of bytes to send
+// Outputs:
+//   Returns true if the data was sent and false upon failure
+bool r4aWebServerFileSend(httpd_req_t *request, File * file, size_t length);
+
+// Upload a file from the browser to the robot with PUT or POST.  The
+// request body is written to a temporary file which replaces the
+// existing file once the entire body is received.
+// Inputs:
+//   request: Address of a HTTP request object, the URI starts with
+//            r4aWebServerNvmArea followed by the LittleFS path
+// Outputs:
+//   Returns the file upload status
+esp_err_t r4aWebServerFileUpload(httpd_req_t *request);
+
+// Look up the MIME type for a file
+// Inputs:
+//   path: Zero terminated string containing the file's path
+// Outputs:
+//   Returns the MIME type for the file's extension or nullptr if the
+//   extension is not known
+const char * r4aWebServerMimeType(const char * path);
+
+// Byte range within a file
+typedef struct _R4A_WEB_SERVER_RANGE
+{
+    size_t _offset;             // Offset of the first byte
+    size_t _length;             // Number of bytes
+} R4A_WEB_SERVER_RANGE;
+
+#define R4A_WEB_SERVER_RANGES_MAX   8   // Most ranges in a request
+
+// Parse the value of a Range header
+// Inputs:
+//   value: Zero terminated Range header value, "bytes=0-99,-100"
+//   fileSize: Number of bytes in the file
+//   ranges: Address of an array to receive the ranges
+//   maximumRanges: Number of entries in the ranges array
+// Outputs:
+//   Returns the number of ranges within the file, zero if none of the
+//   ranges are within the file and -1 if the value is not valid or there
+//   are too many ranges
+int r4aWebServerRangeParse(const char * value,
+                           size_t fileSize,
+                           R4A_WEB_SERVER_RANGE * ranges,
+                           int maximumRanges);
+
+// Send the byte ranges of a file requested by the Range header, a single
+// range is sent as a 206 (Partial Content) response and multiple ranges
+// as a multipart/byteranges response
+// Inputs:
+//   request: Address of a HTTP request object
+//   file: Address of the open file
+//   dataType: MIME type of the file
+// Outputs:
+//   Returns ESP_ERR_NOT_FOUND when the request does not contain a usable
+//   Range header and the whole file needs to be sent, otherwise returns
+//   the status of the response
+esp_err_t r4aWebServerRangeSend(httpd_req_t *request,
+                                File * file,
+                                const char * dataType);
+
 // Start the web server
 // Inputs:
 //   object: Address of a R4A_WEB_SERVER data structure
@@ -964,6 +2507,16 @@ esp_err_t r4aWebServerFileDownload(httpd_req_t *request);
 //   upon failure
 bool r4aWebServerStart(R4A_WEB_SERVER * object);
 
+// Serve static content from LittleFS, supporting the ETag and
+// Last-Modified validators, 304 (Not Modified) responses and
+// precompressed .gz files
+// Inputs:
+//   request: Address of a HTTP request object, the URI must start with
+//            r4aWebServerStaticArea, the URI path is the LittleFS path
+// Outputs:
+//   Returns the file download status
+esp_err_t r4aWebServerStaticFile(httpd_req_t *request);
+
 // Stop the web server
 // Inputs:
 //   object: Address of a R4A_WEB_SERVER data structure
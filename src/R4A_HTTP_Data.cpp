@@ -43,3 +43,34 @@ const char * r4aHttpErrorName[] =
     "HTTPD_414_URI_TOO_LONG",
     "HTTPD_431_REQ_HDR_FIELDS_TOO_LARGE",
 };
+
+// File extension to MIME type mapping, see r4aWebServerMimeType
+const R4A_HTTP_MIME_TYPE r4aHttpMimeType[] =
+{
+    {"bin",     "application/octet-stream"},
+    {"bmp",     "image/bmp"},
+    {"css",     "text/css"},
+    {"csv",     "text/csv"},
+    {"gif",     "image/gif"},
+    {"gz",      "application/gzip"},
+    {"htm",     "text/html"},
+    {"html",    "text/html"},
+    {"ico",     "image/x-icon"},
+    {"jpeg",    "image/jpeg"},
+    {"jpg",     "image/jpeg"},
+    {"js",      "application/javascript"},
+    {"json",    "application/json"},
+    {"log",     "text/plain"},
+    {"map",     "application/json"},
+    {"mjs",     "application/javascript"},
+    {"png",     "image/png"},
+    {"rec",     "application/octet-stream"},
+    {"svg",     "image/svg+xml"},
+    {"txt",     "text/plain"},
+    {"wasm",    "application/wasm"},
+    {"webp",    "image/webp"},
+    {"woff",    "font/woff"},
+    {"woff2",   "font/woff2"},
+    {"xml",     "text/xml"},
+};
+const int r4aHttpMimeTypeCount = sizeof(r4aHttpMimeType) / sizeof(r4aHttpMimeType[0]);
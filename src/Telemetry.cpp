@@ -0,0 +1,265 @@
+/**********************************************************************
+  Telemetry.cpp
+
+  Robots-For-All (R4A)
+  Robot telemetry snapshot
+
+  The snapshot is a compact JSON document built in a preallocated
+  buffer without any heap allocation.  The values are read directly
+  from the library and application variables, the largest costs are
+  the formatting of the numbers and the heap statistics which walk the
+  heap regions.  The time to build each snapshot is measured and
+  reported in the following snapshot as well as by
+  r4aTelemetryDisplay.
+**********************************************************************/
+
+#include "R4A_ESP32.h"
+
+//*********************************************************************
+// Append formatted text to the snapshot
+static void r4aTelemetryAppend(R4A_TELEMETRY * telemetry,
+                               const char * format,
+                               ...)
+{
+    va_list args;
+    int length;
+    size_t space;
+
+    if (telemetry->_overflow)
+        return;
+
+    // Format the text into the remaining space
+    space = telemetry->_bufferSize - telemetry->_length;
+    va_start(args, format);
+    length = vsnprintf(&telemetry->_buffer[telemetry->_length], space, format, args);
+    va_end(args);
+
+    // Detect the overflow
+    if ((length < 0) || ((size_t)length >= space))
+    {
+        telemetry->_overflow = true;
+        return;
+    }
+    telemetry->_length += length;
+}
+
+//*********************************************************************
+// Append the separator and value name to the snapshot
+static void r4aTelemetryName(R4A_TELEMETRY * telemetry, const char * name)
+{
+    r4aTelemetryAppend(telemetry, "%s\"%s\":", telemetry->_first ? "" : ",", name);
+    telemetry->_first = false;
+}
+
+//*********************************************************************
+// Add a boolean value to the telemetry snapshot
+void r4aTelemetryBool(R4A_TELEMETRY * telemetry, const char * name, bool value)
+{
+    r4aTelemetryName(telemetry, name);
+    r4aTelemetryAppend(telemetry, value ? "true" : "false");
+}
+
+//*********************************************************************
+// Display the telemetry statistics
+void r4aTelemetryDisplay(R4A_TELEMETRY * telemetry, Print * display)
+{
+    display->println("Telemetry");
+    display->printf("    Snapshots: %lu\r\n", telemetry->_snapshots);
+    display->printf("    Overflows: %lu\r\n", telemetry->_overflows);
+    display->printf("    Length: %d of %d bytes\r\n",
+                    telemetry->_length, telemetry->_bufferSize);
+    display->printf("    Build time: %lu uSec, maximum %lu uSec\r\n",
+                    telemetry->_buildUsec, telemetry->_maximumUsec);
+}
+
+//*********************************************************************
+// Add a floating point value to the telemetry snapshot
+void r4aTelemetryFloat(R4A_TELEMETRY * telemetry,
+                       const char * name,
+                       double value,
+                       uint8_t decimals)
+{
+    r4aTelemetryName(telemetry, name);
+
+    // JSON does not support NaN or infinity
+    if (isfinite(value))
+        r4aTelemetryAppend(telemetry, "%.*f", decimals, value);
+    else
+        r4aTelemetryAppend(telemetry, "null");
+}
+
+//*********************************************************************
+// Return a JSON document containing the telemetry snapshot
+esp_err_t r4aTelemetryHandler(httpd_req_t *request)
+{
+    R4A_TELEMETRY * telemetry;
+
+    // Get the telemetry data structure address
+    telemetry = (R4A_TELEMETRY *)request->user_ctx;
+
+    // Build the snapshot
+    if (!r4aTelemetrySnapshot(telemetry))
+    {
+        if (r4aWebServerDebug)
+            r4aWebServerDebug->printf("ERROR: Telemetry snapshot larger than %d bytes!\r\n",
+                                      telemetry->_bufferSize);
+        httpd_resp_send_err(request, HTTPD_500_INTERNAL_SERVER_ERROR, "Telemetry buffer too small");
+        return ESP_FAIL;
+    }
+
+    // Send the snapshot
+    httpd_resp_set_type(request, "application/json");
+    httpd_resp_set_hdr(request, "Access-Control-Allow-Origin", "*");
+    httpd_resp_set_hdr(request, "Cache-Control", "no-store");
+    return httpd_resp_send(request, telemetry->_buffer, telemetry->_length);
+}
+
+//*********************************************************************
+// Add a signed integer value to the telemetry snapshot
+void r4aTelemetryInt(R4A_TELEMETRY * telemetry, const char * name, int32_t value)
+{
+    r4aTelemetryName(telemetry, name);
+    r4aTelemetryAppend(telemetry, "%ld", value);
+}
+
+//*********************************************************************
+// Display the telemetry statistics
+void r4aTelemetryMenuDisplay(const struct _R4A_MENU_ENTRY * menuEntry,
+                             const char * command,
+                             Print * display)
+{
+    r4aTelemetryDisplay((R4A_TELEMETRY *)menuEntry->menuParameter, display);
+}
+
+//*********************************************************************
+// Start an object within the telemetry snapshot
+void r4aTelemetryObjectBegin(R4A_TELEMETRY * telemetry, const char * name)
+{
+    r4aTelemetryName(telemetry, name);
+    r4aTelemetryAppend(telemetry, "{");
+    telemetry->_first = true;
+}
+
+//*********************************************************************
+// End an object within the telemetry snapshot
+void r4aTelemetryObjectEnd(R4A_TELEMETRY * telemetry)
+{
+    r4aTelemetryAppend(telemetry, "}");
+    telemetry->_first = false;
+}
+
+//*********************************************************************
+// Build the telemetry snapshot in the preallocated buffer
+bool r4aTelemetrySnapshot(R4A_TELEMETRY * telemetry)
+{
+    R4A_OV2640 * ov2640;
+    int64_t startUsec;
+    uint32_t usec;
+    R4A_WIFI * wifi;
+
+    startUsec = esp_timer_get_time();
+    telemetry->_length = 0;
+    telemetry->_overflow = (telemetry->_bufferSize == 0);
+    telemetry->_first = true;
+    r4aTelemetryAppend(telemetry, "{");
+
+    // Add the system values
+    r4aTelemetryUint(telemetry, "uptimeMsec", millis());
+    r4aTelemetryObjectBegin(telemetry, "heap");
+    r4aTelemetryUint(telemetry, "free", ESP.getFreeHeap());
+    r4aTelemetryUint(telemetry, "minimum", xPortGetMinimumEverFreeHeapSize());
+    r4aTelemetryUint(telemetry, "largest", heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+    r4aTelemetryUint(telemetry, "psramFree", ESP.getFreePsram());
+    r4aTelemetryObjectEnd(telemetry);
+
+    // Add the WiFi state
+    wifi = telemetry->_wifi;
+    if (wifi)
+    {
+        r4aTelemetryObjectBegin(telemetry, "wifi");
+        r4aTelemetryBool(telemetry, "connected", wifi->stationConnected());
+        r4aTelemetryBool(telemetry, "hasIp", wifi->stationHasIp());
+        if (wifi->stationConnected())
+        {
+            r4aTelemetryString(telemetry, "ssid", wifi->ssidGet());
+            r4aTelemetryUint(telemetry, "channel", wifi->channelGet());
+            r4aTelemetryInt(telemetry, "rssi", WiFi.RSSI());
+        }
+        r4aTelemetryObjectEnd(telemetry);
+    }
+
+    // Add the camera frame statistics
+    ov2640 = telemetry->_ov2640;
+    if (ov2640)
+    {
+        r4aTelemetryObjectBegin(telemetry, "camera");
+        r4aTelemetryUint(telemetry, "frames", ov2640->_frameNumber);
+        r4aTelemetryUint(telemetry, "dropped", ov2640->_framesDropped);
+        r4aTelemetryUint(telemetry, "fpsX100", ov2640->_framesPerSecondX100);
+        r4aTelemetryUint(telemetry, "queueDepth", ov2640->_queueDepth);
+        r4aTelemetryUint(telemetry, "frameAgeUsec", ov2640->_frameAgeUsec);
+        r4aTelemetryObjectEnd(telemetry);
+    }
+
+    // Add the application values
+    if (telemetry->_snapshot)
+        telemetry->_snapshot(telemetry);
+
+    // Add the cost of the previous snapshot
+    r4aTelemetryUint(telemetry, "snapshotUsec", telemetry->_buildUsec);
+    telemetry->_first = false;
+    r4aTelemetryAppend(telemetry, "}");
+
+    // Account for the snapshot
+    usec = (uint32_t)(esp_timer_get_time() - startUsec);
+    telemetry->_buildUsec = usec;
+    if (telemetry->_maximumUsec < usec)
+        telemetry->_maximumUsec = usec;
+    telemetry->_snapshots += 1;
+    if (telemetry->_overflow)
+    {
+        telemetry->_overflows += 1;
+        telemetry->_length = 0;
+        if (telemetry->_bufferSize)
+            telemetry->_buffer[0] = 0;
+        return false;
+    }
+    return true;
+}
+
+//*********************************************************************
+// Add a string value to the telemetry snapshot
+void r4aTelemetryString(R4A_TELEMETRY * telemetry,
+                        const char * name,
+                        const char * value)
+{
+    char character;
+
+    r4aTelemetryName(telemetry, name);
+    if (!value)
+    {
+        r4aTelemetryAppend(telemetry, "null");
+        return;
+    }
+
+    // Escape the quotes, backslashes and control characters
+    r4aTelemetryAppend(telemetry, "\"");
+    while ((character = *value++))
+    {
+        if ((character == '"') || (character == '\\'))
+            r4aTelemetryAppend(telemetry, "\\%c", character);
+        else if ((uint8_t)character < ' ')
+            r4aTelemetryAppend(telemetry, "\\u%04x", (uint8_t)character);
+        else
+            r4aTelemetryAppend(telemetry, "%c", character);
+    }
+    r4aTelemetryAppend(telemetry, "\"");
+}
+
+//*********************************************************************
+// Add an unsigned integer value to the telemetry snapshot
+void r4aTelemetryUint(R4A_TELEMETRY * telemetry, const char * name, uint32_t value)
+{
+    r4aTelemetryName(telemetry, name);
+    r4aTelemetryAppend(telemetry, "%lu", value);
+}
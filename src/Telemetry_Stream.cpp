@@ -0,0 +1,277 @@
+/**********************************************************************
+  Telemetry_Stream.cpp
+
+  Robots-For-All (R4A)
+  Server-Sent Events (SSE) telemetry stream
+
+  A browser subscribes with an EventSource on the stream URI.  The
+  handler sends the response header and leaves the connection open,
+  the body is the stream of events.  At each interval the snapshot is
+  built once into the event buffer and a single work item is queued to
+  the web server task to send the event to each of the subscribers.
+
+  The loop never waits for the subscribers: samples are skipped while
+  the previous event is still being sent.  The sends don't block the
+  web server task either: a subscriber whose socket is full skips the
+  sample (decimation) and is disconnected after skipping
+  R4A_TELEMETRY_STREAM_SKIPS samples in a row or after a partial send.
+
+  The cost with 1, 4 or 8 subscribers is displayed by
+  r4aTelemetryStreamDisplay: _publishUsec is the loop's cost to build
+  the event and _sendUsec is the web server task's cost to send the
+  event to all of the subscribers.
+**********************************************************************/
+
+#include "R4A_ESP32.h"
+
+//****************************************
+// Constants
+//****************************************
+
+#define R4A_TELEMETRY_STREAM_HEADER     "HTTP/1.1 200 OK\r\n"                   \
+                                        "Content-Type: text/event-stream\r\n"   \
+                                        "Cache-Control: no-store\r\n"           \
+                                        "Access-Control-Allow-Origin: *\r\n"    \
+                                        "\r\n"                                  \
+                                        ": connected\n\n"
+
+//*********************************************************************
+// Forget the subscriber when the web server closes the connection
+static void r4aTelemetryStreamClose(void * context)
+{
+    R4A_TELEMETRY_CLIENT * client;
+
+    client = (R4A_TELEMETRY_CLIENT *)context;
+    client->_active = false;
+    client->_closing = false;
+}
+
+//*********************************************************************
+// Disconnect a subscriber
+static void r4aTelemetryStreamDrop(R4A_TELEMETRY_STREAM * stream,
+                                   R4A_TELEMETRY_CLIENT * client)
+{
+    // The entry is released by r4aTelemetryStreamClose
+    client->_closing = true;
+    stream->_clientsDropped += 1;
+    httpd_sess_trigger_close(stream->_server, client->_fd);
+}
+
+//*********************************************************************
+// Send the event to each of the subscribers, runs in the web server task
+static void r4aTelemetryStreamSend(void * arg)
+{
+    R4A_TELEMETRY_CLIENT * client;
+    int index;
+    ssize_t sent;
+    int64_t startUsec;
+    R4A_TELEMETRY_STREAM * stream;
+    uint32_t usec;
+
+    stream = (R4A_TELEMETRY_STREAM *)arg;
+    startUsec = esp_timer_get_time();
+    for (index = 0; index < R4A_TELEMETRY_STREAM_CLIENTS; index++)
+    {
+        client = &stream->_client[index];
+        if ((!client->_active) || client->_closing)
+            continue;
+
+        // Don't wait for the subscriber
+        sent = send(client->_fd, stream->_message, stream->_messageLength, MSG_DONTWAIT);
+        if (sent == (ssize_t)stream->_messageLength)
+        {
+            client->_sent += 1;
+            client->_skipped = 0;
+        }
+
+        // Skip the sample when the subscriber's socket is full
+        else if ((sent < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK)))
+        {
+            client->_dropped += 1;
+            client->_skipped += 1;
+            if (client->_skipped >= R4A_TELEMETRY_STREAM_SKIPS)
+                r4aTelemetryStreamDrop(stream, client);
+        }
+
+        // Drop the subscriber after a partial send or error, the event
+        // stream is no longer valid
+        else
+            r4aTelemetryStreamDrop(stream, client);
+    }
+
+    // Account for the send time
+    usec = (uint32_t)(esp_timer_get_time() - startUsec);
+    stream->_sendUsec = usec;
+    if (stream->_maximumSendUsec < usec)
+        stream->_maximumSendUsec = usec;
+
+    // Allow the next event to be built
+    __atomic_store_n(&stream->_sending, false, __ATOMIC_RELEASE);
+}
+
+//*********************************************************************
+// Display the telemetry stream status
+void r4aTelemetryStreamDisplay(R4A_TELEMETRY_STREAM * stream,
+                               Print * display)
+{
+    R4A_TELEMETRY_CLIENT * client;
+    int index;
+
+    display->println("Telemetry stream");
+    display->printf("    Samples: %lu sent, %lu skipped\r\n",
+                    stream->_samples, stream->_samplesDropped);
+    display->printf("    Event: %d bytes, build %lu uSec\r\n",
+                    stream->_messageLength, stream->_publishUsec);
+    display->printf("    Send: %lu uSec, maximum %lu uSec\r\n",
+                    stream->_sendUsec, stream->_maximumSendUsec);
+    display->printf("    Slow subscribers dropped: %lu\r\n", stream->_clientsDropped);
+    display->println("    Socket      Sent   Skipped");
+    display->println("    ------  --------  --------");
+    for (index = 0; index < R4A_TELEMETRY_STREAM_CLIENTS; index++)
+    {
+        client = &stream->_client[index];
+        if (client->_active)
+            display->printf("    %6d  %8lu  %8lu%s\r\n",
+                            client->_fd,
+                            client->_sent,
+                            client->_dropped,
+                            client->_closing ? "  Closing" : "");
+    }
+}
+
+//*********************************************************************
+// Subscribe a browser to the telemetry stream
+esp_err_t r4aTelemetryStreamHandler(httpd_req_t *request)
+{
+    R4A_TELEMETRY_CLIENT * client;
+    int index;
+    R4A_TELEMETRY_STREAM * stream;
+
+    // Get the telemetry stream data structure address
+    stream = (R4A_TELEMETRY_STREAM *)request->user_ctx;
+
+    // Forget the subscribers of a previous server
+    if (stream->_server != request->handle)
+    {
+        for (index = 0; index < R4A_TELEMETRY_STREAM_CLIENTS; index++)
+            stream->_client[index]._active = false;
+        stream->_server = request->handle;
+    }
+
+    // Locate an unused entry
+    client = nullptr;
+    for (index = 0; index < R4A_TELEMETRY_STREAM_CLIENTS; index++)
+        if (!stream->_client[index]._active)
+        {
+            client = &stream->_client[index];
+            break;
+        }
+    if (!client)
+    {
+        if (r4aWebServerDebug)
+            r4aWebServerDebug->printf("ERROR: Too many telemetry stream subscribers!\r\n");
+        httpd_resp_set_status(request, "503 Service Unavailable");
+        return httpd_resp_sendstr(request, "Too many telemetry stream subscribers");
+    }
+
+    // Send the response header, the connection remains open for the events
+    if (httpd_send(request,
+                   R4A_TELEMETRY_STREAM_HEADER,
+                   strlen(R4A_TELEMETRY_STREAM_HEADER)) < 0)
+        return ESP_FAIL;
+
+    // Add the subscriber, the web server calls r4aTelemetryStreamClose
+    // when the connection closes
+    memset(client, 0, sizeof(*client));
+    client->_stream = stream;
+    client->_fd = httpd_req_to_sockfd(request);
+    client->_active = true;
+    request->sess_ctx = client;
+    request->free_ctx = r4aTelemetryStreamClose;
+    if (r4aWebServerDebug)
+        r4aWebServerDebug->printf("Telemetry stream subscriber added, socket %d\r\n",
+                                  client->_fd);
+    return ESP_OK;
+}
+
+//*********************************************************************
+// Display the telemetry stream status
+void r4aTelemetryStreamMenuDisplay(const struct _R4A_MENU_ENTRY * menuEntry,
+                                   const char * command,
+                                   Print * display)
+{
+    r4aTelemetryStreamDisplay((R4A_TELEMETRY_STREAM *)menuEntry->menuParameter,
+                              display);
+}
+
+//*********************************************************************
+// Publish a telemetry sample to the stream subscribers
+void r4aTelemetryStreamUpdate(R4A_TELEMETRY_STREAM * stream,
+                              uint32_t currentMsec,
+                              uint32_t intervalMsec)
+{
+    int index;
+    int length;
+    httpd_handle_t server;
+    int64_t startUsec;
+
+    // Forget the subscribers when the web server stops, the queued work
+    // was discarded with the server
+    server = stream->_webServer ? stream->_webServer->_webServer : nullptr;
+    if ((!server) && stream->_server)
+    {
+        for (index = 0; index < R4A_TELEMETRY_STREAM_CLIENTS; index++)
+            stream->_client[index]._active = false;
+        stream->_server = nullptr;
+        __atomic_store_n(&stream->_sending, false, __ATOMIC_RELEASE);
+    }
+
+    // Wait for the first subscriber of this web server
+    if ((!server) || (server != stream->_server) || (!intervalMsec))
+        return;
+
+    // Wait for the next sample time
+    if ((currentMsec - stream->_lastMsec) < intervalMsec)
+        return;
+    stream->_lastMsec = currentMsec;
+
+    // Nothing to do without subscribers
+    for (index = 0; index < R4A_TELEMETRY_STREAM_CLIENTS; index++)
+        if (stream->_client[index]._active && (!stream->_client[index]._closing))
+            break;
+    if (index >= R4A_TELEMETRY_STREAM_CLIENTS)
+        return;
+
+    // Skip the sample while the previous event is being sent
+    if (__atomic_load_n(&stream->_sending, __ATOMIC_ACQUIRE))
+    {
+        stream->_samplesDropped += 1;
+        return;
+    }
+
+    // Build the event once for all of the subscribers
+    startUsec = esp_timer_get_time();
+    if (!r4aTelemetrySnapshot(stream->_telemetry))
+    {
+        stream->_samplesDropped += 1;
+        return;
+    }
+    length = snprintf(stream->_message, stream->_messageSize, "data: %s\n\n",
+                      stream->_telemetry->_buffer);
+    if ((length < 0) || ((size_t)length >= stream->_messageSize))
+    {
+        stream->_samplesDropped += 1;
+        return;
+    }
+    stream->_messageLength = length;
+    stream->_samples += 1;
+    stream->_publishUsec = (uint32_t)(esp_timer_get_time() - startUsec);
+
+    // Send the event from the web server task
+    __atomic_store_n(&stream->_sending, true, __ATOMIC_RELEASE);
+    if (httpd_queue_work(server, r4aTelemetryStreamSend, stream) != ESP_OK)
+    {
+        __atomic_store_n(&stream->_sending, false, __ATOMIC_RELEASE);
+        stream->_samplesDropped += 1;
+    }
+}
@@ -7,6 +7,15 @@
 
 #include "R4A_ESP32.h"
 
+//****************************************
+// Constants
+//****************************************
+
+#define R4A_WEB_SERVER_UPLOAD_PATH      128     // Longest file path
+#define R4A_WEB_SERVER_UPLOAD_RESERVE   (2 * 4096)  // LittleFS blocks for the metadata
+#define R4A_WEB_SERVER_UPLOAD_RETRIES   3       // Receive timeouts before failing
+#define R4A_WEB_SERVER_UPLOAD_TEMP      ".~"    // Temporary file marker, not allowed in uploads
+
 //****************************************
 // Globals
 //****************************************
@@ -14,6 +23,21 @@
 Print * r4aWebServerDebug;
 const char * r4aWebServerDownloadArea;
 const char * r4aWebServerNvmArea;
+const char * r4aWebServerStaticArea;
+uint32_t r4aWebServerUploadMaximum;
+
+//****************************************
+// Locals
+//****************************************
+
+static uint32_t r4aWebServerUploadCount;   // Numbers the temporary files
+
+//*********************************************************************
+// The R4A_WEB_SERVER object is statically allocated, don't free it when
+// the server stops
+static void r4aWebServerGlobalUserCtxFree(void * context)
+{
+}
 
 //*********************************************************************
 // Check for extension
@@ -45,12 +69,9 @@ esp_err_t r4aWebServerError (httpd_req_t *request,
     };
     const int methodNameEntries = sizeof(methodName) / sizeof(methodName[0]);
     int index;
+    size_t length;
+    char * line;
     const char * method;
-    static char line[1000];
-    R4A_WEB_SERVER * object;
-
-    // Get the web server data structure
-    object = (R4A_WEB_SERVER *)request->user_ctx;
 
     // Get the method name
     method = nullptr;
@@ -61,12 +82,20 @@ esp_err_t r4aWebServerError (httpd_req_t *request,
             break;
         }
 
-    // Send the error to the browser
-    sprintf(line, "<html><body>%s: %s<br>\r\n%s\r\n</body>\r\n</html>\r\n",
-            (method ? method : "Request"),
-            request->uri,
-            r4aHttpErrorName[error]);
+    // Account for the error
+    r4aMetricIncrement(&r4aMetricWebErrors);
+
+    // Send the error to the browser, using the default message when a
+    // buffer is not available
+    line = (char *)r4aWebServerBufferGet(request, &length);
+    if (line)
+        snprintf(line, length, "<html><body>%s: %s<br>\r\n%s\r\n</body>\r\n</html>\r\n",
+                 (method ? method : "Request"),
+                 request->uri,
+                 r4aHttpErrorName[error]);
     httpd_resp_send_err(request, error, line);
+    if (line)
+        r4aWebServerBufferRelease(request, (uint8_t *)line);
 
     // Display the error locally
     if (r4aWebServerDebug)
@@ -85,22 +114,20 @@ esp_err_t r4aWebServerError (httpd_req_t *request,
 // Download a file from the robot to the browser
 esp_err_t r4aWebServerFileDownload(httpd_req_t *request)
 {
-    uint8_t * buffer;
-    const size_t bufferLength = 8192;
-    size_t bytesRead;
     const char * dataType;
     File file;
     const char * path;
+    int64_t startUsec;
     esp_err_t status;
-    R4A_WEB_SERVER * object;
 
-    // Get the web server data structure
-    object = (R4A_WEB_SERVER *)request->user_ctx;
+    // Send the file from an async worker
+    status = r4aWebServerAsync(request, r4aWebServerFileDownload);
+    if (status != ESP_ERR_NOT_FOUND)
+        return status;
 
+    startUsec = esp_timer_get_time();
     do
     {
-        buffer = nullptr;
-
         // Get the file name
         path = request->uri;
 
@@ -124,28 +151,15 @@ esp_err_t r4aWebServerFileDownload(httpd_req_t *request)
         }
 
         // Determine the data type
-        dataType = nullptr;
-        if (r4aWebServerCheckExtension(object, path, ".txt")
-            || r4aWebServerCheckExtension(object, path, ".log"))
-            dataType = "text/plain";
+        dataType = r4aWebServerMimeType(path);
         if (!dataType)
         {
             if (r4aWebServerDebug)
-                r4aWebServerDebug->printf("ERROR: Unknowo file type!\r\n");
+                r4aWebServerDebug->printf("ERROR: Unknown file type!\r\n");
             httpd_resp_send_err(request, HTTPD_500_INTERNAL_SERVER_ERROR, "Unknown file type");
             break;
         }
 
-        // Allocate the buffer
-        buffer = (uint8_t *)malloc(bufferLength);
-        if (!buffer)
-        {
-            if (r4aWebServerDebug)
-                r4aWebServerDebug->printf("ERROR: Failed to allocate the data buffer\r\n");
-            httpd_resp_send_err(request, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to allocate data buffer");
-            break;
-        }
-
         // Open the file
         file = LittleFS.open(path, FILE_READ);
         if (!file)
@@ -165,33 +179,28 @@ esp_err_t r4aWebServerFileDownload(httpd_req_t *request)
             break;
         }
 
-        // Send the file contents to the browser
-        do
+        // Send the requested parts of the file
+        status = r4aWebServerRangeSend(request, &file, dataType);
+        if (status != ESP_ERR_NOT_FOUND)
         {
-            // Read data from the file
-            bytesRead = file.read(buffer, bufferLength);
-
-            // Send a partial response
-            if (bytesRead > 0)
-                status = httpd_resp_send_chunk(request, (char *)buffer, bytesRead);
-            else
-                status = httpd_resp_send_chunk(request, NULL, 0);
-
-            // Process the error
-            if (status != ESP_OK)
-            {
-                if (r4aWebServerDebug)
-                    r4aWebServerDebug->printf("ERROR: Failed to send %d data bytes to browser\r\n", bytesRead);
-                httpd_resp_send_err(request, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to send data to browser");
-                break;
-            }
-        } while (bytesRead > 0);
+            file.close();
+            r4aMetricObserve(&r4aMetricWebDownloads, esp_timer_get_time() - startUsec);
+            return status;
+        }
 
-        // Free the data buffer
-        free(buffer);
+        // Send the file contents to the browser
+        httpd_resp_set_type(request, dataType);
+        httpd_resp_set_hdr(request, "Accept-Ranges", "bytes");
+        if ((!r4aWebServerFileSend(request, &file, file.size()))
+            || (httpd_resp_send_chunk(request, NULL, 0) != ESP_OK))
+        {
+            httpd_resp_send_err(request, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to send data to browser");
+            break;
+        }
 
         // Close the file
         file.close();
+        r4aMetricObserve(&r4aMetricWebDownloads, esp_timer_get_time() - startUsec);
         return ESP_OK;
     } while (0);
 
@@ -199,14 +208,225 @@ esp_err_t r4aWebServerFileDownload(httpd_req_t *request)
     if (file)
         file.close();
 
-    // Free the data buffer
-    if (buffer)
-        free(buffer);
-
     // Failed to access the requested page
+    r4aMetricObserve(&r4aMetricWebDownloads, esp_timer_get_time() - startUsec);
     return ESP_FAIL;
 }
 
+//*********************************************************************
+// Send part of a file to the browser as one or more chunks
+bool r4aWebServerFileSend(httpd_req_t *request, File * file, size_t length)
+{
+    uint8_t * buffer;
+    size_t bufferLength;
+    size_t bytesRead;
+    esp_err_t status;
+
+    // Get a buffer
+    buffer = r4aWebServerBufferGet(request, &bufferLength);
+    if (!buffer)
+        return false;
+
+    // Send the file contents to the browser
+    status = ESP_OK;
+    while (length)
+    {
+        // Read data from the file
+        bytesRead = file->read(buffer, (length < bufferLength) ? length : bufferLength);
+        length -= bytesRead;
+
+        if (bytesRead == 0)
+        {
+            if (r4aWebServerDebug)
+                r4aWebServerDebug->printf("ERROR: Failed to read %d data bytes from the file\r\n", length);
+            status = ESP_FAIL;
+            break;
+        }
+
+        // Send a partial response
+        status = httpd_resp_send_chunk(request, (char *)buffer, bytesRead);
+
+        // Process the error
+        if (status != ESP_OK)
+        {
+            if (r4aWebServerDebug)
+                r4aWebServerDebug->printf("ERROR: Failed to send %d data bytes to browser\r\n", bytesRead);
+            break;
+        }
+    }
+
+    // Return the data buffer
+    r4aWebServerBufferRelease(request, buffer);
+    return (status == ESP_OK);
+}
+
+//*********************************************************************
+// Upload a file from the browser to the robot
+esp_err_t r4aWebServerFileUpload(httpd_req_t *request)
+{
+    uint8_t * buffer;
+    size_t bufferLength;
+    int bytesReceived;
+    File file;
+    size_t freeBytes;
+    size_t length;
+    const char * path;
+    size_t remaining;
+    char response[R4A_WEB_SERVER_UPLOAD_PATH + 32];
+    int retries;
+    esp_err_t status;
+    char tempPath[R4A_WEB_SERVER_UPLOAD_PATH + 16];
+    bool writeFailed;
+
+    // Receive the file on an async worker
+    status = r4aWebServerAsync(request, r4aWebServerFileUpload);
+    if (status != ESP_ERR_NOT_FOUND)
+        return status;
+
+    buffer = nullptr;
+    status = ESP_FAIL;
+    tempPath[0] = 0;
+    do
+    {
+        // Get the file name
+        path = request->uri;
+
+        // Remove the upload prefix
+        if (strncmp(r4aWebServerNvmArea, path, strlen(r4aWebServerNvmArea)) != 0)
+        {
+            if (r4aWebServerDebug)
+                r4aWebServerDebug->printf("ERROR: Not a file upload request\r\n");
+            httpd_resp_send_err(request, HTTPD_500_INTERNAL_SERVER_ERROR, "Not a file upload request");
+            break;
+        }
+        path = &path[strlen(r4aWebServerNvmArea) - 1];
+
+        // Validate the file path
+        length = strlen(path);
+        if (length >= R4A_WEB_SERVER_UPLOAD_PATH)
+        {
+            httpd_resp_send_err(request, HTTPD_414_URI_TOO_LONG, "File path too long");
+            break;
+        }
+        if ((length <= 1) || (path[length - 1] == '/') || strchr(path, '?') || strstr(path, "..")
+            || strstr(path, R4A_WEB_SERVER_UPLOAD_TEMP))
+        {
+            httpd_resp_send_err(request, HTTPD_400_BAD_REQUEST, "Invalid file path");
+            break;
+        }
+
+        // Verify the upload size before receiving any data
+        if (r4aWebServerUploadMaximum && (request->content_len > r4aWebServerUploadMaximum))
+        {
+            if (r4aWebServerDebug)
+                r4aWebServerDebug->printf("ERROR: Upload of %d bytes exceeds the %ld byte limit!\r\n",
+                                          request->content_len, r4aWebServerUploadMaximum);
+            httpd_resp_set_status(request, "413 Payload Too Large");
+            httpd_resp_sendstr(request, "File too large");
+            break;
+        }
+
+        // Verify the free space, the existing file remains until the
+        // upload completes
+        freeBytes = LittleFS.totalBytes() - LittleFS.usedBytes();
+        if ((request->content_len + R4A_WEB_SERVER_UPLOAD_RESERVE) > freeBytes)
+        {
+            if (r4aWebServerDebug)
+                r4aWebServerDebug->printf("ERROR: Upload of %d bytes exceeds the %d bytes free!\r\n",
+                                          request->content_len, freeBytes);
+            httpd_resp_set_status(request, "507 Insufficient Storage");
+            httpd_resp_sendstr(request, "Insufficient free space");
+            break;
+        }
+
+        // Get a buffer
+        buffer = r4aWebServerBufferGet(request, &bufferLength);
+        if (!buffer)
+        {
+            httpd_resp_send_err(request, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to allocate buffer");
+            break;
+        }
+
+        // Create a temporary file for this request, the async workers
+        // may receive several uploads of the same file at once
+        snprintf(tempPath, sizeof(tempPath), "%s" R4A_WEB_SERVER_UPLOAD_TEMP "%lu",
+                 path, __atomic_add_fetch(&r4aWebServerUploadCount, 1, __ATOMIC_RELAXED));
+        file = LittleFS.open(tempPath, FILE_WRITE);
+        if (!file)
+        {
+            if (r4aWebServerDebug)
+                r4aWebServerDebug->printf("ERROR: Failed to create file %s\r\n", tempPath);
+            httpd_resp_send_err(request, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to create file");
+            break;
+        }
+
+        // Write the request body to the temporary file as it arrives
+        remaining = request->content_len;
+        retries = 0;
+        bytesReceived = 0;
+        writeFailed = false;
+        while (remaining)
+        {
+            bytesReceived = httpd_req_recv(request,
+                                           (char *)buffer,
+                                           (remaining < bufferLength)
+                                           ? remaining : bufferLength);
+            if ((bytesReceived == HTTPD_SOCK_ERR_TIMEOUT)
+                && (retries++ < R4A_WEB_SERVER_UPLOAD_RETRIES))
+                continue;
+            if (bytesReceived <= 0)
+                break;
+            retries = 0;
+            if (file.write(buffer, bytesReceived) != (size_t)bytesReceived)
+            {
+                writeFailed = true;
+                break;
+            }
+            remaining -= bytesReceived;
+        }
+        file.close();
+
+        // Handle the receive and write errors
+        if (remaining)
+        {
+            if (r4aWebServerDebug)
+                r4aWebServerDebug->printf("ERROR: Upload of %s failed with %d bytes remaining\r\n",
+                                          path, remaining);
+            if (writeFailed)
+                httpd_resp_send_err(request, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to write file");
+            else if (bytesReceived == HTTPD_SOCK_ERR_TIMEOUT)
+                httpd_resp_send_err(request, HTTPD_408_REQ_TIMEOUT, "Upload timeout");
+            break;
+        }
+
+        // Replace the existing file
+        if (LittleFS.rename(tempPath, path) == false)
+        {
+            if (r4aWebServerDebug)
+                r4aWebServerDebug->printf("ERROR: Failed to rename %s to %s\r\n", tempPath, path);
+            httpd_resp_send_err(request, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to rename file");
+            break;
+        }
+        tempPath[0] = 0;
+
+        // Report the upload success
+        if (r4aWebServerDebug)
+            r4aWebServerDebug->printf("Uploaded %d bytes to %s\r\n", request->content_len, path);
+        snprintf(response, sizeof(response), "Uploaded %d bytes to %s\n",
+                 request->content_len, path);
+        status = httpd_resp_sendstr(request, response);
+    } while (0);
+
+    // Remove the temporary file after a failure
+    if (tempPath[0] && LittleFS.exists(tempPath))
+        LittleFS.remove(tempPath);
+
+    // Return the data buffer
+    if (buffer)
+        r4aWebServerBufferRelease(request, buffer);
+    return status;
+}
+
 //*********************************************************************
 // Start the web server
 bool r4aWebServerStart(R4A_WEB_SERVER * object)
@@ -217,12 +437,21 @@ bool r4aWebServerStart(R4A_WEB_SERVER * object)
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
     config.server_port = object->_port;
 
+    // Locate the R4A_WEB_SERVER object from the request handlers
+    config.global_user_ctx = object;
+    config.global_user_ctx_free_fn = r4aWebServerGlobalUserCtxFree;
+
     // Start the httpd server
     do
     {
         // Update the configuration
         object->_configUpdate(object, &config);
 
+        // Allocate the response buffers and start the async workers
+        // for the long requests
+        r4aWebServerBufferPoolAllocate(object);
+        r4aWebServerAsyncStart(object, &config);
+
         // Start the web server
         error = httpd_start(&object->_webServer, &config);
         if (error != ESP_OK)
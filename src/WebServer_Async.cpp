@@ -0,0 +1,188 @@
+/**********************************************************************
+  WebServer_Async.cpp
+
+  Robots-For-All (R4A)
+  Web server async worker pool
+
+  The ESP-IDF web server calls the request handlers from a single
+  server task, so a long file download or camera image encode delays
+  all of the other requests.  Handlers for long requests call
+  r4aWebServerAsync which copies the request with
+  httpd_req_async_handler_begin and passes the copy to one of a small
+  pool of worker tasks.  The server task immediately returns to handle
+  the next request while the worker sends the response.
+
+  A worker is reserved before the request is copied.  When all of the
+  workers are busy the browser receives a 503 (Service Unavailable)
+  response with Retry-After instead of waiting in a queue behind the
+  long requests.  Each async request holds its socket open until the
+  worker completes, so max_open_sockets needs to allow for the workers.
+**********************************************************************/
+
+#include "R4A_ESP32.h"
+
+//****************************************
+// Constants
+//****************************************
+
+#define R4A_WEB_SERVER_ASYNC_STACK  8192    // Worker task stack size in bytes
+
+//****************************************
+// Types
+//****************************************
+
+typedef struct _R4A_WEB_SERVER_ASYNC_REQUEST
+{
+    httpd_req_t * _request;     // Copy of the request
+    R4A_WEB_SERVER_HANDLER _handler;    // Handler to call with the request
+} R4A_WEB_SERVER_ASYNC_REQUEST;
+
+//*********************************************************************
+// Handle the requests passed to the worker
+static void r4aWebServerAsyncTask(void * parameter)
+{
+    R4A_WEB_SERVER_ASYNC_REQUEST job;
+    R4A_WEB_SERVER * object;
+
+    object = (R4A_WEB_SERVER *)parameter;
+    while (1)
+    {
+        // Wait for a request
+        if (xQueueReceive(object->_asyncQueue, &job, portMAX_DELAY) != pdTRUE)
+            continue;
+
+        // Handle the request, then release the request copy and socket
+        job._handler(job._request);
+        httpd_req_async_handler_complete(job._request);
+
+        // This worker is idle again
+        xSemaphoreGive(object->_asyncIdle);
+    }
+}
+
+//*********************************************************************
+// Run a long request handler on an async worker task
+esp_err_t r4aWebServerAsync(httpd_req_t *request, R4A_WEB_SERVER_HANDLER handler)
+{
+    httpd_req_t * copy;
+    TaskHandle_t currentTask;
+    int index;
+    R4A_WEB_SERVER_ASYNC_REQUEST job;
+    R4A_WEB_SERVER * object;
+
+    // Determine if the worker pool is running
+    object = (R4A_WEB_SERVER *)httpd_get_global_user_ctx(request->handle);
+    if ((!object) || (!object->_asyncQueue))
+        return ESP_ERR_NOT_FOUND;
+
+    // Let the worker handle the request
+    currentTask = xTaskGetCurrentTaskHandle();
+    for (index = 0; index < R4A_WEB_SERVER_ASYNC_WORKERS_MAX; index++)
+        if (object->_asyncTask[index] == currentTask)
+            return ESP_ERR_NOT_FOUND;
+
+    // Reserve a worker, don't queue behind the long requests
+    if (xSemaphoreTake(object->_asyncIdle, 0) != pdTRUE)
+    {
+        r4aMetricIncrement(&r4aMetricWebAsyncBusy);
+        if (r4aWebServerDebug)
+            r4aWebServerDebug->printf("ERROR: All web server workers are busy, rejecting %s\r\n",
+                                      request->uri);
+        httpd_resp_set_status(request, "503 Service Unavailable");
+        httpd_resp_set_hdr(request, "Retry-After", "1");
+        return httpd_resp_sendstr(request, "Web server busy");
+    }
+
+    // Copy the request, the server task handles the request upon failure
+    if (httpd_req_async_handler_begin(request, &copy) != ESP_OK)
+    {
+        xSemaphoreGive(object->_asyncIdle);
+        if (r4aWebServerDebug)
+            r4aWebServerDebug->printf("ERROR: Failed to copy the request for %s\r\n",
+                                      request->uri);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    // Pass the request to the reserved worker, the queue holds an entry
+    // for each worker.  Count the request first, the worker may send
+    // the response before xQueueSend returns.
+    r4aMetricIncrement(&r4aMetricWebAsyncRequests);
+    job._request = copy;
+    job._handler = handler;
+    xQueueSend(object->_asyncQueue, &job, 0);
+    return ESP_OK;
+}
+
+//*********************************************************************
+// Start the async worker tasks
+bool r4aWebServerAsyncStart(R4A_WEB_SERVER * object, httpd_config_t * config)
+{
+    int index;
+    char name[16];
+    UBaseType_t priority;
+    BaseType_t status;
+    int workers;
+
+    // Determine if the pool is disabled or already running
+    workers = object->_asyncWorkers;
+    if ((workers == 0) || object->_asyncQueue)
+        return true;
+    if (workers > R4A_WEB_SERVER_ASYNC_WORKERS_MAX)
+        workers = R4A_WEB_SERVER_ASYNC_WORKERS_MAX;
+    priority = object->_asyncPriority ? object->_asyncPriority : config->task_priority;
+
+    do
+    {
+        // Allocate the request queue and idle worker count
+        object->_asyncIdle = xSemaphoreCreateCounting(workers, workers);
+        if (!object->_asyncIdle)
+            break;
+        object->_asyncQueue = xQueueCreate(workers, sizeof(R4A_WEB_SERVER_ASYNC_REQUEST));
+        if (!object->_asyncQueue)
+            break;
+
+        // Start the worker tasks
+        for (index = 0; index < workers; index++)
+        {
+            sprintf(name, "httpd_async%d", index);
+            status = xTaskCreatePinnedToCore(r4aWebServerAsyncTask,   // Function to implement the task
+                                             name,            // Name of the task
+                                             R4A_WEB_SERVER_ASYNC_STACK,  // Stack size in bytes
+                                             object,          // Task input parameter
+                                             priority,        // Priority of the task
+                                             &object->_asyncTask[index],  // Task handle
+                                             object->_asyncCore); // Core where the task should run
+            if (status != pdPASS)
+            {
+                // Run with the workers that started
+                object->_asyncTask[index] = nullptr;
+                if (r4aWebServerDebug)
+                    r4aWebServerDebug->printf("ERROR: Failed to create web server worker %d!\r\n", index);
+                if (index == 0)
+                    break;
+
+                // Remove the missing workers from the idle count
+                while (index++ < workers)
+                    xSemaphoreTake(object->_asyncIdle, 0);
+                break;
+            }
+        }
+        if (!object->_asyncTask[0])
+            break;
+        return true;
+    } while (0);
+
+    // Run the handlers in the server task
+    Serial.printf("ERROR: Failed to start the web server async workers!\r\n");
+    if (object->_asyncQueue)
+    {
+        vQueueDelete(object->_asyncQueue);
+        object->_asyncQueue = nullptr;
+    }
+    if (object->_asyncIdle)
+    {
+        vSemaphoreDelete(object->_asyncIdle);
+        object->_asyncIdle = nullptr;
+    }
+    return false;
+}
@@ -0,0 +1,123 @@
+/**********************************************************************
+  WebServer_Buffer.cpp
+
+  Robots-For-All (R4A)
+  Web server response buffer pool
+
+  The buffers used to send files and error pages are preallocated once,
+  in PSRAM when available, and owned by the R4A_WEB_SERVER object which
+  the handlers locate with httpd_get_global_user_ctx.  Each bit in
+  _bufferFree represents an available buffer.  A buffer is checked out
+  by clearing its bit with a compare and exchange and returned by
+  setting the bit again, so the server task and the async workers never
+  wait for a lock.  When the pool is empty or not configured the buffer
+  is allocated from the heap and counted by r4aMetricWebBufferMisses.
+**********************************************************************/
+
+#include "R4A_ESP32.h"
+
+//****************************************
+// Constants
+//****************************************
+
+#define R4A_WEB_SERVER_BUFFER_DEFAULT   8192    // Heap buffer size without a pool
+
+//*********************************************************************
+// Get a response buffer from the web server's buffer pool
+uint8_t * r4aWebServerBufferGet(httpd_req_t *request, size_t * length)
+{
+    uint32_t available;
+    uint8_t * buffer;
+    int index;
+    R4A_WEB_SERVER * object;
+
+    // Locate the buffer pool
+    object = (R4A_WEB_SERVER *)httpd_get_global_user_ctx(request->handle);
+    if (object && object->_bufferPool)
+    {
+        // Clear the bit of an available buffer
+        available = __atomic_load_n(&object->_bufferFree, __ATOMIC_RELAXED);
+        while (available)
+        {
+            index = __builtin_ctz(available);
+            if (__atomic_compare_exchange_n(&object->_bufferFree,
+                                            &available,
+                                            available & ~(1u << index),
+                                            false,
+                                            __ATOMIC_ACQUIRE,
+                                            __ATOMIC_RELAXED))
+            {
+                *length = object->_bufferSize;
+                return &object->_bufferPool[index * object->_bufferSize];
+            }
+        }
+    }
+
+    // Allocate the buffer from the heap
+    r4aMetricIncrement(&r4aMetricWebBufferMisses);
+    *length = (object && object->_bufferSize) ? object->_bufferSize
+                                              : R4A_WEB_SERVER_BUFFER_DEFAULT;
+    buffer = (uint8_t *)malloc(*length);
+    if ((!buffer) && r4aWebServerDebug)
+        r4aWebServerDebug->printf("ERROR: Failed to allocate the data buffer\r\n");
+    return buffer;
+}
+
+//*********************************************************************
+// Allocate the response buffer pool
+bool r4aWebServerBufferPoolAllocate(R4A_WEB_SERVER * object)
+{
+    uint8_t count;
+    size_t size;
+
+    // Determine if the pool is disabled or already allocated
+    count = object->_bufferCount;
+    if ((count == 0) || (object->_bufferSize == 0) || object->_bufferPool)
+        return true;
+    if (count > R4A_WEB_SERVER_BUFFERS_MAX)
+    {
+        count = R4A_WEB_SERVER_BUFFERS_MAX;
+        object->_bufferCount = count;
+    }
+    size = count * object->_bufferSize;
+
+    // Allocate the buffers, preferably in PSRAM
+    object->_bufferPool = (uint8_t *)heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+    if (!object->_bufferPool)
+        object->_bufferPool = (uint8_t *)malloc(size);
+    if (!object->_bufferPool)
+    {
+        Serial.printf("ERROR: Failed to allocate %d bytes for the web server buffers!\r\n",
+                      size);
+        return false;
+    }
+
+    // All of the buffers are available
+    __atomic_store_n(&object->_bufferFree,
+                     (count == 32) ? 0xffffffff : ((1u << count) - 1),
+                     __ATOMIC_RELEASE);
+    return true;
+}
+
+//*********************************************************************
+// Return a buffer obtained from r4aWebServerBufferGet
+void r4aWebServerBufferRelease(httpd_req_t *request, uint8_t * buffer)
+{
+    int index;
+    R4A_WEB_SERVER * object;
+
+    // Return the pool buffer by setting its bit
+    object = (R4A_WEB_SERVER *)httpd_get_global_user_ctx(request->handle);
+    if (object
+        && object->_bufferPool
+        && (buffer >= object->_bufferPool)
+        && (buffer < &object->_bufferPool[object->_bufferCount * object->_bufferSize]))
+    {
+        index = (buffer - object->_bufferPool) / object->_bufferSize;
+        __atomic_fetch_or(&object->_bufferFree, 1u << index, __ATOMIC_RELEASE);
+        return;
+    }
+
+    // Free the heap buffer
+    free(buffer);
+}
@@ -0,0 +1,209 @@
+/**********************************************************************
+  WebServer_Range.cpp
+
+  Robots-For-All (R4A)
+  Web server byte range support
+
+  The Range header allows the browser to request only part of a file,
+  such as the bytes recently appended to a log file or the remainder
+  of an interrupted download.  A single range is returned as a 206
+  (Partial Content) response.  Multiple ranges are returned as a 206
+  multipart/byteranges response with each part containing its own
+  Content-Range header.  A Range header that can't be parsed is
+  ignored and the whole file is returned, while ranges that are all
+  beyond the end of the file get a 416 (Range Not Satisfiable)
+  response.
+**********************************************************************/
+
+#include "R4A_ESP32.h"
+
+//****************************************
+// Constants
+//****************************************
+
+#define R4A_WEB_SERVER_RANGE_BOUNDARY   "R4A_BYTE_RANGE_BOUNDARY"
+#define R4A_WEB_SERVER_RANGE_HEADER     128 // Longest Range header value
+
+//*********************************************************************
+// Skip the white space
+static const char * r4aWebServerRangeSkipSpace(const char * value)
+{
+    while ((*value == ' ') || (*value == '\t'))
+        value++;
+    return value;
+}
+
+//*********************************************************************
+// Parse the value of a Range header
+int r4aWebServerRangeParse(const char * value,
+                           size_t fileSize,
+                           R4A_WEB_SERVER_RANGE * ranges,
+                           int maximumRanges)
+{
+    int count;
+    char * end;
+    size_t first;
+    size_t last;
+    bool satisfiable;
+
+    // Only byte ranges are supported
+    if (strncasecmp(value, "bytes=", strlen("bytes=")) != 0)
+        return -1;
+    value += strlen("bytes=");
+
+    // Walk the list of ranges
+    count = 0;
+    while (1)
+    {
+        value = r4aWebServerRangeSkipSpace(value);
+        if (*value == '-')
+        {
+            // Suffix range, the last N bytes of the file
+            value++;
+            if (!isdigit(*value))
+                return -1;
+            last = strtoul(value, &end, 10);
+            value = end;
+            satisfiable = (last > 0) && (fileSize > 0);
+            first = (last < fileSize) ? fileSize - last : 0;
+            last = fileSize - 1;
+        }
+        else
+        {
+            // First byte position
+            if (!isdigit(*value))
+                return -1;
+            first = strtoul(value, &end, 10);
+            value = end;
+            if (*value++ != '-')
+                return -1;
+
+            // Optional last byte position, defaults to the end of the file
+            if (isdigit(*value))
+            {
+                last = strtoul(value, &end, 10);
+                value = end;
+                if (last < first)
+                    return -1;
+                if (last >= fileSize)
+                    last = fileSize - 1;
+            }
+            else
+                last = fileSize - 1;
+            satisfiable = (first < fileSize);
+        }
+
+        // Save the range
+        if (satisfiable)
+        {
+            if (count >= maximumRanges)
+                return -1;
+            ranges[count]._offset = first;
+            ranges[count]._length = last + 1 - first;
+            count += 1;
+        }
+
+        // Locate the next range
+        value = r4aWebServerRangeSkipSpace(value);
+        if (*value == 0)
+            break;
+        if (*value++ != ',')
+            return -1;
+    }
+    return count;
+}
+
+//*********************************************************************
+// Send the byte ranges of a file requested by the Range header
+esp_err_t r4aWebServerRangeSend(httpd_req_t *request,
+                                File * file,
+                                const char * dataType)
+{
+    char contentRange[64];
+    int count;
+    size_t fileSize;
+    char header[R4A_WEB_SERVER_RANGE_HEADER];
+    int index;
+    size_t length;
+    char part[192];
+    R4A_WEB_SERVER_RANGE ranges[R4A_WEB_SERVER_RANGES_MAX];
+
+    // Get the Range header
+    length = httpd_req_get_hdr_value_len(request, "Range");
+    if ((length == 0) || (length >= sizeof(header)))
+        return ESP_ERR_NOT_FOUND;
+    if (httpd_req_get_hdr_value_str(request, "Range", header, sizeof(header)) != ESP_OK)
+        return ESP_ERR_NOT_FOUND;
+
+    // Ignore the Range header when it is not valid
+    fileSize = file->size();
+    count = r4aWebServerRangeParse(header, fileSize, ranges, R4A_WEB_SERVER_RANGES_MAX);
+    if (count < 0)
+    {
+        if (r4aWebServerDebug)
+            r4aWebServerDebug->printf("Ignoring Range: %s\r\n", header);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    // None of the ranges are within the file
+    if (count == 0)
+    {
+        snprintf(contentRange, sizeof(contentRange), "bytes */%u", fileSize);
+        httpd_resp_set_status(request, "416 Range Not Satisfiable");
+        httpd_resp_set_hdr(request, "Content-Range", contentRange);
+        return httpd_resp_send(request, nullptr, 0);
+    }
+    httpd_resp_set_status(request, "206 Partial Content");
+    httpd_resp_set_hdr(request, "Accept-Ranges", "bytes");
+
+    do
+    {
+        // Send a single range
+        if (count == 1)
+        {
+            snprintf(contentRange, sizeof(contentRange), "bytes %u-%u/%u",
+                     ranges[0]._offset,
+                     ranges[0]._offset + ranges[0]._length - 1,
+                     fileSize);
+            httpd_resp_set_type(request, dataType);
+            httpd_resp_set_hdr(request, "Content-Range", contentRange);
+            if ((!file->seek(ranges[0]._offset))
+                || (!r4aWebServerFileSend(request, file, ranges[0]._length)))
+                break;
+        }
+
+        // Send each range as a part of a multipart response
+        else
+        {
+            httpd_resp_set_type(request, "multipart/byteranges; boundary="
+                                         R4A_WEB_SERVER_RANGE_BOUNDARY);
+            for (index = 0; index < count; index++)
+            {
+                snprintf(part, sizeof(part),
+                         "\r\n--" R4A_WEB_SERVER_RANGE_BOUNDARY "\r\n"
+                         "Content-Type: %s\r\n"
+                         "Content-Range: bytes %u-%u/%u\r\n\r\n",
+                         dataType,
+                         ranges[index]._offset,
+                         ranges[index]._offset + ranges[index]._length - 1,
+                         fileSize);
+                if ((httpd_resp_sendstr_chunk(request, part) != ESP_OK)
+                    || (!file->seek(ranges[index]._offset))
+                    || (!r4aWebServerFileSend(request, file, ranges[index]._length)))
+                    break;
+            }
+            if (index < count)
+                break;
+            if (httpd_resp_sendstr_chunk(request, "\r\n--" R4A_WEB_SERVER_RANGE_BOUNDARY "--\r\n") != ESP_OK)
+                break;
+        }
+
+        // Send the final chunk
+        return httpd_resp_send_chunk(request, NULL, 0);
+    } while (0);
+
+    // The response is already started, the connection gets closed
+    if (r4aWebServerDebug)
+        r4aWebServerDebug->printf("ERROR: Failed to send the file ranges to the browser\r\n");
+    return ESP_FAIL;
+}
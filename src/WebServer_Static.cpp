@@ -0,0 +1,293 @@
+/**********************************************************************
+  WebServer_Static.cpp
+
+  Robots-For-All (R4A)
+  Web server static content
+
+  The static content is served from LittleFS.  Each response carries
+  an ETag built from the file's size and modification time along with
+  the Last-Modified time, allowing the browser to revalidate its cached
+  copy with If-None-Match or If-Modified-Since and receive a short 304
+  (Not Modified) response instead of the file.  When the browser
+  accepts gzip encoding and a .gz copy of the file exists, the
+  compressed copy is sent instead.
+**********************************************************************/
+
+#include "R4A_ESP32.h"
+
+//****************************************
+// Constants
+//****************************************
+
+#define R4A_WEB_SERVER_MIME_BUCKETS     64  // Power of 2, over twice the MIME types
+#define R4A_WEB_SERVER_MIME_EXTENSION   8   // Longest extension plus zero termination
+#define R4A_WEB_SERVER_STATIC_HEADER    128 // Longest request header value used
+#define R4A_WEB_SERVER_STATIC_PATH      128 // Longest file path
+#define R4A_WEB_SERVER_STATIC_TIME      1000000000  // Earliest valid file time, 2001
+
+// Value for the Cache-Control header, the browser keeps the content but
+// revalidates it before each use
+#define R4A_WEB_SERVER_STATIC_CACHE     "no-cache"
+
+//****************************************
+// Locals
+//****************************************
+
+// Hash table containing the r4aHttpMimeType index plus one, zero for empty
+static uint8_t r4aWebServerMimeBucket[R4A_WEB_SERVER_MIME_BUCKETS];
+static bool r4aWebServerMimeInitialized;
+
+//*********************************************************************
+// Compute the hash of the file extension (FNV-1a)
+static uint32_t r4aWebServerMimeHash(const char * extension)
+{
+    uint32_t hash;
+
+    hash = 2166136261;
+    while (*extension)
+        hash = (hash ^ (uint8_t)*extension++) * 16777619;
+    return hash;
+}
+
+//*********************************************************************
+// Build the MIME type hash table
+static void r4aWebServerMimeInit()
+{
+    uint32_t bucket;
+    int index;
+
+    if (r4aWebServerMimeInitialized)
+        return;
+
+    // Add each extension, using the next free bucket upon collision
+    for (index = 0; index < r4aHttpMimeTypeCount; index++)
+    {
+        bucket = r4aWebServerMimeHash(r4aHttpMimeType[index]._extension);
+        while (r4aWebServerMimeBucket[bucket & (R4A_WEB_SERVER_MIME_BUCKETS - 1)])
+            bucket += 1;
+        r4aWebServerMimeBucket[bucket & (R4A_WEB_SERVER_MIME_BUCKETS - 1)] = index + 1;
+    }
+    r4aWebServerMimeInitialized = true;
+}
+
+//*********************************************************************
+// Get a request header value, the value may be truncated
+static bool r4aWebServerStaticHeader(httpd_req_t *request,
+                                     const char * name,
+                                     char * value,
+                                     size_t length)
+{
+    esp_err_t status;
+
+    status = httpd_req_get_hdr_value_str(request, name, value, length);
+    if ((status == ESP_OK) || (status == ESP_ERR_HTTPD_RESULT_TRUNC))
+        return true;
+    value[0] = 0;
+    return false;
+}
+
+//*********************************************************************
+// Look up the MIME type for a file
+const char * r4aWebServerMimeType(const char * path)
+{
+    uint32_t bucket;
+    const char * dot;
+    char extension[R4A_WEB_SERVER_MIME_EXTENSION];
+    uint8_t entry;
+    size_t length;
+
+    r4aWebServerMimeInit();
+
+    // Locate the extension in the file name
+    dot = strrchr(path, '.');
+    if ((!dot) || strchr(dot, '/'))
+        return nullptr;
+    dot += 1;
+
+    // Convert the extension to lower case
+    for (length = 0; dot[length]; length++)
+    {
+        if (length >= (sizeof(extension) - 1))
+            return nullptr;
+        extension[length] = tolower(dot[length]);
+    }
+    extension[length] = 0;
+
+    // Search the buckets until an empty bucket is found
+    bucket = r4aWebServerMimeHash(extension);
+    while ((entry = r4aWebServerMimeBucket[bucket & (R4A_WEB_SERVER_MIME_BUCKETS - 1)]))
+    {
+        if (strcmp(r4aHttpMimeType[entry - 1]._extension, extension) == 0)
+            return r4aHttpMimeType[entry - 1]._type;
+        bucket += 1;
+    }
+    return nullptr;
+}
+
+//*********************************************************************
+// Serve static content from LittleFS
+esp_err_t r4aWebServerStaticFile(httpd_req_t *request)
+{
+    const char * dataType;
+    char etag[48];
+    File file;
+    bool gzip;
+    char header[R4A_WEB_SERVER_STATIC_HEADER];
+    char lastModified[32];
+    time_t lastWrite;
+    size_t length;
+    bool notModified;
+    char path[R4A_WEB_SERVER_STATIC_PATH + 4];
+    const char * query;
+    esp_err_t status;
+    struct tm timeFields;
+
+    // Send the file from an async worker
+    status = r4aWebServerAsync(request, r4aWebServerStaticFile);
+    if (status != ESP_ERR_NOT_FOUND)
+        return status;
+
+    do
+    {
+        // Verify the static content prefix
+        if ((!r4aWebServerStaticArea)
+            || (strncmp(r4aWebServerStaticArea, request->uri, strlen(r4aWebServerStaticArea)) != 0))
+        {
+            if (r4aWebServerDebug)
+                r4aWebServerDebug->printf("ERROR: Not a static content request\r\n");
+            httpd_resp_send_err(request, HTTPD_500_INTERNAL_SERVER_ERROR, "Not a static content request");
+            break;
+        }
+
+        // Get the file name, removing the query string
+        query = strchr(request->uri, '?');
+        length = query ? (query - request->uri) : strlen(request->uri);
+        if (length >= R4A_WEB_SERVER_STATIC_PATH)
+        {
+            httpd_resp_send_err(request, HTTPD_414_URI_TOO_LONG, "File path too long");
+            break;
+        }
+        memcpy(path, request->uri, length);
+        path[length] = 0;
+
+        // Use the index page for a directory
+        if (path[length - 1] == '/')
+        {
+            if ((length + strlen("index.html")) >= R4A_WEB_SERVER_STATIC_PATH)
+            {
+                httpd_resp_send_err(request, HTTPD_414_URI_TOO_LONG, "File path too long");
+                break;
+            }
+            strcpy(&path[length], "index.html");
+            length += strlen("index.html");
+        }
+
+        // Don't allow access outside of the static area
+        if (strstr(path, ".."))
+        {
+            httpd_resp_send_err(request, HTTPD_403_FORBIDDEN, "Invalid file path");
+            break;
+        }
+
+        // Determine the data type, sending unknown files as binary data
+        dataType = r4aWebServerMimeType(path);
+        if (!dataType)
+            dataType = "application/octet-stream";
+
+        // Use the compressed file when the browser accepts gzip
+        gzip = false;
+        if (r4aWebServerStaticHeader(request, "Accept-Encoding", header, sizeof(header))
+            && strstr(header, "gzip"))
+        {
+            strcpy(&path[length], ".gz");
+            gzip = LittleFS.exists(path);
+            if (!gzip)
+                path[length] = 0;
+        }
+
+        // Open the file
+        if ((!gzip) && (LittleFS.exists(path) == false))
+        {
+            if (r4aWebServerDebug)
+                r4aWebServerDebug->printf("ERROR: File %s does not exist!\r\n", path);
+            httpd_resp_send_err(request, HTTPD_404_NOT_FOUND, "File does not exist");
+            break;
+        }
+        file = LittleFS.open(path, FILE_READ);
+        if ((!file) || file.isDirectory())
+        {
+            if (r4aWebServerDebug)
+                r4aWebServerDebug->printf("ERROR: Failed to open file %s\r\n", path);
+            httpd_resp_send_err(request, HTTPD_404_NOT_FOUND, "Failed to open file");
+            break;
+        }
+
+        // Build the validators, the compressed file gets a different ETag
+        lastWrite = file.getLastWrite();
+        snprintf(etag, sizeof(etag), "\"%lx-%x%s\"",
+                 (uint32_t)lastWrite,
+                 file.size(),
+                 gzip ? "-gz" : "");
+        lastModified[0] = 0;
+        if (lastWrite >= R4A_WEB_SERVER_STATIC_TIME)
+        {
+            gmtime_r(&lastWrite, &timeFields);
+            strftime(lastModified, sizeof(lastModified),
+                     "%a, %d %b %Y %H:%M:%S GMT", &timeFields);
+        }
+
+        // Set the headers common to the 200 and 304 responses
+        httpd_resp_set_hdr(request, "ETag", etag);
+        httpd_resp_set_hdr(request, "Cache-Control", R4A_WEB_SERVER_STATIC_CACHE);
+        httpd_resp_set_hdr(request, "Vary", "Accept-Encoding");
+        if (lastModified[0])
+            httpd_resp_set_hdr(request, "Last-Modified", lastModified);
+
+        // Determine if the browser's copy is current, If-None-Match takes
+        // precedence over If-Modified-Since.  The browser returns the
+        // Last-Modified value unchanged, so a string comparison is used.
+        if (r4aWebServerStaticHeader(request, "If-None-Match", header, sizeof(header)))
+            notModified = strstr(header, etag) || (strcmp(header, "*") == 0);
+        else
+            notModified = lastModified[0]
+                && r4aWebServerStaticHeader(request, "If-Modified-Since", header, sizeof(header))
+                && (strcmp(header, lastModified) == 0);
+        if (notModified)
+        {
+            file.close();
+            httpd_resp_set_status(request, "304 Not Modified");
+            return httpd_resp_send(request, nullptr, 0);
+        }
+
+        // Send the requested parts of the file
+        if (gzip)
+            httpd_resp_set_hdr(request, "Content-Encoding", "gzip");
+        status = r4aWebServerRangeSend(request, &file, dataType);
+        if (status != ESP_ERR_NOT_FOUND)
+        {
+            file.close();
+            return status;
+        }
+
+        // Send the file contents to the browser
+        httpd_resp_set_type(request, dataType);
+        httpd_resp_set_hdr(request, "Accept-Ranges", "bytes");
+        if ((!r4aWebServerFileSend(request, &file, file.size()))
+            || (httpd_resp_send_chunk(request, NULL, 0) != ESP_OK))
+        {
+            httpd_resp_send_err(request, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to send data to browser");
+            break;
+        }
+
+        // Close the file
+        file.close();
+        return ESP_OK;
+    } while (0);
+
+    // Close the file if necessary
+    if (file)
+        file.close();
+
+    // Failed to access the requested page
+    return ESP_FAIL;
+}
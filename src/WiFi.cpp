@@ -211,6 +211,7 @@ void R4A_WIFI::eventHandler(arduino_event_id_t event, arduino_event_info_t info)
                             info.wifi_sta_disconnected.ssid);
 
         // Start the reconnection timer
+        r4aMetricIncrement(&r4aMetricWifiDisconnects);
         _wifiTimer = millis();
         break;
 
@@ -920,6 +921,7 @@ void R4A_WIFI::update()
             _wifiTimer = 0;
 
             // Start the WiFi scan
+            r4aMetricIncrement(&r4aMetricWifiReconnects);
             stationScanStart(_wifiChannel);
         }
     }